@@ -15,6 +15,7 @@
 #include <DEM/dT.h>
 #include <core/utils/ManagedAllocator.hpp>
 #include <core/utils/ThreadManager.h>
+#include <core/utils/AsyncWriter.h>
 #include <core/utils/GpuManager.h>
 #include <nvmath/helper_math.cuh>
 #include <DEM/Defines.h>
@@ -66,20 +67,141 @@ class DEMSolver {
         m_user_add_bounding_box = inst;
         m_bounding_box_material = mat;
     }
+    /// Make the simulation world periodic along any of X, Y and Z, with the periods being the domain size given by
+    /// InstructBoxDomainDimension. Clumps that leave through one side come back in from the other, and spheres near one
+    /// side touch those near the other. No bounding BC plane is added on the periodic sides. Meshes and analytical
+    /// objects do not see periodic images: a clump touches them only where it is, never across a periodic side, so
+    /// place them away from the periodic sides.
+    void InstructBoxDomainPeriodic(bool x, bool y, bool z) {
+        m_periodic_x = x;
+        m_periodic_y = y;
+        m_periodic_z = z;
+    }
+
+    /// Remove clumps that leave the simulation domain (the one given by InstructBoxDomainDimension, or the region set
+    /// by SetClumpKeepRegion). A clump is caught leaving in the step it does so, and is moved into family family_num,
+    /// which is fixed and has contacts with no one; then all clumps in that family are removed (see PurgeFamily)
+    /// whenever a DoDynamics call starts at least n_steps time steps after the last removal, and some clump has left
+    /// since (the integration kernels count them, so this check costs nothing). Periodic directions are not checked
+    /// unless a keep region is set. Analytical objects and meshes are never removed. This should be called before
+    /// initialization.
+    void UseOutOfDomainCulling(bool use = true,
+                               unsigned int family_num = DEFAULT_CULLED_FAMILY_NUM,
+                               unsigned int n_steps = 0) {
+        use_out_of_domain_culling = use;
+        m_culled_family = family_num;
+        m_cull_freq = n_steps;
+    }
+    /// Set the region (given by its left-bottom-front and right-top-front corners) that clumps have to stay in when
+    /// out-of-domain culling is in use, if it should be smaller than the simulation domain.
+    void SetClumpKeepRegion(float3 lbf, float3 rtf) {
+        m_keep_region_lbf = lbf;
+        m_keep_region_rtf = rtf;
+        use_user_keep_region = true;
+    }
+    /// Remove the clumps that have left the domain so far now (see UseOutOfDomainCulling), and return how many there
+    /// were. This syncs kT and dT.
+    size_t CullOutOfDomainClumps();
+    /// Get the number of clumps removed by out-of-domain culling so far
+    size_t GetNumCulledClumps() const { return m_num_culled_clumps; }
 
     /// Set gravity
     void SetGravitationalAcceleration(float3 g) { G = g; }
     /// Set the initial time step size. If using constant step size, then this will be used throughout; otherwise, the
     /// actual step size depends on the variable step strategy.
     void SetInitTimeStep(double ts_size) { m_ts_size = ts_size; }
+    /// Let dT choose the time step size after each step, within min_ts and max_ts. With MAX_VEL, it goes by the fastest
+    /// point; with INT_GAP, by the deepest contact overlap (see SetAdaptiveTimeStepTargets). Unless contact detection
+    /// is displacement-triggered, the step size is also kept small enough for the expand factor to cover the update
+    /// frequency. CONST goes back to the constant step size set by SetInitTimeStep.
+    void UseAdaptiveTimeStep(VAR_TS_STRAT strat, double min_ts, double max_ts) {
+        ts_size_is_const = (strat == VAR_TS_STRAT::CONST);
+        m_ts_strat = strat;
+        m_min_ts_size = min_ts;
+        m_max_ts_size = max_ts;
+    }
+    /// Set the targets of the variable time step size: with MAX_VEL, the fraction of the smallest sphere radius that
+    /// the fastest point moves in a step; with INT_GAP, the fraction of the smaller radius that the deepest contact
+    /// overlaps. The defaults are 0.01 and 0.01.
+    void SetAdaptiveTimeStepTargets(float max_disp_fraction, float max_overlap_fraction) {
+        m_ts_disp_fraction = max_disp_fraction;
+        m_ts_overlap_fraction = max_overlap_fraction;
+    }
     /// Return the number of clumps that are currently in the simulation
     size_t GetNumClumps() { return nOwnerClumps; }
-    /// Get the current time step size in simulation
+    /// Get the current time step size in simulation (with a variable step size, the one the next step uses)
     double GetTimeStepSize();
     /// Getthe current expand factor in simulation
     float GetExpandFactor();
     /// Set the number of dT steps before it waits for a contact-pair info update from kT
     void SetCDUpdateFreq(int freq) { m_updateFreq = freq; }
+    /// Let the solver choose the update frequency between DoDynamics calls, in the range of min_freq to max_freq, and
+    /// (unless it is fixed by SetExpandFactor) the expand factor that goes with it. It goes by the kT and dT costs
+    /// measured in the previous calls, how often dT was held back waiting for kT, and the max velocity of any point
+    /// sampled before each call, so the frequency follows the simulation as it goes through phases (e.g. filling,
+    /// settling, shaking). The frequency set by SetCDUpdateFreq is where it starts from. Displacement-triggered contact
+    /// detection, if in use, takes precedence. If the max velocity is so high that even min_freq would let a point get
+    /// beyond the expand factor between contact detections, a lower frequency is used (with a warning).
+    void UseAutoCDUpdateFreq(bool use = true,
+                             unsigned int min_freq = DEME_CD_AUTO_FREQ_MIN,
+                             unsigned int max_freq = DEME_CD_AUTO_FREQ_MAX) {
+        use_auto_cd_update_freq = use;
+        m_cd_update_freq_min = min_freq;
+        m_cd_update_freq_max = max_freq;
+    }
+    /// Set how dT and kT wait for each other to hand over work: check n_spins times in a busy loop, then n_yields times
+    /// giving up the CPU in between, then sleep until woken up. Spinning longer cuts the handoff latency when contact
+    /// detection is frequent and the system is small, at the cost of keeping CPU cores busy. The default is 512 spins
+    /// and 16 yields.
+    void SetHandoffBackoff(unsigned int n_spins, unsigned int n_yields) {
+        m_handoff_backoff.nSpins = n_spins;
+        m_handoff_backoff.nYields = n_yields;
+    }
+    /// Instruct dT to ask kT for a new contact list only when the owners have moved far enough since the contact list
+    /// in use was detected (Verlet skin style), instead of every SetCDUpdateFreq steps. A contact list is given up
+    /// before any point of any owner moves further than the expand factor. If max_steps_per_list is non-negative, a
+    /// contact list is also used for at most that many steps (useful if families change on-the-fly). Unless it is fixed
+    /// by SetExpandFactor, the expand factor is then chosen automatically between DoDynamics calls, based on the
+    /// measured kT and dT costs and owner velocities. Note only the translation of analytical objects is accounted for,
+    /// not their rotation.
+    void UseDisplacementTriggeredCD(bool use = true, int max_steps_per_list = -1) {
+        use_displacement_triggered_cd = use;
+        m_cd_max_steps_per_list = max_steps_per_list;
+    }
+    /// Rearrange clumps and their spheres in memory along a Morton (Z-order) curve of their locations, so that clumps
+    /// close in space are close in memory, whenever a DoDynamics call starts at least this many time steps after the
+    /// last time. Owner IDs (used by trackers, the getters/setters and output) do not change. 0 (the default) disables
+    /// it.
+    void SetSpatialReorderFreq(unsigned int n_steps) { m_spatial_reorder_freq = n_steps; }
+    /// Rearrange clumps and their spheres in memory along a Morton curve now (see SetSpatialReorderFreq). This syncs kT
+    /// and dT, and the next DoDynamics call starts with a new contact detection.
+    void ReorderSpatially();
+    /// Let clumps fall asleep (deactivate) after they stay quiet for n_quiet_steps steps in a row, see
+    /// SetSleepThresholds. A sleeping clump is not integrated, and its contacts with other sleeping clumps are frozen
+    /// (no force calculation, and their contact history stays as it is). It wakes up when an owner that moves, or feels
+    /// changing forces, touches it (this includes prescribed bodies coming within the expand factor), or when its
+    /// velocity or family is changed from the outside. Clumps with prescribed motion never sleep.
+    void UseSleeping(bool use = true, unsigned int n_quiet_steps = DEME_SLEEP_QUIET_STEPS) {
+        use_sleeping = use;
+        m_sleep_quiet_steps = n_quiet_steps;
+    }
+    /// Set the velocity, angular velocity and acceleration change between steps (contact forces only) below which a
+    /// clump counts as quiet. By default, a clump is quiet if none of its points moves further than 1e-5 of the
+    /// smallest sphere radius in a step, and its acceleration changes by less than 1% of the gravitational
+    /// acceleration. With a variable step size, these defaults follow the step size as it changes.
+    void SetSleepThresholds(float max_vel, float max_ang_vel, float max_acc_change) {
+        m_sleep_max_vel = max_vel;
+        m_sleep_max_ang_vel = max_ang_vel;
+        m_sleep_max_acc_change = max_acc_change;
+    }
+    /// Get the number of clumps that are currently asleep
+    size_t GetNumSleepingClumps() const;
+    /// Set the range that the automatically chosen expand factor stays in (displacement-triggered contact detection
+    /// only). The default range is 0.005 to 0.5 times the smallest sphere radius.
+    void SetExpandFactorBounds(float min_beta, float max_beta) {
+        m_expand_factor_min = min_beta;
+        m_expand_factor_max = max_beta;
+    }
     // TODO: Implement an API that allows setting ts size through a list
 
     /// Sets the origin of your coordinate system
@@ -98,6 +220,9 @@ class DEMSolver {
     /// Get the jitification string substitution laundary list. It is needed by some of this simulation system's friend
     /// classes.
     std::unordered_map<std::string, std::string> GetJitStringSubs() { return m_subs; }
+    /// Get the on-disk JIT cache of this simulation system (null if it is not in use). It is needed by some of this
+    /// simulation system's friend classes.
+    std::shared_ptr<JitDiskCache> GetJitDiskCache() { return m_jit_disk_cache; }
 
     /// Explicitly instruct the bin size (for contact detection) that the solver should use
     void SetInitBinSize(double bin_size) {
@@ -135,10 +260,33 @@ class DEMSolver {
     void SetJitifyMassProperties(bool use = true) { jitify_mass_moi = use; }
 
     /// Instruct the contact detection process to use one thread to process a bin (if true), instead of using a block to
-    /// process a bin. This probably also requires you to manually set a smaller DEME_MAX_SPHERES_PER_BIN. This can
-    /// potentially be faster especially in a scenario where the spheres are of similar sizes.
+    /// process a bin. Bins with more than DEME_MAX_SPHERES_PER_BIN_ONE_THREAD spheres are then processed through the
+    /// (slower) overfull-bin path. This can potentially be faster especially in a scenario where the spheres are of
+    /// similar sizes.
     void SetOneBinPerThread(bool use = true) { use_one_bin_per_thread = use; }
 
+    /// Instruct contact detection to use a hierarchy of bin levels (if true), where level k bins are 2^k times as large
+    /// as the base bins and each sphere is registered only in the level that matches its size. For systems with widely
+    /// different sphere sizes, this keeps the big spheres from touching a huge number of small bins. The number of
+    /// levels is decided at initialization, from the ratio between the largest sphere and the bin size.
+    void UseBinHierarchy(bool use = true) { use_bin_hierarchy = use; }
+
+    /// Instruct kT to do contact detection using host (CPU) threads, instead of GPU kernels. It produces the same contact
+    /// pair arrays as the GPU version, so it can also serve as a reference for checking the GPU results (see
+    /// DEMdemo_CDValidation). kT then builds no kernels, but a GPU is still needed: the solver arrays are in managed
+    /// memory, and dT still runs on it unless SetHostDynamics is also used.
+    void SetHostContactDetection(bool use = true) { use_host_contact_detection = use; }
+
+    /// Instruct dT to do its per-step work (force calculation, force collection, integration and family changes) using
+    /// host (CPU) threads. The force model and integration strategies are the same jitified ones, just compiled as host
+    /// code. Note a GPU is still needed: the solver arrays are in managed memory, and calls made between steps (such as
+    /// ChangeClumpSizes) still run GPU kernels.
+    void SetHostDynamics(bool use = true) { use_host_dynamics = use; }
+
+    /// Set the number of host threads that the host-side computations (such as host contact detection) can use. The
+    /// default value 0 means using all the hardware concurrency available.
+    void SetNumHostThreads(unsigned int n) { m_num_host_threads = n; }
+
     // NOTE: compact force calculation (in the hope to use shared memory) is not implemented
     void UseCompactForceKernel(bool use_compact);
 
@@ -299,6 +447,20 @@ class DEMSolver {
     /// of some random number)
     void EnsureKernelErrMsgLineNum(bool flag = true) { m_ensure_kernel_line_num = flag; }
 
+    /// Whether to keep the compiled kernels (and the host programs of SetHostContactDetection and SetHostDynamics) in
+    /// an on-disk cache, so later runs with the same kernel source, substitutions, compile flags and toolchain can skip
+    /// the JIT compilation. Default is off. When on, the cache is in the deme_jit_cache directory under the system's
+    /// temp directory (see SetJitCachePath), takes up to 1 GB (see SetJitCacheSizeLimit), and can be deleted whenever
+    /// no simulation is running. Either way, a kernel compiled once is reused by all solvers in the same process.
+    void UseJitCache(bool use = true) { use_jit_disk_cache = use; }
+    /// Set the directory of the on-disk JIT cache. Several processes can share one directory.
+    void SetJitCachePath(const std::filesystem::path& dir) { m_jit_cache_dir = dir; }
+    /// Set the maximum total size (in bytes) of the on-disk JIT cache (1 GB by default). Least recently used entries
+    /// are evicted first.
+    void SetJitCacheSizeLimit(size_t max_bytes) { m_jit_cache_max_bytes = max_bytes; }
+    /// Show the hits, misses and size of the on-disk JIT cache
+    void ShowJitCacheStats();
+
     /// Add an (analytical or clump-represented) external object to the simulation system
     std::shared_ptr<DEMExternObj> AddExternalObject();
     std::shared_ptr<DEMExternObj> AddBCPlane(const float3 pos,
@@ -382,7 +544,7 @@ class DEMSolver {
     void DoDynamics(double thisCallDuration);
 
     /// Equivalent to calling DoDynamics with the time step size as the argument
-    void DoStepDynamics() { DoDynamics(m_ts_size); }
+    void DoStepDynamics() { DoDynamics(GetTimeStepSize()); }
 
     /// Copy the cached sim params to the GPU-accessible managed memory, so that they are picked up from the next ts of
     /// simulation. Usually used when you want to change simulation parameters after the system is already Intialized.
@@ -391,6 +553,39 @@ class DEMSolver {
     /// Transfer newly loaded clumps to the GPU-side in mid-simulation
     void UpdateClumps();
 
+    /// Stage clumps (given the same way as in AddClumps) to be inserted into the running simulation, typically a few at
+    /// a time as an inflow. They go in when InsertStagedClumps is called, or else at the start of the next DoDynamics
+    /// call. Unlike with UpdateClumps, inserting them costs time proportional to the number of staged clumps, not to
+    /// the number of clumps already in the simulation, unless the overlap check is turned on (see
+    /// SetInflowOverlapCheck). To track a staged batch, create its tracker before it is inserted.
+    std::shared_ptr<DEMClumpBatch> AddInflowClumps(DEMClumpBatch& input_batch);
+    std::shared_ptr<DEMClumpBatch> AddInflowClumps(const std::vector<std::shared_ptr<DEMClumpTemplate>>& input_types,
+                                                   const std::vector<float3>& input_xyz);
+    std::shared_ptr<DEMClumpBatch> AddInflowClumps(std::shared_ptr<DEMClumpTemplate>& input_type,
+                                                   const std::vector<float3>& input_xyz) {
+        return AddInflowClumps(std::vector<std::shared_ptr<DEMClumpTemplate>>(input_xyz.size(), input_type),
+                               input_xyz);
+    }
+    /// Insert the staged clumps (see AddInflowClumps) now, leaving out those whose CoM is outside the simulation world
+    /// (and those that would overlap, if SetInflowOverlapCheck is used), and return the number of clumps inserted. kT
+    /// and dT are not synced unless the arrays have to be reallocated to make room, which happens once in a while as
+    /// they grow geometrically: kT finishes the contact detection it may be working on, and the inserted clumps are in
+    /// the next one. Until then they have no contacts, so clumps inserted next to others should be given a gap of at
+    /// least the contact margin (see SetExpandFactor).
+    size_t InsertStagedClumps();
+    /// Set whether staged clumps that would overlap a clump in the simulation, or another staged clump inserted along
+    /// with them, are left out at insertion, and the gap that has to be left between two spheres. It is off by default.
+    /// Analytical objects and meshes are not checked against. The check makes one pass over all the spheres already in
+    /// the simulation (a kernel launch, or a host pass if SetHostDynamics is used), in which a sphere far from the
+    /// staged ones only does a bounding box test; so it is cheap next to a time step, but unlike the rest of the
+    /// insertion, its cost grows with the simulation. It is for when the inflow region is not known to be clear.
+    void SetInflowOverlapCheck(bool check = true, float clearance = 0.f) {
+        m_inflow_check_overlap = check;
+        m_inflow_clearance = clearance;
+    }
+    /// Get the number of staged clumps left out at insertion so far
+    size_t GetNumRejectedInflowClumps() const { return m_num_rejected_inflow_clumps; }
+
     /// Show the collaboration stats between dT and kT. This is more useful for tweaking the number of time steps that
     /// dT should be allowed to be in advance of kT.
     void ShowThreadCollaborationStats();
@@ -406,8 +601,12 @@ class DEMSolver {
     /// Reset the recordings of the wall time and percentages of wall time spend on various solver tasks
     void ClearTimingStats();
 
-    /// Removes all entities associated with a family from the arrays (to save memory space)
-    void PurgeFamily(unsigned int family_num);
+    /// Removes all clumps of a family (and their spheres and contacts) from the simulation, so they no longer take up
+    /// memory or time. The remaining clumps and spheres keep their order, but are numbered from 0 again, and trackers
+    /// follow what is left of the clumps they track (a tracker whose clumps are all gone is marked broken). Analytical
+    /// objects and meshes of this family stay. This syncs kT and dT, and is meant to be called once in a while. Returns
+    /// the number of clumps removed.
+    size_t PurgeFamily(unsigned int family_num);
 
     /// Release the memory for the flattened arrays (which are used for initialization pre-processing and transferring
     /// info the worker threads)
@@ -426,17 +625,35 @@ class DEMSolver {
     // call.
     // void SetClumpOutputMode(OUTPUT_MODE mode) { m_clump_out_mode = mode; }
 
-    /// Choose output format
+    /// Choose output format. BINARY files hold typed columns and can be read back with DEMSnapshot::ReadFile. CHPF
+    /// clump (and contact) files come with a .types.csv side table of the names that the clump type (contact type)
+    /// column numbers. NATIVE clump files are BINARY files that hold positions as the solver stores them, exact and
+    /// more compact (see DecodeNativeSnapshot); sphere files in NATIVE are written as BINARY.
     void SetOutputFormat(OUTPUT_FORMAT format) { m_out_format = format; }
+    /// Set the bits per quaternion component in NATIVE clump files: 8 or 16 to quantize them, or 32 (the default) to
+    /// keep them as they are
+    void SetNativeOutputQuatBits(unsigned int bits);
     /// Specify the information that needs to go into the clump or sphere output files
     void SetOutputContent(unsigned int content) { m_out_content = content; }
-    /// Specify the file format of contact pairs
+    /// Specify the file format of contact pairs (any of those SetOutputFormat takes)
     void SetContactOutputFormat(OUTPUT_FORMAT format) { m_cnt_out_format = format; }
     /// Specify the information that needs to go into the contact pair output files
     void SetContactOutputContent(unsigned int content) { m_cnt_out_content = content; }
+    /// Set the number of significant digits of floating-point numbers in CSV output files (6 by default). 0 means as
+    /// many as it takes for each number to read back exactly.
+    void SetCsvPrecision(unsigned int digits) { m_csv_format.precision = digits; }
+    /// Write only these columns (such as {"X", "Y", "Z", "family"}), in this order, to CSV output files. Columns that a
+    /// file does not have are skipped; an empty list (the default) means all columns.
+    void SetCsvColumns(const std::vector<std::string>& names) { m_csv_format.columns = names; }
+    /// Write output files in the background. WriteSphereFile, WriteClumpFile and WriteContactFile then only copy what
+    /// is to be written and return, and n_threads writer threads format and write the files. At most max_pending files
+    /// wait to be written; past that, the write calls block until one is done.
+    void SetAsyncOutput(bool use = true, unsigned int n_threads = 1, unsigned int max_pending = 4);
+    /// Wait until all output files handed to the background writers are written
+    void WaitForPendingOutput();
 
     /// Let dT do this call and return the reduce value of the inspected quantity
-    float dTInspectReduce(const std::shared_ptr<jitify::Program>& inspection_kernel,
+    float dTInspectReduce(const std::shared_ptr<JitProgram>& inspection_kernel,
                           const std::string& kernel_name,
                           INSPECT_ENTITY_TYPE thing_to_insp,
                           CUB_REDUCE_FLAVOR reduce_flavor,
@@ -462,11 +679,34 @@ class DEMSolver {
     bool jitify_mass_moi = false;
     // CD uses one thread (not one block) to process a bin
     bool use_one_bin_per_thread = false;
+    // CD bins spheres into a hierarchy of bin levels based on their sizes
+    bool use_bin_hierarchy = false;
+    // CD is done by host threads rather than GPU kernels
+    bool use_host_contact_detection = false;
+    // dT's force calculation and integration are done by host threads rather than GPU kernels
+    bool use_host_dynamics = false;
+    // Number of host threads for host-side computations (0 means hardware concurrency)
+    unsigned int m_num_host_threads = 0;
 
     // User explicitly set a bin size to use
     bool use_user_defined_bin_size = false;
     // User explicity specify a expand factor to use
     bool use_user_defined_expand_factor = false;
+    // dT asks for new contact lists based on owner displacements, not a fixed update frequency
+    bool use_displacement_triggered_cd = false;
+    // The max number of steps a contact list can be used for in displacement-triggered CD (negative means no limit)
+    int m_cd_max_steps_per_list = -1;
+    // Quiet clumps fall asleep after this many quiet steps, and the thresholds of being quiet (non-positive values
+    // mean using the default)
+    bool use_sleeping = false;
+    unsigned int m_sleep_quiet_steps = DEME_SLEEP_QUIET_STEPS;
+    float m_sleep_max_vel = -1.f;
+    float m_sleep_max_ang_vel = -1.f;
+    float m_sleep_max_acc_change = -1.f;
+    // The update frequency is chosen between DoDynamics calls, in this range
+    bool use_auto_cd_update_freq = false;
+    unsigned int m_cd_update_freq_min = DEME_CD_AUTO_FREQ_MIN;
+    unsigned int m_cd_update_freq_max = DEME_CD_AUTO_FREQ_MAX;
 
     // I/O related flags
     // The output file format for clumps and spheres
@@ -477,6 +717,12 @@ class DEMSolver {
     OUTPUT_FORMAT m_cnt_out_format = OUTPUT_FORMAT::CSV;
     // The output file content for contact pairs
     unsigned int m_cnt_out_content = CNT_OUTPUT_CONTENT::FORCE | CNT_OUTPUT_CONTENT::POINT;
+    // Bits per quaternion component in NATIVE clump files
+    unsigned int m_native_quat_bits = 32;
+    // Precision and column selection of CSV output files
+    DEMCsvFormat m_csv_format;
+    // Writer threads that format and write output files in the background, if asynchronous output is on
+    std::unique_ptr<AsyncWriter> m_async_writer;
 
     // User instructed simulation `world' size. Note it is an approximate of the true size and we will generate a world
     // not smaller than this.
@@ -502,18 +748,26 @@ class DEMSolver {
     double m_voxelSize;
     // Time step size
     double m_ts_size = -1.0;
-    // If the time step size is a constant (if not, it needs to be supplied with a file or a function)
+    // If the time step size is a constant (if not, dT chooses it with this strategy, in this range, going by these
+    // targets)
     bool ts_size_is_const = true;
+    VAR_TS_STRAT m_ts_strat = VAR_TS_STRAT::CONST;
+    double m_min_ts_size = -1.0;
+    double m_max_ts_size = -1.0;
+    float m_ts_disp_fraction = DEME_TS_DISP_FRACTION;
+    float m_ts_overlap_fraction = DEME_TS_OVERLAP_FRACTION;
     // The length unit. Any XYZ we report to the user, is under the hood a multiple of this l.
     float l = FLT_MAX;
     // The edge length of a bin (for contact detection)
     double m_binSize;
-    // Total number of bins
+    // Total number of bins (of all levels)
     size_t m_num_bins;
-    // Number of bins on each direction
+    // Number of bins on each direction (of the finest level)
     binID_t nbX;
     binID_t nbY;
     binID_t nbZ;
+    // Number of levels in the bin hierarchy (1 if the hierarchy is not used)
+    unsigned int m_num_bin_levels = 1;
     // The amount at which all geometries inflate (for safer contact detection)
     float m_expand_factor = 0.f;
     // When the user suggests the expand factor without explicitly setting it, the `just right' amount of expansion is
@@ -523,6 +777,24 @@ class DEMSolver {
     float m_expand_safety_param = 1.f;
     // User-instructed approximate maximum velocity (of any point on a body in the simulation)
     float m_approx_max_vel = -1.f;
+    // The range of the automatically chosen expand factor (non-positive values mean using the default)
+    float m_expand_factor_min = -1.f;
+    float m_expand_factor_max = -1.f;
+    // The kT and dT timer readings when the expand factor was last chosen
+    double m_expand_tune_kT_time = 0.;
+    double m_expand_tune_dT_time = 0.;
+    // The dT timer reading of waiting for kT, and the max velocity estimate, when the update frequency was last chosen
+    double m_expand_tune_wait_time = 0.;
+    float m_cd_freq_tune_max_vel = -1.f;
+    // If the user was told that the max velocity pushed the update frequency below their minimum
+    bool m_cd_freq_below_min_warned = false;
+    // Samples the max velocity for choosing the update frequency
+    std::shared_ptr<DEMInspector> m_max_vel_inspector;
+    // Clumps are rearranged in memory every this many time steps (0 for never), and the steps run since the last time
+    unsigned int m_spatial_reorder_freq = 0;
+    uint64_t m_steps_since_reorder = 0;
+    // If kT and dT are both idle. dT always is between user calls, but after DoDynamics, kT may still be working.
+    bool workers_in_sync = true;
 
     // The number of user-estimated (max) number of owners that will be present in the simulation. If 0, then the arrays
     // will just be resized at intialization based on the input size.
@@ -534,10 +806,14 @@ class DEMSolver {
     bool sys_initialized = false;
     // Smallest sphere radius (used to let the user know whether the expand factor is sufficient)
     float m_smallest_radius = FLT_MAX;
+    // Largest sphere radius (used to decide the number of bin levels, and to check the periodic domain size)
+    float m_largest_radius = 0.f;
 
     // The number of dT steps before it waits for a kT update. The default value 0 means every dT step will wait for a
     // newly produced contact-pair info (from kT) before proceeding.
     int m_updateFreq = 0;
+    // How dT and kT wait for each other's handoffs
+    HandoffBackoff m_handoff_backoff;
 
     // Where the user wants the origin of the coordinate system to be
     std::string m_user_instructed_origin = "explicit";
@@ -547,6 +823,28 @@ class DEMSolver {
     std::string m_user_add_bounding_box = "none";
     // And the material should be used for the bounding BCs
     std::shared_ptr<DEMMaterial> m_bounding_box_material;
+    // If the simulation world is periodic along X, Y and Z
+    bool m_periodic_x = false;
+    bool m_periodic_y = false;
+    bool m_periodic_z = false;
+    // If clumps leaving the domain (or the keep region, if the user set one) are removed, and the family they are moved
+    // into before that
+    bool use_out_of_domain_culling = false;
+    unsigned int m_culled_family = DEFAULT_CULLED_FAMILY_NUM;
+    bool use_user_keep_region = false;
+    float3 m_keep_region_lbf;
+    float3 m_keep_region_rtf;
+    // The culled clumps are removed every this many time steps (0 for at the start of every DoDynamics call), and the
+    // steps run since the last time, and how many were removed in all
+    unsigned int m_cull_freq = 0;
+    uint64_t m_steps_since_cull = 0;
+    size_t m_num_culled_clumps = 0;
+    // Clumps staged for insertion into the running simulation, if those that would overlap are left out (and the gap
+    // needed between two spheres), and how many were left out in all
+    std::vector<std::shared_ptr<DEMClumpBatch>> m_staged_inflow_batches;
+    bool m_inflow_check_overlap = false;
+    float m_inflow_clearance = 0.f;
+    size_t m_num_rejected_inflow_clumps = 0;
     // Along which direction the size of the simulation world representable with our integer-based voxels needs to be
     // exactly the same as user-instructed simulation domain size?
     SPATIAL_DIR m_box_dir_length_is_exact = SPATIAL_DIR::NONE;
@@ -554,6 +852,13 @@ class DEMSolver {
     // If we should ensure that when kernel jitification fails, the line number reported reflexes where error happens
     bool m_ensure_kernel_line_num = false;
 
+    // If the compiled kernels should be cached on disk, and where, and how large the cache can grow
+    bool use_jit_disk_cache = false;
+    std::filesystem::path m_jit_cache_dir = std::filesystem::temp_directory_path() / "deme_jit_cache";
+    size_t m_jit_cache_max_bytes = (size_t)1 << 30;
+    // This solver's on-disk cache, set up at jitification (null if not in use)
+    std::shared_ptr<JitDiskCache> m_jit_disk_cache;
+
     // Integrator type
     TIME_INTEGRATOR m_integrator = TIME_INTEGRATOR::EXTENDED_TAYLOR;
 
@@ -823,6 +1128,8 @@ class DEMSolver {
     void figureOutNV();
     /// Derive the origin of the coordinate system using user inputs
     void figureOutOrigin();
+    /// Find the smallest and largest sphere radii among the clump templates
+    void findSphereRadiusRange();
     /// Set the default bin (for contact detection) size to be the same of the smallest sphere
     void decideBinSize();
     /// Add boundaries to the simulation `world' based on user instructions
@@ -856,6 +1163,20 @@ class DEMSolver {
     /// stall the siumulation. So perhaps the user should not call it without knowing what they are doing. Also note
     /// this call does not reset the collaboration log between kT and dT.
     void resetWorkerThreads();
+    // Write a snapshot to a file of this format, in the background if asynchronous output is on
+    void writeSnapshotFile(std::shared_ptr<DEMSnapshot> snap,
+                           const std::string& outfilename,
+                           OUTPUT_FORMAT format) const;
+    /// The range that the automatically chosen expand factor stays in
+    void getExpandFactorBounds(float& min_beta, float& max_beta) const;
+    /// The kT and dT timer readings of the work that grows with the expand factor
+    void getExpandFactorDependentTimes(double& dT_time, double& kT_time) const;
+    /// Re-choose the expand factor of displacement-triggered CD, based on the cost and motion measured since it was
+    /// last chosen
+    void tuneExpandFactor();
+    /// Re-choose the update frequency (and the expand factor that goes with it), based on the cost measured since it
+    /// was last chosen and the max velocity now
+    void tuneCDUpdateFreq();
     /// Transfer newly loaded clumps/meshed objects to the GPU-side in mid-simulation and allocate GPU memory space for
     /// them
     void updateClumpMeshArrays(size_t nOwners, size_t nClumps, size_t nSpheres, size_t nTriMesh, size_t nFacets);
@@ -7,6 +7,7 @@
 #include <DEM/API.h>
 #include <DEM/Defines.h>
 #include <DEM/HostSideHelpers.hpp>
+#include <core/utils/JitHelper.h>
 
 #include <iostream>
 #include <fstream>
@@ -201,6 +202,14 @@ void DEMSolver::addAnalCompTemplate(const objType_t type,
 }
 
 void DEMSolver::jitifyKernels() {
+    // Programs built from now on use (or do not use) this solver's on-disk cache. Keep the existing one (and its stats)
+    // if nothing changed.
+    if (!use_jit_disk_cache) {
+        m_jit_disk_cache.reset();
+    } else if (!m_jit_disk_cache || m_jit_disk_cache->getDir() != m_jit_cache_dir ||
+               m_jit_disk_cache->getMaxBytes() != m_jit_cache_max_bytes) {
+        m_jit_disk_cache = std::make_shared<JitDiskCache>(m_jit_cache_dir, m_jit_cache_max_bytes);
+    }
     equipClumpTemplates(m_subs);
     equipSimParams(m_subs);
     equipMassMoiVolume(m_subs);
@@ -210,8 +219,8 @@ void DEMSolver::jitifyKernels() {
     equipFamilyOnFlyChanges(m_subs);
     equipForceModel(m_subs);
     equipIntegrationScheme(m_subs);
-    kT->jitifyKernels(m_subs);
-    dT->jitifyKernels(m_subs);
+    kT->jitifyKernels(m_subs, m_jit_disk_cache);
+    dT->jitifyKernels(m_subs, m_jit_disk_cache);
 
     // Now, inspectors need to be jitified too... but the current design jitify inspector kernels at the first time they
     // are used. for (auto& insp : m_inspectors) {
@@ -332,15 +341,17 @@ void DEMSolver::figureOutNV() {
     m_boxZ = m_voxelSize * (double)((size_t)1 << nvZp2);
 }
 
-void DEMSolver::decideBinSize() {
-    // find the smallest radius
-    for (auto elem : m_template_sp_radii) {
-        for (auto radius : elem) {
-            if (radius < m_smallest_radius) {
-                m_smallest_radius = radius;
-            }
+void DEMSolver::findSphereRadiusRange() {
+    for (const auto& elem : m_template_sp_radii) {
+        for (const auto& radius : elem) {
+            m_smallest_radius = std::min(m_smallest_radius, radius);
+            m_largest_radius = std::max(m_largest_radius, radius);
         }
     }
+}
+
+void DEMSolver::decideBinSize() {
+    findSphereRadiusRange();
 
     // TODO: What should be a default bin size?
     if (m_smallest_radius > DEME_TINY_FLOAT) {
@@ -366,6 +377,32 @@ void DEMSolver::decideBinSize() {
     // It's better to compute num of bins this way, rather than...
     // (uint64_t)(m_boxX / m_binSize + 1) * (uint64_t)(m_boxY / m_binSize + 1) * (uint64_t)(m_boxZ / m_binSize + 1);
     // because the space bins and voxels can cover may be larger than the user-defined sim domain
+
+    // With a bin hierarchy, add coarser levels (each doubling the bin size) until the largest sphere fits in one bin
+    m_num_bin_levels = 1;
+    if (use_bin_hierarchy) {
+        double levelBinSize = m_binSize;
+        uint64_t levelNbX = nbX, levelNbY = nbY, levelNbZ = nbZ;
+        while (m_num_bin_levels < DEME_MAX_BIN_LEVELS && 2.0 * m_largest_radius > levelBinSize) {
+            levelNbX = (levelNbX + 1) / 2;
+            levelNbY = (levelNbY + 1) / 2;
+            levelNbZ = (levelNbZ + 1) / 2;
+            m_num_bins += levelNbX * levelNbY * levelNbZ;
+            levelBinSize *= 2.0;
+            m_num_bin_levels++;
+        }
+    }
+
+    // Two spheres interact through their nearest periodic images only, so a sphere must not reach 2 images of another
+    if (m_periodic_x || m_periodic_y || m_periodic_z) {
+        if ((m_periodic_x && m_user_boxSize.x <= 4.f * m_largest_radius) ||
+            (m_periodic_y && m_user_boxSize.y <= 4.f * m_largest_radius) ||
+            (m_periodic_z && m_user_boxSize.z <= 4.f * m_largest_radius)) {
+            DEME_ERROR("A periodic direction of the domain has to be longer than 4 times the largest sphere radius, "
+                       "%.7g.",
+                       m_largest_radius);
+        }
+    }
 }
 
 void DEMSolver::reportInitStats() const {
@@ -384,6 +421,10 @@ void DEMSolver::reportInitStats() const {
 
     DEME_INFO("The edge length of a bin: %.17g", m_binSize);
     DEME_INFO("The total number of bins: %zu", m_num_bins);
+    if (m_num_bin_levels > 1) {
+        DEME_INFO("Bins are organized in %u levels, with the coarsest bins having edge length %.17g", m_num_bin_levels,
+                  m_binSize * (double)((size_t)1 << (m_num_bin_levels - 1)));
+    }
 
     DEME_INFO("The total number of clumps: %zu", nOwnerClumps);
     DEME_INFO("The combined number of component spheres: %zu", nSpheresGM);
@@ -596,6 +637,20 @@ void DEMSolver::figureOutFamilyMasks() {
         unsigned int posInMat = locateMaskPair<unsigned int>(implID1, implID2);
         m_family_mask_matrix.at(posInMat) = PREVENT_CONTACT;
     }
+    // Clumps waiting to be culled have contacts with no one (the reserved family is fixed, and has no entry in the mask
+    // matrix)
+    if (use_out_of_domain_culling) {
+        if (any_of(unique_clump_families.begin(), unique_clump_families.end(),
+                   [&](unsigned int i) { return i == m_culled_family; })) {
+            DEME_WARNING(
+                "Some clumps are instructed to have family number %u.\nThis is the family that clumps leaving the "
+                "domain are moved into, so these clumps will be removed from the simulation.",
+                m_culled_family);
+        }
+        for (unsigned int i = 0; i < RESERVED_FAMILY_NUM; i++) {
+            m_family_mask_matrix.at(locateMaskPair<unsigned int>(m_culled_family, i)) = PREVENT_CONTACT;
+        }
+    }
 
     // Then, figure out each family's prescription info and put it into an array
     // Multiple user prescription input entries can work on the same array entry
@@ -660,25 +715,34 @@ void DEMSolver::figureOutOrigin() {
 void DEMSolver::addWorldBoundingBox() {
     // Now, add the bounding box for the simulation `world' if instructed.
     // Note the positions to add these planes are determined by the user-wanted box sizes, not m_boxXYZ which is the max
-    // possible box size.
+    // possible box size. Periodic sides get no planes.
     if (m_user_add_bounding_box == "none")
         return;
     auto box = this->AddExternalObject();
-    box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y + m_user_boxSize.y / 2., m_boxLBF.z),
-                  host_make_float3(0, 0, 1), m_bounding_box_material);
+    if (!m_periodic_z) {
+        box->AddPlane(
+            host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y + m_user_boxSize.y / 2., m_boxLBF.z),
+            host_make_float3(0, 0, 1), m_bounding_box_material);
+    }
     if (m_user_add_bounding_box == "only_bottom")
         return;
-    box->AddPlane(host_make_float3(m_boxLBF.x, m_boxLBF.y + m_user_boxSize.y / 2., m_boxLBF.z + m_user_boxSize.z / 2.),
-                  host_make_float3(1, 0, 0), m_bounding_box_material);
-    box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x, m_boxLBF.y + m_user_boxSize.y / 2.,
-                                   m_boxLBF.z + m_user_boxSize.z / 2.),
-                  host_make_float3(-1, 0, 0), m_bounding_box_material);
-    box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y, m_boxLBF.z + m_user_boxSize.z / 2.),
-                  host_make_float3(0, 1, 0), m_bounding_box_material);
-    box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y + m_user_boxSize.y,
-                                   m_boxLBF.z + m_user_boxSize.z / 2.),
-                  host_make_float3(0, -1, 0), m_bounding_box_material);
-    if (m_user_add_bounding_box == "top_open")
+    if (!m_periodic_x) {
+        box->AddPlane(
+            host_make_float3(m_boxLBF.x, m_boxLBF.y + m_user_boxSize.y / 2., m_boxLBF.z + m_user_boxSize.z / 2.),
+            host_make_float3(1, 0, 0), m_bounding_box_material);
+        box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x, m_boxLBF.y + m_user_boxSize.y / 2.,
+                                       m_boxLBF.z + m_user_boxSize.z / 2.),
+                      host_make_float3(-1, 0, 0), m_bounding_box_material);
+    }
+    if (!m_periodic_y) {
+        box->AddPlane(
+            host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y, m_boxLBF.z + m_user_boxSize.z / 2.),
+            host_make_float3(0, 1, 0), m_bounding_box_material);
+        box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y + m_user_boxSize.y,
+                                       m_boxLBF.z + m_user_boxSize.z / 2.),
+                      host_make_float3(0, -1, 0), m_bounding_box_material);
+    }
+    if (m_user_add_bounding_box == "top_open" || m_periodic_z)
         return;
     // Finally, if == all, add a top boundary
     box->AddPlane(host_make_float3(m_boxLBF.x + m_user_boxSize.x / 2., m_boxLBF.y + m_user_boxSize.y / 2.,
@@ -701,6 +765,7 @@ void DEMSolver::transferSolverParams() {
 
     // Time step constant-ness and expand factor constant-ness
     dT->solverFlags.isStepConst = ts_size_is_const;
+    dT->solverFlags.stepSizeStrat = ts_size_is_const ? VAR_TS_STRAT::CONST : m_ts_strat;
     kT->solverFlags.isExpandFactorFixed = use_user_defined_expand_factor;
 
     // Jitify or not
@@ -710,16 +775,32 @@ void DEMSolver::transferSolverParams() {
 
     // CD strategy
     kT->solverFlags.useOneBinPerThread = use_one_bin_per_thread;
+    kT->solverFlags.useHostContactDetection = use_host_contact_detection;
+    kT->solverFlags.nHostThreads = m_num_host_threads;
+    dT->solverFlags.useHostDynamics = use_host_dynamics;
+    dT->solverFlags.nHostThreads = m_num_host_threads;
+
+    // If the update frequency is chosen automatically, it starts from the user-set one, brought into range
+    bool auto_cd_update_freq = use_auto_cd_update_freq && !use_displacement_triggered_cd;
+    if (auto_cd_update_freq) {
+        m_updateFreq = std::min(std::max(m_updateFreq, (int)m_cd_update_freq_min), (int)m_cd_update_freq_max);
+    }
 
     // Tell kT and dT if this run is async
-    kT->solverFlags.isAsync = !(m_updateFreq == 0);
-    dT->solverFlags.isAsync = !(m_updateFreq == 0);
-    // Make sure dT kT understand the lock--waiting policy of this run
-    dTkT_InteractionManager->dynamicRequestedUpdateFrequency = m_updateFreq;
-
-    // Tell kT and dT whether the user enforeced potential on-the-fly family number changes
-    kT->solverFlags.canFamilyChange = famnum_can_change_conditionally;
-    dT->solverFlags.canFamilyChange = famnum_can_change_conditionally;
+    kT->solverFlags.isAsync = use_displacement_triggered_cd || auto_cd_update_freq || !(m_updateFreq == 0);
+    dT->solverFlags.isAsync = use_displacement_triggered_cd || auto_cd_update_freq || !(m_updateFreq == 0);
+    // Make sure dT kT understand the lock--waiting policy of this run. In displacement-triggered CD, dT decides when to
+    // wait by itself, not by counting steps.
+    dTkT_InteractionManager->dynamicRequestedUpdateFrequency = use_displacement_triggered_cd ? -1 : m_updateFreq;
+    dTkT_InteractionManager->handoffBackoff = m_handoff_backoff;
+    dT->solverFlags.useDisplacementTriggeredCD = use_displacement_triggered_cd;
+    dT->solverFlags.maxStepsPerContactList = m_cd_max_steps_per_list;
+    dT->solverFlags.useSleeping = use_sleeping && m_sleep_quiet_steps > 0;
+
+    // Tell kT and dT whether the user enforeced potential on-the-fly family number changes (culling clumps that leave
+    // the domain is one)
+    kT->solverFlags.canFamilyChange = famnum_can_change_conditionally || use_out_of_domain_culling;
+    dT->solverFlags.canFamilyChange = famnum_can_change_conditionally || use_out_of_domain_culling;
 
     kT->solverFlags.should_sort_pairs = kT_should_sort;
 
@@ -729,10 +810,27 @@ void DEMSolver::transferSolverParams() {
 
 void DEMSolver::transferSimParams() {
     // Figure out ts size and the envelope to add to geometries (for CD safety)
-    if ((!use_user_defined_expand_factor) && ts_size_is_const) {
+    if ((!use_user_defined_expand_factor) && use_displacement_triggered_cd) {
+        // Start from an expand factor that lasts a few steps at the user-estimated max velocity (if any), unless it is
+        // already chosen in a previous run. It is re-chosen based on the measured cost later.
+        float min_beta, max_beta;
+        getExpandFactorBounds(min_beta, max_beta);
+        if (m_expand_factor < min_beta || m_expand_factor > max_beta) {
+            if (m_approx_max_vel > 0.f && m_ts_size > 0.) {
+                m_expand_factor = m_approx_max_vel * m_ts_size * DEME_CD_AUTO_EXPAND_INIT_STEPS * m_expand_safety_param;
+            } else {
+                m_expand_factor = std::sqrt(min_beta * max_beta);
+            }
+            m_expand_factor = std::min(std::max(m_expand_factor, min_beta), max_beta);
+        }
+    } else if (!use_user_defined_expand_factor) {
+        // With a variable step size, the margin goes by the initial step size, and dT keeps the steps small enough for
+        // it
         m_expand_factor = m_approx_max_vel * m_ts_size * m_updateFreq * m_expand_safety_param;
     }
-    if (m_expand_factor * m_expand_safety_param <= 0.0 && m_updateFreq > 0 && ts_size_is_const) {
+    // (If the update frequency is chosen automatically, the expand factor goes by the sampled max velocity)
+    if (m_expand_factor * m_expand_safety_param <= 0.0 && m_updateFreq > 0 && ts_size_is_const &&
+        !use_displacement_triggered_cd && !use_auto_cd_update_freq) {
         DEME_WARNING(
             "You instructed that the physics can stretch %u time steps into the future, but did not instruct the "
             "geometries to expand via SetExpandFactor or SetMaxVelocity. The contact detection procedure will likely "
@@ -751,10 +849,278 @@ void DEMSolver::transferSimParams() {
     }
     DEME_DEBUG_PRINTF("%u contact wildcards are in the force model.", nContactWildcards);
 
-    dT->setSimParams(nvXp2, nvYp2, nvZp2, l, m_voxelSize, m_binSize, nbX, nbY, nbZ, m_boxLBF, G, m_ts_size,
+    // A variable step size carries on from where dT left it, brought into the (possibly changed) range
+    double ts_size = m_ts_size;
+    if (!ts_size_is_const) {
+        if (sys_initialized) {
+            ts_size = dT->simParams->h;
+        }
+        ts_size = std::min(std::max(ts_size, m_min_ts_size), m_max_ts_size);
+    }
+
+    dT->setSimParams(nvXp2, nvYp2, nvZp2, l, m_voxelSize, m_binSize, nbX, nbY, nbZ, m_boxLBF, G, ts_size,
                      m_expand_factor, m_approx_max_vel, m_expand_safety_param, nContactWildcards, nOwnerWildcards);
-    kT->setSimParams(nvXp2, nvYp2, nvZp2, l, m_voxelSize, m_binSize, nbX, nbY, nbZ, m_boxLBF, G, m_ts_size,
+    kT->setSimParams(nvXp2, nvYp2, nvZp2, l, m_voxelSize, m_binSize, nbX, nbY, nbZ, m_boxLBF, G, ts_size,
                      m_expand_factor, m_approx_max_vel, m_expand_safety_param, nContactWildcards, nOwnerWildcards);
+    dT->simParams->nBinLevels = m_num_bin_levels;
+    kT->simParams->nBinLevels = m_num_bin_levels;
+    for (DEMSimParams* simParams : {dT->simParams, kT->simParams}) {
+        simParams->periodicX = m_periodic_x;
+        simParams->periodicY = m_periodic_y;
+        simParams->periodicZ = m_periodic_z;
+        simParams->periodX = m_user_boxSize.x;
+        simParams->periodY = m_user_boxSize.y;
+        simParams->periodZ = m_user_boxSize.z;
+    }
+
+    // The region clumps have to stay in, relative to the LBF corner and within the simulation world (a clump waiting to
+    // be removed sits on its edge, which must have a valid voxel ID). Without a user-set region, it is the
+    // user-specified domain, and periodic directions are not bounded.
+    {
+        double worldRTF[3] = {m_boxX - m_voxelSize, m_boxY - m_voxelSize, m_boxZ - m_voxelSize};
+        double keepLBF[3] = {0., 0., 0.};
+        double keepRTF[3] = {m_periodic_x ? worldRTF[0] : m_user_boxSize.x,
+                             m_periodic_y ? worldRTF[1] : m_user_boxSize.y,
+                             m_periodic_z ? worldRTF[2] : m_user_boxSize.z};
+        if (use_user_keep_region) {
+            float LBF[3] = {m_boxLBF.x, m_boxLBF.y, m_boxLBF.z};
+            float userLBF[3] = {m_keep_region_lbf.x, m_keep_region_lbf.y, m_keep_region_lbf.z};
+            float userRTF[3] = {m_keep_region_rtf.x, m_keep_region_rtf.y, m_keep_region_rtf.z};
+            for (int i = 0; i < 3; i++) {
+                keepLBF[i] = (double)userLBF[i] - LBF[i];
+                keepRTF[i] = (double)userRTF[i] - LBF[i];
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            keepLBF[i] = std::min(std::max(keepLBF[i], 0.), worldRTF[i]);
+            keepRTF[i] = std::min(std::max(keepRTF[i], 0.), worldRTF[i]);
+        }
+        dT->simParams->cullOutOfDomain = use_out_of_domain_culling;
+        dT->simParams->cullFamily = m_culled_family;
+        dT->simParams->keepLBFX = keepLBF[0];
+        dT->simParams->keepLBFY = keepLBF[1];
+        dT->simParams->keepLBFZ = keepLBF[2];
+        dT->simParams->keepRTFX = keepRTF[0];
+        dT->simParams->keepRTFY = keepRTF[1];
+        dT->simParams->keepRTFZ = keepRTF[2];
+    }
+
+    // The bounds and targets of the variable step size
+    if (!ts_size_is_const) {
+        dT->simParams->minStepSize = m_min_ts_size;
+        dT->simParams->maxStepSize = m_max_ts_size;
+        dT->simParams->stepRefLength =
+            (m_smallest_radius < DEME_HUGE_FLOAT) ? m_smallest_radius : (float)(m_binSize / 2.);
+        dT->simParams->stepDispFraction = m_ts_disp_fraction;
+        dT->simParams->stepOverlapFraction = m_ts_overlap_fraction;
+        dT->simParams->recordContactOverlap = (m_ts_strat == VAR_TS_STRAT::INT_GAP);
+    } else {
+        dT->simParams->minStepSize = m_ts_size;
+        dT->simParams->maxStepSize = m_ts_size;
+        dT->simParams->stepRefLength = 0.f;
+        dT->simParams->stepDispFraction = 0.f;
+        dT->simParams->stepOverlapFraction = 0.f;
+        dT->simParams->recordContactOverlap = false;
+    }
+
+    // The thresholds of a clump being quiet, for it to fall asleep
+    if (use_sleeping && m_sleep_quiet_steps > 0) {
+        // The thresholds the user did not set are left 0, and dT works them out in each step from the step size it is
+        // using then (it changes over time if the step size is variable)
+        float radius = (m_smallest_radius < DEME_HUGE_FLOAT) ? m_smallest_radius : (float)(m_binSize / 2.);
+        dT->simParams->sleepMaxVel = std::max(m_sleep_max_vel, 0.f);
+        dT->simParams->sleepMaxAngVel = std::max(m_sleep_max_ang_vel, 0.f);
+        dT->simParams->sleepMaxDispPerStep = DEME_SLEEP_DISP_FRACTION * radius;
+        dT->simParams->sleepRefRadius = radius;
+        // Without gravity, go by the acceleration that takes a quiet clump to the max velocity in a step
+        float g = length(G);
+        dT->simParams->sleepMaxAccChange = (m_sleep_max_acc_change > 0.f)
+                                               ? m_sleep_max_acc_change
+                                               : ((g > 0.f) ? DEME_SLEEP_ACC_CHANGE_FRACTION * g : 0.f);
+        dT->simParams->sleepQuietSteps = m_sleep_quiet_steps;
+    } else {
+        dT->simParams->sleepMaxVel = 0.f;
+        dT->simParams->sleepMaxAngVel = 0.f;
+        dT->simParams->sleepMaxAccChange = 0.f;
+        dT->simParams->sleepMaxDispPerStep = 0.f;
+        dT->simParams->sleepRefRadius = 0.f;
+        dT->simParams->sleepQuietSteps = 0;
+    }
+}
+
+void DEMSolver::getExpandFactorBounds(float& min_beta, float& max_beta) const {
+    // Without any sphere, go by the bin size (which is otherwise twice the smallest radius)
+    float radius = (m_smallest_radius < DEME_HUGE_FLOAT) ? m_smallest_radius : (float)(m_binSize / 2.);
+    min_beta = (m_expand_factor_min > 0.f) ? m_expand_factor_min : DEME_CD_AUTO_EXPAND_MIN_FRACTION * radius;
+    max_beta = (m_expand_factor_max > 0.f) ? m_expand_factor_max : DEME_CD_AUTO_EXPAND_MAX_FRACTION * radius;
+    max_beta = std::max(min_beta, max_beta);
+}
+
+void DEMSolver::getExpandFactorDependentTimes(double& dT_time, double& kT_time) const {
+    // The work that grows with the expand factor: forces and integration on dT, and CD on kT
+    dT_time = dT->timers.GetTimer("Calculate contact forces").GetTimeSeconds() +
+              dT->timers.GetTimer("Collect contact forces").GetTimeSeconds() +
+              dT->timers.GetTimer("Integration").GetTimeSeconds();
+    kT_time = kT->timers.GetTimer("Discretize domain").GetTimeSeconds() +
+              kT->timers.GetTimer("Find contact pairs").GetTimeSeconds() +
+              kT->timers.GetTimer("Build history map").GetTimeSeconds();
+}
+
+void DEMSolver::tuneExpandFactor() {
+    double dT_time, kT_time;
+    getExpandFactorDependentTimes(dT_time, kT_time);
+    double dT_time_spent = dT_time - m_expand_tune_dT_time;
+    double kT_time_spent = kT_time - m_expand_tune_kT_time;
+    uint64_t nSteps = dT->nStepsSinceExpandTune;
+    uint64_t nLists = dT->nListsSinceExpandTune;
+    double dispPerStep = dT->cdMaxDispPerStep;
+    if (nSteps < DEME_CD_AUTO_EXPAND_MIN_SAMPLE_STEPS || nLists == 0) {
+        return;
+    }
+    m_expand_tune_dT_time = dT_time;
+    m_expand_tune_kT_time = kT_time;
+    dT->nStepsSinceExpandTune = 0;
+    dT->nListsSinceExpandTune = 0;
+    dT->cdMaxDispPerStep = 0.f;
+    // If the user cleared the timers in between, there is nothing to learn from this round
+    if (dT_time_spent <= 0. || kT_time_spent <= 0.) {
+        return;
+    }
+
+    // The throughput model: the number of contact candidates, hence both the dT cost per step and the kT cost per
+    // contact list, grow with the volume of the expanded spheres; and a contact list lasts until the fastest owner
+    // covers the expand factor. Minimize the cost per step, (dT cost + kT cost / steps per list), over the bounds.
+    double dT_cost = dT_time_spent / nSteps;
+    double kT_cost = kT_time_spent / nLists;
+    float min_beta, max_beta;
+    getExpandFactorBounds(min_beta, max_beta);
+    double radius = (m_smallest_radius < DEME_HUGE_FLOAT) ? m_smallest_radius : m_binSize / 2.;
+    double current_beta = m_expand_factor;
+    double best_beta = current_beta, best_cost = DEME_HUGE_FLOAT;
+    const unsigned int n_candidates = 64;
+    for (unsigned int i = 0; i < n_candidates; i++) {
+        double beta = min_beta * std::pow((double)max_beta / min_beta, (double)i / (n_candidates - 1));
+        double growth = std::pow((radius + beta) / (radius + current_beta), 3.);
+        double steps_per_list =
+            (dispPerStep > 0.) ? DEME_CD_DISP_TRIGGER_FRACTION * beta / dispPerStep : DEME_HUGE_FLOAT;
+        if (m_cd_max_steps_per_list >= 0) {
+            steps_per_list = std::min(steps_per_list, (double)m_cd_max_steps_per_list);
+        }
+        steps_per_list = std::max(steps_per_list, 1.);
+        double cost = growth * (dT_cost + kT_cost / steps_per_list);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_beta = beta;
+        }
+    }
+    m_expand_factor = best_beta;
+    // dT tells kT which expand factor goes with each work order, so only dT's copy is changed here
+    dT->simParams->beta = m_expand_factor;
+    DEME_STEP_STATS(
+        "Expand factor is set to %.9g (was %.9g), with %.9g s per dT step, %.9g s per kT update and an owner "
+        "displacement of up to %.9g per step measured.",
+        best_beta, current_beta, dT_cost, kT_cost, dispPerStep);
+}
+
+void DEMSolver::tuneCDUpdateFreq() {
+    // The max velocity is sampled between calls, so it is only let down slowly: the peaks of the previous call are
+    // likely to come back. The user estimate, if any, is where it starts from.
+    if (!m_max_vel_inspector) {
+        m_max_vel_inspector = std::make_shared<DEMInspector>(this, "clump_max_absv");
+        m_cd_freq_tune_max_vel = m_approx_max_vel;
+    }
+    float vel = (nSpheresGM > 0) ? m_max_vel_inspector->GetValue() : 0.f;
+    m_cd_freq_tune_max_vel = std::max(vel, (float)DEME_CD_AUTO_FREQ_VEL_DECAY * m_cd_freq_tune_max_vel);
+
+    // The expand factor has to cover how far any point can go in the steps dT runs ahead of the contact list, so a
+    // frequency is only allowed if that is within the bounds (or the user-fixed expand factor)
+    float min_beta, max_beta;
+    getExpandFactorBounds(min_beta, max_beta);
+    double reach_per_step = (double)m_cd_freq_tune_max_vel * dT->simParams->h * m_expand_safety_param;
+    double beta_cap = use_user_defined_expand_factor ? m_expand_factor : max_beta;
+    unsigned int max_freq = m_cd_update_freq_max;
+    if (reach_per_step > 0.) {
+        max_freq = (unsigned int)std::min((double)max_freq, std::floor(beta_cap / reach_per_step));
+    }
+    // Contacts must not be missed, so if that bound is below the user's minimum, the bound wins
+    unsigned int min_freq = m_cd_update_freq_min;
+    if (max_freq < min_freq) {
+        if (!m_cd_freq_below_min_warned) {
+            DEME_WARNING(
+                "With a max velocity of %.9g, the contact detection update frequency has to be at most %u to not miss "
+                "contacts, which is below the minimum of %u given to UseAutoCDUpdateFreq. %u is used for now.",
+                m_cd_freq_tune_max_vel, max_freq, m_cd_update_freq_min, max_freq);
+            m_cd_freq_below_min_warned = true;
+        }
+        min_freq = max_freq;
+    }
+    auto betaForFreq = [&](unsigned int freq) {
+        if (use_user_defined_expand_factor) {
+            return (double)m_expand_factor;
+        }
+        return std::min(std::max(reach_per_step * freq, (double)min_beta), (double)max_beta);
+    };
+    unsigned int current_freq = (unsigned int)std::max(m_updateFreq, 0);
+    unsigned int best_freq = std::min(current_freq, max_freq);
+
+    double dT_time, kT_time;
+    getExpandFactorDependentTimes(dT_time, kT_time);
+    double wait_time = dT->timers.GetTimer("Wait for kT update").GetTimeSeconds();
+    double dT_time_spent = dT_time - m_expand_tune_dT_time;
+    double kT_time_spent = kT_time - m_expand_tune_kT_time;
+    double wait_time_spent = wait_time - m_expand_tune_wait_time;
+    uint64_t nSteps = dT->nStepsSinceExpandTune;
+    uint64_t nLists = dT->nListsSinceExpandTune;
+    uint64_t nHeldBack = dT->nHeldBackSinceExpandTune;
+    // If the user cleared the timers in between, there is nothing to learn from this round
+    bool can_choose = nSteps >= DEME_CD_AUTO_EXPAND_MIN_SAMPLE_STEPS && nLists > 0 && dT_time_spent > 0. &&
+                      kT_time_spent > 0. && wait_time_spent >= 0.;
+    if (nSteps >= DEME_CD_AUTO_EXPAND_MIN_SAMPLE_STEPS && nLists > 0) {
+        m_expand_tune_dT_time = dT_time;
+        m_expand_tune_kT_time = kT_time;
+        m_expand_tune_wait_time = wait_time;
+        dT->nStepsSinceExpandTune = 0;
+        dT->nListsSinceExpandTune = 0;
+        dT->nHeldBackSinceExpandTune = 0;
+    }
+
+    if (can_choose) {
+        // The throughput model: the dT cost per step grows with the volume of the expanded spheres. kT works alongside
+        // dT, and dT only has to wait for it when a contact list takes kT longer than the steps dT may run on the
+        // previous one; at frequency 0, it always waits. Minimize the cost per step over the allowed frequencies.
+        double dT_cost = dT_time_spent / nSteps;
+        double kT_cost = kT_time_spent / nLists;
+        // If dT was held back for longer than the model says at the current frequency, kT is in effect slower than
+        // measured (e.g. it shares the GPU with dT), and its cost is taken to be what the wait suggests
+        if (current_freq > 0 && nHeldBack > 0) {
+            kT_cost = std::max(kT_cost, current_freq * (dT_cost + wait_time_spent / nSteps));
+        }
+        double radius = (m_smallest_radius < DEME_HUGE_FLOAT) ? m_smallest_radius : m_binSize / 2.;
+        double current_beta = std::max((double)dT->simParams->beta, 0.);
+        double best_cost = DEME_HUGE_FLOAT;
+        // Ties go to the lower frequency, which gives dT fresher contact lists. A large range is sampled sparsely.
+        for (uint64_t freq = min_freq; freq <= max_freq; freq = std::max(freq + 1, freq * 21 / 20)) {
+            double growth = std::pow((radius + betaForFreq(freq)) / (radius + current_beta), 3.);
+            double cost = (freq == 0) ? growth * (dT_cost + kT_cost) : growth * std::max(dT_cost, kT_cost / freq);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_freq = (unsigned int)freq;
+            }
+        }
+        DEME_STEP_STATS(
+            "Contact detection update frequency is set to %u (was %u), with %.9g s per dT step, %.9g s per kT update, "
+            "%zu times dT held back in %zu steps and a max velocity of %.9g.",
+            best_freq, current_freq, dT_cost, kT_cost, (size_t)nHeldBack, (size_t)nSteps, m_cd_freq_tune_max_vel);
+    }
+
+    // Even without a new choice, the expand factor follows the max velocity
+    m_updateFreq = best_freq;
+    dTkT_InteractionManager->dynamicRequestedUpdateFrequency = m_updateFreq;
+    if (!use_user_defined_expand_factor) {
+        m_expand_factor = betaForFreq(best_freq);
+        // dT tells kT which expand factor goes with each work order, so only dT's copy is changed here
+        dT->simParams->beta = m_expand_factor;
+    }
 }
 
 void DEMSolver::allocateGPUArrays() {
@@ -815,6 +1181,9 @@ void DEMSolver::initializeGPUArrays() {
         m_family_mask_matrix,
         // Templates and misc.
         flattened_clump_templates);
+    // kT keeps a copy of the analytical entity definitions, in case it does contact detection on the host
+    kT->populateAnalGeoArrays(m_anal_owner, m_anal_types, m_anal_normals, m_anal_comp_pos, m_anal_comp_rot,
+                              m_anal_size_1, m_anal_size_2, m_anal_size_3, nOwnerClumps);
 }
 
 /// When more clumps/meshed objects got loaded, this method should be called to transfer them to the GPU-side in
@@ -888,13 +1257,42 @@ void DEMSolver::validateUserInputs() {
             m_user_boxSize.x, m_user_boxSize.y, m_user_boxSize.z);
     }
 
-    if (m_updateFreq < 0) {
+    if (use_displacement_triggered_cd && m_updateFreq != 0) {
+        DEME_WARNING(
+            "Displacement-triggered contact detection is in use, so the update frequency set via SetCDUpdateFreq is "
+            "ignored.");
+    }
+
+    if (use_auto_cd_update_freq && use_displacement_triggered_cd) {
+        DEME_WARNING(
+            "Displacement-triggered contact detection is in use, so the update frequency is not chosen automatically "
+            "as instructed via UseAutoCDUpdateFreq.");
+    }
+
+    if (use_auto_cd_update_freq && m_cd_update_freq_min > m_cd_update_freq_max) {
+        DEME_ERROR("The range of the automatically chosen update frequency is %u to %u. It is empty.",
+                   m_cd_update_freq_min, m_cd_update_freq_max);
+    }
+
+    if (m_updateFreq < 0 && !use_displacement_triggered_cd && !use_auto_cd_update_freq) {
         DEME_WARNING(
             "The physics of the DEM system can drift into the future as much as it wants compared to contact "
             "detections, because SetCDUpdateFreq was called with a negative argument. Please make sure this is "
             "intended.");
     }
 
+    if (!ts_size_is_const) {
+        if (m_min_ts_size <= 0. || m_max_ts_size < m_min_ts_size) {
+            DEME_ERROR("The range of the variable time step size is %.9g to %.9g. It must be positive and not empty.",
+                       m_min_ts_size, m_max_ts_size);
+        }
+        if (m_ts_size < m_min_ts_size || m_ts_size > m_max_ts_size) {
+            DEME_WARNING("The initial time step size %.9g is out of the range of the variable time step size, %.9g to "
+                         "%.9g. It will be brought into the range.",
+                         m_ts_size, m_min_ts_size, m_max_ts_size);
+        }
+    }
+
     if ((!ts_size_is_const) && (!use_user_defined_expand_factor) && (m_approx_max_vel <= 0.f)) {
         DEME_ERROR(
             "When using variable time step size, this solver needs your approximated maximum body/point velocity to "
@@ -902,8 +1300,24 @@ void DEMSolver::validateUserInputs() {
             "explicitly set a expand factor via SetExpandFactor.");
     }
 
+    if (use_out_of_domain_culling && m_culled_family >= RESERVED_FAMILY_NUM) {
+        DEME_ERROR("Clumps leaving the domain are instructed to be moved into family %u, but it has to be smaller than "
+                   "the reserved family number %u.",
+                   m_culled_family, RESERVED_FAMILY_NUM);
+    }
+    if (use_user_keep_region &&
+        (m_keep_region_rtf.x <= m_keep_region_lbf.x || m_keep_region_rtf.y <= m_keep_region_lbf.y ||
+         m_keep_region_rtf.z <= m_keep_region_lbf.z)) {
+        DEME_ERROR(
+            "The region that clumps have to stay in is empty. Its RTF corner must be larger than its LBF corner.");
+    }
+
     // Fix the reserved family (reserved family number is in user family, not in impl family)
     SetFamilyFixed(RESERVED_FAMILY_NUM);
+    // And the family that clumps leaving the domain wait in, until they are removed
+    if (use_out_of_domain_culling) {
+        SetFamilyFixed(m_culled_family);
+    }
 }
 
 // inline unsigned int stash_material_in_templates(std::vector<std::shared_ptr<DEMMaterial>>& loaded_materials,
@@ -1066,8 +1480,9 @@ inline void DEMSolver::equipAnalGeoTemplates(std::unordered_map<std::string, std
     std::string objOwner, objType, objMat, objNormal, objRelPosX, objRelPosY, objRelPosZ, objRotX, objRotY, objRotZ,
         objSize1, objSize2, objSize3, objMass;
     for (unsigned int i = 0; i < nAnalGM; i++) {
-        // External objects will be owners, and their IDs are following template-loaded simulation clumps
-        bodyID_t myOwner = nOwnerClumps + m_anal_owner.at(i);
+        // External objects will be owners, and their IDs are following template-loaded simulation clumps (until
+        // PurgeFamily moves them, which dT keeps track of)
+        bodyID_t myOwner = dT->ownerAnalBody.at(i);
         objOwner += std::to_string(myOwner) + ",";
         objType += std::to_string(m_anal_types.at(i)) + ",";
         objMat += std::to_string(m_anal_materials.at(i)) + ",";
@@ -8,6 +8,7 @@
 #include <DEM/Defines.h>
 #include <DEM/HostSideHelpers.hpp>
 #include <DEM/AuxClasses.h>
+#include <core/utils/JitHelper.h>
 
 #include <iostream>
 #include <fstream>
@@ -32,6 +33,8 @@ DEMSolver::DEMSolver(unsigned int nGPUs) {
 }
 
 DEMSolver::~DEMSolver() {
+    // Finish the output files still being written in the background
+    m_async_writer.reset();
     delete kT;
     delete dT;
     delete kTMain_InteractionManager;
@@ -519,6 +522,25 @@ std::shared_ptr<DEMClumpBatch> DEMSolver::AddClumps(const std::vector<std::share
     return AddClumps(a_batch);
 }
 
+std::shared_ptr<DEMClumpBatch> DEMSolver::AddInflowClumps(DEMClumpBatch& input_batch) {
+    // Like in AddClumps, load_order is its position in the staging array, which the trackers of it go by
+    input_batch.load_order = m_staged_inflow_batches.size();
+    m_staged_inflow_batches.push_back(std::make_shared<DEMClumpBatch>(std::move(input_batch)));
+    return m_staged_inflow_batches.back();
+}
+
+std::shared_ptr<DEMClumpBatch> DEMSolver::AddInflowClumps(
+    const std::vector<std::shared_ptr<DEMClumpTemplate>>& input_types,
+    const std::vector<float3>& input_xyz) {
+    if (input_types.size() != input_xyz.size()) {
+        DEME_ERROR("Arrays in the call AddInflowClumps must all have the same length.");
+    }
+    DEMClumpBatch a_batch(input_types.size());
+    a_batch.SetTypes(input_types);
+    a_batch.SetPos(input_xyz);
+    return AddInflowClumps(a_batch);
+}
+
 std::shared_ptr<DEMMeshConnected> DEMSolver::AddWavefrontMeshObject(DEMMeshConnected& mesh) {
     if (mesh.GetNumTriangles() == 0) {
         DEME_WARNING("It seems that a mesh contains 0 triangle facet.");
@@ -596,61 +618,92 @@ std::shared_ptr<DEMInspector> DEMSolver::CreateInspector(const std::string& quan
     return m_inspectors.back();
 }
 
-void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
-    switch (m_out_format) {
-        case (OUTPUT_FORMAT::CHPF): {
-            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            dT->writeSpheresAsChpf(ptFile);
-            break;
-        }
-        case (OUTPUT_FORMAT::CSV): {
-            std::ofstream ptFile(outfilename, std::ios::out);
-            dT->writeSpheresAsCsv(ptFile);
-            break;
-        }
-        case (OUTPUT_FORMAT::BINARY): {
-            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            //// TODO: Implement it
-            break;
-        }
-        default:
-            DEME_ERROR("Sphere output file format is unknown. Please set it via SetOutputFormat.");
+void DEMSolver::SetNativeOutputQuatBits(unsigned int bits) {
+    if (bits != 8 && bits != 16 && bits != 32) {
+        DEME_ERROR("SetNativeOutputQuatBits takes 8, 16 or 32 bits, not %u.", bits);
     }
+    m_native_quat_bits = bits;
 }
 
-void DEMSolver::WriteClumpFile(const std::string& outfilename) const {
-    switch (m_out_format) {
-        case (OUTPUT_FORMAT::CHPF): {
-            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            dT->writeClumpsAsChpf(ptFile);
-            break;
+void DEMSolver::SetAsyncOutput(bool use, unsigned int n_threads, unsigned int max_pending) {
+    // Files already handed to the old writers are written first
+    m_async_writer.reset();
+    if (use) {
+        m_async_writer = std::make_unique<AsyncWriter>(n_threads, max_pending);
+    }
+}
+
+void DEMSolver::WaitForPendingOutput() {
+    if (m_async_writer) {
+        try {
+            m_async_writer->flush();
+        } catch (const std::exception& e) {
+            DEME_ERROR("Writing an output file in the background failed: %s", e.what());
         }
-        case (OUTPUT_FORMAT::CSV): {
-            std::ofstream ptFile(outfilename, std::ios::out);
-            dT->writeClumpsAsCsv(ptFile);
-            break;
+    }
+}
+
+void DEMSolver::writeSnapshotFile(std::shared_ptr<DEMSnapshot> snap,
+                                  const std::string& outfilename,
+                                  OUTPUT_FORMAT format) const {
+    DEMCsvFormat csv_format = m_csv_format;
+    csv_format.nThreads = m_num_host_threads;
+    auto write = [snap, outfilename, format, csv_format]() {
+        switch (format) {
+            case (OUTPUT_FORMAT::CHPF): {
+                std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+                writeSnapshotAsChpf(ptFile, *snap);
+                // What the string table column (such as clump type) numbers goes to a side table
+                if (!snap->stringTableColumn.empty()) {
+                    std::ofstream typeFile(std::filesystem::path(outfilename).replace_extension(".types.csv"),
+                                           std::ios::out);
+                    writeSnapshotStringTable(typeFile, *snap);
+                }
+                break;
+            }
+            case (OUTPUT_FORMAT::CSV): {
+                std::ofstream ptFile(outfilename, std::ios::out);
+                writeSnapshotAsCsv(ptFile, *snap, csv_format);
+                break;
+            }
+            case (OUTPUT_FORMAT::BINARY):
+            case (OUTPUT_FORMAT::NATIVE): {
+                snap->WriteFile(outfilename);
+                break;
+            }
+            default:
+                throw std::runtime_error("Output file format is unknown. Please set it via SetOutputFormat.");
         }
-        case (OUTPUT_FORMAT::BINARY): {
-            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
-            //// TODO: Implement it
-            break;
+    };
+
+    try {
+        if (m_async_writer) {
+            // The snapshot is already a host-side copy, so the simulation can go on while it is written
+            m_async_writer->submit(std::move(write));
+        } else {
+            write();
         }
-        default:
-            DEME_ERROR("Clump output file format is unknown. Please set it via SetOutputFormat.");
+    } catch (const std::exception& e) {
+        DEME_ERROR("Failed to write output file %s: %s", outfilename.c_str(), e.what());
     }
 }
 
+void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
+    auto snap = std::make_shared<DEMSnapshot>();
+    dT->makeSphereSnapshot(*snap);
+    writeSnapshotFile(snap, outfilename, m_out_format);
+}
+
+void DEMSolver::WriteClumpFile(const std::string& outfilename) const {
+    auto snap = std::make_shared<DEMSnapshot>();
+    dT->makeClumpSnapshot(*snap, m_out_format == OUTPUT_FORMAT::NATIVE, m_native_quat_bits);
+    writeSnapshotFile(snap, outfilename, m_out_format);
+}
+
 void DEMSolver::WriteContactFile(const std::string& outfilename) const {
-    switch (m_cnt_out_format) {
-        case (OUTPUT_FORMAT::CSV): {
-            std::ofstream ptFile(outfilename, std::ios::out);
-            dT->writeContactsAsCsv(ptFile);
-            break;
-        }
-        default:
-            DEME_ERROR(
-                "Contact pair output file format is unknown or not implemented. Please re-set it via SetOutputFormat.");
-    }
+    auto snap = std::make_shared<DEMSnapshot>();
+    dT->makeContactSnapshot(*snap);
+    writeSnapshotFile(snap, outfilename, m_cnt_out_format);
 }
 
 // The method should be called after user inputs are in place, and before starting the simulation. It figures out a part
@@ -715,6 +768,25 @@ void DEMSolver::ShowTimingStats() {
     DEME_PRINTF("--------------------------\n");
 }
 
+void DEMSolver::ShowJitCacheStats() {
+    std::shared_ptr<JitDiskCache> cache = m_jit_disk_cache;
+    DEME_PRINTF("\n~~ JIT CACHE STATISTICS ~~\n");
+    if (!cache) {
+        DEME_PRINTF("On-disk JIT cache is not in use\n");
+        DEME_PRINTF("--------------------------\n");
+        return;
+    }
+    const JitDiskCache::Stats stats = cache->getStats();
+    DEME_PRINTF("Cache directory: %s\n", cache->getDir().string().c_str());
+    DEME_PRINTF("Hits: %zu\n", stats.hits);
+    DEME_PRINTF("Misses: %zu\n", stats.misses);
+    DEME_PRINTF("Stores: %zu\n", stats.stores);
+    DEME_PRINTF("Evictions: %zu\n", stats.evictions);
+    DEME_PRINTF("Errors: %zu\n", stats.errors);
+    DEME_PRINTF("Disk usage: %zu of %zu bytes\n", cache->diskUsage(), cache->getMaxBytes());
+    DEME_PRINTF("--------------------------\n");
+}
+
 void DEMSolver::ClearTimingStats() {
     kT->resetTimers();
     dT->resetTimers();
@@ -778,6 +850,7 @@ void DEMSolver::resetWorkerThreads() {
     // Finally, reset the thread stats and wait for potential new user calls
     kT->resetUserCallStat();
     dT->resetUserCallStat();
+    workers_in_sync = true;
 }
 
 /// When simulation parameters are updated by the user, they can call this method to transfer them to the GPU-side in
@@ -856,17 +929,260 @@ void DEMSolver::ChangeClumpSizes(const std::vector<bodyID_t>& IDs, const std::ve
     // This method requires kT and dT are sync-ed
     // resetWorkerThreads();
 
-    std::thread dThread = std::move(std::thread([this, IDs, factors]() { this->dT->changeOwnerSizes(IDs, factors); }));
-    std::thread kThread = std::move(std::thread([this, IDs, factors]() { this->kT->changeOwnerSizes(IDs, factors); }));
+    // The workers know owners by where they are in memory
+    std::vector<bodyID_t> internalIDs(IDs.size());
+    for (size_t i = 0; i < IDs.size(); i++)
+        internalIDs[i] = dT->ownerInternalID(IDs[i]);
+
+    std::thread dThread =
+        std::move(std::thread([this, &internalIDs, factors]() { this->dT->changeOwnerSizes(internalIDs, factors); }));
+    std::thread kThread =
+        std::move(std::thread([this, &internalIDs, factors]() { this->kT->changeOwnerSizes(internalIDs, factors); }));
     dThread.join();
     kThread.join();
 }
 
+void DEMSolver::ReorderSpatially() {
+    if (!sys_initialized) {
+        DEME_ERROR(
+            "ReorderSpatially operates on the simulation arrays directly, so it requires the system to be initialized "
+            "first.");
+    }
+    // The arrays are rearranged when kT and dT are both idle, and after that kT starts over with a new contact
+    // detection (whose contacts are matched against the current ones, so contact history is kept)
+    if (!workers_in_sync) {
+        resetWorkerThreads();
+    }
+    std::vector<bodyID_t> ownerNewToOld, sphereNewToOld;
+    dT->computeSpatialOrder(ownerNewToOld, sphereNewToOld);
+    dT->applySpatialOrder(ownerNewToOld, sphereNewToOld);
+    kT->applySpatialOrder(ownerNewToOld, sphereNewToOld);
+    m_steps_since_reorder = 0;
+    DEME_STEP_STATS("Clumps and spheres are rearranged along a Morton curve in memory.");
+}
+
 /// Removes all entities associated with a family from the arrays (to save memory space). This method should only be
 /// called periodically because it gives a large overhead. This is only used in long simulations where if the
 /// `phased-out' entities do not get cleared, we won't have enough memory space.
-/// TODO: Implement it.
-void DEMSolver::PurgeFamily(unsigned int family_num) {}
+size_t DEMSolver::PurgeFamily(unsigned int family_num) {
+    if (!sys_initialized) {
+        DEME_ERROR(
+            "PurgeFamily operates on the simulation arrays directly, so it requires the system to be initialized "
+            "first.");
+    }
+    // dT is idle between user calls, so what it has can be looked at before kT is synced
+    std::vector<bodyID_t> ownerNewToOld, sphereNewToOld;
+    dT->computePurgeOrder(family_num, ownerNewToOld, sphereNewToOld);
+    const size_t nOwnersRemoved = nOwnerBodies - ownerNewToOld.size();
+    const size_t nSpheresRemoved = nSpheresGM - sphereNewToOld.size();
+    // The clumps the integration kernels counted into the culled family all go with it, whoever asked for the purge
+    if (family_num == m_culled_family) {
+        *(dT->stateOfSolver_resources.pNumCulledClumps) = 0;
+    }
+    if (nOwnersRemoved == 0) {
+        DEME_STEP_STATS("There is no clump in family %u to purge.", family_num);
+        return 0;
+    }
+    // Like a spatial reordering, the arrays are compacted when kT and dT are both idle, and after that kT starts over
+    // with a new contact detection (whose contacts are matched against the kept ones, so their history is kept)
+    if (!workers_in_sync) {
+        resetWorkerThreads();
+    }
+    // The owners of analytical components are jitified, so if they moved, the kernels are jitified again
+    const std::vector<bodyID_t> analOwnersBefore(dT->ownerAnalBody);
+    std::vector<bodyID_t> ownerPublicOldToNew;
+    dT->applyPurge(ownerNewToOld, sphereNewToOld, ownerPublicOldToNew);
+    kT->applyPurge(ownerNewToOld, sphereNewToOld);
+    nOwnerBodies -= nOwnersRemoved;
+    nOwnerClumps -= nOwnersRemoved;
+    nSpheresGM -= nSpheresRemoved;
+    packDataPointers();
+
+    // Trackers follow the clumps they track to their new IDs. The kept ones of a batch still have consecutive IDs.
+    for (auto& tracked_obj : m_tracked_objs) {
+        if (tracked_obj->isBroken)
+            continue;
+        size_t nKept = 0;
+        for (size_t i = 0; i < tracked_obj->nSpanOwners; i++) {
+            bodyID_t newID = ownerPublicOldToNew.at(tracked_obj->ownerID + i);
+            if (newID == NULL_BODYID)
+                continue;
+            if (nKept == 0)
+                tracked_obj->ownerID = newID;
+            nKept++;
+        }
+        if (nKept == 0) {
+            tracked_obj->isBroken = true;
+        } else {
+            tracked_obj->nSpanOwners = nKept;
+        }
+    }
+
+    if (dT->ownerAnalBody != analOwnersBefore) {
+        jitifyKernels();
+    }
+    DEME_STEP_STATS("%zu clumps (%zu spheres) in family %u are purged.", nOwnersRemoved, nSpheresRemoved,
+                    family_num);
+    return nOwnersRemoved;
+}
+
+size_t DEMSolver::CullOutOfDomainClumps() {
+    if (!use_out_of_domain_culling) {
+        DEME_WARNING("CullOutOfDomainClumps is called, but out-of-domain culling is not in use (see "
+                     "UseOutOfDomainCulling), so no work is done.");
+        return 0;
+    }
+    // The clumps that left are already in the culled family; they only need to be compacted away
+    size_t nCulled = PurgeFamily(m_culled_family);
+    m_steps_since_cull = 0;
+    m_num_culled_clumps += nCulled;
+    if (nCulled > 0) {
+        DEME_STEP_STATS("%zu clumps that left the domain are removed, %zu in all so far.", nCulled,
+                        m_num_culled_clumps);
+    }
+    return nCulled;
+}
+
+size_t DEMSolver::InsertStagedClumps() {
+    if (!sys_initialized) {
+        DEME_ERROR(
+            "InsertStagedClumps adds clumps to a running simulation, so it requires the system to be initialized "
+            "first.");
+    }
+    if (nLastTimeClumpTemplateLoad != nClumpTemplateLoad) {
+        DEME_ERROR(
+            "InsertStagedClumps cannot be used after loading new clump templates. Consider re-initializing at this "
+            "point.\nNumber of clump templates at last initialization: %u\nNumber of clump templates now: %u",
+            nLastTimeClumpTemplateLoad, nClumpTemplateLoad);
+    }
+    if (m_staged_inflow_batches.empty()) {
+        return 0;
+    }
+
+    // Flatten the spheres of the staged clumps, with positions relative to the LBF corner of the world like dT has
+    // them. Clumps whose CoM is outside of the world cannot be represented, so they are left out.
+    size_t nStaged = 0;
+    for (const auto& a_batch : m_staged_inflow_batches) {
+        nStaged += a_batch->GetNumClumps();
+    }
+    std::vector<notStupidBool_t> clumpRejected(nStaged, 0);
+    std::vector<float3> sphPos;
+    std::vector<float> sphRadius;
+    std::vector<size_t> sphClump;
+    size_t nOutOfWorld = 0;
+    size_t clumpNum = 0;
+    for (const auto& a_batch : m_staged_inflow_batches) {
+        for (size_t i = 0; i < a_batch->GetNumClumps(); i++, clumpNum++) {
+            const auto& type = a_batch->types.at(i);
+            if (!type) {
+                DEME_ERROR("Some clumps staged via AddInflowClumps do not have their types set.");
+            }
+            float3 CoM = a_batch->xyz.at(i) - m_boxLBF;
+            if (CoM.x < 0 || CoM.y < 0 || CoM.z < 0 || CoM.x >= m_boxX || CoM.y >= m_boxY || CoM.z >= m_boxZ) {
+                clumpRejected[clumpNum] = 1;
+                nOutOfWorld++;
+                continue;
+            }
+            if (!m_inflow_check_overlap) {
+                continue;
+            }
+            const float4& oriQ = a_batch->oriQ.at(i);
+            for (unsigned int j = 0; j < type->nComp; j++) {
+                float3 relPos = type->relPos.at(j);
+                hostApplyOriQToVector3<float, float>(relPos.x, relPos.y, relPos.z, oriQ.w, oriQ.x, oriQ.y, oriQ.z);
+                sphPos.push_back(CoM + relPos);
+                sphRadius.push_back(type->radii.at(j));
+                sphClump.push_back(clumpNum);
+            }
+        }
+    }
+    // dT is idle between user calls, so its spheres can be looked at while kT may still be working
+    if (m_inflow_check_overlap) {
+        dT->markInflowOverlaps(sphPos, sphRadius, sphClump, m_inflow_clearance, clumpRejected);
+    }
+
+    // The kept clumps of each staged batch make up a batch, even if an empty one, so trackers find their clumps
+    std::vector<std::shared_ptr<DEMClumpBatch>> kept_batches;
+    size_t nInserted = 0, nSpheresInserted = 0;
+    clumpNum = 0;
+    for (const auto& a_batch : m_staged_inflow_batches) {
+        std::vector<size_t> kept;
+        for (size_t i = 0; i < a_batch->GetNumClumps(); i++, clumpNum++) {
+            if (!clumpRejected[clumpNum]) {
+                kept.push_back(i);
+            }
+        }
+        auto kept_batch = std::make_shared<DEMClumpBatch>(kept.size());
+        kept_batch->load_order = a_batch->load_order;
+        kept_batch->family_isSpecified = a_batch->family_isSpecified;
+        for (size_t k = 0; k < kept.size(); k++) {
+            size_t i = kept[k];
+            kept_batch->types[k] = a_batch->types[i];
+            kept_batch->families[k] = a_batch->families[i];
+            kept_batch->xyz[k] = a_batch->xyz[i];
+            kept_batch->vel[k] = a_batch->vel[i];
+            kept_batch->oriQ[k] = a_batch->oriQ[i];
+            kept_batch->angVel[k] = a_batch->angVel[i];
+            nSpheresInserted += a_batch->types[i]->nComp;
+        }
+        nInserted += kept.size();
+        kept_batches.push_back(kept_batch);
+    }
+    m_staged_inflow_batches.clear();
+    const size_t nRejected = nStaged - nInserted;
+    m_num_rejected_inflow_clumps += nRejected;
+
+    // The new clumps go after the existing owners, so the IDs of those stay, and populating them only goes through the
+    // new clumps. The arrays grow geometrically (see DEME_TRACKED_RESIZE), so they usually have room for the new
+    // clumps: then they are grown in place, and kT is only held off while that happens (it finishes the contact
+    // detection it may be working on, and the new clumps are in the next). Only an insertion that goes over capacity
+    // has kT and dT synced and the arrays reallocated.
+    size_t nOwners_old = nOwnerBodies;
+    size_t nClumps_old = nOwnerClumps;
+    size_t nSpheres_old = nSpheresGM;
+    nOwnerClumps += nInserted;
+    nSpheresGM += nSpheresInserted;
+    // Template info is needed for populating the clump arrays, and it is released afterwards like in UpdateClumps
+    preprocessClumpTemplates();
+    updateTotalEntityNum();
+    std::unique_lock<std::mutex> kTWorkLock(dTkT_InteractionManager->kinematicWork_AccessCoordination,
+                                            std::defer_lock);
+    if (dT->entityArraysHaveRoom(nOwnerBodies, nSpheresGM) && kT->entityArraysHaveRoom(nOwnerBodies, nSpheresGM)) {
+        kTWorkLock.lock();
+        dT->resizeEntityArrays(nOwnerBodies, nOwnerClumps, nSpheresGM);
+        kT->resizeEntityArrays(nOwnerBodies, nOwnerClumps, nSpheresGM);
+    } else {
+        if (!workers_in_sync) {
+            resetWorkerThreads();
+        }
+        allocateGPUArrays();
+    }
+    {
+        ClumpTemplateFlatten flattened_clump_templates(m_template_clump_mass, m_template_clump_moi,
+                                                       m_template_sp_mat_ids, m_template_sp_radii,
+                                                       m_template_sp_relPos, m_template_clump_volume);
+        dT->updateClumpMeshArrays(kept_batches, {}, {}, {}, {}, {}, {}, {}, {}, {}, flattened_clump_templates, {}, {},
+                                  {}, {}, {}, m_loaded_materials, m_family_mask_matrix, m_no_output_families,
+                                  m_tracked_objs, nOwners_old, nClumps_old, nSpheres_old, nTriMeshes, nTriGM);
+        kT->updateClumpMeshArrays(kept_batches, {}, {}, {}, {}, m_family_mask_matrix, flattened_clump_templates,
+                                  nOwners_old, nClumps_old, nSpheres_old, nTriMeshes, nTriGM);
+    }
+    packDataPointers();
+    if (kTWorkLock.owns_lock()) {
+        kTWorkLock.unlock();
+    }
+    ReleaseFlattenedArrays();
+    // A tracker of a staged batch whose clumps were all left out has nothing to track
+    for (auto& tracked_obj : m_tracked_objs) {
+        if (tracked_obj->type == OWNER_TYPE::CLUMP && tracked_obj->nSpanOwners == 0) {
+            tracked_obj->isBroken = true;
+        }
+    }
+
+    DEME_STEP_STATS("%zu staged clumps (%zu spheres) are inserted, and %zu are left out (%zu outside of the world).",
+                    nInserted, nSpheresInserted, nRejected, nOutOfWorld);
+    return nInserted;
+}
 
 void DEMSolver::DoDynamics(double thisCallDuration) {
     // Is it needed here??
@@ -878,8 +1194,33 @@ void DEMSolver::DoDynamics(double thisCallDuration) {
     // Tell dT how long this call is
     dT->setCycleDuration(thisCallDuration);
 
+    // In displacement-triggered CD, the expand factor is re-chosen based on how the previous calls went
+    if (use_displacement_triggered_cd && !use_user_defined_expand_factor) {
+        tuneExpandFactor();
+    } else if (use_auto_cd_update_freq && !use_displacement_triggered_cd) {
+        // Otherwise, the update frequency may be re-chosen in the same way, if the user asks for it
+        tuneCDUpdateFreq();
+    }
+    // Remove the clumps that left the domain if it is time (before a reordering, which does not need to move them). The
+    // integration kernels count the clumps they move into the culled family, so if none left, the arrays are not even
+    // looked at.
+    if (use_out_of_domain_culling && m_steps_since_cull >= m_cull_freq &&
+        *(dT->stateOfSolver_resources.pNumCulledClumps) > 0) {
+        CullOutOfDomainClumps();
+    }
+    // Insert the staged inflow clumps, if any (also before a reordering, which can then place them)
+    if (!m_staged_inflow_batches.empty()) {
+        InsertStagedClumps();
+    }
+    // Rearrange clumps in memory if it is time
+    if (m_spatial_reorder_freq > 0 && m_steps_since_reorder >= m_spatial_reorder_freq) {
+        ReorderSpatially();
+    }
+    uint64_t nStepsBefore = dT->nTotalSteps;
+
     dT->startThread();
     kT->startThread();
+    workers_in_sync = false;
 
     // Wait till dT is done
     std::unique_lock<std::mutex> lock(dTMain_InteractionManager->mainCanProceed);
@@ -889,6 +1230,12 @@ void DEMSolver::DoDynamics(double thisCallDuration) {
     // Reset to make ready for next user call, don't forget it. We don't do a `deep' reset using resetUserCallStat,
     // since that's only used when kT and dT sync.
     dTMain_InteractionManager->userCallDone = false;
+    m_steps_since_reorder += dT->nTotalSteps - nStepsBefore;
+    m_steps_since_cull += dT->nTotalSteps - nStepsBefore;
+    if (!ts_size_is_const) {
+        DEME_STEP_STATS("%zu steps were run in this call, and the time step size is now %.9g.",
+                        (size_t)(dT->nTotalSteps - nStepsBefore), dT->simParams->h);
+    }
 }
 
 void DEMSolver::DoDynamicsThenSync(double thisCallDuration) {
@@ -900,6 +1247,21 @@ void DEMSolver::DoDynamicsThenSync(double thisCallDuration) {
     resetWorkerThreads();
 }
 
+size_t DEMSolver::GetNumSleepingClumps() const {
+    return dT->getNumSleepingClumps();
+}
+
+double DEMSolver::GetTimeStepSize() {
+    if (sys_initialized) {
+        return dT->simParams->h;
+    }
+    return m_ts_size;
+}
+
+float DEMSolver::GetExpandFactor() {
+    return m_expand_factor;
+}
+
 void DEMSolver::ShowThreadCollaborationStats() {
     DEME_PRINTF("\n~~ kT--dT CO-OP STATISTICS ~~\n");
     DEME_PRINTF("Number of steps dynamic executed: %zu\n", dT->nTotalSteps);
@@ -918,6 +1280,17 @@ void DEMSolver::ShowThreadCollaborationStats() {
                 (dTkT_InteractionManager->schedulingStats.nTimesDynamicHeldBack).load());
     DEME_PRINTF("Number of times kinematic held back: %zu\n",
                 (dTkT_InteractionManager->schedulingStats.nTimesKinematicHeldBack).load());
+    if (use_displacement_triggered_cd) {
+        DEME_PRINTF("Expand factor in use: %.9g\n", m_expand_factor);
+    } else if (use_auto_cd_update_freq) {
+        DEME_PRINTF("Update frequency in use: %d\n", m_updateFreq);
+        DEME_PRINTF("Expand factor in use: %.9g\n", m_expand_factor);
+    }
+    if (use_sleeping) {
+        DEME_PRINTF("Number of clumps asleep: %zu\n", dT->getNumSleepingClumps());
+    }
+    DEME_PRINTF("Number of bins that took the overfull-bin path: %zu (in %zu contact detections)\n",
+                (kT->nOverfullBins).load(), (kT->nCDWithOverfullBins).load());
     DEME_PRINTF("-----------------------------\n");
 }
 
@@ -928,10 +1301,12 @@ void DEMSolver::ClearThreadCollaborationStats() {
     // dTkT_InteractionManager->schedulingStats.nKinematicReceives = 0;
     dTkT_InteractionManager->schedulingStats.nTimesDynamicHeldBack = 0;
     dTkT_InteractionManager->schedulingStats.nTimesKinematicHeldBack = 0;
+    kT->nOverfullBins = 0;
+    kT->nCDWithOverfullBins = 0;
     dT->nTotalSteps = 0;
 }
 
-float DEMSolver::dTInspectReduce(const std::shared_ptr<jitify::Program>& inspection_kernel,
+float DEMSolver::dTInspectReduce(const std::shared_ptr<JitProgram>& inspection_kernel,
                                  const std::string& kernel_name,
                                  INSPECT_ENTITY_TYPE thing_to_insp,
                                  CUB_REDUCE_FLAVOR reduce_flavor,
@@ -147,14 +147,15 @@ void DEMInspector::Initialize(const std::unordered_map<std::string, std::string>
     std::unordered_map<std::string, std::string> my_subs = Subs;
     my_subs["_inRegionPolicy_"] = in_region_specifier;
     my_subs["_quantityQueryProcess_"] = inspection_code;
+    std::shared_ptr<JitDiskCache> disk_cache = sys->GetJitDiskCache();
     if (thing_to_insp == INSPECT_ENTITY_TYPE::SPHERE) {
-        inspection_kernel = std::make_shared<jitify::Program>(std::move(
+        inspection_kernel = std::make_shared<JitProgram>(std::move(
             JitHelper::buildProgram("DEMSphereQueryKernels", JitHelper::KERNEL_DIR / "DEMSphereQueryKernels.cu",
-                                    my_subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+                                    my_subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
     } else if (thing_to_insp == INSPECT_ENTITY_TYPE::CLUMP) {
-        inspection_kernel = std::make_shared<jitify::Program>(
+        inspection_kernel = std::make_shared<JitProgram>(
             std::move(JitHelper::buildProgram("DEMOwnerQueryKernels", JitHelper::KERNEL_DIR / "DEMOwnerQueryKernels.cu",
-                                              my_subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+                                              my_subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
     }
     initialized = true;
 }
@@ -10,10 +10,8 @@
 #include <core/utils/JitHelper.h>
 #include <DEM/Defines.h>
 
-// Forward declare jitify::Program to avoid downstream dependency
-namespace jitify {
-class Program;
-}
+// Forward declare JitProgram to avoid downstream dependency (on jitify)
+class JitProgram;
 
 namespace deme {
 
@@ -23,7 +21,7 @@ class DEMSolver;
 /// their simulation entites, in a given region.
 class DEMInspector {
   private:
-    std::shared_ptr<jitify::Program> inspection_kernel;
+    std::shared_ptr<JitProgram> inspection_kernel;
 
     std::string inspection_code;
     std::string in_region_code;
@@ -23,11 +23,45 @@ namespace deme {
 #define DEME_GET_VAR_NAME(Variable) (#Variable)
 #define DEME_KT_CD_NTHREADS_PER_BLOCK 256
 #define DEME_MAX_SPHERES_PER_BIN 256  ///< Can't be larger than DEME_KT_CD_NTHREADS_PER_BLOCK
+// Max spheres a bin can have in the one-bin-per-thread CD kernels, which keep them in per-thread local arrays. Bins
+// with more spheres than the bin-wise kernels hold are not an error; they take the (slower) overfull-bin path instead.
+#define DEME_MAX_SPHERES_PER_BIN_ONE_THREAD 64
 #define DEME_TINY_FLOAT 1e-12
 #define DEME_HUGE_FLOAT 1e15
 #define DEME_BITS_PER_BYTE 8
 #define DEME_CUDA_WARP_SIZE 32
 #define DEME_MAX_WILDCARD_NUM 8
+// In displacement-triggered contact detection, dT must switch to a new contact list before any owner moves further than
+// this fraction of the expand factor (half the Verlet skin) from where it was when the list in use was detected
+#define DEME_CD_DISP_TRIGGER_FRACTION 0.9
+// Default bounds of the automatically chosen expand factor, as fractions of the smallest sphere radius
+#define DEME_CD_AUTO_EXPAND_MIN_FRACTION 0.005
+#define DEME_CD_AUTO_EXPAND_MAX_FRACTION 0.5
+// Without measurements, the initial expand factor is what the user-estimated max velocity covers in this many steps
+#define DEME_CD_AUTO_EXPAND_INIT_STEPS 10
+// The expand factor is re-chosen only if at least this many dT steps have been run since it was last chosen
+#define DEME_CD_AUTO_EXPAND_MIN_SAMPLE_STEPS 100
+// Default bounds of the automatically chosen contact detection update frequency
+#define DEME_CD_AUTO_FREQ_MIN 1
+#define DEME_CD_AUTO_FREQ_MAX 50
+// The max velocity the automatically chosen update frequency goes by can only drop by this factor per DoDynamics call,
+// as the velocity is sampled between calls and the peaks in between would otherwise be forgotten
+#define DEME_CD_AUTO_FREQ_VEL_DECAY 0.5
+// Default number of consecutive quiet steps after which a clump falls asleep
+#define DEME_SLEEP_QUIET_STEPS 200
+// By default, a clump is quiet if none of its points moves further than this fraction of the smallest sphere radius in
+// a step, and its acceleration changes by less than this fraction of the gravitational acceleration between steps
+#define DEME_SLEEP_DISP_FRACTION 1e-5
+#define DEME_SLEEP_ACC_CHANGE_FRACTION 0.01
+// Default targets of the variable time step size: with MAX_VEL, no point moves further than this fraction of the
+// smallest sphere radius in a step; with INT_GAP, no contact overlaps more than this fraction of its smaller radius
+#define DEME_TS_DISP_FRACTION 0.01
+#define DEME_TS_OVERLAP_FRACTION 0.01
+// The variable time step size grows by at most this factor, and shrinks by at most this factor, per step
+#define DEME_TS_MAX_GROWTH 1.05
+#define DEME_TS_MAX_SHRINK 0.5
+// Max number of levels in the multi-level bin hierarchy; bins of level k are 2^k times as large as those of level 0
+#define DEME_MAX_BIN_LEVELS 8
 
 // A few pre-computed constants
 constexpr double TWO_OVER_THREE = 0.666666666666667;
@@ -44,6 +78,9 @@ constexpr int64_t MAX_SUBVOXEL = (int64_t)1 << VOXEL_RES_POWER2;
 #define DEME_NUM_BODIES_PER_BLOCK 512
 #define DEME_MAX_THREADS_PER_BLOCK 1024
 #define DEME_INIT_CNT_MULTIPLIER 5
+// When an entity array needs to grow past its capacity, its capacity grows by at least this factor, so that adding
+// entities a few at a time to a running simulation only reallocates once in a while
+#define DEME_ARRAY_GROWTH_FACTOR 1.5
 // If there are more than this number of analytical geometry, we may have difficulty jitify them all
 #define DEME_THRESHOLD_TOO_MANY_ANAL_GEO 64
 // If a clump has more than this number of sphere components, it is automatically considered a non-jitifiable big clump
@@ -75,6 +112,12 @@ const ownerType_t OWNER_T_CLUMP = 0;
 const ownerType_t OWNER_T_ANALYTICAL = 1;
 const ownerType_t OWNER_T_MESH = 2;
 
+// Bits of an owner's sleep state
+const sleepState_t SLEEP_ASLEEP = 1;        // Not integrated, and its contacts with other sleeping owners are frozen
+const sleepState_t SLEEP_WAKE_REQUEST = 2;  // A restless owner touches this sleeping one, so it wakes up
+const sleepState_t SLEEP_RESTLESS = 4;      // Moving or feeling changing forces, so it wakes up the owners it touches
+const sleepState_t SLEEP_NO_ACC_REF = 8;    // Just woken up, so there is no acceleration to compare with yet
+
 // This ID marks that this is a new contact, not present when we did contact detection last time
 // TODO: half max add half max... so stupid... Better way?? numeric_limit won't work...
 constexpr contactPairs_t NULL_MAPPING_PARTNER = ((size_t)1 << (sizeof(contactPairs_t) * DEME_BITS_PER_BYTE - 1)) +
@@ -86,6 +129,8 @@ constexpr bodyID_t NULL_BODYID = ((size_t)1 << (sizeof(bodyID_t) * DEME_BITS_PER
 const unsigned int DEFAULT_CLUMP_FAMILY_NUM = 0;
 // Reserved (user) clump family number which is always used for fixities
 constexpr unsigned int RESERVED_FAMILY_NUM = ((unsigned int)1 << (sizeof(family_t) * DEME_BITS_PER_BYTE)) - 1;
+// Default (user) family number that clumps leaving the domain are moved into, when out-of-domain culling is in use
+constexpr unsigned int DEFAULT_CULLED_FAMILY_NUM = RESERVED_FAMILY_NUM - 1;
 // The number of all possible families is known: it depends on family_t
 constexpr size_t NUM_AVAL_FAMILIES = (size_t)1 << (sizeof(family_t) * DEME_BITS_PER_BYTE);
 // Reserved clump template mark number, used to indicate the largest inertiaOffset number (currently not used since all
@@ -111,7 +156,7 @@ enum class INSPECT_ENTITY_TYPE { SPHERE, CLUMP, MESH, MESH_FACET };
 // Which reduce operation is needed in an inspection
 enum class CUB_REDUCE_FLAVOR { NONE, MAX, MIN, SUM };
 // Format of the output files
-enum class OUTPUT_FORMAT { CSV, BINARY, CHPF };
+enum class OUTPUT_FORMAT { CSV, BINARY, CHPF, NATIVE };
 // Force mode type
 enum class FORCE_MODEL { HERTZIAN, HERTZIAN_FRICTIONLESS, CUSTOM };
 // The info that should be present in the output files
@@ -170,6 +215,8 @@ struct DEMSimParams {
     double voxelSize;
     // The edge length of a bin (for contact detection)
     double binSize;
+    // Number of levels in the bin hierarchy (1 means single-level binning). Level k bins have edge length binSize * 2^k
+    unsigned int nBinLevels = 1;
     // Number of clumps, spheres, triangles, mesh-represented objects, analytical components, external objs...
     bodyID_t nSpheresGM;
     triID_t nTriGM;
@@ -210,6 +257,47 @@ struct DEMSimParams {
     // Number of wildcards (extra property) arrays associated with contacts and owners
     unsigned int nContactWildcards;
     unsigned int nOwnerWildcards;
+
+    // A clump is quiet if its velocity, angular velocity and acceleration change between steps are below these, and
+    // falls asleep after this many quiet steps in a row (0 means clumps never sleep). A threshold of 0 follows the
+    // current step size h, which may vary: the max velocity is then sleepMaxDispPerStep / h, the max angular velocity
+    // is the max velocity over sleepRefRadius, and the max acceleration change is DEME_SLEEP_ACC_CHANGE_FRACTION times
+    // the max velocity over h.
+    float sleepMaxVel = 0.f;
+    float sleepMaxAngVel = 0.f;
+    float sleepMaxAccChange = 0.f;
+    float sleepMaxDispPerStep = 0.f;
+    float sleepRefRadius = 0.f;
+    unsigned int sleepQuietSteps = 0;
+
+    // Bounds and targets of the variable time step size, and the length its targets are fractions of (only used if the
+    // step size is not constant)
+    double minStepSize = 0.;
+    double maxStepSize = 0.;
+    float stepRefLength = 0.f;
+    float stepDispFraction = 0.f;
+    float stepOverlapFraction = 0.f;
+    // If the force kernel records each contact's overlap, for the INT_GAP strategy
+    bool recordContactOverlap = false;
+
+    // Periodic boundaries: if each direction is periodic, and its period (the user-specified domain size, starting from
+    // the LBF corner)
+    bool periodicX = false;
+    bool periodicY = false;
+    bool periodicZ = false;
+    double periodX = 0.;
+    double periodY = 0.;
+    double periodZ = 0.;
+    // Out-of-domain culling: if it is in use, clumps that leave the keep region (relative to the LBF corner) are moved
+    // into family cullFamily, to be removed from the simulation later
+    bool cullOutOfDomain = false;
+    family_t cullFamily = 0;
+    double keepLBFX = 0.;
+    double keepLBFY = 0.;
+    double keepLBFZ = 0.;
+    double keepRTFX = 0.;
+    double keepRTFY = 0.;
+    double keepRTFZ = 0.;
 };
 
 // A struct that holds pointers to data arrays that dT uses
@@ -218,6 +306,8 @@ struct DEMDataDT {
     inertiaOffset_t* inertiaPropOffsets;
 
     family_t* familyID;
+    // Counts the clumps that integration moves into the culled family (out-of-domain culling)
+    size_t* pNumCulledClumps;
 
     voxelID_t* voxelID;
 
@@ -290,6 +380,30 @@ struct DEMDataDT {
     oriQ_t* pKTOwnedBuffer_oriQ2 = NULL;
     oriQ_t* pKTOwnedBuffer_oriQ3 = NULL;
     family_t* pKTOwnedBuffer_familyID = NULL;
+    float* pKTOwnedBuffer_beta = NULL;
+
+    // Owner positions and orientations that the contact list in use was detected with, and how far each owner's
+    // geometry reaches from its CoM (only used in displacement-triggered contact detection)
+    voxelID_t* voxelID_cdRef;
+    subVoxelPos_t* locX_cdRef;
+    subVoxelPos_t* locY_cdRef;
+    subVoxelPos_t* locZ_cdRef;
+    oriQ_t* oriQw_cdRef;
+    oriQ_t* oriQx_cdRef;
+    oriQ_t* oriQy_cdRef;
+    oriQ_t* oriQz_cdRef;
+    float* ownerCDReach;
+
+    // Owner sleep states, the number of quiet steps in a row and the acceleration in the previous step (only used if
+    // clumps can sleep)
+    ownerType_t* ownerTypes;
+    sleepState_t* ownerSleepState;
+    unsigned int* ownerQuietSteps;
+    float3* ownerPrevAcc;
+
+    // Each contact's overlap over the smaller radius of the two bodies, in a temp vector (only used if
+    // recordContactOverlap)
+    float* contactOverlap;
 
     // The collection of pointers to DEM template arrays such as radiiSphere, still useful when there are template info
     // not directly jitified into the kernels
@@ -333,12 +447,16 @@ struct DEMDataKT {
     oriQ_t* oriQ2_buffer;
     oriQ_t* oriQ3_buffer;
     family_t* familyID_buffer;
+    // The expand factor that the work order should be processed with
+    float beta_buffer = 0.f;
 
     // Family mask
     notStupidBool_t* familyMasks;
 
     // The offset info that indexes into the template arrays
     bodyID_t* ownerClumpBody;
+    // Public sphere IDs that sphere--sphere contact pairs are oriented by (NULL if they are where the spheres are)
+    bodyID_t* spherePublicID;
     clumpComponentOffset_t* clumpComponentOffset;
     clumpComponentOffsetExt_t* clumpComponentOffsetExt;
     bodyID_t* ownerMesh;
@@ -346,6 +464,21 @@ struct DEMDataKT {
     float3* relPosNode2;
     float3* relPosNode3;
 
+    // Analytical entity definitions. The kernels use the jitified version of them; these are for the host-side contact
+    // detection.
+    bodyID_t* ownerAnalBody;
+    objType_t* typeAnalEntity;
+    notStupidBool_t* normalAnalEntity;
+    float* relPosEntityX;
+    float* relPosEntityY;
+    float* relPosEntityZ;
+    float* oriEntityX;
+    float* oriEntityY;
+    float* oriEntityZ;
+    float* sizeEntity1;
+    float* sizeEntity2;
+    float* sizeEntity3;
+
     // kT's own work arrays. Now these array pointers get assigned in contactDetection() which point to shared scratch
     // spaces. No need to do forward declaration anymore. They are left here for reference, should contactDetection()
     // need to be re-visited.
@@ -382,6 +515,31 @@ struct DEMDataKT {
     float* relPosSphereZ;
 };
 
+// A uniform grid over the spheres of the clumps staged for insertion, which the existing spheres look up to find the
+// staged clumps they would overlap. Positions are relative to the LBF corner of the world.
+struct DEMInflowGrid {
+    // The LBF corner of the grid, the cell edge length, and the number of cells along each direction
+    double LBFX;
+    double LBFY;
+    double LBFZ;
+    double cellSize;
+    unsigned int nCellX;
+    unsigned int nCellY;
+    unsigned int nCellZ;
+    // The largest staged sphere radius, and the gap that has to be left between two spheres
+    float maxRadius;
+    float clearance;
+    // The staged spheres, sorted by cell: those in cell c are the cellStart[c]-th to the (cellStart[c + 1] - 1)-th
+    size_t* cellStart;
+    float* sphX;
+    float* sphY;
+    float* sphZ;
+    float* sphRadius;
+    // The staged clump each sphere belongs to, and the marks of the staged clumps that would overlap something
+    size_t* sphClump;
+    notStupidBool_t* clumpRejected;
+};
+
 // typedef DEMDataDT* DEMDataDTPtr;
 // typedef DEMSimParams* DEMSimParamsPtr;
 
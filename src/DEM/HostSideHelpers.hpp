@@ -17,8 +17,13 @@
 #include <regex>
 #include <fstream>
 #include <filesystem>
+#include <thread>
+#include <atomic>
 #include <nvmath/helper_math.cuh>
 #include <DEM/VariableTypes.h>
+#include <core/utils/JitSubstitution.h>
+#include <core/utils/HostThreadPool.h>
+#include <algorithms/DEMHostWrappers.hpp>
 // #include <DEM/Defines.h>
 
 namespace deme {
@@ -53,15 +58,18 @@ inline T1 vector_sum(const std::vector<T1>& vect) {
     return sum_of_elems;
 }
 
+// In-place exclusive prefix scan
 template <typename T1>
 inline void hostPrefixScan(T1* arr, size_t n) {
-    T1 buffer_previous = arr[0];
-    arr[0] = 0;
-    for (size_t i = 1; i < n; i++) {
-        T1 item_to_add = buffer_previous;
-        buffer_previous = arr[i];
-        arr[i] = arr[i - 1] + item_to_add;
-    }
+    HostScratchPad scratchPad;
+    hostDEMPrefixScan(arr, arr, n, HostThreadPool::Shared(), scratchPad);
+}
+
+// Split [0, n) into (at most) nThreads contiguous chunks and let the threads of a shared pool process one chunk each by
+// calling func(begin, end). If nThreads is 0, the hardware concurrency is used.
+template <typename Func>
+inline void hostParallelFor(size_t n, unsigned int nThreads, const Func& func) {
+    HostThreadPool::Shared(nThreads).parallelFor(n, func);
 }
 
 template <typename T1>
@@ -132,11 +140,7 @@ inline std::string replace_pattern(const std::string& in, const std::string& fro
 /// Replace all instances of certain patterns from a string, based on a mapping passed as an argument
 inline std::string replace_patterns(const std::string& in,
                                     const std::unordered_map<std::string, std::string>& mapping) {
-    std::string str = in;
-    for (const auto& rep : mapping) {
-        str = std::regex_replace(str, std::regex(rep.first), rep.second);
-    }
-    return str;
+    return JitSubstitution::apply(in, mapping);
 }
 
 /// Sachin Gupta's work on removing comments from a piece of code, from
@@ -221,64 +225,42 @@ inline float3 Rodrigues(const float3& vec, const float3& axis, const float& thet
     return res;
 }
 
+// In-place (stable) sort of vals by unsigned integer keys
 template <typename T1, typename T2>
 inline void hostSortByKey(T1* keys, T2* vals, size_t n) {
-    // Just bubble sort it
-    bool swapped;
-    for (size_t i = 0; i < n - 1; i++) {
-        swapped = false;
-        for (size_t j = 0; j < n - i - 1; j++) {
-            if (keys[j] > keys[j + 1]) {
-                elemSwap<T1>(&keys[j], &keys[j + 1]);
-                elemSwap<T2>(&vals[j], &vals[j + 1]);
-                swapped = true;
-            }
-        }
-        if (!swapped) {
-            break;
-        }
-    }
+    HostScratchPad scratchPad;
+    hostDEMSortByKeys(keys, keys, vals, vals, n, HostThreadPool::Shared(), scratchPad);
 }
 
+// Count the runs of identical consecutive items in arr that are at least minSegLen long
 template <typename T1>
 inline void hostScanForJumpsNum(T1* arr, size_t n, unsigned int minSegLen, size_t& total_found) {
-    size_t i = 0;
-    size_t found = 0;
-    while (i < n - 1) {
-        size_t thisIndx = i;
-        T1 thisItem = arr[i];
-        do {
-            i++;
-        } while (arr[i] == thisItem && i < n - 1);
-        if (i - thisIndx >= minSegLen || (i == n - 1 && i - thisIndx + 1 >= minSegLen && arr[i] == thisItem)) {
+    HostScratchPad scratchPad;
+    std::atomic<size_t> found(0);
+    hostDEMForEachRun(arr, n, HostThreadPool::Shared(), scratchPad, [&](size_t, size_t begin, size_t end) {
+        if (end - begin >= minSegLen)
             found++;
-        }
-    }
+    });
     total_found = found;
 }
 
-// Tell each active bin where to find its touching spheres
+// Tell each active bin where to find its touching spheres: for each run of identical consecutive items in arr that is
+// at least minSegLen long, its item, location and length
 template <typename T1, typename T2, typename T3>
 inline void hostScanForJumps(T1* arr, T1* arr_elem, T2* jump_loc, T3* jump_len, size_t n, unsigned int minSegLen) {
+    // Runs are reported in order, so this part stays serial
     size_t total_found = 0;
-    T2 i = 0;
-    unsigned int thisSegLen;
-    while (i < n - 1) {
-        thisSegLen = 0;
-        T2 thisIndx = i;
-        T1 thisItem = arr[i];
-        do {
-            i++;
-            thisSegLen++;
-        } while (arr[i] == thisItem && i < n - 1);
-        if (i - thisIndx >= minSegLen || (i == n - 1 && i - thisIndx + 1 >= minSegLen && arr[i] == thisItem)) {
-            jump_loc[total_found] = thisIndx;
-            if (i == n - 1 && i - thisIndx + 1 >= minSegLen && arr[i] == thisItem)
-                thisSegLen++;
-            jump_len[total_found] = thisSegLen;
-            arr_elem[total_found] = arr[thisIndx];
+    for (size_t i = 0; i < n;) {
+        size_t j = i + 1;
+        while (j < n && arr[j] == arr[i])
+            j++;
+        if (j - i >= minSegLen) {
+            jump_loc[total_found] = (T2)i;
+            jump_len[total_found] = (T3)(j - i);
+            arr_elem[total_found] = arr[i];
             total_found++;
         }
+        i = j;
     }
 }
 
@@ -348,6 +330,118 @@ inline void hostPositionToVoxelID(T1& ID,
     ID += voxelNumZ << (nvXp2 + nvYp2);
 }
 
+// Spreads the lower 21 bits of x apart, leaving 2 zero bits between each two of them
+inline uint64_t hostSpreadBitsBy3(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | (x << 32)) & 0x1f00000000ffff;
+    x = (x | (x << 16)) & 0x1f0000ff0000ff;
+    x = (x | (x << 8)) & 0x100f00f00f00f00f;
+    x = (x | (x << 4)) & 0x10c30c30c30c30c3;
+    x = (x | (x << 2)) & 0x1249249249249249;
+    return x;
+}
+
+// The Morton (Z-order) code of a voxelID: the bits of its XYZ components interleaved, so voxels that are close in space
+// tend to be close in this order too. A 64-bit code has room for 21 bits per component, so only the 21 most significant
+// bits of each component are used.
+template <typename T1>
+inline uint64_t hostVoxelIDToMortonCode(const T1& ID,
+                                        const unsigned char& nvXp2,
+                                        const unsigned char& nvYp2,
+                                        const unsigned char& nvZp2) {
+    T1 X, Y, Z;
+    hostIDChopper<T1, T1>(X, Y, Z, ID, nvXp2, nvYp2);
+    const unsigned char maxBits = std::max(nvXp2, std::max(nvYp2, nvZp2));
+    const unsigned char shift = (maxBits > 21) ? maxBits - 21 : 0;
+    return hostSpreadBitsBy3((uint64_t)X >> shift) | (hostSpreadBitsBy3((uint64_t)Y >> shift) << 1) |
+           (hostSpreadBitsBy3((uint64_t)Z >> shift) << 2);
+}
+
+// Rearranges the first n elements of arr so that the i-th one becomes the newToOld[i]-th old one
+template <typename T1, typename T2, typename Alloc>
+inline void hostApplyPermutation(std::vector<T1, Alloc>& arr,
+                                 const std::vector<T2>& newToOld,
+                                 size_t n,
+                                 HostThreadPool& pool) {
+    std::vector<T1> old(arr.begin(), arr.begin() + n);
+    pool.parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            arr[i] = old[newToOld[i]];
+    });
+}
+
+// After some items are rearranged (the i-th one is the newToOld[i]-th old one), updates the maps between their public
+// IDs and where they are. Empty maps mean the public IDs are where the items are.
+template <typename T1>
+inline void hostUpdateIDMaps(std::vector<T1>& publicToInternal,
+                             std::vector<T1>& internalToPublic,
+                             const std::vector<T1>& newToOld,
+                             size_t n,
+                             HostThreadPool& pool) {
+    if (internalToPublic.empty()) {
+        internalToPublic.resize(n);
+        std::iota(internalToPublic.begin(), internalToPublic.end(), (T1)0);
+    }
+    hostApplyPermutation(internalToPublic, newToOld, n, pool);
+    publicToInternal.resize(n);
+    pool.parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            publicToInternal[internalToPublic[i]] = (T1)i;
+    });
+}
+
+// Of the first nOld elements of arr, keeps those that keptOld lists at the front, so that the i-th one becomes the
+// keptOld[i]-th old one
+template <typename T1, typename T2, typename Alloc>
+inline void hostApplyCompaction(std::vector<T1, Alloc>& arr,
+                                const std::vector<T2>& keptOld,
+                                size_t nOld,
+                                HostThreadPool& pool) {
+    std::vector<T1> old(arr.begin(), arr.begin() + nOld);
+    pool.parallelFor(keptOld.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            arr[i] = old[keptOld[i]];
+    });
+}
+
+// After only the items that keptOld lists are kept (see hostApplyCompaction), updates the maps between their public IDs
+// and where they are. The kept items keep the order of their public IDs, which are numbered from 0 again, and
+// publicOldToNew tells the new public ID of each old one (nullID if that item is gone). Empty maps stay empty, since
+// the kept items then still are where their public IDs say.
+template <typename T1>
+inline void hostCompactIDMaps(std::vector<T1>& publicToInternal,
+                              std::vector<T1>& internalToPublic,
+                              const std::vector<T1>& keptOld,
+                              size_t nOld,
+                              std::vector<T1>& publicOldToNew,
+                              const T1& nullID,
+                              HostThreadPool& pool) {
+    const size_t nNew = keptOld.size();
+    publicOldToNew.assign(nOld, nullID);
+    if (internalToPublic.empty()) {
+        for (size_t i = 0; i < nNew; i++)
+            publicOldToNew[keptOld[i]] = (T1)i;
+        return;
+    }
+    std::vector<notStupidBool_t> isKept(nOld, 0);
+    for (size_t i = 0; i < nNew; i++)
+        isKept[internalToPublic[keptOld[i]]] = 1;
+    T1 nextID = 0;
+    for (size_t i = 0; i < nOld; i++) {
+        if (isKept[i])
+            publicOldToNew[i] = nextID++;
+    }
+    hostApplyCompaction(internalToPublic, keptOld, nOld, pool);
+    internalToPublic.resize(nNew);
+    publicToInternal.resize(nNew);
+    pool.parallelFor(nNew, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            internalToPublic[i] = publicOldToNew[internalToPublic[i]];
+            publicToInternal[internalToPublic[i]] = (T1)i;
+        }
+    });
+}
+
 template <typename T1>
 std::vector<T1> hostUniqueVector(const std::vector<T1>& vec) {
     std::vector<T1> unique_vec(vec);
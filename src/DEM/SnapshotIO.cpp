@@ -0,0 +1,496 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <DEM/SnapshotIO.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#include <chpf.hpp>
+#include <core/utils/HostThreadPool.h>
+
+namespace deme {
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'D', 'E', 'M', 'E', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+
+template <typename T>
+void writePod(std::ostream& out, const T& val) {
+    out.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+void writeString(std::ostream& out, const std::string& str) {
+    writePod<uint32_t>(out, (uint32_t)str.size());
+    out.write(str.data(), str.size());
+}
+
+// Reads the fields of a snapshot file, and makes sure none of them claims more bytes than the stream has left, so that
+// a corrupt or truncated file is rejected before anything is allocated for it. A stream that cannot tell its size (such
+// as a pipe) is read as is, and only fails when it runs out.
+class SnapshotReader {
+  public:
+    explicit SnapshotReader(std::istream& input) : in(input) {
+        const std::streampos here = in.tellg();
+        if (here == std::streampos(-1))
+            return;
+        in.seekg(0, std::ios::end);
+        const std::streampos end = in.tellg();
+        in.seekg(here);
+        if (end != std::streampos(-1) && end >= here)
+            remaining = (uint64_t)(end - here);
+    }
+
+    uint64_t Remaining() const { return remaining; }
+
+    void ReadBytes(char* dst, uint64_t n, const std::string& what) {
+        checkBytes(n, what);
+        in.read(dst, (std::streamsize)n);
+        if (!in) {
+            throw std::runtime_error("Snapshot file ended in the middle of " + what + ".");
+        }
+        remaining -= n;
+    }
+
+    template <typename T>
+    T ReadPod(const std::string& what) {
+        T val;
+        ReadBytes(reinterpret_cast<char*>(&val), sizeof(T), what);
+        return val;
+    }
+
+    std::string ReadString(const std::string& what) {
+        uint32_t len = ReadPod<uint32_t>(what);
+        checkBytes(len, what);
+        std::string str(len, '\0');
+        ReadBytes(&str[0], len, what);
+        return str;
+    }
+
+    // Check that count entries of at least minBytes each can still be in the stream
+    void CheckCount(uint64_t count, uint64_t minBytes, const std::string& what) const {
+        if (count > remaining / minBytes) {
+            throw std::runtime_error("Snapshot file is corrupt or truncated: it claims " + std::to_string(count) + " " +
+                                     what + ", but only " + std::to_string(remaining) + " bytes are left.");
+        }
+    }
+
+  private:
+    void checkBytes(uint64_t n, const std::string& what) const {
+        if (n > remaining) {
+            throw std::runtime_error("Snapshot file is corrupt or truncated: " + what + " needs " + std::to_string(n) +
+                                     " bytes, but only " + std::to_string(remaining) + " are left.");
+        }
+    }
+
+    std::istream& in;
+    uint64_t remaining = std::numeric_limits<uint64_t>::max();
+};
+
+template <typename T>
+const T* columnData(const DEMSnapshotColumn& col) {
+    return reinterpret_cast<const T*>(col.data.data());
+}
+
+// Rows of a CSV file are formatted by parallel chunks of at most this many rows, each into its own buffer, and the
+// buffers are written in order
+constexpr size_t CSV_ROWS_PER_CHUNK = 16384;
+
+template <typename T>
+char* formatCsvValue(char* p, char* end, T val, unsigned int precision) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return (precision ? std::to_chars(p, end, val, std::chars_format::general, (int)precision)
+                          : std::to_chars(p, end, val))
+            .ptr;
+    } else {
+        return std::to_chars(p, end, val).ptr;
+    }
+}
+
+// Format an element of a column; 8-bit integers are written as numbers, not characters
+char* formatCsvValue(char* p, char* end, const DEMSnapshotColumn& col, size_t row, unsigned int precision) {
+    switch (col.type) {
+        case (SNAPSHOT_COL_TYPE::UINT8):
+            return formatCsvValue<unsigned int>(p, end, columnData<uint8_t>(col)[row], precision);
+        case (SNAPSHOT_COL_TYPE::UINT16):
+            return formatCsvValue<unsigned int>(p, end, columnData<uint16_t>(col)[row], precision);
+        case (SNAPSHOT_COL_TYPE::UINT32):
+            return formatCsvValue<uint32_t>(p, end, columnData<uint32_t>(col)[row], precision);
+        case (SNAPSHOT_COL_TYPE::UINT64):
+            return formatCsvValue<uint64_t>(p, end, columnData<uint64_t>(col)[row], precision);
+        case (SNAPSHOT_COL_TYPE::INT32):
+            return formatCsvValue<int32_t>(p, end, columnData<int32_t>(col)[row], precision);
+        case (SNAPSHOT_COL_TYPE::FLOAT):
+            return formatCsvValue<float>(p, end, columnData<float>(col)[row], precision);
+        case (SNAPSHOT_COL_TYPE::DOUBLE):
+            return formatCsvValue<double>(p, end, columnData<double>(col)[row], precision);
+    }
+    return p;
+}
+
+// The most characters that an element of a column can take in a CSV file. A floating-point number takes at most its
+// digits, a sign, a point and an exponent such as e-308 (or leading zeros such as 0.000); with no precision given, it
+// takes as many digits as it needs to read back exactly.
+size_t csvValueMaxChars(SNAPSHOT_COL_TYPE type, unsigned int precision) {
+    switch (type) {
+        case (SNAPSHOT_COL_TYPE::UINT8):
+            return 3;
+        case (SNAPSHOT_COL_TYPE::UINT16):
+            return 5;
+        case (SNAPSHOT_COL_TYPE::UINT32):
+            return 10;
+        case (SNAPSHOT_COL_TYPE::INT32):
+            return 11;
+        case (SNAPSHOT_COL_TYPE::UINT64):
+            return 20;
+        case (SNAPSHOT_COL_TYPE::FLOAT):
+            return (precision ? precision : 9) + 8;
+        case (SNAPSHOT_COL_TYPE::DOUBLE):
+            return (precision ? precision : 17) + 9;
+    }
+    return 0;
+}
+
+// ChPF takes the columns of a file as a parameter pack, but which columns there are is only known at run time (from
+// the output content flags). So the columns are unrolled into the pack one at a time, the floating-point ones first,
+// then the integer ones, and a file has at most this many of either kind.
+constexpr size_t CHPF_MAX_FLOAT_COLUMNS = 20;
+constexpr size_t CHPF_MAX_INT_COLUMNS = 3;
+
+template <size_t nInt, typename... Cols>
+void writeChpfIntColumns(std::ofstream& out,
+                         const std::vector<std::string>& names,
+                         const std::vector<std::vector<unsigned int>>& intCols,
+                         const Cols&... cols) {
+    if constexpr (nInt < CHPF_MAX_INT_COLUMNS) {
+        if (nInt < intCols.size()) {
+            writeChpfIntColumns<nInt + 1>(out, names, intCols, cols..., intCols[nInt]);
+            return;
+        }
+    }
+    chpf::Writer pw;
+    pw.write(out, chpf::Compressor::Type::USE_DEFAULT, names, cols...);
+}
+
+template <size_t nFloat, typename... Cols>
+void writeChpfFloatColumns(std::ofstream& out,
+                           const std::vector<std::string>& names,
+                           const std::vector<std::vector<float>>& floatCols,
+                           const std::vector<std::vector<unsigned int>>& intCols,
+                           const Cols&... cols) {
+    if constexpr (nFloat < CHPF_MAX_FLOAT_COLUMNS) {
+        if (nFloat < floatCols.size()) {
+            writeChpfFloatColumns<nFloat + 1>(out, names, floatCols, intCols, cols..., floatCols[nFloat]);
+            return;
+        }
+    }
+    writeChpfIntColumns<0>(out, names, intCols, cols...);
+}
+
+}  // namespace
+
+size_t snapshotColTypeSize(SNAPSHOT_COL_TYPE type) {
+    switch (type) {
+        case (SNAPSHOT_COL_TYPE::UINT8):
+            return 1;
+        case (SNAPSHOT_COL_TYPE::UINT16):
+            return 2;
+        case (SNAPSHOT_COL_TYPE::UINT32):
+        case (SNAPSHOT_COL_TYPE::INT32):
+        case (SNAPSHOT_COL_TYPE::FLOAT):
+            return 4;
+        case (SNAPSHOT_COL_TYPE::UINT64):
+        case (SNAPSHOT_COL_TYPE::DOUBLE):
+            return 8;
+    }
+    throw std::runtime_error("Unknown snapshot column type " + std::to_string((unsigned int)type) + ".");
+}
+
+void DEMSnapshot::Write(std::ostream& out) const {
+    out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writePod<uint32_t>(out, SNAPSHOT_VERSION);
+    writePod<uint32_t>(out, SNAPSHOT_BYTE_ORDER_MARK);
+    writeString(out, entity);
+    writePod<double>(out, time);
+    writePod<uint64_t>(out, nRows);
+    writePod<uint32_t>(out, (uint32_t)attributes.size());
+    for (const auto& attr : attributes) {
+        writeString(out, attr.first);
+        writePod<double>(out, attr.second);
+    }
+    writePod<uint32_t>(out, (uint32_t)stringTable.size());
+    for (const auto& str : stringTable) {
+        writeString(out, str);
+    }
+    writeString(out, stringTableColumn);
+    writePod<uint32_t>(out, (uint32_t)columns.size());
+    for (const auto& col : columns) {
+        writeString(out, col.name);
+        writeString(out, col.unit);
+        writePod<uint8_t>(out, (uint8_t)col.type);
+    }
+    // Then the columns, each in one go
+    for (const auto& col : columns) {
+        out.write(col.data.data(), col.data.size());
+    }
+}
+
+void DEMSnapshot::WriteFile(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + filename + " to write a snapshot in.");
+    }
+    Write(out);
+}
+
+DEMSnapshot DEMSnapshot::Read(std::istream& in) {
+    SnapshotReader reader(in);
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    bool isSnapshot = reader.Remaining() >= sizeof(magic);
+    if (isSnapshot) {
+        reader.ReadBytes(magic, sizeof(magic), "the header");
+        isSnapshot = std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+    }
+    if (!isSnapshot) {
+        throw std::runtime_error("This is not a snapshot file of the BINARY output format.");
+    }
+    uint32_t version = reader.ReadPod<uint32_t>("the header");
+    if (reader.ReadPod<uint32_t>("the header") != SNAPSHOT_BYTE_ORDER_MARK) {
+        throw std::runtime_error("This snapshot file was written on a machine of a different byte order.");
+    }
+    if (version > SNAPSHOT_VERSION) {
+        throw std::runtime_error("This snapshot file is of version " + std::to_string(version) +
+                                 ", but only versions up to " + std::to_string(SNAPSHOT_VERSION) + " can be read.");
+    }
+
+    DEMSnapshot snap;
+    snap.entity = reader.ReadString("the entity name");
+    snap.time = reader.ReadPod<double>("the header");
+    snap.nRows = reader.ReadPod<uint64_t>("the header");
+    // An attribute is at least a name length and a value, and a string at least its length
+    uint32_t nAttributes = reader.ReadPod<uint32_t>("the header");
+    reader.CheckCount(nAttributes, sizeof(uint32_t) + sizeof(double), "attributes");
+    for (uint32_t i = 0; i < nAttributes; i++) {
+        std::string name = reader.ReadString("an attribute name");
+        snap.attributes[name] = reader.ReadPod<double>("attribute " + name);
+    }
+    uint32_t nStrings = reader.ReadPod<uint32_t>("the header");
+    reader.CheckCount(nStrings, sizeof(uint32_t), "strings in the string table");
+    snap.stringTable.resize(nStrings);
+    for (uint32_t i = 0; i < nStrings; i++) {
+        snap.stringTable[i] = reader.ReadString("the string table");
+    }
+    snap.stringTableColumn = reader.ReadString("the string table column name");
+    // A column header is at least two string lengths and a type
+    uint32_t nColumns = reader.ReadPod<uint32_t>("the header");
+    reader.CheckCount(nColumns, 2 * sizeof(uint32_t) + sizeof(uint8_t), "columns");
+    snap.columns.resize(nColumns);
+    uint64_t rowBytes = 0;
+    for (auto& col : snap.columns) {
+        col.name = reader.ReadString("a column name");
+        col.unit = reader.ReadString("the unit of column " + col.name);
+        uint8_t type = reader.ReadPod<uint8_t>("the type of column " + col.name);
+        if (type > (uint8_t)SNAPSHOT_COL_TYPE::DOUBLE) {
+            throw std::runtime_error("Column " + col.name + " of this snapshot file is of unknown type " +
+                                     std::to_string((unsigned int)type) + ".");
+        }
+        col.type = (SNAPSHOT_COL_TYPE)type;
+        rowBytes += snapshotColTypeSize(col.type);
+    }
+    // All the columns, nRows elements each, are what is left of the file
+    if (rowBytes > 0) {
+        reader.CheckCount(snap.nRows, rowBytes, "rows");
+    }
+    for (auto& col : snap.columns) {
+        col.data.resize(snap.nRows * snapshotColTypeSize(col.type));
+        reader.ReadBytes(col.data.data(), col.data.size(), "column " + col.name);
+    }
+    return snap;
+}
+
+DEMSnapshot DEMSnapshot::ReadFile(const std::string& filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open snapshot file " + filename + ".");
+    }
+    return Read(in);
+}
+
+DEMSnapshot DecodeNativeSnapshot(const DEMSnapshot& snap) {
+    if (snap.GetAttribute("native_coordinates") == 0.) {
+        return snap;
+    }
+    const size_t nRows = snap.GetNumRows();
+    const unsigned int nvXp2 = (unsigned int)snap.GetAttribute("nvXp2");
+    const unsigned int nvYp2 = (unsigned int)snap.GetAttribute("nvYp2");
+    const double l = snap.GetAttribute("l");
+    const double voxelSize = snap.GetAttribute("voxelSize");
+    const double LBF[3] = {snap.GetAttribute("LBFX"), snap.GetAttribute("LBFY"), snap.GetAttribute("LBFZ")};
+    const unsigned int quatBits = (unsigned int)snap.GetAttribute("quat_bits", 32.);
+
+    DEMSnapshot decoded(snap.entity, nRows, snap.time);
+    decoded.attributes = snap.attributes;
+    decoded.attributes.erase("native_coordinates");
+    decoded.stringTable = snap.stringTable;
+    decoded.stringTableColumn = snap.stringTableColumn;
+
+    // The same as hostVoxelIDToPosition does in the solver
+    const std::vector<uint64_t> voxel = snap.GetColumn<uint64_t>("voxel");
+    const std::vector<double> subPos[3] = {snap.GetColumn<double>("locX"), snap.GetColumn<double>("locY"),
+                                           snap.GetColumn<double>("locZ")};
+    double* pos[3] = {decoded.AddColumn<double>("X", "L"), decoded.AddColumn<double>("Y", "L"),
+                      decoded.AddColumn<double>("Z", "L")};
+    for (size_t k = 0; k < nRows; k++) {
+        const uint64_t voxelIDs[3] = {voxel[k] & ((uint64_t(1) << nvXp2) - 1),
+                                      (voxel[k] >> nvXp2) & ((uint64_t(1) << nvYp2) - 1), voxel[k] >> (nvXp2 + nvYp2)};
+        for (int d = 0; d < 3; d++) {
+            pos[d][k] = (double)voxelIDs[d] * voxelSize + subPos[d][k] * l + LBF[d];
+        }
+    }
+
+    const std::string QNames[4] = {"Qw", "Qx", "Qy", "Qz"};
+    if (snap.HasColumn("Qw")) {
+        std::vector<float> Q[4];
+        for (int j = 0; j < 4; j++) {
+            Q[j] = snap.GetColumn<float>(QNames[j]);
+        }
+        float* decodedQ[4];
+        for (int j = 0; j < 4; j++) {
+            decodedQ[j] = decoded.AddColumn<float>(QNames[j]);
+        }
+        for (size_t k = 0; k < nRows; k++) {
+            float q[4];
+            for (int j = 0; j < 4; j++) {
+                q[j] = (quatBits < 32) ? dequantizeQuatComponent((uint32_t)Q[j][k], quatBits) : Q[j][k];
+            }
+            float norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            for (int j = 0; j < 4; j++) {
+                decodedQ[j][k] = (norm > 0.f) ? q[j] / norm : q[j];
+            }
+        }
+    }
+
+    for (const auto& col : snap.GetColumns()) {
+        if (!decoded.HasColumn(col.name) && col.name != "voxel" && col.name != "locX" && col.name != "locY" &&
+            col.name != "locZ") {
+            decoded.AppendColumn(col);
+        }
+    }
+    return decoded;
+}
+
+void writeSnapshotAsCsv(std::ostream& out, const DEMSnapshot& snap, const DEMCsvFormat& format) {
+    // The columns to write, and the most characters a row of them takes
+    std::vector<const DEMSnapshotColumn*> columns;
+    if (format.columns.empty()) {
+        for (const auto& col : snap.GetColumns())
+            columns.push_back(&col);
+    } else {
+        for (const auto& name : format.columns) {
+            for (const auto& col : snap.GetColumns()) {
+                if (col.name == name)
+                    columns.push_back(&col);
+            }
+        }
+    }
+    std::vector<uint64_t> strIndices;
+    size_t maxStrLen = 0;
+    size_t rowMaxChars = columns.size() + 1;
+    for (const auto col : columns) {
+        if (col->name == snap.stringTableColumn) {
+            strIndices = snap.GetColumn<uint64_t>(col->name);
+            for (const auto& str : snap.stringTable)
+                maxStrLen = std::max(maxStrLen, str.size());
+            rowMaxChars += std::max(maxStrLen, csvValueMaxChars(col->type, format.precision));
+        } else {
+            rowMaxChars += csvValueMaxChars(col->type, format.precision);
+        }
+    }
+
+    std::string header;
+    for (size_t j = 0; j < columns.size(); j++) {
+        header += (j ? "," : "") + columns[j]->name;
+    }
+    header += "\n";
+    out << header;
+
+    HostThreadPool& pool = HostThreadPool::Shared(format.nThreads);
+    const size_t nChunks = pool.size();
+    const size_t rowsPerBlock = nChunks * CSV_ROWS_PER_CHUNK;
+    std::vector<std::vector<char>> chunkBufs(nChunks);
+    std::vector<size_t> chunkChars(nChunks);
+    for (size_t blockBegin = 0; blockBegin < snap.GetNumRows(); blockBegin += rowsPerBlock) {
+        size_t nBlockRows = std::min(rowsPerBlock, snap.GetNumRows() - blockBegin);
+        std::fill(chunkChars.begin(), chunkChars.end(), 0);
+        pool.parallelForChunks(nBlockRows, nChunks, [&](size_t c, size_t begin, size_t end) {
+            std::vector<char>& buf = chunkBufs[c];
+            if (buf.size() < (end - begin) * rowMaxChars)
+                buf.resize((end - begin) * rowMaxChars);
+            char* p = buf.data();
+            char* bufEnd = buf.data() + buf.size();
+            for (size_t row = blockBegin + begin; row < blockBegin + end; row++) {
+                for (size_t j = 0; j < columns.size(); j++) {
+                    if (j)
+                        *p++ = ',';
+                    if (!strIndices.empty() && columns[j]->name == snap.stringTableColumn &&
+                        strIndices[row] < snap.stringTable.size()) {
+                        const std::string& str = snap.stringTable[strIndices[row]];
+                        p = std::copy(str.begin(), str.end(), p);
+                    } else {
+                        p = formatCsvValue(p, bufEnd, *columns[j], row, format.precision);
+                    }
+                }
+                *p++ = '\n';
+            }
+            chunkChars[c] = p - buf.data();
+        });
+        for (size_t c = 0; c < nChunks; c++) {
+            out.write(chunkBufs[c].data(), chunkChars[c]);
+        }
+    }
+}
+
+void writeSnapshotAsChpf(std::ofstream& out, const DEMSnapshot& snap) {
+    std::vector<std::string> floatNames, intNames;
+    std::vector<std::vector<float>> floatCols;
+    std::vector<std::vector<unsigned int>> intCols;
+    for (const auto& col : snap.GetColumns()) {
+        if (col.type == SNAPSHOT_COL_TYPE::FLOAT || col.type == SNAPSHOT_COL_TYPE::DOUBLE) {
+            floatNames.push_back(col.name);
+            floatCols.push_back(snap.GetColumn<float>(col.name));
+        } else {
+            intNames.push_back(col.name);
+            intCols.push_back(snap.GetColumn<unsigned int>(col.name));
+        }
+    }
+    if (floatCols.size() > CHPF_MAX_FLOAT_COLUMNS || intCols.size() > CHPF_MAX_INT_COLUMNS) {
+        throw std::runtime_error("A CHPF file can have at most " + std::to_string(CHPF_MAX_FLOAT_COLUMNS) +
+                                 " floating-point and " + std::to_string(CHPF_MAX_INT_COLUMNS) +
+                                 " integer columns, but " + std::to_string(floatCols.size()) + " and " +
+                                 std::to_string(intCols.size()) + " are asked for.");
+    }
+    std::vector<std::string> names(floatNames);
+    names.insert(names.end(), intNames.begin(), intNames.end());
+    writeChpfFloatColumns<0>(out, names, floatCols, intCols);
+}
+
+void writeSnapshotStringTable(std::ostream& out, const DEMSnapshot& snap) {
+    std::ostringstream outstrstream;
+    outstrstream << snap.stringTableColumn << ",name\n";
+    for (size_t i = 0; i < snap.stringTable.size(); i++) {
+        if (!snap.stringTable[i].empty())
+            outstrstream << i << "," << snap.stringTable[i] << "\n";
+    }
+    out << outstrstream.str();
+}
+
+}  // namespace deme
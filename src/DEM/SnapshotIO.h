@@ -0,0 +1,243 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_SNAPSHOT_IO_H
+#define DEME_SNAPSHOT_IO_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace deme {
+
+// The element types that a snapshot column can have
+enum class SNAPSHOT_COL_TYPE : uint8_t { UINT8, UINT16, UINT32, UINT64, INT32, FLOAT, DOUBLE };
+
+template <typename T>
+struct SnapshotColType;
+template <>
+struct SnapshotColType<uint8_t> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::UINT8;
+};
+template <>
+struct SnapshotColType<uint16_t> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::UINT16;
+};
+template <>
+struct SnapshotColType<uint32_t> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::UINT32;
+};
+template <>
+struct SnapshotColType<uint64_t> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::UINT64;
+};
+template <>
+struct SnapshotColType<int32_t> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::INT32;
+};
+template <>
+struct SnapshotColType<float> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::FLOAT;
+};
+template <>
+struct SnapshotColType<double> {
+    static constexpr SNAPSHOT_COL_TYPE value = SNAPSHOT_COL_TYPE::DOUBLE;
+};
+
+/// Size in bytes of an element of this type
+size_t snapshotColTypeSize(SNAPSHOT_COL_TYPE type);
+
+/// A column of a snapshot: its elements, one per row, stored back to back
+struct DEMSnapshotColumn {
+    std::string name;
+    // The unit of the quantity, in terms of the length unit L, mass unit M and time unit T the simulation is set up in
+    // (such as "L/T" for a velocity); empty if the quantity has no unit, such as an ID
+    std::string unit;
+    SNAPSHOT_COL_TYPE type;
+    std::vector<char> data;
+};
+
+/// A snapshot of simulation entities (spheres or clumps), stored column by column. This is what the BINARY output
+/// format writes, and DEMSnapshot::ReadFile reads those files back for post-processing or restarting.
+///
+/// A file has a header, then the data of each column back to back, in the order the header lists them. All numbers are
+/// in the byte order of the machine that wrote the file (which the reader checks):
+///   - "DEMESNAP" (8 bytes), then the format version and a byte order mark 0x01020304 (uint32 each)
+///   - the entity type (string), the simulation time (double) and the number of rows (uint64)
+///   - the number of attributes (uint32), then the name (string) and value (double) of each
+///   - the number of entries of the string table (uint32), then each (string), then the name of the column that
+///     refers to it (string, empty if none)
+///   - the number of columns (uint32), then the name (string), unit (string) and type (uint8, see SNAPSHOT_COL_TYPE) of
+///     each
+/// where a string is its length (uint32) followed by its characters.
+class DEMSnapshot {
+  public:
+    /// The kind of entities the rows stand for, such as "sphere" or "clump"
+    std::string entity;
+    /// Simulation time of this snapshot
+    double time = 0.;
+    /// Named numbers that help interpret the data, such as the output content flags it was written with
+    std::map<std::string, double> attributes;
+    /// Strings that an integer column refers to by index, such as the clump template names for the clump type column,
+    /// and the name of that column
+    std::vector<std::string> stringTable;
+    std::string stringTableColumn;
+
+    DEMSnapshot() {}
+    DEMSnapshot(const std::string& entity_type, size_t num_rows, double sim_time)
+        : entity(entity_type), time(sim_time), nRows(num_rows) {}
+
+    size_t GetNumRows() const { return nRows; }
+    size_t GetNumColumns() const { return columns.size(); }
+    const std::vector<DEMSnapshotColumn>& GetColumns() const { return columns; }
+    bool HasColumn(const std::string& name) const { return findColumn(name) != nullptr; }
+
+    /// Add a column and return where its elements (one per row) are to be filled in
+    template <typename T>
+    T* AddColumn(const std::string& name, const std::string& unit = "") {
+        if (HasColumn(name)) {
+            throw std::runtime_error("Snapshot column " + name + " is added twice.");
+        }
+        DEMSnapshotColumn col;
+        col.name = name;
+        col.unit = unit;
+        col.type = SnapshotColType<T>::value;
+        col.data.resize(nRows * sizeof(T));
+        columns.push_back(std::move(col));
+        return reinterpret_cast<T*>(columns.back().data.data());
+    }
+
+    /// Add a column whose elements are already filled in
+    void AppendColumn(const DEMSnapshotColumn& col) {
+        if (HasColumn(col.name)) {
+            throw std::runtime_error("Snapshot column " + col.name + " is added twice.");
+        }
+        if (col.data.size() != nRows * snapshotColTypeSize(col.type)) {
+            throw std::runtime_error("Snapshot column " + col.name + " does not have an element for each row.");
+        }
+        columns.push_back(col);
+    }
+
+    /// Get the elements of a column, converted to type T if the column is of another type
+    template <typename T>
+    std::vector<T> GetColumn(const std::string& name) const {
+        const DEMSnapshotColumn* col = findColumn(name);
+        if (!col) {
+            throw std::runtime_error("Snapshot has no column named " + name + ".");
+        }
+        std::vector<T> res(nRows);
+        switch (col->type) {
+            case (SNAPSHOT_COL_TYPE::UINT8):
+                convertColumn<uint8_t, T>(*col, res);
+                break;
+            case (SNAPSHOT_COL_TYPE::UINT16):
+                convertColumn<uint16_t, T>(*col, res);
+                break;
+            case (SNAPSHOT_COL_TYPE::UINT32):
+                convertColumn<uint32_t, T>(*col, res);
+                break;
+            case (SNAPSHOT_COL_TYPE::UINT64):
+                convertColumn<uint64_t, T>(*col, res);
+                break;
+            case (SNAPSHOT_COL_TYPE::INT32):
+                convertColumn<int32_t, T>(*col, res);
+                break;
+            case (SNAPSHOT_COL_TYPE::FLOAT):
+                convertColumn<float, T>(*col, res);
+                break;
+            case (SNAPSHOT_COL_TYPE::DOUBLE):
+                convertColumn<double, T>(*col, res);
+                break;
+        }
+        return res;
+    }
+
+    /// Get an attribute, or default_val if this snapshot does not have it
+    double GetAttribute(const std::string& name, double default_val = 0.) const {
+        auto it = attributes.find(name);
+        return (it == attributes.end()) ? default_val : it->second;
+    }
+
+    /// Write this snapshot in the BINARY format
+    void Write(std::ostream& out) const;
+    void WriteFile(const std::string& filename) const;
+    /// Read a snapshot written in the BINARY format
+    static DEMSnapshot Read(std::istream& in);
+    static DEMSnapshot ReadFile(const std::string& filename);
+
+  private:
+    size_t nRows = 0;
+    std::vector<DEMSnapshotColumn> columns;
+
+    const DEMSnapshotColumn* findColumn(const std::string& name) const {
+        for (const auto& col : columns) {
+            if (col.name == name)
+                return &col;
+        }
+        return nullptr;
+    }
+
+    template <typename T1, typename T2>
+    static void convertColumn(const DEMSnapshotColumn& col, std::vector<T2>& res) {
+        const T1* src = reinterpret_cast<const T1*>(col.data.data());
+        for (size_t i = 0; i < res.size(); i++) {
+            res[i] = static_cast<T2>(src[i]);
+        }
+    }
+};
+
+/// Quantize a quaternion component (in [-1, 1]) to an unsigned integer of nBits (8 or 16) bits, and back. The scale is
+/// symmetric about the middle value, so 0 and +-1 come back exactly.
+inline uint32_t quantizeQuatComponent(float q, unsigned int nBits) {
+    const float half = (float)((1u << (nBits - 1)) - 1);
+    float clamped = (q < -1.f) ? -1.f : ((q > 1.f) ? 1.f : q);
+    return (uint32_t)std::lround(clamped * half + half);
+}
+inline float dequantizeQuatComponent(uint32_t val, unsigned int nBits) {
+    const float half = (float)((1u << (nBits - 1)) - 1);
+    return ((float)val - half) / half;
+}
+
+/// Decode a snapshot written in the NATIVE output format. Clump positions in that format are stored as the solver
+/// stores them: a voxel ID (column voxel) and the positions in the voxel (columns locX, locY, locZ, in units of the
+/// length unit l), which are exact and take 14 bytes rather than 24 as doubles. The attributes hold what it takes to
+/// decode them: the voxel ID bit split (nvXp2, nvYp2, nvZp2), l, the voxel size and the left-bottom-front corner of the
+/// domain (LBFX, LBFY, LBFZ). Quaternions may be quantized to quat_bits bits per component.
+///
+/// The decoded snapshot has X, Y, Z (double) in place of the native columns and float quaternions (normalized after
+/// dequantization); the other columns are copied. A snapshot that is not in the native format is returned as is.
+DEMSnapshot DecodeNativeSnapshot(const DEMSnapshot& snap);
+
+/// How writeSnapshotAsCsv formats a snapshot
+struct DEMCsvFormat {
+    /// Significant digits of floating-point numbers; 0 means as many as it takes for them to read back exactly
+    unsigned int precision = 6;
+    /// The columns to write, in this order. Columns that the snapshot does not have are skipped, and empty means all
+    /// of its columns.
+    std::vector<std::string> columns;
+    /// Rows are formatted in parallel by this many host threads (0 means the hardware concurrency)
+    unsigned int nThreads = 1;
+};
+
+/// Write a snapshot as CSV, a row per line. The values of the column that refers to the string table are written as the
+/// strings they stand for.
+void writeSnapshotAsCsv(std::ostream& out, const DEMSnapshot& snap, const DEMCsvFormat& format = DEMCsvFormat());
+/// Write a snapshot as a CHPF file. Floating-point columns go out as float and integer ones as unsigned int, so the
+/// column that refers to the string table holds numbers, and the table itself can be written with
+/// writeSnapshotStringTable.
+void writeSnapshotAsChpf(std::ofstream& out, const DEMSnapshot& snap);
+/// Write the string table of a snapshot as CSV, with the number and the string of each entry
+void writeSnapshotStringTable(std::ostream& out, const DEMSnapshot& snap);
+
+}  // namespace deme
+
+#endif
@@ -23,6 +23,7 @@
 #include <DEM/HostSideHelpers.hpp>
 #include <filesystem>
 #include <cstring>
+#include <algorithm>
 
 namespace deme {
 // Structs defined here will be used by some host classes in DEM.
@@ -58,6 +59,10 @@ class DEMSolverStateData {
     size_t* pNumPrevContacts;
     // Number of spheres in the previous CD step (in case user added/removed clumps from the system)
     size_t* pNumPrevSpheres;
+    // Number of clumps that integration moved into the culled family since the last out-of-domain culling
+    size_t* pNumCulledClumps;
+    // Number of bins in this CD step that had too many spheres for the bin-wise CD kernels
+    size_t numOverfullBins = 0;
 
     DEMSolverStateData(unsigned int nArrays) : numTempArrays(nArrays) {
         GPU_CALL(cudaMallocManaged(&pNumContacts, sizeof(size_t)));
@@ -65,9 +70,11 @@ class DEMSolverStateData {
         GPU_CALL(cudaMallocManaged(&pTempSizeVar2, sizeof(size_t)));
         GPU_CALL(cudaMallocManaged(&pNumPrevContacts, sizeof(size_t)));
         GPU_CALL(cudaMallocManaged(&pNumPrevSpheres, sizeof(size_t)));
+        GPU_CALL(cudaMallocManaged(&pNumCulledClumps, sizeof(size_t)));
         *pNumContacts = 0;
         *pNumPrevContacts = 0;
         *pNumPrevSpheres = 0;
+        *pNumCulledClumps = 0;
         threadTempVectors.resize(numTempArrays);
     }
     ~DEMSolverStateData() {
@@ -76,6 +83,7 @@ class DEMSolverStateData {
         GPU_CALL(cudaFree(pTempSizeVar2));
         GPU_CALL(cudaFree(pNumPrevContacts));
         GPU_CALL(cudaFree(pNumPrevSpheres));
+        GPU_CALL(cudaFree(pNumCulledClumps));
     }
 
     // Return raw pointer to swath of device memory that is at least "sizeNeeded" large
@@ -209,10 +217,16 @@ inline std::string pretty_format_bytes(size_t bytes) {
         m_approx_bytes_used += byte_delta;                     \
     }
 
+// Used when allocating the entity arrays. An array that already holds something (so entities are being added to a
+// running simulation) grows its capacity geometrically, so adding a few entities at a time costs time proportional to
+// what is added, not to what is already there.
 #define DEME_TRACKED_RESIZE(vec, newsize, name, val)                                                               \
     {                                                                                                              \
         size_t item_size = sizeof(decltype(vec)::value_type);                                                      \
         size_t old_size = vec.size();                                                                              \
+        if (old_size > 0 && (size_t)(newsize) > vec.capacity()) {                                                  \
+            vec.reserve(std::max((size_t)(newsize), (size_t)(vec.capacity() * DEME_ARRAY_GROWTH_FACTOR)));         \
+        }                                                                                                          \
         vec.resize(newsize, val);                                                                                  \
         size_t new_size = vec.size();                                                                              \
         size_t byte_delta = item_size * (new_size - old_size);                                                     \
@@ -221,6 +235,25 @@ inline std::string pretty_format_bytes(size_t bytes) {
                         pretty_format_bytes(byte_delta).c_str());                                                  \
     }
 
+// Like DEME_TRACKED_RESIZE, but never shrinks vec. This is for the arrays whose length is but an estimate when they are
+// allocated (such as the contact arrays, which contact detection resizes later), so that allocating for more entities
+// does not cut off what they hold.
+#define DEME_TRACKED_GROW(vec, newsize, name, val)       \
+    {                                                    \
+        if (vec.size() < (size_t)(newsize)) {            \
+            DEME_TRACKED_RESIZE(vec, newsize, name, val); \
+        }                                                \
+    }
+
+// Keeps the items of the first nOld elements of vec that keptOld lists (see hostApplyCompaction), and gives the memory
+// of the rest back
+#define DEME_TRACKED_COMPACT(vec, keptOld, nOld, pool)                                 \
+    {                                                                                  \
+        hostApplyCompaction(vec, keptOld, nOld, pool);                                 \
+        DEME_TRACKED_RESIZE_NOPRINT(vec, keptOld.size(), decltype(vec)::value_type()); \
+        vec.shrink_to_fit();                                                           \
+    }
+
 //// TODO: this is currently not tracked...
 // ptr being a reference to a pointer is crucial
 template <typename T>
@@ -355,6 +388,18 @@ struct SolverFlags {
     bool useMassJitify = false;
     // Contact detection uses a thread for a bin, not a block for a bin
     bool useOneBinPerThread = false;
+    // Contact detection is done by host (CPU) threads instead of GPU kernels
+    bool useHostContactDetection = false;
+    // Force calculation, force collection and integration are done by host (CPU) threads instead of GPU kernels
+    bool useHostDynamics = false;
+    // Number of host threads used by host-side computations (0 means using hardware concurrency)
+    unsigned int nHostThreads = 0;
+    // dT asks kT for a new contact list based on how far the owners moved, not on a fixed number of steps
+    bool useDisplacementTriggeredCD = false;
+    // In displacement-triggered CD, the max number of steps a contact list can be used for (negative means no limit)
+    int maxStepsPerContactList = -1;
+    // Quiet clumps fall asleep: they are not integrated, and their contacts with each other are frozen
+    bool useSleeping = false;
 };
 
 class DEMMaterial {
@@ -587,6 +632,11 @@ const std::string OUTPUT_FILE_Y_COL_NAME = std::string("Y");
 const std::string OUTPUT_FILE_Z_COL_NAME = std::string("Z");
 const std::string OUTPUT_FILE_R_COL_NAME = std::string("r");
 const std::string OUTPUT_FILE_CLUMP_TYPE_NAME = std::string("clump_type");
+// Column names of the native coordinates of a position (see DecodeNativeSnapshot)
+const std::string OUTPUT_FILE_VOXEL_COL_NAME = std::string("voxel");
+const std::string OUTPUT_FILE_SUBPOS_X_COL_NAME = std::string("locX");
+const std::string OUTPUT_FILE_SUBPOS_Y_COL_NAME = std::string("locY");
+const std::string OUTPUT_FILE_SUBPOS_Z_COL_NAME = std::string("locZ");
 const std::filesystem::path USER_SCRIPT_PATH =
     std::filesystem::path(PROJECT_SOURCE_DIRECTORY) / "src" / "kernel" / "DEMUserScripts";
 const std::filesystem::path SOURCE_DATA_PATH = std::filesystem::path(PROJECT_SOURCE_DIRECTORY) / "data";
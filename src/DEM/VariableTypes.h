@@ -30,9 +30,11 @@ typedef unsigned short int binsSphereTouches_t;
 // This type needs to be large enough to hold the result of a prefix scan of the type binsSphereTouches_t (and objID_t);
 // but normally, it should be the same magnitude as bodyID_t.
 typedef unsigned int binSphereTouchPairs_t;
-// How many spheres a bin can touch, tops? We can assume it will not be too large to save GPU memory. Note this type
-// also doubles as the type for the number of contacts in a bin. NOTE!! Seems uint8_t is not supported by CUB???
-typedef unsigned short int spheresBinTouches_t;
+// How many spheres a bin can touch, tops? Bins past DEME_MAX_SPHERES_PER_BIN are processed by the overfull-bin path, so
+// this has to hold the count of any bin, and a short (which the count would silently wrap around in) is not enough
+// when many small spheres sit in a bin sized for big ones. Note this type also doubles as the type for the number of
+// contacts in a (not overfull) bin.
+typedef unsigned int spheresBinTouches_t;
 // Need to be large enough to hold the number of total contact pairs. In general this number should be in the same
 // magnitude as bodyID_t.
 typedef unsigned int contactPairs_t;
@@ -44,6 +46,7 @@ typedef uint8_t notStupidBool_t;  ///< Ad-hoc bool (array) type
 typedef uint8_t contact_t;        ///< Contact type (sphere--sphere is 1, etc.)
 typedef uint8_t family_t;         ///< Data type for clump presecription type
 typedef uint8_t ownerType_t;      ///< The type of a owner entity
+typedef uint8_t sleepState_t;     ///< Sleep state bits of an owner entity
 
 typedef uint8_t objType_t;
 typedef bool objNormal_t;
@@ -8,9 +8,9 @@
 #include <thread>
 #include <algorithm>
 
-#include <chpf.hpp>
 #include <core/ApiVersion.h>
 #include <core/utils/JitHelper.h>
+#include <core/utils/HostJitHelper.h>
 #include <DEM/dT.h>
 #include <DEM/kT.h>
 #include <DEM/HostSideHelpers.hpp>
@@ -18,6 +18,8 @@
 #include <DEM/Defines.h>
 
 #include <algorithms/DEMCubBasedSubroutines.h>
+#include <algorithms/DEMHostBasedSubroutines.h>
+#include <algorithms/DEMHistoryMapping.hpp>
 
 namespace deme {
 
@@ -25,6 +27,7 @@ namespace deme {
 void DEMDynamicThread::packDataPointers() {
     granData->inertiaPropOffsets = inertiaPropOffsets.data();
     granData->familyID = familyID.data();
+    granData->pNumCulledClumps = stateOfSolver_resources.pNumCulledClumps;
     granData->voxelID = voxelID.data();
     granData->locX = locX.data();
     granData->locY = locY.data();
@@ -50,10 +53,10 @@ void DEMDynamicThread::packDataPointers() {
     granData->contactType = contactType.data();
     granData->familyMasks = familyMaskMatrix.data();
 
-    // granData->idGeometryA_buffer = idGeometryA_buffer.data();
-    // granData->idGeometryB_buffer = idGeometryB_buffer.data();
-    // granData->contactType_buffer = contactType_buffer.data();
-    // granData->contactMapping_buffer = contactMapping_buffer.data();
+    granData->idGeometryA_buffer = idGeometryA_buffer.data();
+    granData->idGeometryB_buffer = idGeometryB_buffer.data();
+    granData->contactType_buffer = contactType_buffer.data();
+    granData->contactMapping_buffer = contactMapping_buffer.data();
 
     granData->contactForces = contactForces.data();
     granData->contactTorque_convToForce = contactTorque_convToForce.data();
@@ -88,9 +91,28 @@ void DEMDynamicThread::packDataPointers() {
     granData->mmiXX = mmiXX.data();
     granData->mmiYY = mmiYY.data();
     granData->mmiZZ = mmiZZ.data();
+
+    // Displacement-triggered CD reference arrays
+    granData->voxelID_cdRef = voxelID_cdRef.data();
+    granData->locX_cdRef = locX_cdRef.data();
+    granData->locY_cdRef = locY_cdRef.data();
+    granData->locZ_cdRef = locZ_cdRef.data();
+    granData->oriQw_cdRef = oriQw_cdRef.data();
+    granData->oriQx_cdRef = oriQx_cdRef.data();
+    granData->oriQy_cdRef = oriQy_cdRef.data();
+    granData->oriQz_cdRef = oriQz_cdRef.data();
+    granData->ownerCDReach = ownerCDReach.data();
+
+    // Sleep state arrays
+    granData->ownerTypes = ownerTypes.data();
+    granData->ownerSleepState = ownerSleepState.data();
+    granData->ownerQuietSteps = ownerQuietSteps.data();
+    granData->ownerPrevAcc = ownerPrevAcc.data();
 }
 
 void DEMDynamicThread::packTransferPointers(DEMKinematicThread*& kT) {
+    this->kT = kT;
+    swapTransferBuffers = (streamInfo.device == kT->streamInfo.device);
     // These are the pointers for sending data to dT
     granData->pKTOwnedBuffer_voxelID = kT->granData->voxelID_buffer;
     granData->pKTOwnedBuffer_locX = kT->granData->locX_buffer;
@@ -101,6 +123,7 @@ void DEMDynamicThread::packTransferPointers(DEMKinematicThread*& kT) {
     granData->pKTOwnedBuffer_oriQ2 = kT->granData->oriQ2_buffer;
     granData->pKTOwnedBuffer_oriQ3 = kT->granData->oriQ3_buffer;
     granData->pKTOwnedBuffer_familyID = kT->granData->familyID_buffer;
+    granData->pKTOwnedBuffer_beta = &(kT->granData->beta_buffer);
 }
 
 void DEMDynamicThread::changeFamily(unsigned int ID_from, unsigned int ID_to) {
@@ -207,10 +230,525 @@ void DEMDynamicThread::changeOwnerSizes(const std::vector<bodyID_t>& IDs, const
         .configure(dim3(blocks_needed_for_changing), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
         .launch(granData, idBool, ownerFactors, simParams->nSpheresGM);
     GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    ownerCDReach_isStale = true;
 
     // cudaStreamDestroy(new_stream);
 }
 
+void DEMDynamicThread::computeSpatialOrder(std::vector<bodyID_t>& ownerNewToOld,
+                                           std::vector<bodyID_t>& sphereNewToOld) {
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    HostScratchPad scratchPad;
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+
+    // Only clumps move. Analytical objects and meshes keep their places (so their components need no change), and the
+    // clumps are sorted among the places that clumps take.
+    std::vector<bodyID_t> clumpSlots;
+    clumpSlots.reserve(simParams->nOwnerClumps);
+    for (size_t i = 0; i < nOwners; i++) {
+        if (ownerTypes[i] == OWNER_T_CLUMP)
+            clumpSlots.push_back(i);
+    }
+    const size_t nClumps = clumpSlots.size();
+    std::vector<uint64_t> mortonCodes(nClumps), mortonCodesSorted(nClumps);
+    std::vector<bodyID_t> clumpsSorted(nClumps);
+    pool.parallelFor(nClumps, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            mortonCodes[i] = hostVoxelIDToMortonCode<voxelID_t>(voxelID[clumpSlots[i]], simParams->nvXp2,
+                                                                simParams->nvYp2, simParams->nvZp2);
+    });
+    hostDEMSortByKeys(mortonCodes.data(), mortonCodesSorted.data(), clumpSlots.data(), clumpsSorted.data(), nClumps,
+                      pool, scratchPad);
+    ownerNewToOld.resize(nOwners);
+    std::iota(ownerNewToOld.begin(), ownerNewToOld.end(), (bodyID_t)0);
+    for (size_t i = 0; i < nClumps; i++)
+        ownerNewToOld[clumpSlots[i]] = clumpsSorted[i];
+
+    // Spheres follow their owners' new order, keeping their order within a clump (the sort is stable)
+    std::vector<bodyID_t> ownerOldToNew(nOwners);
+    for (size_t i = 0; i < nOwners; i++)
+        ownerOldToNew[ownerNewToOld[i]] = i;
+    std::vector<bodyID_t> sphereKeys(nSpheres), sphereKeysSorted(nSpheres), sphereIDs(nSpheres);
+    pool.parallelFor(nSpheres, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sphereKeys[i] = ownerOldToNew[ownerClumpBody[i]];
+            sphereIDs[i] = i;
+        }
+    });
+    sphereNewToOld.resize(nSpheres);
+    hostDEMSortByKeys(sphereKeys.data(), sphereKeysSorted.data(), sphereIDs.data(), sphereNewToOld.data(), nSpheres,
+                      pool, scratchPad);
+}
+
+void DEMDynamicThread::applySpatialOrder(const std::vector<bodyID_t>& ownerNewToOld,
+                                         const std::vector<bodyID_t>& sphereNewToOld) {
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    std::vector<bodyID_t> ownerOldToNew(nOwners), sphereOldToNew(nSpheres);
+    for (size_t i = 0; i < nOwners; i++)
+        ownerOldToNew[ownerNewToOld[i]] = i;
+    for (size_t i = 0; i < nSpheres; i++)
+        sphereOldToNew[sphereNewToOld[i]] = i;
+
+    // Owner arrays
+    hostApplyPermutation(familyID, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(ownerTypes, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(inertiaPropOffsets, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(voxelID, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(locX, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(locY, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(locZ, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQw, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQx, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQy, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQz, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(vX, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(vY, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(vZ, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(omgBarX, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(omgBarY, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(omgBarZ, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(aX, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(aY, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(aZ, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(alphaX, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(alphaY, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(alphaZ, ownerNewToOld, nOwners, pool);
+    if (!solverFlags.useMassJitify) {
+        hostApplyPermutation(massOwnerBody, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(mmiXX, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(mmiYY, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(mmiZZ, ownerNewToOld, nOwners, pool);
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++)
+        hostApplyPermutation(ownerWildcards[i], ownerNewToOld, nOwners, pool);
+    if (solverFlags.useDisplacementTriggeredCD) {
+        hostApplyPermutation(voxelID_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(locX_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(locY_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(locZ_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(oriQw_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(oriQx_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(oriQy_cdRef, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(oriQz_cdRef, ownerNewToOld, nOwners, pool);
+    }
+    if (needsOwnerCDReach()) {
+        hostApplyPermutation(ownerCDReach, ownerNewToOld, nOwners, pool);
+    }
+    if (solverFlags.useSleeping) {
+        hostApplyPermutation(ownerSleepState, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(ownerQuietSteps, ownerNewToOld, nOwners, pool);
+        hostApplyPermutation(ownerPrevAcc, ownerNewToOld, nOwners, pool);
+    }
+
+    // Sphere arrays, and the owners they belong to
+    hostApplyPermutation(ownerClumpBody, sphereNewToOld, nSpheres, pool);
+    pool.parallelFor(nSpheres, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            ownerClumpBody[i] = ownerOldToNew[ownerClumpBody[i]];
+    });
+    hostApplyPermutation(sphereMaterialOffset, sphereNewToOld, nSpheres, pool);
+    if (solverFlags.useClumpJitify) {
+        hostApplyPermutation(clumpComponentOffset, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(clumpComponentOffsetExt, sphereNewToOld, nSpheres, pool);
+    } else {
+        hostApplyPermutation(radiiSphere, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(relPosSphereX, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(relPosSphereY, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(relPosSphereZ, sphereNewToOld, nSpheres, pool);
+    }
+
+    hostUpdateIDMaps(ownerPublicToInternal, ownerInternalToPublic, ownerNewToOld, nOwners, pool);
+    hostUpdateIDMaps(spherePublicToInternal, sphereInternalToPublic, sphereNewToOld, nSpheres, pool);
+
+    // The contact pairs now point to where their spheres are. They keep their orientation, which kT decides by the
+    // public sphere IDs.
+    const size_t nContacts = *stateOfSolver_resources.pNumContacts;
+    pool.parallelFor(nContacts, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (contactType[i] == NOT_A_CONTACT)
+                continue;
+            idGeometryA[i] = sphereOldToNew[idGeometryA[i]];
+            if (contactType[i] == SPHERE_SPHERE_CONTACT)
+                idGeometryB[i] = sphereOldToNew[idGeometryB[i]];
+        }
+    });
+    // kT finds the history of a contact by searching the previous contacts by their (idA, idB) keys, so the contacts
+    // (and the wildcards that carry their history) are sorted by the keys again
+    if (!solverFlags.isHistoryless) {
+        std::vector<uint64_t> keys(nContacts), keysSorted(nContacts);
+        std::vector<contactPairs_t> contactIDs(nContacts), contactNewToOld(nContacts);
+        pool.parallelFor(nContacts, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                keys[i] = hostContactKey(idGeometryA[i], idGeometryB[i]);
+        });
+        std::iota(contactIDs.begin(), contactIDs.end(), (contactPairs_t)0);
+        HostScratchPad scratchPad;
+        hostDEMSortByKeys(keys.data(), keysSorted.data(), contactIDs.data(), contactNewToOld.data(), nContacts, pool,
+                          scratchPad);
+        hostApplyPermutation(idGeometryA, contactNewToOld, nContacts, pool);
+        hostApplyPermutation(idGeometryB, contactNewToOld, nContacts, pool);
+        hostApplyPermutation(contactType, contactNewToOld, nContacts, pool);
+        hostApplyPermutation(contactForces, contactNewToOld, nContacts, pool);
+        hostApplyPermutation(contactTorque_convToForce, contactNewToOld, nContacts, pool);
+        hostApplyPermutation(contactPointGeometryA, contactNewToOld, nContacts, pool);
+        hostApplyPermutation(contactPointGeometryB, contactNewToOld, nContacts, pool);
+        for (unsigned int i = 0; i < simParams->nContactWildcards; i++)
+            hostApplyPermutation(contactWildcards[i], contactNewToOld, nContacts, pool);
+    }
+    // Cached contact-related info is rebuilt
+    contactPairArr_isFresh = true;
+}
+
+void DEMDynamicThread::computePurgeOrder(unsigned int family_num,
+                                         std::vector<bodyID_t>& ownerNewToOld,
+                                         std::vector<bodyID_t>& sphereNewToOld) {
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    // Only clumps are removed. Analytical objects and meshes of this family stay, as their components live in arrays
+    // (some of them jitified) that are only built on initialization.
+    size_t nOtherOwnersInFamily = 0;
+    ownerNewToOld.clear();
+    ownerNewToOld.reserve(nOwners);
+    for (size_t i = 0; i < nOwners; i++) {
+        if (familyID[i] != family_num) {
+            ownerNewToOld.push_back(i);
+        } else if (ownerTypes[i] != OWNER_T_CLUMP) {
+            ownerNewToOld.push_back(i);
+            nOtherOwnersInFamily++;
+        }
+    }
+    if (nOtherOwnersInFamily > 0) {
+        DEME_WARNING("Family %u has %zu analytical or mesh owner(s). PurgeFamily only removes clumps, so they stay.",
+                     family_num, nOtherOwnersInFamily);
+    }
+    sphereNewToOld.clear();
+    sphereNewToOld.reserve(nSpheres);
+    for (size_t i = 0; i < nSpheres; i++) {
+        if (familyID[ownerClumpBody[i]] != family_num)
+            sphereNewToOld.push_back(i);
+    }
+}
+
+void DEMDynamicThread::applyPurge(const std::vector<bodyID_t>& ownerNewToOld,
+                                  const std::vector<bodyID_t>& sphereNewToOld,
+                                  std::vector<bodyID_t>& ownerPublicOldToNew) {
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    const size_t nOwnersKept = ownerNewToOld.size();
+    const size_t nSpheresKept = sphereNewToOld.size();
+    std::vector<bodyID_t> ownerOldToNew(nOwners, NULL_BODYID), sphereOldToNew(nSpheres, NULL_BODYID);
+    for (size_t i = 0; i < nOwnersKept; i++)
+        ownerOldToNew[ownerNewToOld[i]] = i;
+    for (size_t i = 0; i < nSpheresKept; i++)
+        sphereOldToNew[sphereNewToOld[i]] = i;
+
+    // Owner arrays
+    DEME_TRACKED_COMPACT(familyID, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(ownerTypes, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(inertiaPropOffsets, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(voxelID, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locX, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locY, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locZ, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQw, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQx, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQy, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQz, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(vX, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(vY, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(vZ, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(omgBarX, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(omgBarY, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(omgBarZ, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(aX, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(aY, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(aZ, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(alphaX, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(alphaY, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(alphaZ, ownerNewToOld, nOwners, pool);
+    if (!solverFlags.useMassJitify) {
+        DEME_TRACKED_COMPACT(massOwnerBody, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(mmiXX, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(mmiYY, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(mmiZZ, ownerNewToOld, nOwners, pool);
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        hostApplyCompaction(ownerWildcards[i], ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_RESIZE_FLOAT(ownerWildcards[i], nOwnersKept, 0);
+        ownerWildcards[i].shrink_to_fit();
+    }
+    if (solverFlags.useDisplacementTriggeredCD) {
+        DEME_TRACKED_COMPACT(voxelID_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(locX_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(locY_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(locZ_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(oriQw_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(oriQx_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(oriQy_cdRef, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(oriQz_cdRef, ownerNewToOld, nOwners, pool);
+    }
+    if (needsOwnerCDReach()) {
+        DEME_TRACKED_COMPACT(ownerCDReach, ownerNewToOld, nOwners, pool);
+    }
+    if (solverFlags.useSleeping) {
+        DEME_TRACKED_COMPACT(ownerSleepState, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(ownerQuietSteps, ownerNewToOld, nOwners, pool);
+        DEME_TRACKED_COMPACT(ownerPrevAcc, ownerNewToOld, nOwners, pool);
+    }
+
+    // Sphere arrays, and the owners they belong to
+    DEME_TRACKED_COMPACT(ownerClumpBody, sphereNewToOld, nSpheres, pool);
+    pool.parallelFor(nSpheresKept, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            ownerClumpBody[i] = ownerOldToNew[ownerClumpBody[i]];
+    });
+    DEME_TRACKED_COMPACT(sphereMaterialOffset, sphereNewToOld, nSpheres, pool);
+    if (solverFlags.useClumpJitify) {
+        DEME_TRACKED_COMPACT(clumpComponentOffset, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(clumpComponentOffsetExt, sphereNewToOld, nSpheres, pool);
+    } else {
+        DEME_TRACKED_COMPACT(radiiSphere, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(relPosSphereX, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(relPosSphereY, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(relPosSphereZ, sphereNewToOld, nSpheres, pool);
+    }
+    // The owners of the mesh facets and analytical components are all kept, but they may have moved
+    for (auto& owner : ownerMesh)
+        owner = ownerOldToNew[owner];
+    for (auto& owner : ownerAnalBody)
+        owner = ownerOldToNew[owner];
+
+    hostCompactIDMaps(ownerPublicToInternal, ownerInternalToPublic, ownerNewToOld, nOwners, ownerPublicOldToNew,
+                      NULL_BODYID, pool);
+    std::vector<bodyID_t> spherePublicOldToNew;
+    hostCompactIDMaps(spherePublicToInternal, sphereInternalToPublic, sphereNewToOld, nSpheres, spherePublicOldToNew,
+                      NULL_BODYID, pool);
+
+    // Contacts that involve a removed sphere are dropped. The others point to where their spheres now are, and they
+    // stay sorted by their (idA, idB) keys and keep their orientation, since the kept spheres keep their order in both
+    // the arrays and the public IDs. The contact arrays themselves keep their sizes, as they are sized by kT's contact
+    // detection and trade places with dT's buffers.
+    const size_t nContacts = *stateOfSolver_resources.pNumContacts;
+    std::vector<contactPairs_t> contactNewToOld;
+    contactNewToOld.reserve(nContacts);
+    for (size_t i = 0; i < nContacts; i++) {
+        if (contactType[i] == NOT_A_CONTACT || sphereOldToNew[idGeometryA[i]] == NULL_BODYID)
+            continue;
+        if (contactType[i] == SPHERE_SPHERE_CONTACT && sphereOldToNew[idGeometryB[i]] == NULL_BODYID)
+            continue;
+        contactNewToOld.push_back(i);
+    }
+    const size_t nContactsKept = contactNewToOld.size();
+    hostApplyCompaction(idGeometryA, contactNewToOld, nContacts, pool);
+    hostApplyCompaction(idGeometryB, contactNewToOld, nContacts, pool);
+    hostApplyCompaction(contactType, contactNewToOld, nContacts, pool);
+    hostApplyCompaction(contactForces, contactNewToOld, nContacts, pool);
+    hostApplyCompaction(contactTorque_convToForce, contactNewToOld, nContacts, pool);
+    hostApplyCompaction(contactPointGeometryA, contactNewToOld, nContacts, pool);
+    hostApplyCompaction(contactPointGeometryB, contactNewToOld, nContacts, pool);
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++)
+        hostApplyCompaction(contactWildcards[i], contactNewToOld, nContacts, pool);
+    pool.parallelFor(nContactsKept, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            idGeometryA[i] = sphereOldToNew[idGeometryA[i]];
+            if (contactType[i] == SPHERE_SPHERE_CONTACT)
+                idGeometryB[i] = sphereOldToNew[idGeometryB[i]];
+        }
+    });
+    *stateOfSolver_resources.pNumContacts = nContactsKept;
+
+    simParams->nOwnerClumps -= nOwners - nOwnersKept;
+    simParams->nOwnerBodies = nOwnersKept;
+    simParams->nSpheresGM = nSpheresKept;
+    // Cached contact-related info is rebuilt
+    contactPairArr_isFresh = true;
+}
+
+// The host version of markInflowOverlapsOfSphere in DEMMiscKernels.cu, for all periodic images of the sphere: calls f
+// with each staged sphere (in grid order) that is too close to a sphere at (X, Y, Z) of this radius
+template <typename Func>
+static void forEachInflowOverlap(const DEMInflowGrid& grid,
+                                 const DEMSimParams* simParams,
+                                 double X,
+                                 double Y,
+                                 double Z,
+                                 float radius,
+                                 const Func& f) {
+    double reach = (double)radius + grid.maxRadius + grid.clearance;
+    for (int k = -1; k <= 1; k++) {
+        for (int j = -1; j <= 1; j++) {
+            for (int i = -1; i <= 1; i++) {
+                if ((i != 0 && !simParams->periodicX) || (j != 0 && !simParams->periodicY) ||
+                    (k != 0 && !simParams->periodicZ))
+                    continue;
+                // This image, relative to the grid
+                double pX = X + i * simParams->periodX - grid.LBFX;
+                double pY = Y + j * simParams->periodY - grid.LBFY;
+                double pZ = Z + k * simParams->periodZ - grid.LBFZ;
+                if (pX + reach < 0. || pY + reach < 0. || pZ + reach < 0. ||
+                    pX - reach >= grid.nCellX * grid.cellSize || pY - reach >= grid.nCellY * grid.cellSize ||
+                    pZ - reach >= grid.nCellZ * grid.cellSize)
+                    continue;
+                int cellX0 = std::max(0, (int)std::floor((pX - reach) / grid.cellSize));
+                int cellY0 = std::max(0, (int)std::floor((pY - reach) / grid.cellSize));
+                int cellZ0 = std::max(0, (int)std::floor((pZ - reach) / grid.cellSize));
+                int cellX1 = std::min((int)grid.nCellX - 1, (int)std::floor((pX + reach) / grid.cellSize));
+                int cellY1 = std::min((int)grid.nCellY - 1, (int)std::floor((pY + reach) / grid.cellSize));
+                int cellZ1 = std::min((int)grid.nCellZ - 1, (int)std::floor((pZ + reach) / grid.cellSize));
+                for (int cz = cellZ0; cz <= cellZ1; cz++) {
+                    for (int cy = cellY0; cy <= cellY1; cy++) {
+                        for (int cx = cellX0; cx <= cellX1; cx++) {
+                            size_t cell =
+                                (size_t)cx + (size_t)cy * grid.nCellX + (size_t)cz * grid.nCellX * grid.nCellY;
+                            for (size_t s = grid.cellStart[cell]; s < grid.cellStart[cell + 1]; s++) {
+                                double dX = grid.sphX[s] - grid.LBFX - pX;
+                                double dY = grid.sphY[s] - grid.LBFY - pY;
+                                double dZ = grid.sphZ[s] - grid.LBFZ - pZ;
+                                double minDist = (double)radius + grid.sphRadius[s] + grid.clearance;
+                                if (dX * dX + dY * dY + dZ * dZ < minDist * minDist)
+                                    f(s);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void DEMDynamicThread::markInflowOverlaps(const std::vector<float3>& sphPos,
+                                          const std::vector<float>& sphRadius,
+                                          const std::vector<size_t>& sphClump,
+                                          float clearance,
+                                          std::vector<notStupidBool_t>& clumpRejected) {
+    size_t nStaged = sphPos.size();
+    if (nStaged == 0)
+        return;
+
+    // A uniform grid over the staged spheres, with cells no smaller than the largest reach between two of them, so a
+    // sphere only needs to look at the cells its own reach touches. If the staged spheres are spread thin, the cells
+    // are made larger, so that there are not many more cells than spheres.
+    DEMInflowGrid grid;
+    float3 lo = sphPos[0], hi = sphPos[0];
+    float maxRadius = 0.f;
+    for (size_t i = 0; i < nStaged; i++) {
+        lo = fminf(lo, sphPos[i]);
+        hi = fmaxf(hi, sphPos[i]);
+        maxRadius = std::max(maxRadius, sphRadius[i]);
+    }
+    grid.LBFX = lo.x;
+    grid.LBFY = lo.y;
+    grid.LBFZ = lo.z;
+    grid.maxRadius = maxRadius;
+    grid.clearance = clearance;
+    grid.cellSize = std::max(2. * maxRadius + clearance, 1e-6 * simParams->voxelSize);
+    size_t nCells;
+    while (true) {
+        grid.nCellX = (unsigned int)((hi.x - lo.x) / grid.cellSize) + 1;
+        grid.nCellY = (unsigned int)((hi.y - lo.y) / grid.cellSize) + 1;
+        grid.nCellZ = (unsigned int)((hi.z - lo.z) / grid.cellSize) + 1;
+        nCells = (size_t)grid.nCellX * grid.nCellY * grid.nCellZ;
+        if (nCells <= 8 * nStaged)
+            break;
+        grid.cellSize *= 2.;
+    }
+
+    // Sort the staged spheres by cell (a counting sort, which keeps the spheres of a cell in their staged order)
+    std::vector<size_t> sphCell(nStaged);
+    std::vector<size_t, ManagedAllocator<size_t>> cellStart(nCells + 1, 0);
+    for (size_t i = 0; i < nStaged; i++) {
+        size_t cx = std::min<size_t>((size_t)((sphPos[i].x - lo.x) / grid.cellSize), grid.nCellX - 1);
+        size_t cy = std::min<size_t>((size_t)((sphPos[i].y - lo.y) / grid.cellSize), grid.nCellY - 1);
+        size_t cz = std::min<size_t>((size_t)((sphPos[i].z - lo.z) / grid.cellSize), grid.nCellZ - 1);
+        sphCell[i] = cx + cy * grid.nCellX + cz * grid.nCellX * grid.nCellY;
+        cellStart[sphCell[i] + 1]++;
+    }
+    for (size_t c = 0; c < nCells; c++)
+        cellStart[c + 1] += cellStart[c];
+    std::vector<float, ManagedAllocator<float>> gridX(nStaged), gridY(nStaged), gridZ(nStaged), gridRadius(nStaged);
+    std::vector<size_t, ManagedAllocator<size_t>> gridClump(nStaged);
+    std::vector<notStupidBool_t, ManagedAllocator<notStupidBool_t>> rejected(clumpRejected.begin(),
+                                                                             clumpRejected.end());
+    {
+        std::vector<size_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < nStaged; i++) {
+            size_t s = fill[sphCell[i]]++;
+            gridX[s] = sphPos[i].x;
+            gridY[s] = sphPos[i].y;
+            gridZ[s] = sphPos[i].z;
+            gridRadius[s] = sphRadius[i];
+            gridClump[s] = sphClump[i];
+        }
+    }
+    grid.cellStart = cellStart.data();
+    grid.sphX = gridX.data();
+    grid.sphY = gridY.data();
+    grid.sphZ = gridZ.data();
+    grid.sphRadius = gridRadius.data();
+    grid.sphClump = gridClump.data();
+    grid.clumpRejected = rejected.data();
+
+    // Existing spheres against the staged ones, one pass over the existing spheres. This is the part whose cost grows
+    // with the simulation, not with the inflow: kT's bins are not kept between contact detections (they live in its
+    // scratch space), so there is nothing to query the insertion region with, but all a far away sphere does is a
+    // bounding box test against the grid.
+    size_t nExisting = simParams->nSpheresGM;
+    if (nExisting > 0) {
+        if (solverFlags.useHostDynamics) {
+            HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+            // Each chunk has its own marks, merged afterwards
+            size_t nChunks = std::max<size_t>(1, pool.numChunks(nExisting, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+            std::vector<std::vector<size_t>> chunkHits(nChunks);
+            pool.parallelForChunks(nExisting, nChunks, [&](size_t c, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    bodyID_t owner = ownerClumpBody[i];
+                    size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[i] : i;
+                    float3 relPos = host_make_float3(relPosSphereX[compOffset], relPosSphereY[compOffset],
+                                                     relPosSphereZ[compOffset]);
+                    hostApplyOriQToVector3<float, oriQ_t>(relPos.x, relPos.y, relPos.z, oriQw[owner], oriQx[owner],
+                                                          oriQy[owner], oriQz[owner]);
+                    double X, Y, Z;
+                    hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+                        X, Y, Z, voxelID[owner], locX[owner], locY[owner], locZ[owner], simParams->nvXp2,
+                        simParams->nvYp2, simParams->voxelSize, simParams->l);
+                    forEachInflowOverlap(grid, simParams, X + relPos.x, Y + relPos.y, Z + relPos.z,
+                                         radiiSphere[compOffset],
+                                         [&](size_t s) { chunkHits[c].push_back(gridClump[s]); });
+                }
+            });
+            for (const auto& hits : chunkHits) {
+                for (size_t clump : hits)
+                    rejected[clump] = 1;
+            }
+        } else {
+            size_t blocks_needed_for_spheres =
+                (nExisting + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+            misc_kernels->kernel("markInflowOverlaps")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_spheres), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(granData, simParams, grid, solverFlags.useClumpJitify, nExisting);
+            GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        }
+    }
+
+    // Then the staged clumps against each other, in order: a staged clump is left out if it overlaps an earlier one
+    // that is kept. The spheres of a staged clump are contiguous in the input.
+    for (size_t i = 0; i < nStaged; i++) {
+        size_t myClump = sphClump[i];
+        if (rejected[myClump])
+            continue;
+        forEachInflowOverlap(grid, simParams, sphPos[i].x, sphPos[i].y, sphPos[i].z, sphRadius[i], [&](size_t s) {
+            if (gridClump[s] < myClump && !rejected[gridClump[s]])
+                rejected[myClump] = 1;
+        });
+    }
+    std::copy(rejected.begin(), rejected.end(), clumpRejected.begin());
+}
+
 void DEMDynamicThread::allocateManagedArrays(size_t nOwnerBodies,
                                              size_t nOwnerClumps,
                                              unsigned int nExtObj,
@@ -226,12 +764,9 @@ void DEMDynamicThread::allocateManagedArrays(size_t nOwnerBodies,
     // dT buffer arrays should be on dT and this is to ensure that
     GPU_CALL(cudaSetDevice(streamInfo.device));
 
-    // Sizes of these arrays
-    simParams->nSpheresGM = nSpheresGM;
+    // Sizes of these arrays (those of the owner and sphere arrays are set in resizeEntityArrays)
     simParams->nTriGM = nTriGM;
     simParams->nAnalGM = nAnalGM;
-    simParams->nOwnerBodies = nOwnerBodies;
-    simParams->nOwnerClumps = nOwnerClumps;
     simParams->nExtObj = nExtObj;
     simParams->nTriMeshes = nTriMeshes;
     simParams->nDistinctMassProperties = nMassProperties;
@@ -240,6 +775,79 @@ void DEMDynamicThread::allocateManagedArrays(size_t nOwnerBodies,
     simParams->nDistinctClumpComponents = nClumpComponents;
     simParams->nMatTuples = nMatTuples;
 
+    // Resize to the number of owners and spheres
+    resizeEntityArrays(nOwnerBodies, nOwnerClumps, nSpheresGM);
+
+    // Resize the family mask `matrix' (in fact it is flattened)
+    DEME_TRACKED_RESIZE(familyMaskMatrix, (NUM_AVAL_FAMILIES - 1) * NUM_AVAL_FAMILIES / 2, "familyMaskMatrix",
+                        DONT_PREVENT_CONTACT);
+
+    // Resize to the number of triangle facets
+    DEME_TRACKED_RESIZE(ownerMesh, nTriGM, "ownerMesh", 0);
+    DEME_TRACKED_RESIZE(relPosNode1, nTriGM, "relPosNode1", make_float3(0));
+    DEME_TRACKED_RESIZE(relPosNode2, nTriGM, "relPosNode2", make_float3(0));
+    DEME_TRACKED_RESIZE(relPosNode3, nTriGM, "relPosNode3", make_float3(0));
+    DEME_TRACKED_RESIZE(triMaterialOffset, nTriGM, "triMaterialOffset", 0);
+
+    // Resize to the number of analytical geometries
+    DEME_TRACKED_RESIZE(ownerAnalBody, nAnalGM, "ownerAnalBody", 0);
+
+    // If we jitify mass properties, then the mass arrays are per mass property (otherwise, they are owner arrays)
+    if (solverFlags.useMassJitify) {
+        DEME_TRACKED_RESIZE(massOwnerBody, nMassProperties, "massOwnerBody", 0);
+        DEME_TRACKED_RESIZE(mmiXX, nMassProperties, "mmiXX", 0);
+        DEME_TRACKED_RESIZE(mmiYY, nMassProperties, "mmiYY", 0);
+        DEME_TRACKED_RESIZE(mmiZZ, nMassProperties, "mmiZZ", 0);
+    }
+    // Volume info is jitified
+    DEME_TRACKED_RESIZE(volumeOwnerBody, nMassProperties, "volumeOwnerBody", 0);
+
+    // Arrays for contact info
+    // The lengths of contact event-based arrays are just estimates. My estimate of total contact pairs is ~ 4n, and I
+    // think the max is 6n (although I can't prove it). Note the estimate should be large enough to decrease the number
+    // of reallocations in the simulation, but not too large that eats too much memory.
+    DEME_TRACKED_GROW(idGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryA", 0);
+    DEME_TRACKED_GROW(idGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryB", 0);
+    DEME_TRACKED_GROW(contactForces, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactForces", make_float3(0));
+    DEME_TRACKED_GROW(contactTorque_convToForce, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactTorque_convToForce",
+                      make_float3(0));
+    DEME_TRACKED_GROW(contactType, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactType", NOT_A_CONTACT);
+    DEME_TRACKED_GROW(contactPointGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactPointGeometryA",
+                      make_float3(0));
+    DEME_TRACKED_GROW(contactPointGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactPointGeometryB",
+                      make_float3(0));
+    // Allocate memory for each wildcard array
+    contactWildcards.resize(simParams->nContactWildcards);
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+        // Like the other contact arrays, this one may hold live contacts if this is not the first allocation
+        if (contactWildcards[i].size() < nOwnerBodies * DEME_INIT_CNT_MULTIPLIER) {
+            DEME_TRACKED_RESIZE_FLOAT(contactWildcards[i], nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, 0);
+        }
+    }
+
+    // Transfer buffer arrays
+    // The following several arrays will have variable sizes, so here we only used an estimate.
+    // They are managed arrays like the work arrays, so that when kT and dT share a device, a buffer and a work array
+    // can trade places instead of being copied.
+    DEME_TRACKED_GROW(idGeometryA_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryA_buffer", 0);
+    DEME_TRACKED_GROW(idGeometryB_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryB_buffer", 0);
+    DEME_TRACKED_GROW(contactType_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactType_buffer", NOT_A_CONTACT);
+    advise(idGeometryA_buffer.data(), idGeometryA_buffer.size(), ManagedAdvice::PREFERRED_LOC, streamInfo.device);
+    advise(idGeometryB_buffer.data(), idGeometryB_buffer.size(), ManagedAdvice::PREFERRED_LOC, streamInfo.device);
+    advise(contactType_buffer.data(), contactType_buffer.size(), ManagedAdvice::PREFERRED_LOC, streamInfo.device);
+    if (!solverFlags.isHistoryless) {
+        DEME_TRACKED_GROW(contactMapping_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactMapping_buffer",
+                          NULL_MAPPING_PARTNER);
+        advise(contactMapping_buffer.data(), contactMapping_buffer.size(), ManagedAdvice::PREFERRED_LOC,
+               streamInfo.device);
+    }
+}
+
+void DEMDynamicThread::resizeEntityArrays(size_t nOwnerBodies, size_t nOwnerClumps, size_t nSpheresGM) {
+    simParams->nOwnerBodies = nOwnerBodies;
+    simParams->nOwnerClumps = nOwnerClumps;
+    simParams->nSpheresGM = nSpheresGM;
+
     // Resize to the number of clumps
     DEME_TRACKED_RESIZE(familyID, nOwnerBodies, "familyID", 0);
     DEME_TRACKED_RESIZE(voxelID, nOwnerBodies, "voxelID", 0);
@@ -262,10 +870,53 @@ void DEMDynamicThread::allocateManagedArrays(size_t nOwnerBodies,
     DEME_TRACKED_RESIZE(alphaX, nOwnerBodies, "alphaX", 0);
     DEME_TRACKED_RESIZE(alphaY, nOwnerBodies, "alphaY", 0);
     DEME_TRACKED_RESIZE(alphaZ, nOwnerBodies, "alphaZ", 0);
+    // The owner states that the contact list in use was detected with. Contact lists detected before owners are added
+    // do not know the new owners, so they can no longer be used.
+    if (solverFlags.useDisplacementTriggeredCD) {
+        DEME_TRACKED_RESIZE(voxelID_cdRef, nOwnerBodies, "voxelID_cdRef", 0);
+        DEME_TRACKED_RESIZE(locX_cdRef, nOwnerBodies, "locX_cdRef", 0);
+        DEME_TRACKED_RESIZE(locY_cdRef, nOwnerBodies, "locY_cdRef", 0);
+        DEME_TRACKED_RESIZE(locZ_cdRef, nOwnerBodies, "locZ_cdRef", 0);
+        DEME_TRACKED_RESIZE(oriQw_cdRef, nOwnerBodies, "oriQw_cdRef", 1);
+        DEME_TRACKED_RESIZE(oriQx_cdRef, nOwnerBodies, "oriQx_cdRef", 0);
+        DEME_TRACKED_RESIZE(oriQy_cdRef, nOwnerBodies, "oriQy_cdRef", 0);
+        DEME_TRACKED_RESIZE(oriQz_cdRef, nOwnerBodies, "oriQz_cdRef", 0);
+        cdListIsValid = false;
+        cdOrderIsValid = false;
+    }
+    if (needsOwnerCDReach()) {
+        DEME_TRACKED_RESIZE(ownerCDReach, nOwnerBodies, "ownerCDReach", 0);
+        ownerCDReach_isStale = true;
+    }
+    // Owners added later start awake
+    if (solverFlags.useSleeping) {
+        DEME_TRACKED_RESIZE(ownerSleepState, nOwnerBodies, "ownerSleepState", SLEEP_NO_ACC_REF);
+        DEME_TRACKED_RESIZE(ownerQuietSteps, nOwnerBodies, "ownerQuietSteps", 0);
+        DEME_TRACKED_RESIZE(ownerPrevAcc, nOwnerBodies, "ownerPrevAcc", make_float3(0));
+    }
+    // If owners and spheres were rearranged before, the ones added now get public IDs that are where they are
+    for (size_t i = ownerInternalToPublic.size(); !ownerInternalToPublic.empty() && i < nOwnerBodies; i++) {
+        ownerInternalToPublic.push_back(i);
+        ownerPublicToInternal.push_back(i);
+    }
+    for (size_t i = sphereInternalToPublic.size(); !sphereInternalToPublic.empty() && i < nSpheresGM; i++) {
+        sphereInternalToPublic.push_back(i);
+        spherePublicToInternal.push_back(i);
+    }
 
-    // Resize the family mask `matrix' (in fact it is flattened)
-    DEME_TRACKED_RESIZE(familyMaskMatrix, (NUM_AVAL_FAMILIES - 1) * NUM_AVAL_FAMILIES / 2, "familyMaskMatrix",
-                        DONT_PREVENT_CONTACT);
+    // Resize to number of owners
+    DEME_TRACKED_RESIZE(ownerTypes, nOwnerBodies, "ownerTypes", 0);
+    DEME_TRACKED_RESIZE(inertiaPropOffsets, nOwnerBodies, "inertiaPropOffsets", 0);
+    if (!solverFlags.useMassJitify) {
+        DEME_TRACKED_RESIZE(massOwnerBody, nOwnerBodies, "massOwnerBody", 0);
+        DEME_TRACKED_RESIZE(mmiXX, nOwnerBodies, "mmiXX", 0);
+        DEME_TRACKED_RESIZE(mmiYY, nOwnerBodies, "mmiYY", 0);
+        DEME_TRACKED_RESIZE(mmiZZ, nOwnerBodies, "mmiZZ", 0);
+    }
+    ownerWildcards.resize(simParams->nOwnerWildcards);
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        DEME_TRACKED_RESIZE_FLOAT(ownerWildcards[i], nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, 0);
+    }
 
     // Resize to the number of geometries
     DEME_TRACKED_RESIZE(ownerClumpBody, nSpheresGM, "ownerClumpBody", 0);
@@ -277,89 +928,21 @@ void DEMDynamicThread::allocateManagedArrays(size_t nOwnerBodies,
         // clumpComponentOffset is typically uint_8, so it may not). If a sphere's component offset index falls in this
         // range then it is not jitified, and the kernel needs to look for it in the global memory.
         DEME_TRACKED_RESIZE(clumpComponentOffsetExt, nSpheresGM, "clumpComponentOffsetExt", 0);
-        DEME_TRACKED_RESIZE(radiiSphere, nClumpComponents, "radiiSphere", 0);
-        DEME_TRACKED_RESIZE(relPosSphereX, nClumpComponents, "relPosSphereX", 0);
-        DEME_TRACKED_RESIZE(relPosSphereY, nClumpComponents, "relPosSphereY", 0);
-        DEME_TRACKED_RESIZE(relPosSphereZ, nClumpComponents, "relPosSphereZ", 0);
+        DEME_TRACKED_RESIZE(radiiSphere, simParams->nDistinctClumpComponents, "radiiSphere", 0);
+        DEME_TRACKED_RESIZE(relPosSphereX, simParams->nDistinctClumpComponents, "relPosSphereX", 0);
+        DEME_TRACKED_RESIZE(relPosSphereY, simParams->nDistinctClumpComponents, "relPosSphereY", 0);
+        DEME_TRACKED_RESIZE(relPosSphereZ, simParams->nDistinctClumpComponents, "relPosSphereZ", 0);
     } else {
         DEME_TRACKED_RESIZE(radiiSphere, nSpheresGM, "radiiSphere", 0);
         DEME_TRACKED_RESIZE(relPosSphereX, nSpheresGM, "relPosSphereX", 0);
         DEME_TRACKED_RESIZE(relPosSphereY, nSpheresGM, "relPosSphereY", 0);
         DEME_TRACKED_RESIZE(relPosSphereZ, nSpheresGM, "relPosSphereZ", 0);
     }
+}
 
-    // Resize to the number of triangle facets
-    DEME_TRACKED_RESIZE(ownerMesh, nTriGM, "ownerMesh", 0);
-    DEME_TRACKED_RESIZE(relPosNode1, nTriGM, "relPosNode1", make_float3(0));
-    DEME_TRACKED_RESIZE(relPosNode2, nTriGM, "relPosNode2", make_float3(0));
-    DEME_TRACKED_RESIZE(relPosNode3, nTriGM, "relPosNode3", make_float3(0));
-    DEME_TRACKED_RESIZE(triMaterialOffset, nTriGM, "triMaterialOffset", 0);
-
-    // Resize to the number of analytical geometries
-    DEME_TRACKED_RESIZE(ownerAnalBody, nAnalGM, "ownerAnalBody", 0);
-
-    // Resize to number of owners
-    DEME_TRACKED_RESIZE(ownerTypes, nOwnerBodies, "ownerTypes", 0);
-    DEME_TRACKED_RESIZE(inertiaPropOffsets, nOwnerBodies, "inertiaPropOffsets", 0);
-    // If we jitify mass properties, then
-    if (solverFlags.useMassJitify) {
-        DEME_TRACKED_RESIZE(massOwnerBody, nMassProperties, "massOwnerBody", 0);
-        DEME_TRACKED_RESIZE(mmiXX, nMassProperties, "mmiXX", 0);
-        DEME_TRACKED_RESIZE(mmiYY, nMassProperties, "mmiYY", 0);
-        DEME_TRACKED_RESIZE(mmiZZ, nMassProperties, "mmiZZ", 0);
-    } else {
-        DEME_TRACKED_RESIZE(massOwnerBody, nOwnerBodies, "massOwnerBody", 0);
-        DEME_TRACKED_RESIZE(mmiXX, nOwnerBodies, "mmiXX", 0);
-        DEME_TRACKED_RESIZE(mmiYY, nOwnerBodies, "mmiYY", 0);
-        DEME_TRACKED_RESIZE(mmiZZ, nOwnerBodies, "mmiZZ", 0);
-    }
-    // Volume info is jitified
-    DEME_TRACKED_RESIZE(volumeOwnerBody, nMassProperties, "volumeOwnerBody", 0);
-
-    // Arrays for contact info
-    // The lengths of contact event-based arrays are just estimates. My estimate of total contact pairs is ~ 4n, and I
-    // think the max is 6n (although I can't prove it). Note the estimate should be large enough to decrease the number
-    // of reallocations in the simulation, but not too large that eats too much memory.
-    DEME_TRACKED_RESIZE(idGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryA", 0);
-    DEME_TRACKED_RESIZE(idGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryB", 0);
-    DEME_TRACKED_RESIZE(contactForces, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactForces", make_float3(0));
-    DEME_TRACKED_RESIZE(contactTorque_convToForce, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactTorque_convToForce",
-                        make_float3(0));
-    DEME_TRACKED_RESIZE(contactType, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactType", NOT_A_CONTACT);
-    DEME_TRACKED_RESIZE(contactPointGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactPointGeometryA",
-                        make_float3(0));
-    DEME_TRACKED_RESIZE(contactPointGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactPointGeometryB",
-                        make_float3(0));
-    // Allocate memory for each wildcard array
-    contactWildcards.resize(simParams->nContactWildcards);
-    ownerWildcards.resize(simParams->nOwnerWildcards);
-    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
-        DEME_TRACKED_RESIZE_FLOAT(contactWildcards[i], nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, 0);
-    }
-    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
-        DEME_TRACKED_RESIZE_FLOAT(ownerWildcards[i], nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, 0);
-    }
-
-    // Transfer buffer arrays
-    // The following several arrays will have variable sizes, so here we only used an estimate.
-    // It is cudaMalloc-ed memory, not managed, because we want explicit locality control of buffers
-    buffer_size = nOwnerBodies * DEME_INIT_CNT_MULTIPLIER;
-    DEME_DEVICE_PTR_ALLOC(granData->idGeometryA_buffer, buffer_size);
-    DEME_DEVICE_PTR_ALLOC(granData->idGeometryB_buffer, buffer_size);
-    DEME_DEVICE_PTR_ALLOC(granData->contactType_buffer, buffer_size);
-    // DEME_TRACKED_RESIZE(idGeometryA_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryA_buffer",
-    // 0); DEME_TRACKED_RESIZE(idGeometryB_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER,
-    // "idGeometryB_buffer", 0); DEME_TRACKED_RESIZE(contactType_buffer, nOwnerBodies *
-    // DEME_INIT_CNT_MULTIPLIER, "contactType_buffer", NOT_A_CONTACT);
-    // DEME_ADVISE_DEVICE(idGeometryA_buffer, streamInfo.device);
-    // DEME_ADVISE_DEVICE(idGeometryB_buffer, streamInfo.device);
-    // DEME_ADVISE_DEVICE(contactType_buffer, streamInfo.device);
-    if (!solverFlags.isHistoryless) {
-        // DEME_TRACKED_RESIZE(contactMapping_buffer, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER,
-        //                         "contactMapping_buffer", NULL_MAPPING_PARTNER);
-        // DEME_ADVISE_DEVICE(contactMapping_buffer, streamInfo.device);
-        DEME_DEVICE_PTR_ALLOC(granData->contactMapping_buffer, buffer_size);
-    }
+bool DEMDynamicThread::entityArraysHaveRoom(size_t nOwnerBodies, size_t nSpheresGM) const {
+    // The owner arrays are allocated, grown and compacted together, and so are the sphere arrays, so one of each tells
+    return familyID.capacity() >= nOwnerBodies && ownerClumpBody.capacity() >= nSpheresGM;
 }
 
 void DEMDynamicThread::registerPolicies(const std::unordered_map<unsigned int, std::string>& template_number_name_map,
@@ -818,365 +1401,349 @@ void DEMDynamicThread::updateClumpMeshArrays(const std::vector<std::shared_ptr<D
                      nExistingFacets);
 }
 
-void DEMDynamicThread::writeSpheresAsChpf(std::ofstream& ptFile) const {
-    chpf::Writer pw;
-    // pw.write(ptFile, chpf::Compressor::Type::USE_DEFAULT, mass);
-    std::vector<float> posX(simParams->nSpheresGM);
-    std::vector<float> posY(simParams->nSpheresGM);
-    std::vector<float> posZ(simParams->nSpheresGM);
-    std::vector<float> spRadii(simParams->nSpheresGM);
-    std::vector<unsigned int> families;
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-        families.resize(simParams->nSpheresGM);
+void DEMDynamicThread::addOwnerSnapshotColumns(DEMSnapshot& snap, const std::vector<bodyID_t>& rowOwners) const {
+    const unsigned int flags = solverFlags.outputFlags;
+    const size_t nRows = rowOwners.size();
+    float* absv = (flags & OUTPUT_CONTENT::ABSV) ? snap.AddColumn<float>("absv", "L/T") : nullptr;
+    float *v_x = nullptr, *v_y = nullptr, *v_z = nullptr;
+    if (flags & OUTPUT_CONTENT::VEL) {
+        v_x = snap.AddColumn<float>("v_x", "L/T");
+        v_y = snap.AddColumn<float>("v_y", "L/T");
+        v_z = snap.AddColumn<float>("v_z", "L/T");
     }
-    size_t num_output_spheres = 0;
-
-    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
-        auto this_owner = ownerClumpBody.at(i);
-        family_t this_family = familyID.at(this_owner);
-        // If this (impl-level) family is in the no-output list, skip it
-        if (std::binary_search(familiesNoOutput.begin(), familiesNoOutput.end(), this_family)) {
-            continue;
-        }
-
-        float3 CoM;
-        float X, Y, Z;
-        voxelID_t voxel = voxelID.at(this_owner);
-        subVoxelPos_t subVoxX = locX.at(this_owner);
-        subVoxelPos_t subVoxY = locY.at(this_owner);
-        subVoxelPos_t subVoxZ = locZ.at(this_owner);
-        hostVoxelIDToPosition<float, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel, subVoxX, subVoxY, subVoxZ,
-                                                               simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
-                                                               simParams->l);
-        CoM.x = X + simParams->LBFX;
-        CoM.y = Y + simParams->LBFY;
-        CoM.z = Z + simParams->LBFZ;
-
-        size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt.at(i) : i;
-        float this_sp_deviation_x = relPosSphereX.at(compOffset);
-        float this_sp_deviation_y = relPosSphereY.at(compOffset);
-        float this_sp_deviation_z = relPosSphereZ.at(compOffset);
-        float this_sp_rot_0 = oriQw.at(this_owner);
-        float this_sp_rot_1 = oriQx.at(this_owner);
-        float this_sp_rot_2 = oriQy.at(this_owner);
-        float this_sp_rot_3 = oriQz.at(this_owner);
-        hostApplyOriQToVector3<float, float>(this_sp_deviation_x, this_sp_deviation_y, this_sp_deviation_z,
-                                             this_sp_rot_0, this_sp_rot_1, this_sp_rot_2, this_sp_rot_3);
-        posX.at(num_output_spheres) = CoM.x + this_sp_deviation_x;
-        posY.at(num_output_spheres) = CoM.y + this_sp_deviation_y;
-        posZ.at(num_output_spheres) = CoM.z + this_sp_deviation_z;
-        // std::cout << "Sphere Pos: " << posX.at(i) << ", " << posY.at(i) << ", " << posZ.at(i) << std::endl;
-
-        spRadii.at(num_output_spheres) = radiiSphere.at(compOffset);
-
-        // Family number
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-            families.at(num_output_spheres) = this_family;
-        }
-
-        num_output_spheres++;
-    }
-    // Write basics
-    posX.resize(num_output_spheres);
-    posY.resize(num_output_spheres);
-    posZ.resize(num_output_spheres);
-    spRadii.resize(num_output_spheres);
-    // TODO: Set {} to the list of column names
-    pw.write(ptFile, chpf::Compressor::Type::USE_DEFAULT,
-             {OUTPUT_FILE_X_COL_NAME, OUTPUT_FILE_Y_COL_NAME, OUTPUT_FILE_Z_COL_NAME, OUTPUT_FILE_R_COL_NAME}, posX,
-             posY, posZ, spRadii);
-    // Write family numbers
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-        families.resize(num_output_spheres);
-        // TODO: How to do that?
-        // pw.write(ptFile, chpf::Compressor::Type::USE_DEFAULT, {}, families);
-    }
-}
-
-void DEMDynamicThread::writeSpheresAsCsv(std::ofstream& ptFile) const {
-    std::ostringstream outstrstream;
-
-    outstrstream << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME + "," +
-                        OUTPUT_FILE_R_COL_NAME;
-
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-        outstrstream << ",absv";
+    float *w_x = nullptr, *w_y = nullptr, *w_z = nullptr;
+    if (flags & OUTPUT_CONTENT::ANG_VEL) {
+        w_x = snap.AddColumn<float>("w_x", "1/T");
+        w_y = snap.AddColumn<float>("w_y", "1/T");
+        w_z = snap.AddColumn<float>("w_z", "1/T");
     }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-        outstrstream << ",v_x,v_y,v_z";
+    float *a_x = nullptr, *a_y = nullptr, *a_z = nullptr;
+    if (flags & OUTPUT_CONTENT::ACC) {
+        a_x = snap.AddColumn<float>("a_x", "L/T^2");
+        a_y = snap.AddColumn<float>("a_y", "L/T^2");
+        a_z = snap.AddColumn<float>("a_z", "L/T^2");
     }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_VEL) {
-    //     outstrstream << ",w_x,w_y,w_z";
-    // }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::ACC) {
-    //     outstrstream << ",a_x,a_y,a_z";
-    // }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_ACC) {
-    //     outstrstream << ",alpha_x,alpha_y,alpha_z";
-    // }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-        outstrstream << ",family";
+    float *alpha_x = nullptr, *alpha_y = nullptr, *alpha_z = nullptr;
+    if (flags & OUTPUT_CONTENT::ANG_ACC) {
+        alpha_x = snap.AddColumn<float>("alpha_x", "1/T^2");
+        alpha_y = snap.AddColumn<float>("alpha_y", "1/T^2");
+        alpha_z = snap.AddColumn<float>("alpha_z", "1/T^2");
     }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::MAT) {
-    //     outstrstream << ",material";
-    // }
-    outstrstream << "\n";
-
-    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
-        auto this_owner = ownerClumpBody.at(i);
-        family_t this_family = familyID.at(this_owner);
-        // If this (impl-level) family is in the no-output list, skip it
-        if (std::binary_search(familiesNoOutput.begin(), familiesNoOutput.end(), this_family)) {
-            continue;
+    family_t* family = (flags & OUTPUT_CONTENT::FAMILY) ? snap.AddColumn<family_t>("family") : nullptr;
+
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    pool.parallelFor(nRows, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            bodyID_t owner = rowOwners[k];
+            if (absv) {
+                absv[k] = std::sqrt(vX[owner] * vX[owner] + vY[owner] * vY[owner] + vZ[owner] * vZ[owner]);
+            }
+            if (v_x) {
+                v_x[k] = vX[owner];
+                v_y[k] = vY[owner];
+                v_z[k] = vZ[owner];
+            }
+            // Angular velocity and acceleration are stored in the local frame, and go out in the global frame
+            if (w_x) {
+                float3 w = host_make_float3(omgBarX[owner], omgBarY[owner], omgBarZ[owner]);
+                hostApplyOriQToVector3<float, oriQ_t>(w.x, w.y, w.z, oriQw[owner], oriQx[owner], oriQy[owner],
+                                                      oriQz[owner]);
+                w_x[k] = w.x;
+                w_y[k] = w.y;
+                w_z[k] = w.z;
+            }
+            if (a_x) {
+                a_x[k] = aX[owner];
+                a_y[k] = aY[owner];
+                a_z[k] = aZ[owner];
+            }
+            if (alpha_x) {
+                float3 alpha = host_make_float3(alphaX[owner], alphaY[owner], alphaZ[owner]);
+                hostApplyOriQToVector3<float, oriQ_t>(alpha.x, alpha.y, alpha.z, oriQw[owner], oriQx[owner],
+                                                      oriQy[owner], oriQz[owner]);
+                alpha_x[k] = alpha.x;
+                alpha_y[k] = alpha.y;
+                alpha_z[k] = alpha.z;
+            }
+            if (family) {
+                family[k] = familyID[owner];
+            }
         }
+    });
+}
 
-        float3 CoM;
-        float3 pos;
-        float radius;
-        float X, Y, Z;
-        voxelID_t voxel = voxelID.at(this_owner);
-        subVoxelPos_t subVoxX = locX.at(this_owner);
-        subVoxelPos_t subVoxY = locY.at(this_owner);
-        subVoxelPos_t subVoxZ = locZ.at(this_owner);
-        hostVoxelIDToPosition<float, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel, subVoxX, subVoxY, subVoxZ,
-                                                               simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
-                                                               simParams->l);
-        CoM.x = X + simParams->LBFX;
-        CoM.y = Y + simParams->LBFY;
-        CoM.z = Z + simParams->LBFZ;
-
-        size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt.at(i) : i;
-        float3 this_sp_deviation;
-        this_sp_deviation.x = relPosSphereX.at(compOffset);
-        this_sp_deviation.y = relPosSphereY.at(compOffset);
-        this_sp_deviation.z = relPosSphereZ.at(compOffset);
-        float this_sp_rot_0 = oriQw.at(this_owner);
-        float this_sp_rot_1 = oriQx.at(this_owner);
-        float this_sp_rot_2 = oriQy.at(this_owner);
-        float this_sp_rot_3 = oriQz.at(this_owner);
-        hostApplyOriQToVector3<float, float>(this_sp_deviation.x, this_sp_deviation.y, this_sp_deviation.z,
-                                             this_sp_rot_0, this_sp_rot_1, this_sp_rot_2, this_sp_rot_3);
-        pos = CoM + this_sp_deviation;
-        outstrstream << pos.x << "," << pos.y << "," << pos.z;
-
-        radius = radiiSphere.at(compOffset);
-        outstrstream << "," << radius;
-
-        // Only linear velocity
-        float3 vxyz;
-        vxyz.x = vX.at(this_owner);
-        vxyz.y = vY.at(this_owner);
-        vxyz.z = vZ.at(this_owner);
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-            outstrstream << "," << length(vxyz);
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-            outstrstream << "," << vxyz.x << "," << vxyz.y << "," << vxyz.z;
+void DEMDynamicThread::makeSphereSnapshot(DEMSnapshot& snap) const {
+    // Spheres are written in the order of their public IDs, which does not change when spheres are rearranged, and
+    // those in no-output families are skipped
+    std::vector<bodyID_t> rowSpheres, rowOwners;
+    rowSpheres.reserve(simParams->nSpheresGM);
+    rowOwners.reserve(simParams->nSpheresGM);
+    for (size_t n = 0; n < simParams->nSpheresGM; n++) {
+        bodyID_t i = sphereInternalID(n);
+        bodyID_t owner = ownerClumpBody[i];
+        if (std::binary_search(familiesNoOutput.begin(), familiesNoOutput.end(), familyID[owner])) {
+            continue;
         }
-
-        // Family number needs to be user number
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-            outstrstream << "," << +(this_family);
+        rowSpheres.push_back(i);
+        rowOwners.push_back(owner);
+    }
+    const size_t nRows = rowSpheres.size();
+    snap = DEMSnapshot("sphere", nRows, timeElapsed);
+    snap.attributes["output_content"] = solverFlags.outputFlags;
+
+    double* X = snap.AddColumn<double>(OUTPUT_FILE_X_COL_NAME, "L");
+    double* Y = snap.AddColumn<double>(OUTPUT_FILE_Y_COL_NAME, "L");
+    double* Z = snap.AddColumn<double>(OUTPUT_FILE_Z_COL_NAME, "L");
+    float* R = snap.AddColumn<float>(OUTPUT_FILE_R_COL_NAME, "L");
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    pool.parallelFor(nRows, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            bodyID_t i = rowSpheres[k];
+            bodyID_t owner = rowOwners[k];
+            double CoMX, CoMY, CoMZ;
+            hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(CoMX, CoMY, CoMZ, voxelID[owner], locX[owner],
+                                                                    locY[owner], locZ[owner], simParams->nvXp2,
+                                                                    simParams->nvYp2, simParams->voxelSize,
+                                                                    simParams->l);
+            size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[i] : i;
+            float3 relPos = host_make_float3(relPosSphereX[compOffset], relPosSphereY[compOffset],
+                                             relPosSphereZ[compOffset]);
+            hostApplyOriQToVector3<float, oriQ_t>(relPos.x, relPos.y, relPos.z, oriQw[owner], oriQx[owner],
+                                                  oriQy[owner], oriQz[owner]);
+            X[k] = CoMX + simParams->LBFX + relPos.x;
+            Y[k] = CoMY + simParams->LBFY + relPos.y;
+            Z[k] = CoMZ + simParams->LBFZ + relPos.z;
+            R[k] = radiiSphere[compOffset];
         }
-
-        outstrstream << "\n";
+    });
+    addOwnerSnapshotColumns(snap, rowOwners);
+    if (solverFlags.outputFlags & OUTPUT_CONTENT::MAT) {
+        materialsOffset_t* mat = snap.AddColumn<materialsOffset_t>("material");
+        pool.parallelFor(nRows, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                mat[k] = sphereMaterialOffset[rowSpheres[k]];
+            }
+        });
     }
-
-    ptFile << outstrstream.str();
 }
 
-void DEMDynamicThread::writeClumpsAsChpf(std::ofstream& ptFile) const {}
-
-void DEMDynamicThread::writeClumpsAsCsv(std::ofstream& ptFile) const {
-    std::ostringstream outstrstream;
-
-    // xyz and quaternion are always there
-    outstrstream << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME +
-                        ",Qw,Qx,Qy,Qz," + OUTPUT_FILE_CLUMP_TYPE_NAME;
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-        outstrstream << ",absv";
-    }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-        outstrstream << ",v_x,v_y,v_z";
-    }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_VEL) {
-    //     outstrstream << ",w_x,w_y,w_z";
-    // }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::ACC) {
-    //     outstrstream << ",a_x,a_y,a_z";
-    // }
-    // if (solverFlags.outputFlags & OUTPUT_CONTENT::ANG_ACC) {
-    //     outstrstream << ",alpha_x,alpha_y,alpha_z";
-    // }
-    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-        outstrstream << ",family";
-    }
-    outstrstream << "\n";
-
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
-        // i is this owner's number. And if it is not a clump, we can move on.
-        if (ownerTypes.at(i) != OWNER_T_CLUMP)
-            continue;
-
-        family_t this_family = familyID.at(i);
-        // If this (impl-level) family is in the no-output list, skip it
-        if (std::binary_search(familiesNoOutput.begin(), familiesNoOutput.end(), this_family)) {
+void DEMDynamicThread::makeClumpSnapshot(DEMSnapshot& snap, bool native, unsigned int quatBits) const {
+    // Clumps are written in the order of their public IDs, which does not change when owners are rearranged
+    std::vector<bodyID_t> rowOwners;
+    rowOwners.reserve(simParams->nOwnerClumps);
+    for (size_t n = 0; n < simParams->nOwnerBodies; n++) {
+        bodyID_t i = ownerInternalID(n);
+        if (ownerTypes[i] != OWNER_T_CLUMP ||
+            std::binary_search(familiesNoOutput.begin(), familiesNoOutput.end(), familyID[i])) {
             continue;
         }
+        rowOwners.push_back(i);
+    }
+    const size_t nRows = rowOwners.size();
+    snap = DEMSnapshot("clump", nRows, timeElapsed);
+    snap.attributes["output_content"] = solverFlags.outputFlags;
+    // The clump type column holds template numbers, and the names are in the string table
+    snap.stringTableColumn = OUTPUT_FILE_CLUMP_TYPE_NAME;
+    for (const auto& mark_name : templateNumNameMap) {
+        if (snap.stringTable.size() <= mark_name.first)
+            snap.stringTable.resize(mark_name.first + 1);
+        snap.stringTable[mark_name.first] = mark_name.second;
+    }
 
-        float3 CoM;
-        float X, Y, Z;
-        voxelID_t voxel = voxelID.at(i);
-        subVoxelPos_t subVoxX = locX.at(i);
-        subVoxelPos_t subVoxY = locY.at(i);
-        subVoxelPos_t subVoxZ = locZ.at(i);
-        hostVoxelIDToPosition<float, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel, subVoxX, subVoxY, subVoxZ,
-                                                               simParams->nvXp2, simParams->nvYp2, simParams->voxelSize,
-                                                               simParams->l);
-        CoM.x = X + simParams->LBFX;
-        CoM.y = Y + simParams->LBFY;
-        CoM.z = Z + simParams->LBFZ;
-        // Output position
-        outstrstream << CoM.x << "," << CoM.y << "," << CoM.z;
-
-        // Then quaternions
-        outstrstream << "," << oriQw.at(i) << "," << oriQx.at(i) << "," << oriQy.at(i) << "," << oriQz.at(i);
-
-        // Then type of clump
-        unsigned int clump_mark = inertiaPropOffsets.at(i);
-        outstrstream << "," << templateNumNameMap.at(clump_mark);
-
-        // Only linear velocity
-        float3 vxyz;
-        vxyz.x = vX.at(i);
-        vxyz.y = vY.at(i);
-        vxyz.z = vZ.at(i);
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::ABSV) {
-            outstrstream << "," << length(vxyz);
-        }
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::VEL) {
-            outstrstream << "," << vxyz.x << "," << vxyz.y << "," << vxyz.z;
-        }
-
-        // Family number needs to be user number
-        if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
-            outstrstream << "," << +(this_family);
+    if (native) {
+        // Positions are written as they are stored, with what it takes to decode them
+        snap.attributes["native_coordinates"] = 1.;
+        snap.attributes["nvXp2"] = simParams->nvXp2;
+        snap.attributes["nvYp2"] = simParams->nvYp2;
+        snap.attributes["nvZp2"] = simParams->nvZp2;
+        snap.attributes["l"] = simParams->l;
+        snap.attributes["voxelSize"] = simParams->voxelSize;
+        snap.attributes["LBFX"] = simParams->LBFX;
+        snap.attributes["LBFY"] = simParams->LBFY;
+        snap.attributes["LBFZ"] = simParams->LBFZ;
+        snap.attributes["quat_bits"] = quatBits;
+    }
+    double *X = nullptr, *Y = nullptr, *Z = nullptr;
+    voxelID_t* voxel = nullptr;
+    subVoxelPos_t *subPosX = nullptr, *subPosY = nullptr, *subPosZ = nullptr;
+    if (native) {
+        voxel = snap.AddColumn<voxelID_t>(OUTPUT_FILE_VOXEL_COL_NAME);
+        subPosX = snap.AddColumn<subVoxelPos_t>(OUTPUT_FILE_SUBPOS_X_COL_NAME);
+        subPosY = snap.AddColumn<subVoxelPos_t>(OUTPUT_FILE_SUBPOS_Y_COL_NAME);
+        subPosZ = snap.AddColumn<subVoxelPos_t>(OUTPUT_FILE_SUBPOS_Z_COL_NAME);
+    } else {
+        X = snap.AddColumn<double>(OUTPUT_FILE_X_COL_NAME, "L");
+        Y = snap.AddColumn<double>(OUTPUT_FILE_Y_COL_NAME, "L");
+        Z = snap.AddColumn<double>(OUTPUT_FILE_Z_COL_NAME, "L");
+    }
+    // Quaternions go out as they are, or quantized to 8 or 16 bits in the native format
+    const std::string QNames[4] = {"Qw", "Qx", "Qy", "Qz"};
+    oriQ_t* Q[4] = {nullptr, nullptr, nullptr, nullptr};
+    uint8_t* Q8[4] = {nullptr, nullptr, nullptr, nullptr};
+    uint16_t* Q16[4] = {nullptr, nullptr, nullptr, nullptr};
+    if (solverFlags.outputFlags & OUTPUT_CONTENT::QUAT) {
+        for (int j = 0; j < 4; j++) {
+            if (native && quatBits == 8) {
+                Q8[j] = snap.AddColumn<uint8_t>(QNames[j]);
+            } else if (native && quatBits == 16) {
+                Q16[j] = snap.AddColumn<uint16_t>(QNames[j]);
+            } else {
+                Q[j] = snap.AddColumn<oriQ_t>(QNames[j]);
+            }
         }
-
-        outstrstream << "\n";
     }
-
-    ptFile << outstrstream.str();
+    inertiaOffset_t* clumpType = snap.AddColumn<inertiaOffset_t>(OUTPUT_FILE_CLUMP_TYPE_NAME);
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    pool.parallelFor(nRows, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            bodyID_t i = rowOwners[k];
+            if (native) {
+                voxel[k] = voxelID[i];
+                subPosX[k] = locX[i];
+                subPosY[k] = locY[i];
+                subPosZ[k] = locZ[i];
+            } else {
+                double CoMX, CoMY, CoMZ;
+                hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(CoMX, CoMY, CoMZ, voxelID[i], locX[i],
+                                                                        locY[i], locZ[i], simParams->nvXp2,
+                                                                        simParams->nvYp2, simParams->voxelSize,
+                                                                        simParams->l);
+                X[k] = CoMX + simParams->LBFX;
+                Y[k] = CoMY + simParams->LBFY;
+                Z[k] = CoMZ + simParams->LBFZ;
+            }
+            const oriQ_t oriQ[4] = {oriQw[i], oriQx[i], oriQy[i], oriQz[i]};
+            for (int j = 0; j < 4; j++) {
+                if (Q[j])
+                    Q[j][k] = oriQ[j];
+                else if (Q8[j])
+                    Q8[j][k] = (uint8_t)quantizeQuatComponent(oriQ[j], 8);
+                else if (Q16[j])
+                    Q16[j][k] = (uint16_t)quantizeQuatComponent(oriQ[j], 16);
+            }
+            clumpType[k] = inertiaPropOffsets[i];
+        }
+    });
+    addOwnerSnapshotColumns(snap, rowOwners);
 }
 
-void DEMDynamicThread::writeContactsAsCsv(std::ofstream& ptFile) const {
-    std::ostringstream outstrstream;
+void DEMDynamicThread::makeContactSnapshot(DEMSnapshot& snap) const {
+    // Fake contacts are not written
+    std::vector<size_t> rowContacts;
+    rowContacts.reserve(*(stateOfSolver_resources.pNumContacts));
+    for (size_t i = 0; i < *(stateOfSolver_resources.pNumContacts); i++) {
+        if (contactType[i] != NOT_A_CONTACT)
+            rowContacts.push_back(i);
+    }
+    const size_t nRows = rowContacts.size();
+    const unsigned int flags = solverFlags.cntOutFlags;
+    snap = DEMSnapshot("contact", nRows, timeElapsed);
+    snap.attributes["contact_output_content"] = flags;
+    // Type is mapped to SS, SM and such through the string table
+    snap.stringTableColumn = OUTPUT_FILE_CNT_TYPE_NAME;
+    for (const auto& type_name : contact_type_out_name_map) {
+        if (snap.stringTable.size() <= type_name.first)
+            snap.stringTable.resize(type_name.first + 1);
+        snap.stringTable[type_name.first] = type_name.second;
+    }
 
-    outstrstream << OUTPUT_FILE_OWNER_1_NAME + "," + OUTPUT_FILE_OWNER_2_NAME + "," + OUTPUT_FILE_CNT_TYPE_NAME;
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
-        outstrstream << "," + OUTPUT_FILE_FORCE_X_NAME + "," + OUTPUT_FILE_FORCE_Y_NAME + "," +
-                            OUTPUT_FILE_FORCE_Z_NAME;
+    bodyID_t* A = snap.AddColumn<bodyID_t>(OUTPUT_FILE_OWNER_1_NAME);
+    bodyID_t* B = snap.AddColumn<bodyID_t>(OUTPUT_FILE_OWNER_2_NAME);
+    contact_t* type = snap.AddColumn<contact_t>(OUTPUT_FILE_CNT_TYPE_NAME);
+    float *f_x = nullptr, *f_y = nullptr, *f_z = nullptr;
+    if (flags & CNT_OUTPUT_CONTENT::FORCE) {
+        f_x = snap.AddColumn<float>(OUTPUT_FILE_FORCE_X_NAME, "ML/T^2");
+        f_y = snap.AddColumn<float>(OUTPUT_FILE_FORCE_Y_NAME, "ML/T^2");
+        f_z = snap.AddColumn<float>(OUTPUT_FILE_FORCE_Z_NAME, "ML/T^2");
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::POINT) {
-        outstrstream << "," + OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME;
+    double *X = nullptr, *Y = nullptr, *Z = nullptr;
+    if (flags & CNT_OUTPUT_CONTENT::POINT) {
+        X = snap.AddColumn<double>(OUTPUT_FILE_X_COL_NAME, "L");
+        Y = snap.AddColumn<double>(OUTPUT_FILE_Y_COL_NAME, "L");
+        Z = snap.AddColumn<double>(OUTPUT_FILE_Z_COL_NAME, "L");
     }
-    // if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::COMPONENT) {
-    //     outstrstream << ","+OUTPUT_FILE_COMP_1_NAME+","+OUTPUT_FILE_COMP_2_NAME;
-    // }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
-        outstrstream << "," + OUTPUT_FILE_NORMAL_X_NAME + "," + OUTPUT_FILE_NORMAL_Y_NAME + "," +
-                            OUTPUT_FILE_NORMAL_Z_NAME;
+    float *n_x = nullptr, *n_y = nullptr, *n_z = nullptr;
+    if (flags & CNT_OUTPUT_CONTENT::NORMAL) {
+        n_x = snap.AddColumn<float>(OUTPUT_FILE_NORMAL_X_NAME);
+        n_y = snap.AddColumn<float>(OUTPUT_FILE_NORMAL_Y_NAME);
+        n_z = snap.AddColumn<float>(OUTPUT_FILE_NORMAL_Z_NAME);
     }
-    if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE_ONLY_FORCE) {
-        outstrstream << "," + OUTPUT_FILE_TOF_X_NAME + "," + OUTPUT_FILE_TOF_Y_NAME + "," + OUTPUT_FILE_TOF_Z_NAME;
+    float *tof_x = nullptr, *tof_y = nullptr, *tof_z = nullptr;
+    if (flags & CNT_OUTPUT_CONTENT::TORQUE_ONLY_FORCE) {
+        tof_x = snap.AddColumn<float>(OUTPUT_FILE_TOF_X_NAME, "ML/T^2");
+        tof_y = snap.AddColumn<float>(OUTPUT_FILE_TOF_Y_NAME, "ML/T^2");
+        tof_z = snap.AddColumn<float>(OUTPUT_FILE_TOF_Z_NAME, "ML/T^2");
     }
-    outstrstream << "\n";
-
-    for (size_t i = 0; i < *(stateOfSolver_resources.pNumContacts); i++) {
-        // Geos that are involved in this contact
-        auto geoA = idGeometryA.at(i);
-        auto geoB = idGeometryB.at(i);
-        auto type = contactType.at(i);
-        // We don't output fake contact
-        if (type == NOT_A_CONTACT)
-            continue;
 
-        // geoA's owner must be a sphere
-        auto ownerA = ownerClumpBody.at(geoA);
-        bodyID_t ownerB;
-        // geoB's owner depends...
-        switch (type) {
-            case (SPHERE_SPHERE_CONTACT):
-                ownerB = ownerClumpBody.at(geoB);
-                break;
-            case (SPHERE_MESH_CONTACT):
-                ownerB = ownerMesh.at(geoB);
-                break;
-            default:  // Default is sphere--analytical
-                ownerB = ownerAnalBody.at(geoB);
-        }
-        // Type is mapped to SS, SM and such....
-        outstrstream << ownerA << "," << ownerB << "," << contact_type_out_name_map.at(type);
-
-        // Force is already in global...
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::FORCE) {
-            float3 forcexyz = contactForces.at(i);
-            outstrstream << "," << forcexyz.x << "," << forcexyz.y << "," << forcexyz.z;
-        }
-
-        // Contact point is in local frame. To make it global, first map that vector to axis-aligned global frame, then
-        // add the location of body A CoM
-        float4 oriQA;
-        float3 CoM, cntPntA;  // A's CoM
-        {
-            oriQA.w = oriQw.at(i);
-            oriQA.x = oriQx.at(i);
-            oriQA.y = oriQy.at(i);
-            oriQA.z = oriQz.at(i);
-            voxelID_t voxel = voxelID.at(ownerA);
-            subVoxelPos_t subVoxX = locX.at(ownerA);
-            subVoxelPos_t subVoxY = locY.at(ownerA);
-            subVoxelPos_t subVoxZ = locZ.at(ownerA);
-            hostVoxelIDToPosition<float, voxelID_t, subVoxelPos_t>(CoM.x, CoM.y, CoM.z, voxel, subVoxX, subVoxY,
-                                                                   subVoxZ, simParams->nvXp2, simParams->nvYp2,
-                                                                   simParams->voxelSize, simParams->l);
-            CoM.x += simParams->LBFX;
-            CoM.y += simParams->LBFY;
-            CoM.z += simParams->LBFZ;
-            cntPntA = contactPointGeometryA.at(i);
-            hostApplyOriQToVector3(cntPntA.x, cntPntA.y, cntPntA.z, oriQA.w, oriQA.x, oriQA.y, oriQA.z);
-            cntPntA += CoM;
-        }
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::POINT) {
-            // oriQ is updated already... whereas the contact point is effectively last step's... That's unfortunate.
-            // Should we do somthing ahout it?
-            outstrstream << "," << cntPntA.x << "," << cntPntA.y << "," << cntPntA.z;
-        }
-
-        // To get contact normal: it's just contact point - sphereA center, that gives you the outward normal for body A
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::NORMAL) {
-            size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt.at(geoA) : geoA;
-            float3 this_sp_deviation;
-            this_sp_deviation.x = relPosSphereX.at(compOffset);
-            this_sp_deviation.y = relPosSphereY.at(compOffset);
-            this_sp_deviation.z = relPosSphereZ.at(compOffset);
-            hostApplyOriQToVector3<float, float>(this_sp_deviation.x, this_sp_deviation.y, this_sp_deviation.z, oriQA.w,
-                                                 oriQA.x, oriQA.y, oriQA.z);
-            float3 pos = CoM + this_sp_deviation;
-            float3 normal = normalize(cntPntA - pos);
-            outstrstream << "," << normal.x << "," << normal.y << "," << normal.z;
-        }
-
-        // Torque is in global already...
-        if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::TORQUE_ONLY_FORCE) {
-            float3 forcexyz = contactTorque_convToForce.at(i);
-            outstrstream << "," << forcexyz.x << "," << forcexyz.y << "," << forcexyz.z;
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    pool.parallelFor(nRows, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            size_t i = rowContacts[k];
+            // geoA's owner must be a sphere, and geoB's owner depends...
+            bodyID_t geoA = idGeometryA[i];
+            bodyID_t geoB = idGeometryB[i];
+            bodyID_t ownerA = ownerClumpBody[geoA];
+            bodyID_t ownerB;
+            switch (contactType[i]) {
+                case (SPHERE_SPHERE_CONTACT):
+                    ownerB = ownerClumpBody[geoB];
+                    break;
+                case (SPHERE_MESH_CONTACT):
+                    ownerB = ownerMesh[geoB];
+                    break;
+                default:  // Default is sphere--analytical
+                    ownerB = ownerAnalBody[geoB];
+            }
+            // Owners are written with their public IDs
+            A[k] = ownerPublicID(ownerA);
+            B[k] = ownerPublicID(ownerB);
+            type[k] = contactType[i];
+
+            // Force and torque are already in global
+            if (f_x) {
+                f_x[k] = contactForces[i].x;
+                f_y[k] = contactForces[i].y;
+                f_z[k] = contactForces[i].z;
+            }
+            if (tof_x) {
+                tof_x[k] = contactTorque_convToForce[i].x;
+                tof_y[k] = contactTorque_convToForce[i].y;
+                tof_z[k] = contactTorque_convToForce[i].z;
+            }
+            if (!X && !n_x)
+                continue;
+
+            // Contact point is in the local frame of A. To make it global, first map that vector to axis-aligned
+            // global frame, then add the location of body A CoM. oriQ is updated already, whereas the contact point is
+            // effectively last step's...
+            double CoMX, CoMY, CoMZ;
+            hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(CoMX, CoMY, CoMZ, voxelID[ownerA], locX[ownerA],
+                                                                    locY[ownerA], locZ[ownerA], simParams->nvXp2,
+                                                                    simParams->nvYp2, simParams->voxelSize,
+                                                                    simParams->l);
+            float3 cntPntA = contactPointGeometryA[i];
+            hostApplyOriQToVector3<float, oriQ_t>(cntPntA.x, cntPntA.y, cntPntA.z, oriQw[ownerA], oriQx[ownerA],
+                                                  oriQy[ownerA], oriQz[ownerA]);
+            if (X) {
+                X[k] = CoMX + simParams->LBFX + cntPntA.x;
+                Y[k] = CoMY + simParams->LBFY + cntPntA.y;
+                Z[k] = CoMZ + simParams->LBFZ + cntPntA.z;
+            }
+            // To get contact normal: it's just contact point - sphereA center, that gives you the outward normal for
+            // body A. Both are relative to A's CoM here.
+            if (n_x) {
+                size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[geoA] : geoA;
+                float3 relPos = host_make_float3(relPosSphereX[compOffset], relPosSphereY[compOffset],
+                                                 relPosSphereZ[compOffset]);
+                hostApplyOriQToVector3<float, oriQ_t>(relPos.x, relPos.y, relPos.z, oriQw[ownerA], oriQx[ownerA],
+                                                      oriQy[ownerA], oriQz[ownerA]);
+                float3 normal = normalize(cntPntA - relPos);
+                n_x[k] = normal.x;
+                n_y[k] = normal.y;
+                n_z[k] = normal.z;
+            }
         }
-
-        outstrstream << "\n";
-    }
-
-    ptFile << outstrstream.str();
+    });
 }
 
 inline void DEMDynamicThread::contactEventArraysResize(size_t nContactPairs) {
@@ -1199,6 +1766,30 @@ inline void DEMDynamicThread::contactEventArraysResize(size_t nContactPairs) {
     granData->contactPointGeometryB = contactPointGeometryB.data();
 }
 
+inline void DEMDynamicThread::swapContactBuffers() {
+    idGeometryA.swap(idGeometryA_buffer);
+    idGeometryB.swap(idGeometryB_buffer);
+    contactType.swap(contactType_buffer);
+    granData->idGeometryA = idGeometryA.data();
+    granData->idGeometryB = idGeometryB.data();
+    granData->contactType = contactType.data();
+    granData->idGeometryA_buffer = idGeometryA_buffer.data();
+    granData->idGeometryB_buffer = idGeometryB_buffer.data();
+    granData->contactType_buffer = contactType_buffer.data();
+    if (!solverFlags.isHistoryless) {
+        contactMapping.swap(contactMapping_buffer);
+        granData->contactMapping = contactMapping.data();
+        granData->contactMapping_buffer = contactMapping_buffer.data();
+    }
+
+    // kT sends its next produce to what used to be our work arrays. It only does so while holding the same lock we are
+    // holding now, so it always sees the new pointers.
+    kT->granData->pDTOwnedBuffer_idGeometryA = granData->idGeometryA_buffer;
+    kT->granData->pDTOwnedBuffer_idGeometryB = granData->idGeometryB_buffer;
+    kT->granData->pDTOwnedBuffer_contactType = granData->contactType_buffer;
+    kT->granData->pDTOwnedBuffer_contactMapping = granData->contactMapping_buffer;
+}
+
 inline void DEMDynamicThread::unpackMyBuffer() {
     // Make a note on the contact number of the previous time step
     *stateOfSolver_resources.pNumPrevContacts = *stateOfSolver_resources.pNumContacts;
@@ -1206,27 +1797,67 @@ inline void DEMDynamicThread::unpackMyBuffer() {
     GPU_CALL(cudaMemcpy(stateOfSolver_resources.pNumContacts, &(granData->nContactPairs_buffer), sizeof(size_t),
                         cudaMemcpyDeviceToDevice));
 
+    // The buffers hold the new contact arrays in full, so they just become the work arrays. contactMapping is not
+    // copied either, as it is only used once per kT update, at the time of unpacking, and stays put until the next one.
+    if (swapTransferBuffers) {
+        swapContactBuffers();
+    }
+
     // Need to resize those contact event-based arrays before usage
     if (*stateOfSolver_resources.pNumContacts > idGeometryA.size() ||
-        *stateOfSolver_resources.pNumContacts > buffer_size) {
+        *stateOfSolver_resources.pNumContacts > contactForces.size()) {
         contactEventArraysResize(*stateOfSolver_resources.pNumContacts);
     }
 
-    GPU_CALL(cudaMemcpy(granData->idGeometryA, granData->idGeometryA_buffer,
-                        *stateOfSolver_resources.pNumContacts * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->idGeometryB, granData->idGeometryB_buffer,
-                        *stateOfSolver_resources.pNumContacts * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->contactType, granData->contactType_buffer,
-                        *stateOfSolver_resources.pNumContacts * sizeof(contact_t), cudaMemcpyDeviceToDevice));
-    if (!solverFlags.isHistoryless) {
-        // Note we don't have to use dedicated memory space for unpacking contactMapping_buffer contents, because we
-        // only use it once per kT update, at the time of unpacking. So let us just use a temp vector to store it. Note
-        // we cannot use vector 0 since it may hold critical flattened owner ID info.
-        size_t mapping_bytes = (*stateOfSolver_resources.pNumContacts) * sizeof(contactPairs_t);
-        granData->contactMapping = (contactPairs_t*)stateOfSolver_resources.allocateTempVector(1, mapping_bytes);
-        GPU_CALL(cudaMemcpy(granData->contactMapping, granData->contactMapping_buffer, mapping_bytes,
-                            cudaMemcpyDeviceToDevice));
+    if (!swapTransferBuffers) {
+        GPU_CALL(cudaMemcpy(granData->idGeometryA, granData->idGeometryA_buffer,
+                            *stateOfSolver_resources.pNumContacts * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->idGeometryB, granData->idGeometryB_buffer,
+                            *stateOfSolver_resources.pNumContacts * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->contactType, granData->contactType_buffer,
+                            *stateOfSolver_resources.pNumContacts * sizeof(contact_t), cudaMemcpyDeviceToDevice));
+        if (!solverFlags.isHistoryless) {
+            // Note we don't have to use dedicated memory space for unpacking contactMapping_buffer contents, because
+            // we only use it once per kT update, at the time of unpacking. So let us just use a temp vector to store
+            // it. Note we cannot use vector 0 since it may hold critical flattened owner ID info.
+            size_t mapping_bytes = (*stateOfSolver_resources.pNumContacts) * sizeof(contactPairs_t);
+            granData->contactMapping = (contactPairs_t*)stateOfSolver_resources.allocateTempVector(1, mapping_bytes);
+            GPU_CALL(cudaMemcpy(granData->contactMapping, granData->contactMapping_buffer, mapping_bytes,
+                                cudaMemcpyDeviceToDevice));
+        }
     }
+
+    // In displacement-triggered CD, the owner states in the order that produced this contact list become the reference
+    // for measuring displacements. dT sends no new order before it gets this produce, so they are still in kT's buffer,
+    // or, if kT swapped its buffers in, in kT's work arrays.
+    if (solverFlags.useDisplacementTriggeredCD) {
+        const DEMDataKT* order = kT->granData;
+        const bool inWorkArrays = swapTransferBuffers;
+        GPU_CALL(cudaMemcpy(granData->voxelID_cdRef, inWorkArrays ? order->voxelID : granData->pKTOwnedBuffer_voxelID,
+                            simParams->nOwnerBodies * sizeof(voxelID_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->locX_cdRef, inWorkArrays ? order->locX : granData->pKTOwnedBuffer_locX,
+                            simParams->nOwnerBodies * sizeof(subVoxelPos_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->locY_cdRef, inWorkArrays ? order->locY : granData->pKTOwnedBuffer_locY,
+                            simParams->nOwnerBodies * sizeof(subVoxelPos_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->locZ_cdRef, inWorkArrays ? order->locZ : granData->pKTOwnedBuffer_locZ,
+                            simParams->nOwnerBodies * sizeof(subVoxelPos_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQw_cdRef, inWorkArrays ? order->oriQw : granData->pKTOwnedBuffer_oriQ0,
+                            simParams->nOwnerBodies * sizeof(oriQ_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQx_cdRef, inWorkArrays ? order->oriQx : granData->pKTOwnedBuffer_oriQ1,
+                            simParams->nOwnerBodies * sizeof(oriQ_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQy_cdRef, inWorkArrays ? order->oriQy : granData->pKTOwnedBuffer_oriQ2,
+                            simParams->nOwnerBodies * sizeof(oriQ_t), cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQz_cdRef, inWorkArrays ? order->oriQz : granData->pKTOwnedBuffer_oriQ3,
+                            simParams->nOwnerBodies * sizeof(oriQ_t), cudaMemcpyDeviceToDevice));
+        cdListExpandFactor = cdOrderExpandFactor;
+        cdListIsValid = cdOrderIsValid;
+        cdOrderOutstanding = false;
+        nStepsOnCDList = nStepsOnCDOrder;
+        // Average over the last few deliveries, so one slow kT update does not make dT order too early for long
+        cdOrderLatency = (cdOrderLatency < 0.) ? (double)nStepsOnCDOrder
+                                               : 0.75 * cdOrderLatency + 0.25 * (double)nStepsOnCDOrder;
+    }
+    nListsSinceExpandTune++;
 }
 
 inline void DEMDynamicThread::sendToTheirBuffer() {
@@ -1253,6 +1884,13 @@ inline void DEMDynamicThread::sendToTheirBuffer() {
         GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_familyID, granData->familyID,
                             simParams->nOwnerBodies * sizeof(family_t), cudaMemcpyDeviceToDevice));
     }
+
+    // The expand factor may be re-chosen between orders, so kT is told which one this order goes with
+    GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_beta, &(simParams->beta), sizeof(float), cudaMemcpyDeviceToDevice));
+    cdOrderExpandFactor = simParams->beta;
+    cdOrderIsValid = true;
+    cdOrderOutstanding = true;
+    nStepsOnCDOrder = 0;
 }
 
 inline void DEMDynamicThread::migratePersistentContacts() {
@@ -1281,7 +1919,15 @@ inline void DEMDynamicThread::migratePersistentContacts() {
             // GPU_CALL(cudaMemset(contactSentry, 0, sentry_bytes));
             blocks_needed_for_rearrange = (*stateOfSolver_resources.pNumPrevContacts + DEME_MAX_THREADS_PER_BLOCK - 1) /
                                           DEME_MAX_THREADS_PER_BLOCK;
-            if (blocks_needed_for_rearrange > 0) {
+            if (solverFlags.useHostDynamics) {
+                hostParallelFor(*stateOfSolver_resources.pNumPrevContacts, solverFlags.nHostThreads,
+                                [&](size_t begin, size_t end) {
+                                    host_prep_force_kernels->launch(
+                                        "markAliveContacts", begin, end,
+                                        granData->contactWildcards[simParams->nContactWildcards - 1], contactSentry,
+                                        *stateOfSolver_resources.pNumPrevContacts);
+                                });
+            } else if (blocks_needed_for_rearrange > 0) {
                 prep_force_kernels->kernel("markAliveContacts")
                     .instantiate()
                     .configure(dim3(blocks_needed_for_rearrange), dim3(DEME_MAX_THREADS_PER_BLOCK), 0,
@@ -1296,7 +1942,13 @@ inline void DEMDynamicThread::migratePersistentContacts() {
     // Rearrange contact histories based on kT instruction
     blocks_needed_for_rearrange =
         (*stateOfSolver_resources.pNumContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
-    if (blocks_needed_for_rearrange > 0) {
+    if (solverFlags.useHostDynamics) {
+        hostParallelFor(*stateOfSolver_resources.pNumContacts, solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+            host_prep_force_kernels->launch("rearrangeContactWildcards", begin, end, granData, newWildcards[0],
+                                            contactSentry, simParams->nContactWildcards,
+                                            *stateOfSolver_resources.pNumContacts);
+        });
+    } else if (blocks_needed_for_rearrange > 0) {
         prep_force_kernels->kernel("rearrangeContactWildcards")
             .instantiate()
             .configure(dim3(blocks_needed_for_rearrange), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
@@ -1347,6 +1999,16 @@ inline void DEMDynamicThread::migratePersistentContacts() {
 }
 
 inline void DEMDynamicThread::calculateForces() {
+    // The INT_GAP step size strategy needs the contact overlaps, in temp vector 5 which force calculation and
+    // collection do not use
+    if (simParams->recordContactOverlap) {
+        granData->contactOverlap = (float*)stateOfSolver_resources.allocateTempVector(
+            5, std::max<size_t>(*stateOfSolver_resources.pNumContacts, 1) * sizeof(float));
+    }
+    if (solverFlags.useHostDynamics) {
+        hostCalculateForces();
+        return;
+    }
     // reset force (acceleration) arrays for this time step and apply gravity
     size_t threads_needed_for_prep = simParams->nOwnerBodies > *stateOfSolver_resources.pNumContacts
                                          ? simParams->nOwnerBodies
@@ -1421,7 +2083,35 @@ inline void DEMDynamicThread::calculateForces() {
     }
 }
 
+inline void DEMDynamicThread::hostCalculateForces() {
+    const size_t nContacts = *stateOfSolver_resources.pNumContacts;
+    const size_t nOwners = simParams->nOwnerBodies;
+    // Reset force (acceleration) arrays for this time step
+    hostParallelFor(std::max(nOwners, nContacts), solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+        host_prep_force_kernels->launch("prepareForceArrays", begin, end, simParams, granData, nContacts);
+    });
+
+    if (nContacts > 0) {
+        timers.GetTimer("Calculate contact forces").start();
+        hostParallelFor(nContacts, solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+            host_cal_force_kernels->launch("calculateContactForces", begin, end, simParams, granData, nContacts);
+        });
+        timers.GetTimer("Calculate contact forces").stop();
+
+        timers.GetTimer("Collect contact forces").start();
+        hostCollectContactForces(*host_collect_force_kernels, granData, nContacts, nOwners, contactPairArr_isFresh,
+                                 solverFlags.nHostThreads, stateOfSolver_resources, timers);
+        timers.GetTimer("Collect contact forces").stop();
+    }
+}
+
 inline void DEMDynamicThread::integrateOwnerMotions() {
+    if (solverFlags.useHostDynamics) {
+        hostParallelFor(simParams->nOwnerBodies, solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+            host_integrator_kernels->launch("integrateOwners", begin, end, simParams, granData, timeElapsed);
+        });
+        return;
+    }
     size_t blocks_needed_for_clumps =
         (simParams->nOwnerBodies + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
     integrator_kernels->kernel("integrateOwners")
@@ -1431,8 +2121,40 @@ inline void DEMDynamicThread::integrateOwnerMotions() {
     GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
 }
 
+inline void DEMDynamicThread::updateSleepStates() {
+    if (solverFlags.useHostDynamics) {
+        hostParallelFor(simParams->nOwnerBodies, solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+            host_integrator_kernels->launch("updateSleepStates", begin, end, simParams, granData, timeElapsed);
+        });
+        return;
+    }
+    size_t blocks_needed_for_owners =
+        (simParams->nOwnerBodies + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
+    integrator_kernels->kernel("updateSleepStates")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, streamInfo.stream)
+        .launch(simParams, granData, timeElapsed);
+    GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+}
+
+size_t DEMDynamicThread::getNumSleepingClumps() const {
+    if (!solverFlags.useSleeping) {
+        return 0;
+    }
+    size_t nSleeping = 0;
+    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
+        nSleeping += (ownerSleepState[i] & SLEEP_ASLEEP) ? 1 : 0;
+    }
+    return nSleeping;
+}
+
 inline void DEMDynamicThread::routineChecks() {
-    if (solverFlags.canFamilyChange) {
+    if (solverFlags.canFamilyChange && solverFlags.useHostDynamics) {
+        hostParallelFor(simParams->nOwnerBodies, solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+            host_mod_kernels->launch("applyFamilyChanges", begin, end, granData, (size_t)simParams->nOwnerBodies,
+                                     simParams->h, timeElapsed);
+        });
+    } else if (solverFlags.canFamilyChange) {
         size_t blocks_needed_for_clumps =
             (simParams->nOwnerBodies + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
         mod_kernels->kernel("applyFamilyChanges")
@@ -1444,18 +2166,18 @@ inline void DEMDynamicThread::routineChecks() {
 }
 
 inline void DEMDynamicThread::ifProduceFreshThenUseItAndSendNewOrder() {
-    if (pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
+    if (pSchedSupport->dynamicOwned_Prod2ConsBuffer.isFresh()) {
         timers.GetTimer("Unpack updates from kT").start();
         {
             // Acquire lock and use the content of the dynamic-owned transfer buffer
             std::lock_guard<std::mutex> lock(pSchedSupport->dynamicOwnedBuffer_AccessCoordination);
             unpackMyBuffer();
+            // dT got the produce, now mark its buffer to be no longer fresh
+            pSchedSupport->dynamicOwned_Prod2ConsBuffer.consume();
             // Leave myself a mental note that I just obtained new produce from kT
             contactPairArr_isFresh = true;
             // pSchedSupport->schedulingStats.nDynamicReceives++;
         }
-        // dT got the produce, now mark its buffer to be no longer fresh
-        pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh = false;
         pSchedSupport->stampLastUpdateOfDynamic = (pSchedSupport->currentStampOfDynamic).load();
 
         // If this is a history-based run, then when contacts are received, we need to migrate the contact
@@ -1465,20 +2187,244 @@ inline void DEMDynamicThread::ifProduceFreshThenUseItAndSendNewOrder() {
         }
         timers.GetTimer("Unpack updates from kT").stop();
 
-        timers.GetTimer("Send to kT buffer").start();
-        // Acquire lock and refresh the work order for the kinematic
-        {
-            std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
-            sendToTheirBuffer();
+        // In displacement-triggered CD, the new contact list comes with a new reference for the displacements, and
+        // whether to send a new order is decided based on them
+        if (solverFlags.useDisplacementTriggeredCD) {
+            updateDisplacementSinceCD();
+        } else {
+            sendNewOrder();
         }
-        pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
-        pSchedSupport->schedulingStats.nKinematicUpdates++;
-        timers.GetTimer("Send to kT buffer").stop();
-        // Signal the kinematic that it has data for a new work order
-        pSchedSupport->cv_KinematicCanProceed.notify_all();
     }
 }
 
+inline void DEMDynamicThread::sendNewOrder() {
+    timers.GetTimer("Send to kT buffer").start();
+    // Acquire lock and refresh the work order for the kinematic
+    {
+        std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
+        sendToTheirBuffer();
+        pSchedSupport->kinematicOwned_Cons2ProdBuffer.publish();
+    }
+    pSchedSupport->schedulingStats.nKinematicUpdates++;
+    timers.GetTimer("Send to kT buffer").stop();
+    // Signal the kinematic that it has data for a new work order
+    pSchedSupport->kinematicOwned_Cons2ProdBuffer.notifyConsumer();
+}
+
+void DEMDynamicThread::computeOwnerCDReach() {
+    std::fill(ownerCDReach.begin(), ownerCDReach.end(), 0.f);
+    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
+        bodyID_t owner = ownerClumpBody[i];
+        size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[i] : i;
+        float3 relPos;
+        relPos.x = relPosSphereX[compOffset];
+        relPos.y = relPosSphereY[compOffset];
+        relPos.z = relPosSphereZ[compOffset];
+        float reach = length(relPos);
+        ownerCDReach[owner] = std::max(ownerCDReach[owner], reach);
+    }
+    for (size_t i = 0; i < simParams->nTriGM; i++) {
+        bodyID_t owner = ownerMesh[i];
+        float reach = std::max(std::max(length(relPosNode1[i]), length(relPosNode2[i])), length(relPosNode3[i]));
+        ownerCDReach[owner] = std::max(ownerCDReach[owner], reach);
+    }
+    // Analytical objects are left at 0: they are typically boundaries that are large or unbounded, so only their
+    // translation is accounted for
+    ownerCDReach_isStale = false;
+}
+
+inline void DEMDynamicThread::updateDisplacementSinceCD() {
+    size_t n = simParams->nOwnerBodies;
+    if (n == 0) {
+        maxDispSinceCD = 0.f;
+        return;
+    }
+    if (solverFlags.useHostDynamics) {
+        HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+        size_t nChunks = std::max<size_t>(1, pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+        std::vector<float> chunkMax(nChunks, 0.f);
+        pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+            float myMax = 0.f;
+            for (size_t i = begin; i < end; i++) {
+                double X, Y, Z, refX, refY, refZ;
+                hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(X, Y, Z, voxelID[i], locX[i], locY[i],
+                                                                        locZ[i], simParams->nvXp2, simParams->nvYp2,
+                                                                        simParams->voxelSize, simParams->l);
+                hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+                    refX, refY, refZ, voxelID_cdRef[i], locX_cdRef[i], locY_cdRef[i], locZ_cdRef[i], simParams->nvXp2,
+                    simParams->nvYp2, simParams->voxelSize, simParams->l);
+                double dX = X - refX, dY = Y - refY, dZ = Z - refZ;
+                // Measured to the nearest periodic image of the reference, like in computeOwnerDisplacements
+                if (simParams->periodicX)
+                    dX -= simParams->periodX * std::round(dX / simParams->periodX);
+                if (simParams->periodicY)
+                    dY -= simParams->periodY * std::round(dY / simParams->periodY);
+                if (simParams->periodicZ)
+                    dZ -= simParams->periodZ * std::round(dZ / simParams->periodZ);
+                // See computeOwnerDisplacements in DEMMiscKernels.cu for the rotation part
+                float qDot = oriQw[i] * oriQw_cdRef[i] + oriQx[i] * oriQx_cdRef[i] + oriQy[i] * oriQy_cdRef[i] +
+                             oriQz[i] * oriQz_cdRef[i];
+                float qDist = std::sqrt(std::max(2.f - 2.f * std::abs(qDot), 0.f));
+                float disp = (float)std::sqrt(dX * dX + dY * dY + dZ * dZ) + 2.f * ownerCDReach[i] * qDist;
+                myMax = std::max(myMax, disp);
+            }
+            chunkMax[c] = myMax;
+        });
+        maxDispSinceCD = *std::max_element(chunkMax.begin(), chunkMax.end());
+        return;
+    }
+    // Temp vector 0 may hold the cached owner info for force collection, and 1 is free after the contact history is
+    // migrated
+    float* ownerDisp = (float*)stateOfSolver_resources.allocateTempVector(1, n * sizeof(float));
+    float* maxDisp = (float*)stateOfSolver_resources.allocateTempVector(2, sizeof(float));
+    size_t blocks_needed_for_owners = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    misc_kernels->kernel("computeOwnerDisplacements")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(granData, simParams, ownerDisp, n);
+    GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    floatMaxReduce(ownerDisp, maxDisp, n, streamInfo.stream, stateOfSolver_resources);
+    maxDispSinceCD = *maxDisp;
+}
+
+inline bool DEMDynamicThread::contactListIsStale() const {
+    if (!cdListIsValid || maxDispSinceCD >= DEME_CD_DISP_TRIGGER_FRACTION * cdListExpandFactor) {
+        return true;
+    }
+    return solverFlags.maxStepsPerContactList >= 0 &&
+           nStepsOnCDList >= (uint64_t)solverFlags.maxStepsPerContactList;
+}
+
+inline void DEMDynamicThread::ifDisplacedThenSendNewOrder() {
+    if (cdOrderOutstanding) {
+        return;
+    }
+    // Extrapolate the displacement to when a new order would be delivered, at the average rate since the contact list
+    // in use was detected
+    double stepsToDelivery = std::max(cdOrderLatency, 0.) + 1.;
+    double rate = (nStepsOnCDList > 0) ? (double)maxDispSinceCD / (double)nStepsOnCDList : 0.;
+    bool due = (double)maxDispSinceCD + rate * stepsToDelivery >=
+               DEME_CD_DISP_TRIGGER_FRACTION * (double)cdListExpandFactor;
+    if (solverFlags.maxStepsPerContactList >= 0 &&
+        (double)nStepsOnCDList + stepsToDelivery >= (double)solverFlags.maxStepsPerContactList) {
+        due = true;
+    }
+    if (due || !cdListIsValid) {
+        sendNewOrder();
+    }
+}
+
+inline void DEMDynamicThread::ifDisplacedTooMuchThenWait() {
+    // The contact list kT delivers can already be stale on arrival, if the order was sent long ago. Then dT orders
+    // again and waits for that one, whose positions are the current ones.
+    while (contactListIsStale()) {
+        if (!cdOrderOutstanding) {
+            sendNewOrder();
+        }
+        timers.GetTimer("Wait for kT update").start();
+        pSchedSupport->schedulingStats.nTimesDynamicHeldBack++;
+        pSchedSupport->dynamicOwned_Prod2ConsBuffer.waitForFresh(pSchedSupport->handoffBackoff);
+        timers.GetTimer("Wait for kT update").stop();
+        ifProduceFreshThenUseItAndSendNewOrder();
+    }
+}
+
+inline void DEMDynamicThread::updateMaxPointVel() {
+    size_t n = simParams->nOwnerBodies;
+    if (n == 0) {
+        maxPointVel = 0.f;
+        return;
+    }
+    if (solverFlags.useHostDynamics) {
+        HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+        size_t nChunks = std::max<size_t>(1, pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+        std::vector<float> chunkMax(nChunks, 0.f);
+        pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+            float myMax = 0.f;
+            for (size_t i = begin; i < end; i++) {
+                float vel = std::sqrt(vX[i] * vX[i] + vY[i] * vY[i] + vZ[i] * vZ[i]) +
+                            std::sqrt(omgBarX[i] * omgBarX[i] + omgBarY[i] * omgBarY[i] + omgBarZ[i] * omgBarZ[i]) *
+                                ownerCDReach[i];
+                myMax = std::max(myMax, vel);
+            }
+            chunkMax[c] = myMax;
+        });
+        maxPointVel = *std::max_element(chunkMax.begin(), chunkMax.end());
+        return;
+    }
+    // Same temp vectors as updateDisplacementSinceCD, which is done with them by now
+    float* ownerVel = (float*)stateOfSolver_resources.allocateTempVector(1, n * sizeof(float));
+    float* maxVel = (float*)stateOfSolver_resources.allocateTempVector(2, sizeof(float));
+    size_t blocks_needed_for_owners = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    misc_kernels->kernel("computeOwnerMaxPointVel")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(granData, ownerVel, n);
+    GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    floatMaxReduce(ownerVel, maxVel, n, streamInfo.stream, stateOfSolver_resources);
+    maxPointVel = *maxVel;
+}
+
+inline void DEMDynamicThread::updateMaxContactOverlap() {
+    size_t n = *stateOfSolver_resources.pNumContacts;
+    if (n == 0) {
+        maxContactOverlap = 0.f;
+        return;
+    }
+    if (solverFlags.useHostDynamics) {
+        HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+        size_t nChunks = std::max<size_t>(1, pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+        std::vector<float> chunkMax(nChunks, 0.f);
+        const float* overlap = granData->contactOverlap;
+        pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+            float myMax = 0.f;
+            for (size_t i = begin; i < end; i++) {
+                myMax = std::max(myMax, overlap[i]);
+            }
+            chunkMax[c] = myMax;
+        });
+        maxContactOverlap = *std::max_element(chunkMax.begin(), chunkMax.end());
+        return;
+    }
+    // The overlaps are in temp vector 5, which the force calculation of this step filled
+    float* maxOverlap = (float*)stateOfSolver_resources.allocateTempVector(2, sizeof(float));
+    floatMaxReduce(granData->contactOverlap, maxOverlap, n, streamInfo.stream, stateOfSolver_resources);
+    maxContactOverlap = *maxOverlap;
+}
+
+inline void DEMDynamicThread::chooseStepSize() {
+    double h = simParams->h;
+    double newH = h * DEME_TS_MAX_GROWTH;
+    updateMaxPointVel();
+    switch (solverFlags.stepSizeStrat) {
+        case (VAR_TS_STRAT::MAX_VEL):
+            // No point moves further than the target fraction of the smallest radius
+            if (maxPointVel > 0.f) {
+                newH = std::min(newH, (double)simParams->stepDispFraction * simParams->stepRefLength / maxPointVel);
+            }
+            break;
+        case (VAR_TS_STRAT::INT_GAP):
+            // The overlaps scale about linearly with the step size in an impact, so scale the step by how far off the
+            // deepest overlap is from the target
+            updateMaxContactOverlap();
+            if (maxContactOverlap > 0.f) {
+                newH = std::min(newH, h * std::max((double)simParams->stepOverlapFraction / maxContactOverlap,
+                                                   (double)DEME_TS_MAX_SHRINK));
+            }
+            break;
+        default:
+            break;
+    }
+    // kT detects contacts with geometries enlarged by the expand factor, which has to cover how far any point moves
+    // in the steps that one contact list is used for (displacement-triggered CD orders new lists on its own)
+    int64_t freq = pSchedSupport->dynamicRequestedUpdateFrequency;
+    if (!solverFlags.useDisplacementTriggeredCD && freq > 0 && maxPointVel > 0.f && simParams->beta > 0.f) {
+        newH = std::min(newH, (double)simParams->beta /
+                                  ((double)maxPointVel * (double)freq * (double)simParams->expSafetyParam));
+    }
+    simParams->h = std::min(std::max(newH, simParams->minStepSize), simParams->maxStepSize);
+}
+
 void DEMDynamicThread::workerThread() {
     // Set the gpu for this thread
     GPU_CALL(cudaSetDevice(streamInfo.device));
@@ -1498,6 +2444,10 @@ void DEMDynamicThread::workerThread() {
             }
         }
 
+        if (needsOwnerCDReach() && ownerCDReach_isStale) {
+            computeOwnerCDReach();
+        }
+
         // There is only one situation where dT needs to wait for kT to provide one initial CD result...
         // This is the `new-boot' case, where stampLastUpdateOfDynamic == -1; in any other situations, dT does not have
         // `drift-into-future-too-much' problem here, b/c if it has the problem then it would have been addressed at the
@@ -1508,23 +2458,17 @@ void DEMDynamicThread::workerThread() {
             {
                 std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
                 sendToTheirBuffer();
+                pSchedSupport->kinematicOwned_Cons2ProdBuffer.publish();
             }
-            pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
             contactPairArr_isFresh = true;
             pSchedSupport->schedulingStats.nKinematicUpdates++;
             // Signal the kinematic that it has data for a new work order.
-            pSchedSupport->cv_KinematicCanProceed.notify_all();
+            pSchedSupport->kinematicOwned_Cons2ProdBuffer.notifyConsumer();
             // Then dT will wait for kT to finish one initial run
-            {
-                std::unique_lock<std::mutex> lock(pSchedSupport->dynamicCanProceed);
-                while (!pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
-                    // loop to avoid spurious wakeups
-                    pSchedSupport->cv_DynamicCanProceed.wait(lock);
-                }
-            }
+            pSchedSupport->dynamicOwned_Prod2ConsBuffer.waitForFresh(pSchedSupport->handoffBackoff);
         }
 
-        for (double cycle = 0.0; cycle < cycleDuration; cycle += simParams->h) {
+        for (double cycle = 0.0; cycle < cycleDuration;) {
             // If the produce is fresh, use it, and then send kT a new work order.
             // We used to send work order to kT whenever kT unpacks its buffer. This can lead to a situation where dT
             // sends a new work order and then immediately bails out (user asks it to do something else). A bit later
@@ -1534,39 +2478,52 @@ void DEMDynamicThread::workerThread() {
             // unpacks it.
             ifProduceFreshThenUseItAndSendNewOrder();
 
+            // In displacement-triggered CD, it is how far the owners moved since the contact list in use was detected
+            // that decides when to order a new one, and when to wait for it
+            if (solverFlags.useDisplacementTriggeredCD) {
+                ifDisplacedThenSendNewOrder();
+                ifDisplacedTooMuchThenWait();
+            }
+
             // Check if we need to wait; i.e., if dynamic drifted too much into future, then we must wait a bit before
             // the next cycle begins
             if (pSchedSupport->dynamicShouldWait()) {
                 timers.GetTimer("Wait for kT update").start();
                 // Wait for a signal from kT to indicate that kT has caught up
                 pSchedSupport->schedulingStats.nTimesDynamicHeldBack++;
-                std::unique_lock<std::mutex> lock(pSchedSupport->dynamicCanProceed);
-                while (!pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
-                    // Loop to avoid spurious wakeups
-                    pSchedSupport->cv_DynamicCanProceed.wait(lock);
-                }
+                nHeldBackSinceExpandTune++;
+                pSchedSupport->dynamicOwned_Prod2ConsBuffer.waitForFresh(pSchedSupport->handoffBackoff);
                 timers.GetTimer("Wait for kT update").stop();
             }
             // NOTE: This ShouldWait check should follow the ifProduceFreshThenUseItAndSendNewOrder call. Because we
             // need to avoid a scenario where dT is waiting here, and kT is also chilling waiting for an update. But
-            // with this ShouldWait check being here, if dynamicOwned_Prod2ConsBuffer_isFresh is true so
+            // with this ShouldWait check being here, if dynamicOwned_Prod2ConsBuffer is fresh so
             // ifProduceFreshThenUseItAndSendNewOrder is executed, then kT is is working for us, no worry; if
-            // dynamicOwned_Prod2ConsBuffer_isFresh is false so ifProduceFreshThenUseItAndSendNewOrder didn't run, then
+            // dynamicOwned_Prod2ConsBuffer is not fresh so ifProduceFreshThenUseItAndSendNewOrder didn't run, then
             // kT has to be in the process of doing a CD, we still will not be locked here.
 
-            // If using variable ts size, only when a step is accepted can we move on
-            bool step_accepted = false;
-            do {
-                calculateForces();
-
-                routineChecks();
+            // A variable step size is chosen after each step, for the next one, so steps are never redone
+            const double stepSize = simParams->h;
+            calculateForces();
 
-                timers.GetTimer("Integration").start();
-                integrateOwnerMotions();
-                timers.GetTimer("Integration").stop();
+            routineChecks();
 
-                step_accepted = true;
-            } while ((!solverFlags.isStepConst) || (!step_accepted));
+            timers.GetTimer("Integration").start();
+            integrateOwnerMotions();
+            if (solverFlags.useSleeping) {
+                updateSleepStates();
+            }
+            nStepsSinceExpandTune++;
+            if (solverFlags.useDisplacementTriggeredCD) {
+                nStepsOnCDList++;
+                nStepsOnCDOrder++;
+                updateDisplacementSinceCD();
+                cdMaxDispPerStep = std::max(cdMaxDispPerStep, maxDispSinceCD / (float)nStepsOnCDList);
+            }
+            if (!solverFlags.isStepConst) {
+                chooseStepSize();
+            }
+            timers.GetTimer("Integration").stop();
 
             // CalculateForces is done, set contactPairArr_isFresh to false
             // This will be set to true next time it receives an update from kT
@@ -1581,8 +2538,8 @@ void DEMDynamicThread::workerThread() {
             pSchedSupport->currentStampOfDynamic++;
             nTotalSteps++;
 
-            //// TODO: make changes for variable time step size cases
-            timeElapsed += simParams->h;
+            timeElapsed += stepSize;
+            cycle += stepSize;
         }
 
         // When getting here, dT has finished one user call (although perhaps not at the end of the user script)
@@ -1610,54 +2567,78 @@ void DEMDynamicThread::resetUserCallStat() {
     pSchedSupport->currentStampOfDynamic = 0;
     // Reset dT stats variables, making ready for next user call
     pSchedSupport->dynamicDone = false;
-    pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh = false;
+    pSchedSupport->dynamicOwned_Prod2ConsBuffer.consume();
     contactPairArr_isFresh = true;
+    // If kT was working on an order, its produce is discarded
+    cdOrderOutstanding = false;
 }
 
 size_t DEMDynamicThread::estimateMemUsage() const {
     return m_approx_bytes_used;
 }
 
-void DEMDynamicThread::jitifyKernels(const std::unordered_map<std::string, std::string>& Subs) {
-    // First one is force array preparation kernels
-    {
-        prep_force_kernels = std::make_shared<jitify::Program>(
-            std::move(JitHelper::buildProgram("DEMPrepForceKernels", JitHelper::KERNEL_DIR / "DEMPrepForceKernels.cu",
-                                              Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
-    }
-    // Then force calculation kernels
-    {
-        cal_force_kernels = std::make_shared<jitify::Program>(
-            std::move(JitHelper::buildProgram("DEMCalcForceKernels", JitHelper::KERNEL_DIR / "DEMCalcForceKernels.cu",
-                                              Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
-    }
-    // Then force accumulation kernels
-    {
-        collect_force_kernels = std::make_shared<jitify::Program>(std::move(
-            JitHelper::buildProgram("DEMCollectForceKernels", JitHelper::KERNEL_DIR / "DEMCollectForceKernels.cu", Subs,
-                                    {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
-    }
-    // Then integration kernels
-    {
-        integrator_kernels = std::make_shared<jitify::Program>(std::move(
-            JitHelper::buildProgram("DEMIntegrationKernels", JitHelper::KERNEL_DIR / "DEMIntegrationKernels.cu", Subs,
-                                    {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+void DEMDynamicThread::jitifyKernels(const std::unordered_map<std::string, std::string>& Subs,
+                                     const std::shared_ptr<JitDiskCache>& disk_cache) {
+    // If the per-step work is done by host threads, then the force and integration kernels are compiled as host code
+    if (solverFlags.useHostDynamics) {
+        jitifyHostKernels(Subs, disk_cache);
+    } else {
+        // First one is force array preparation kernels
+        {
+            prep_force_kernels = std::make_shared<JitProgram>(std::move(
+                JitHelper::buildProgram("DEMPrepForceKernels", JitHelper::KERNEL_DIR / "DEMPrepForceKernels.cu", Subs,
+                                        {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
+        }
+        // Then force calculation kernels
+        {
+            cal_force_kernels = std::make_shared<JitProgram>(std::move(
+                JitHelper::buildProgram("DEMCalcForceKernels", JitHelper::KERNEL_DIR / "DEMCalcForceKernels.cu", Subs,
+                                        {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
+        }
+        // Then force accumulation kernels
+        {
+            collect_force_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
+                "DEMCollectForceKernels", JitHelper::KERNEL_DIR / "DEMCollectForceKernels.cu", Subs,
+                {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
+        }
+        // Then integration kernels
+        {
+            integrator_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
+                "DEMIntegrationKernels", JitHelper::KERNEL_DIR / "DEMIntegrationKernels.cu", Subs,
+                {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
+        }
     }
     // Then kernels that are... wildcards, which make on-the-fly changes to solver data
-    if (solverFlags.canFamilyChange) {
-        mod_kernels = std::make_shared<jitify::Program>(
+    if (solverFlags.canFamilyChange && !solverFlags.useHostDynamics) {
+        mod_kernels = std::make_shared<JitProgram>(
             std::move(JitHelper::buildProgram("DEMModeratorKernels", JitHelper::KERNEL_DIR / "DEMModeratorKernels.cu",
-                                              Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+                                              Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
     }
     // Then misc kernels
     {
-        misc_kernels = std::make_shared<jitify::Program>(
+        misc_kernels = std::make_shared<JitProgram>(
             std::move(JitHelper::buildProgram("DEMMiscKernels", JitHelper::KERNEL_DIR / "DEMMiscKernels.cu", Subs,
-                                              {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+                                              {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
+    }
+}
+
+void DEMDynamicThread::jitifyHostKernels(const std::unordered_map<std::string, std::string>& Subs,
+                                         const std::shared_ptr<JitDiskCache>& disk_cache) {
+    host_prep_force_kernels = std::make_shared<HostJitProgram>(HostJitHelper::buildProgram(
+        "DEMPrepForceKernels", JitHelper::KERNEL_DIR / "DEMPrepForceKernels.cu", Subs, {}, disk_cache));
+    host_cal_force_kernels = std::make_shared<HostJitProgram>(HostJitHelper::buildProgram(
+        "DEMCalcForceKernels", JitHelper::KERNEL_DIR / "DEMCalcForceKernels.cu", Subs, {}, disk_cache));
+    host_collect_force_kernels = std::make_shared<HostJitProgram>(HostJitHelper::buildProgram(
+        "DEMCollectForceKernels", JitHelper::KERNEL_DIR / "DEMCollectForceKernels.cu", Subs, {}, disk_cache));
+    host_integrator_kernels = std::make_shared<HostJitProgram>(HostJitHelper::buildProgram(
+        "DEMIntegrationKernels", JitHelper::KERNEL_DIR / "DEMIntegrationKernels.cu", Subs, {}, disk_cache));
+    if (solverFlags.canFamilyChange) {
+        host_mod_kernels = std::make_shared<HostJitProgram>(HostJitHelper::buildProgram(
+            "DEMModeratorKernels", JitHelper::KERNEL_DIR / "DEMModeratorKernels.cu", Subs, {}, disk_cache));
     }
 }
 
-float* DEMDynamicThread::inspectCall(const std::shared_ptr<jitify::Program>& inspection_kernel,
+float* DEMDynamicThread::inspectCall(const std::shared_ptr<JitProgram>& inspection_kernel,
                                      const std::string& kernel_name,
                                      size_t n,
                                      CUB_REDUCE_FLAVOR reduce_flavor,
@@ -1720,6 +2701,7 @@ float* DEMDynamicThread::inspectCall(const std::shared_ptr<jitify::Program>& ins
 }
 
 float3 DEMDynamicThread::getOwnerAngVel(bodyID_t ownerID) const {
+    ownerID = ownerInternalID(ownerID);
     float3 angVel;
     angVel.x = omgBarX.at(ownerID);
     angVel.y = omgBarY.at(ownerID);
@@ -1728,6 +2710,7 @@ float3 DEMDynamicThread::getOwnerAngVel(bodyID_t ownerID) const {
 }
 
 float4 DEMDynamicThread::getOwnerOriQ(bodyID_t ownerID) const {
+    ownerID = ownerInternalID(ownerID);
     float4 oriQ;
     oriQ.w = oriQw.at(ownerID);
     oriQ.x = oriQx.at(ownerID);
@@ -1737,6 +2720,7 @@ float4 DEMDynamicThread::getOwnerOriQ(bodyID_t ownerID) const {
 }
 
 float3 DEMDynamicThread::getOwnerAcc(bodyID_t ownerID) const {
+    ownerID = ownerInternalID(ownerID);
     float3 acc;
     acc.x = aX.at(ownerID);
     acc.y = aY.at(ownerID);
@@ -1745,6 +2729,7 @@ float3 DEMDynamicThread::getOwnerAcc(bodyID_t ownerID) const {
 }
 
 float3 DEMDynamicThread::getOwnerAngAcc(bodyID_t ownerID) const {
+    ownerID = ownerInternalID(ownerID);
     float3 aa;
     aa.x = alphaX.at(ownerID);
     aa.y = alphaY.at(ownerID);
@@ -1753,6 +2738,7 @@ float3 DEMDynamicThread::getOwnerAngAcc(bodyID_t ownerID) const {
 }
 
 float3 DEMDynamicThread::getOwnerVel(bodyID_t ownerID) const {
+    ownerID = ownerInternalID(ownerID);
     float3 vel;
     vel.x = vX.at(ownerID);
     vel.y = vY.at(ownerID);
@@ -1761,6 +2747,7 @@ float3 DEMDynamicThread::getOwnerVel(bodyID_t ownerID) const {
 }
 
 float3 DEMDynamicThread::getOwnerPos(bodyID_t ownerID) const {
+    ownerID = ownerInternalID(ownerID);
     float3 pos;
     double X, Y, Z;
     voxelID_t voxel = voxelID.at(ownerID);
@@ -1776,12 +2763,14 @@ float3 DEMDynamicThread::getOwnerPos(bodyID_t ownerID) const {
 }
 
 void DEMDynamicThread::setOwnerAngVel(bodyID_t ownerID, float3 angVel) {
+    ownerID = ownerInternalID(ownerID);
     omgBarX.at(ownerID) = angVel.x;
     omgBarY.at(ownerID) = angVel.y;
     omgBarZ.at(ownerID) = angVel.z;
 }
 
 void DEMDynamicThread::setOwnerPos(bodyID_t ownerID, float3 pos) {
+    ownerID = ownerInternalID(ownerID);
     // Convert to relative pos wrt LBF point first
     double X, Y, Z;
     X = pos.x - simParams->LBFX;
@@ -1793,6 +2782,7 @@ void DEMDynamicThread::setOwnerPos(bodyID_t ownerID, float3 pos) {
 }
 
 void DEMDynamicThread::setOwnerOriQ(bodyID_t ownerID, float4 oriQ) {
+    ownerID = ownerInternalID(ownerID);
     oriQw.at(ownerID) = oriQ.w;
     oriQx.at(ownerID) = oriQ.x;
     oriQy.at(ownerID) = oriQ.y;
@@ -1800,6 +2790,7 @@ void DEMDynamicThread::setOwnerOriQ(bodyID_t ownerID, float4 oriQ) {
 }
 
 void DEMDynamicThread::setOwnerVel(bodyID_t ownerID, float3 vel) {
+    ownerID = ownerInternalID(ownerID);
     vX.at(ownerID) = vel.x;
     vY.at(ownerID) = vel.y;
     vZ.at(ownerID) = vel.z;
@@ -22,13 +22,14 @@
 #include <DEM/BdrsAndObjs.h>
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
+#include <DEM/SnapshotIO.h>
 
 // #include <core/utils/JitHelper.h>
 
-// Forward declare jitify::Program to avoid downstream dependency
-namespace jitify {
-class Program;
-}
+// Forward declare JitProgram to avoid downstream dependency (on jitify)
+class JitProgram;
+class JitDiskCache;
+class HostJitProgram;
 
 namespace deme {
 
@@ -53,15 +54,13 @@ class DEMDynamicThread {
     // The std::thread that binds to this instance
     std::thread th;
 
-    // Number of items in the buffer array (which is not a managed vector, due to our need to explicitly control where
-    // it is allocated)
-    size_t buffer_size;
-
     // Object which stores the device and stream IDs for this thread
     GpuManager::StreamInfo streamInfo;
 
-    // A class that contains scratch pad and system status data (constructed with the number of temp arrays we need)
-    DEMSolverStateData stateOfSolver_resources = DEMSolverStateData(7);
+    // A class that contains scratch pad and system status data (constructed with the number of temp arrays we need).
+    // Temp vectors 0 and 7 hold force collection's owner IDs and owner-to-contact CSR, which live on until kT sends a
+    // new contact pair array, so nothing else should use them.
+    DEMSolverStateData stateOfSolver_resources = DEMSolverStateData(8);
 
     // The number of for iterations dT does for a specific user "run simulation" call
     double cycleDuration;
@@ -70,10 +69,15 @@ class DEMDynamicThread {
     // kT modifies these arrays; dT uses them only.
 
     // dT gets contact pair/location/history map info from kT
-    // std::vector<bodyID_t, ManagedAllocator<bodyID_t>> idGeometryA_buffer;
-    // std::vector<bodyID_t, ManagedAllocator<bodyID_t>> idGeometryB_buffer;
-    // std::vector<contact_t, ManagedAllocator<contact_t>> contactType_buffer;
-    // std::vector<contactPairs_t, ManagedAllocator<contactPairs_t>> contactMapping_buffer;
+    std::vector<bodyID_t, ManagedAllocator<bodyID_t>> idGeometryA_buffer;
+    std::vector<bodyID_t, ManagedAllocator<bodyID_t>> idGeometryB_buffer;
+    std::vector<contact_t, ManagedAllocator<contact_t>> contactType_buffer;
+    std::vector<contactPairs_t, ManagedAllocator<contactPairs_t>> contactMapping_buffer;
+
+    // If kT and dT share a device, the buffers are exchanged with the work arrays by swapping them, not copying them
+    bool swapTransferBuffers = false;
+    // Friend system DEMKinematicThread
+    DEMKinematicThread* kT = NULL;
 
     // Pointers to simulation params-related arrays
     DEMSimParams* simParams;
@@ -175,11 +179,31 @@ class DEMDynamicThread {
     std::vector<float, ManagedAllocator<float>> alphaY;
     std::vector<float, ManagedAllocator<float>> alphaZ;
 
+    // Owner positions and orientations that the contact list in use was detected with, used to measure how far the
+    // owners moved since (only allocated in displacement-triggered contact detection)
+    std::vector<voxelID_t, ManagedAllocator<voxelID_t>> voxelID_cdRef;
+    std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locX_cdRef;
+    std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locY_cdRef;
+    std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locZ_cdRef;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQw_cdRef;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQx_cdRef;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQy_cdRef;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQz_cdRef;
+    // How far the geometry of each owner reaches from its CoM, which bounds how far a rotation moves its components
+    std::vector<float, ManagedAllocator<float>> ownerCDReach;
+
+    // Owner sleep states (bits of SLEEP_*), the number of quiet steps in a row, and the acceleration in the previous
+    // step that tells whether the forces on an owner change (only used if clumps can sleep)
+    std::vector<sleepState_t, ManagedAllocator<sleepState_t>> ownerSleepState;
+    std::vector<unsigned int, ManagedAllocator<unsigned int>> ownerQuietSteps;
+    std::vector<float3, ManagedAllocator<float3>> ownerPrevAcc;
+
     // Contact pair/location, for dT's personal use!!
     std::vector<bodyID_t, ManagedAllocator<bodyID_t>> idGeometryA;
     std::vector<bodyID_t, ManagedAllocator<bodyID_t>> idGeometryB;
     std::vector<contact_t, ManagedAllocator<contact_t>> contactType;
-    // std::vector<contactPairs_t, ManagedAllocator<contactPairs_t>> contactMapping;
+    // The contact mapping kT sent along with the contact pairs (only kept here when the buffers are swapped)
+    std::vector<contactPairs_t, ManagedAllocator<contactPairs_t>> contactMapping;
 
     // Some of dT's own work arrays
     // Force of each contact event. It is the force that bodyA feels.
@@ -221,12 +245,51 @@ class DEMDynamicThread {
     // freshly obtained from kT.
     bool contactPairArr_isFresh = true;
 
+    // Displacement-triggered contact detection bookkeeping. The max owner displacement since the contact list in use
+    // was detected
+    float maxDispSinceCD = 0.f;
+    // The expand factor that the contact list in use, and the one kT is working on, are detected with
+    float cdListExpandFactor = 0.f;
+    float cdOrderExpandFactor = 0.f;
+    // Number of steps since the owner positions of the contact list in use, and of the order kT is working on, were
+    // sent
+    uint64_t nStepsOnCDList = 0;
+    uint64_t nStepsOnCDOrder = 0;
+    // If kT is working on an order whose contact list dT has not received yet
+    bool cdOrderOutstanding = false;
+    // If the contact list in use, and the one kT is working on, were ordered after the last time owners were added
+    bool cdListIsValid = false;
+    bool cdOrderIsValid = false;
+    // Running average of the number of steps kT takes to deliver an order (negative if not measured yet)
+    double cdOrderLatency = -1.;
+    // Since the expand factor (or the update frequency) was last chosen: the number of steps, the number of contact
+    // lists received, the number of times dT was held back by the update frequency and the max per-step owner
+    // displacement rate (displacement-triggered CD only)
+    uint64_t nStepsSinceExpandTune = 0;
+    uint64_t nListsSinceExpandTune = 0;
+    uint64_t nHeldBackSinceExpandTune = 0;
+    float cdMaxDispPerStep = 0.f;
+    // If ownerCDReach needs to be re-computed, because owners are added or changed
+    bool ownerCDReach_isStale = true;
+    // The max point velocity and the max contact overlap (over the smaller radius) in the last step, which the
+    // variable step size goes by
+    float maxPointVel = 0.f;
+    float maxContactOverlap = 0.f;
+
     // Template-related arrays in managed memory
     // Belonged-body ID
     std::vector<bodyID_t, ManagedAllocator<bodyID_t>> ownerClumpBody;
     std::vector<bodyID_t, ManagedAllocator<bodyID_t>> ownerMesh;
     std::vector<bodyID_t> ownerAnalBody;
 
+    // The public owner and sphere IDs (the ones trackers and output use) do not change when owners and spheres are
+    // rearranged in memory; these map them to and from where the owners and spheres are. They are empty if nothing was
+    // ever rearranged, meaning the public IDs are where the owners and spheres are.
+    std::vector<bodyID_t> ownerPublicToInternal;
+    std::vector<bodyID_t> ownerInternalToPublic;
+    std::vector<bodyID_t> spherePublicToInternal;
+    std::vector<bodyID_t> sphereInternalToPublic;
+
     // The ID that maps this sphere component's geometry-defining parameters, when this component is jitified
     std::vector<clumpComponentOffset_t, ManagedAllocator<clumpComponentOffset_t>> clumpComponentOffset;
     // The ID that maps this sphere component's geometry-defining parameters, when this component is not jitified (too
@@ -332,6 +395,49 @@ class DEMDynamicThread {
     /// Set this owner's velocity
     void setOwnerVel(bodyID_t ownerID, float3 vel);
 
+    /// Where the owner with this public ID is in the owner arrays, and the other way around
+    bodyID_t ownerInternalID(bodyID_t ID) const {
+        return ownerPublicToInternal.empty() ? ID : ownerPublicToInternal[ID];
+    }
+    bodyID_t ownerPublicID(bodyID_t ID) const {
+        return ownerInternalToPublic.empty() ? ID : ownerInternalToPublic[ID];
+    }
+    /// Where the sphere with this public ID is in the sphere arrays, and the other way around
+    bodyID_t sphereInternalID(bodyID_t ID) const {
+        return spherePublicToInternal.empty() ? ID : spherePublicToInternal[ID];
+    }
+    bodyID_t spherePublicID(bodyID_t ID) const {
+        return sphereInternalToPublic.empty() ? ID : sphereInternalToPublic[ID];
+    }
+
+    /// Find the order that puts clumps along a Morton curve of their voxels, with each clump's spheres following it.
+    /// Both orders are given as new-to-old maps.
+    void computeSpatialOrder(std::vector<bodyID_t>& ownerNewToOld, std::vector<bodyID_t>& sphereNewToOld);
+    /// Rearrange the owner, sphere and contact arrays in this order. kT and dT must both be idle.
+    void applySpatialOrder(const std::vector<bodyID_t>& ownerNewToOld, const std::vector<bodyID_t>& sphereNewToOld);
+    /// Find the owners and spheres that stay when the clumps of this (user-level) family are removed, given as
+    /// new-to-old maps
+    void computePurgeOrder(unsigned int family_num,
+                           std::vector<bodyID_t>& ownerNewToOld,
+                           std::vector<bodyID_t>& sphereNewToOld);
+    /// Keep only these owners and spheres, and the contacts among them, and shrink the arrays. ownerPublicOldToNew gets
+    /// the new public ID of each old one (NULL_BODYID for removed owners). kT and dT must both be idle.
+    void applyPurge(const std::vector<bodyID_t>& ownerNewToOld,
+                    const std::vector<bodyID_t>& sphereNewToOld,
+                    std::vector<bodyID_t>& ownerPublicOldToNew);
+    /// Find the staged clumps that are too close to an existing sphere, or to an earlier staged clump that is kept, to
+    /// be inserted. The staged spheres are given by their positions relative to the LBF corner of the world and the
+    /// (0-based) staged clump they belong to, with the spheres of a clump next to each other; clumpRejected has an
+    /// element per staged clump, and those of the rejected ones are set to 1. dT must be idle.
+    void markInflowOverlaps(const std::vector<float3>& sphPos,
+                            const std::vector<float>& sphRadius,
+                            const std::vector<size_t>& sphClump,
+                            float clearance,
+                            std::vector<notStupidBool_t>& clumpRejected);
+
+    /// The number of sleeping clumps
+    size_t getNumSleepingClumps() const;
+
     /// Change all entities with (user-level) family number ID_from to have a new number ID_to
     void changeFamily(unsigned int ID_from, unsigned int ID_to);
 
@@ -348,6 +454,10 @@ class DEMDynamicThread {
                                unsigned int nClumpComponents,
                                unsigned int nJitifiableClumpComponents,
                                unsigned int nMatTuples);
+    /// Resize the arrays that have an element per owner or per sphere, and set the numbers of those
+    void resizeEntityArrays(size_t nOwnerBodies, size_t nOwnerClumps, size_t nSpheresGM);
+    /// Whether the arrays that have an element per owner or per sphere can grow to these lengths without reallocating
+    bool entityArraysHaveRoom(size_t nOwnerBodies, size_t nSpheresGM) const;
 
     // Components of initManagedArrays
     void buildTrackedObjs(const std::vector<std::shared_ptr<DEMClumpBatch>>& input_clump_batches,
@@ -442,11 +552,14 @@ class DEMDynamicThread {
     void packDataPointers();
     void packTransferPointers(DEMKinematicThread*& kT);
 
-    void writeSpheresAsChpf(std::ofstream& ptFile) const;
-    void writeSpheresAsCsv(std::ofstream& ptFile) const;
-    void writeClumpsAsChpf(std::ofstream& ptFile) const;
-    void writeClumpsAsCsv(std::ofstream& ptFile) const;
-    void writeContactsAsCsv(std::ofstream& ptFile) const;
+    /// Collect the spheres, the clumps, or the contacts into a snapshot (see DEMSnapshot) with the columns that the
+    /// output content flags ask for. The snapshot is a host-side copy, so it can be formatted and written while the
+    /// simulation goes on.
+    void makeSphereSnapshot(DEMSnapshot& snap) const;
+    /// If native, clump positions are written as they are stored (voxel ID and sub-voxel positions) and quaternions
+    /// are quantized to quatBits bits (see DecodeNativeSnapshot)
+    void makeClumpSnapshot(DEMSnapshot& snap, bool native = false, unsigned int quatBits = 32) const;
+    void makeContactSnapshot(DEMSnapshot& snap) const;
 
     /// Called each time when the user calls DoDynamicsThenSync.
     void startThread();
@@ -471,10 +584,14 @@ class DEMDynamicThread {
     }
 
     // Jitify dT kernels (at initialization) based on existing knowledge of this run
-    void jitifyKernels(const std::unordered_map<std::string, std::string>& Subs);
+    void jitifyKernels(const std::unordered_map<std::string, std::string>& Subs,
+                       const std::shared_ptr<JitDiskCache>& disk_cache);
+    // Compile the force and integration kernels as host code, for doing dT's per-step work on host threads
+    void jitifyHostKernels(const std::unordered_map<std::string, std::string>& Subs,
+                           const std::shared_ptr<JitDiskCache>& disk_cache);
 
     // Execute this kernel, then return the reduced value
-    float* inspectCall(const std::shared_ptr<jitify::Program>& inspection_kernel,
+    float* inspectCall(const std::shared_ptr<JitProgram>& inspection_kernel,
                        const std::string& kernel_name,
                        size_t n,
                        CUB_REDUCE_FLAVOR reduce_flavor,
@@ -492,12 +609,42 @@ class DEMDynamicThread {
 
     // Update clump-based acceleration array based on sphere-based force array
     inline void calculateForces();
+    // Host (CPU) version of calculateForces, using host-compiled kernels
+    inline void hostCalculateForces();
 
     // Update clump pos/oriQ and vel/omega based on acceleration
     inline void integrateOwnerMotions();
+    // Put quiet clumps to sleep, and wake up the sleeping ones that are disturbed
+    inline void updateSleepStates();
 
     // If kT provides fresh CD results, we unpack and use it
     inline void ifProduceFreshThenUseItAndSendNewOrder();
+    // Fill kT's buffer with a new work order and notify kT
+    inline void sendNewOrder();
+
+    // Add the owner-level columns (velocities, family...) that the output content flags ask for to a snapshot whose row
+    // k is of owner rowOwners[k]
+    void addOwnerSnapshotColumns(DEMSnapshot& snap, const std::vector<bodyID_t>& rowOwners) const;
+
+    // Compute how far the geometry of each owner reaches from its CoM
+    void computeOwnerCDReach();
+    // If ownerCDReach is in use, for displacement-triggered CD or for the variable step size
+    bool needsOwnerCDReach() const { return solverFlags.useDisplacementTriggeredCD || !solverFlags.isStepConst; }
+    // Update maxPointVel, the max velocity of any point of any owner
+    inline void updateMaxPointVel();
+    // Update maxContactOverlap, the max overlap of any contact over its smaller radius
+    inline void updateMaxContactOverlap();
+    // Choose the size of the next step, if the step size is variable
+    inline void chooseStepSize();
+    // Update maxDispSinceCD, the max owner displacement since the contact list in use was detected
+    inline void updateDisplacementSinceCD();
+    // If the contact list in use can no longer be trusted to contain all the contacts
+    inline bool contactListIsStale() const;
+    // Send kT a new work order if, by the time it is delivered, the owners are expected to have moved too much for the
+    // contact list in use
+    inline void ifDisplacedThenSendNewOrder();
+    // Wait for kT to deliver a new contact list if the owners have moved too much for the one in use
+    inline void ifDisplacedTooMuchThenWait();
 
     // Some per-step checks/modification, done before integration, but after force calculation (thus sort of in the
     // mid-step stage)
@@ -509,15 +656,23 @@ class DEMDynamicThread {
     void sendToTheirBuffer();
     // Resize some work arrays based on the number of contact pairs provided by kT
     void contactEventArraysResize(size_t nContactPairs);
+    // Swap the contact buffers kT filled with the work arrays, and point both threads to where they now are
+    inline void swapContactBuffers();
 
     // Just-in-time compiled kernels
-    std::shared_ptr<jitify::Program> prep_force_kernels;
-    std::shared_ptr<jitify::Program> cal_force_kernels;
-    std::shared_ptr<jitify::Program> collect_force_kernels;
-    std::shared_ptr<jitify::Program> integrator_kernels;
-    // std::shared_ptr<jitify::Program> quarry_stats_kernels;
-    std::shared_ptr<jitify::Program> mod_kernels;
-    std::shared_ptr<jitify::Program> misc_kernels;
+    std::shared_ptr<JitProgram> prep_force_kernels;
+    std::shared_ptr<JitProgram> cal_force_kernels;
+    std::shared_ptr<JitProgram> collect_force_kernels;
+    std::shared_ptr<JitProgram> integrator_kernels;
+    // std::shared_ptr<JitProgram> quarry_stats_kernels;
+    std::shared_ptr<JitProgram> mod_kernels;
+    std::shared_ptr<JitProgram> misc_kernels;
+    // The same force and integration kernels, compiled as host code (used if dT works on host threads)
+    std::shared_ptr<HostJitProgram> host_prep_force_kernels;
+    std::shared_ptr<HostJitProgram> host_cal_force_kernels;
+    std::shared_ptr<HostJitProgram> host_collect_force_kernels;
+    std::shared_ptr<HostJitProgram> host_integrator_kernels;
+    std::shared_ptr<HostJitProgram> host_mod_kernels;
 };  // dT ends
 
 }  // namespace deme
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <iostream>
 #include <thread>
+#include <algorithm>
 
 #include <core/ApiVersion.h>
 #include <core/utils/JitHelper.h>
@@ -15,68 +16,145 @@
 #include <DEM/Defines.h>
 
 #include <algorithms/DEMCubBasedSubroutines.h>
+#include <algorithms/DEMHostBasedSubroutines.h>
 
 namespace deme {
 
 inline void DEMKinematicThread::transferArraysResize(size_t nContactPairs) {
     // TODO: This memory usage is not tracked... How can I track the size changes on my friend's end??
-    // dT->idGeometryA_buffer.resize(nContactPairs);
-    // dT->idGeometryB_buffer.resize(nContactPairs);
-    // dT->contactType_buffer.resize(nContactPairs);
-    // DEME_ADVISE_DEVICE(dT->idGeometryA_buffer, dT->streamInfo.device);
-    // DEME_ADVISE_DEVICE(dT->idGeometryB_buffer, dT->streamInfo.device);
-    // DEME_ADVISE_DEVICE(dT->contactType_buffer, dT->streamInfo.device);
-
     // These buffers are on dT
-    GPU_CALL(cudaSetDevice(dT->streamInfo.device));
-    dT->buffer_size = nContactPairs;
-    DEME_DEVICE_PTR_ALLOC(dT->granData->idGeometryA_buffer, nContactPairs);
-    DEME_DEVICE_PTR_ALLOC(dT->granData->idGeometryB_buffer, nContactPairs);
-    DEME_DEVICE_PTR_ALLOC(dT->granData->contactType_buffer, nContactPairs);
+    dT->idGeometryA_buffer.resize(nContactPairs);
+    dT->idGeometryB_buffer.resize(nContactPairs);
+    dT->contactType_buffer.resize(nContactPairs);
+    advise(dT->idGeometryA_buffer.data(), nContactPairs, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(dT->idGeometryB_buffer.data(), nContactPairs, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(dT->contactType_buffer.data(), nContactPairs, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    dT->granData->idGeometryA_buffer = dT->idGeometryA_buffer.data();
+    dT->granData->idGeometryB_buffer = dT->idGeometryB_buffer.data();
+    dT->granData->contactType_buffer = dT->contactType_buffer.data();
     granData->pDTOwnedBuffer_idGeometryA = dT->granData->idGeometryA_buffer;
     granData->pDTOwnedBuffer_idGeometryB = dT->granData->idGeometryB_buffer;
     granData->pDTOwnedBuffer_contactType = dT->granData->contactType_buffer;
 
     if (!solverFlags.isHistoryless) {
-        // dT->contactMapping_buffer.resize(nContactPairs);
-        // DEME_ADVISE_DEVICE(dT->contactMapping_buffer, dT->streamInfo.device);
-        DEME_DEVICE_PTR_ALLOC(dT->granData->contactMapping_buffer, nContactPairs);
+        dT->contactMapping_buffer.resize(nContactPairs);
+        advise(dT->contactMapping_buffer.data(), nContactPairs, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+        dT->granData->contactMapping_buffer = dT->contactMapping_buffer.data();
         granData->pDTOwnedBuffer_contactMapping = dT->granData->contactMapping_buffer;
     }
-    // Unset the device change we just made
-    GPU_CALL(cudaSetDevice(streamInfo.device));
 }
 
-inline void DEMKinematicThread::unpackMyBuffer() {
-    GPU_CALL(cudaMemcpy(granData->voxelID, granData->voxelID_buffer, simParams->nOwnerBodies * sizeof(voxelID_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->locX, granData->locX_buffer, simParams->nOwnerBodies * sizeof(subVoxelPos_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->locY, granData->locY_buffer, simParams->nOwnerBodies * sizeof(subVoxelPos_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->locZ, granData->locZ_buffer, simParams->nOwnerBodies * sizeof(subVoxelPos_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->oriQw, granData->oriQ0_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->oriQx, granData->oriQ1_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->oriQy, granData->oriQ2_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
-                        cudaMemcpyDeviceToDevice));
-    GPU_CALL(cudaMemcpy(granData->oriQz, granData->oriQ3_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
-                        cudaMemcpyDeviceToDevice));
-
-    // Family number is a typical changable quantity on-the-fly. If this flag is on, kT received changes from dT.
+inline void DEMKinematicThread::swapOwnerBuffers() {
+    voxelID.swap(voxelID_buffer);
+    locX.swap(locX_buffer);
+    locY.swap(locY_buffer);
+    locZ.swap(locZ_buffer);
+    oriQw.swap(oriQ0_buffer);
+    oriQx.swap(oriQ1_buffer);
+    oriQy.swap(oriQ2_buffer);
+    oriQz.swap(oriQ3_buffer);
+    granData->voxelID = voxelID.data();
+    granData->locX = locX.data();
+    granData->locY = locY.data();
+    granData->locZ = locZ.data();
+    granData->oriQw = oriQw.data();
+    granData->oriQx = oriQx.data();
+    granData->oriQy = oriQy.data();
+    granData->oriQz = oriQz.data();
+    granData->voxelID_buffer = voxelID_buffer.data();
+    granData->locX_buffer = locX_buffer.data();
+    granData->locY_buffer = locY_buffer.data();
+    granData->locZ_buffer = locZ_buffer.data();
+    granData->oriQ0_buffer = oriQ0_buffer.data();
+    granData->oriQ1_buffer = oriQ1_buffer.data();
+    granData->oriQ2_buffer = oriQ2_buffer.data();
+    granData->oriQ3_buffer = oriQ3_buffer.data();
     if (solverFlags.canFamilyChange) {
-        GPU_CALL(cudaMemcpy(granData->familyID, granData->familyID_buffer, simParams->nOwnerBodies * sizeof(family_t),
+        familyID.swap(familyID_buffer);
+        granData->familyID = familyID.data();
+        granData->familyID_buffer = familyID_buffer.data();
+    }
+
+    // dT writes its next work order into what used to be our work arrays. It only does so while holding the same lock
+    // we are holding now, so it always sees the new pointers.
+    dT->granData->pKTOwnedBuffer_voxelID = granData->voxelID_buffer;
+    dT->granData->pKTOwnedBuffer_locX = granData->locX_buffer;
+    dT->granData->pKTOwnedBuffer_locY = granData->locY_buffer;
+    dT->granData->pKTOwnedBuffer_locZ = granData->locZ_buffer;
+    dT->granData->pKTOwnedBuffer_oriQ0 = granData->oriQ0_buffer;
+    dT->granData->pKTOwnedBuffer_oriQ1 = granData->oriQ1_buffer;
+    dT->granData->pKTOwnedBuffer_oriQ2 = granData->oriQ2_buffer;
+    dT->granData->pKTOwnedBuffer_oriQ3 = granData->oriQ3_buffer;
+    dT->granData->pKTOwnedBuffer_familyID = granData->familyID_buffer;
+}
+
+inline void DEMKinematicThread::swapContactBuffers() {
+    idGeometryA.swap(dT->idGeometryA_buffer);
+    idGeometryB.swap(dT->idGeometryB_buffer);
+    contactType.swap(dT->contactType_buffer);
+    granData->idGeometryA = idGeometryA.data();
+    granData->idGeometryB = idGeometryB.data();
+    granData->contactType = contactType.data();
+    dT->granData->idGeometryA_buffer = dT->idGeometryA_buffer.data();
+    dT->granData->idGeometryB_buffer = dT->idGeometryB_buffer.data();
+    dT->granData->contactType_buffer = dT->contactType_buffer.data();
+    granData->pDTOwnedBuffer_idGeometryA = dT->granData->idGeometryA_buffer;
+    granData->pDTOwnedBuffer_idGeometryB = dT->granData->idGeometryB_buffer;
+    granData->pDTOwnedBuffer_contactType = dT->granData->contactType_buffer;
+    if (!solverFlags.isHistoryless) {
+        contactMapping.swap(dT->contactMapping_buffer);
+        granData->contactMapping = contactMapping.data();
+        dT->granData->contactMapping_buffer = dT->contactMapping_buffer.data();
+        granData->pDTOwnedBuffer_contactMapping = dT->granData->contactMapping_buffer;
+    }
+}
+
+inline void DEMKinematicThread::unpackMyBuffer() {
+    if (swapTransferBuffers) {
+        // The buffers hold the latest work order in full, so they just become the work arrays
+        swapOwnerBuffers();
+    } else {
+        GPU_CALL(cudaMemcpy(granData->voxelID, granData->voxelID_buffer, simParams->nOwnerBodies * sizeof(voxelID_t),
                             cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->locX, granData->locX_buffer, simParams->nOwnerBodies * sizeof(subVoxelPos_t),
+                            cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->locY, granData->locY_buffer, simParams->nOwnerBodies * sizeof(subVoxelPos_t),
+                            cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->locZ, granData->locZ_buffer, simParams->nOwnerBodies * sizeof(subVoxelPos_t),
+                            cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQw, granData->oriQ0_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
+                            cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQx, granData->oriQ1_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
+                            cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQy, granData->oriQ2_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
+                            cudaMemcpyDeviceToDevice));
+        GPU_CALL(cudaMemcpy(granData->oriQz, granData->oriQ3_buffer, simParams->nOwnerBodies * sizeof(oriQ_t),
+                            cudaMemcpyDeviceToDevice));
+
+        // Family number is a typical changable quantity on-the-fly. If this flag is on, kT received changes from dT.
+        if (solverFlags.canFamilyChange) {
+            GPU_CALL(cudaMemcpy(granData->familyID, granData->familyID_buffer,
+                                simParams->nOwnerBodies * sizeof(family_t), cudaMemcpyDeviceToDevice));
+        }
     }
+
+    // The expand factor this order should be processed with (it may be re-chosen between orders)
+    GPU_CALL(cudaMemcpy(&(simParams->beta), &(granData->beta_buffer), sizeof(float), cudaMemcpyDeviceToDevice));
 }
 
 inline void DEMKinematicThread::sendToTheirBuffer() {
     GPU_CALL(cudaMemcpy(granData->pDTOwnedBuffer_nContactPairs, stateOfSolver_resources.pNumContacts, sizeof(size_t),
                         cudaMemcpyDeviceToDevice));
+    if (swapTransferBuffers) {
+        // The contact arrays are not needed until the next CD, which writes them anew, so hand them over as they are.
+        // What we get back is either what dT last worked with (it swapped it out when unpacking) or an older produce
+        // dT never picked up; either way, dT is done with it.
+        swapContactBuffers();
+        return;
+    }
+
     // Resize dT owned buffers before usage
-    if (*stateOfSolver_resources.pNumContacts > dT->buffer_size) {
+    if (*stateOfSolver_resources.pNumContacts > dT->idGeometryA_buffer.size()) {
         transferArraysResize(*stateOfSolver_resources.pNumContacts);
     }
 
@@ -86,16 +164,11 @@ inline void DEMKinematicThread::sendToTheirBuffer() {
                         (*stateOfSolver_resources.pNumContacts) * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
     GPU_CALL(cudaMemcpy(granData->pDTOwnedBuffer_contactType, granData->contactType,
                         (*stateOfSolver_resources.pNumContacts) * sizeof(contact_t), cudaMemcpyDeviceToDevice));
-    // DEME_MIGRATE_TO_DEVICE(dT->idGeometryA_buffer, dT->streamInfo.device, streamInfo.stream);
-    // DEME_MIGRATE_TO_DEVICE(dT->idGeometryB_buffer, dT->streamInfo.device, streamInfo.stream);
-    // DEME_MIGRATE_TO_DEVICE(dT->contactType_buffer, dT->streamInfo.device, streamInfo.stream);
     if (!solverFlags.isHistoryless) {
         GPU_CALL(cudaMemcpy(granData->pDTOwnedBuffer_contactMapping, granData->contactMapping,
                             (*stateOfSolver_resources.pNumContacts) * sizeof(contactPairs_t),
                             cudaMemcpyDeviceToDevice));
-        // DEME_MIGRATE_TO_DEVICE(dT->contactMapping_buffer, dT->streamInfo.device, streamInfo.stream);
     }
-    // GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
 }
 
 void DEMKinematicThread::workerThread() {
@@ -121,17 +194,13 @@ void DEMKinematicThread::workerThread() {
         // via memcpy
         while (!pSchedSupport->dynamicDone) {
             // Before producing something, a new work order should be in place. Wait on it.
-            if (!pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh) {
+            if (!pSchedSupport->kinematicOwned_Cons2ProdBuffer.isFresh()) {
                 timers.GetTimer("Wait for dT update").start();
                 pSchedSupport->schedulingStats.nTimesKinematicHeldBack++;
-                std::unique_lock<std::mutex> lock(pSchedSupport->kinematicCanProceed);
 
-                // kT never got locked in here indefinitely because, dT will always send a cv_KinematicCanProceed signal
-                // AFTER setting dynamicDone to true, if dT is about to finish
-                while (!pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh) {
-                    // Loop to avoid spurious wakeups
-                    pSchedSupport->cv_KinematicCanProceed.wait(lock);
-                }
+                // kT never got locked in here indefinitely because, when kT is to quit waiting, breakWaitingStatus
+                // publishes an (empty) order AFTER setting dynamicDone to true
+                pSchedSupport->kinematicOwned_Cons2ProdBuffer.waitForFresh(pSchedSupport->handoffBackoff);
                 timers.GetTimer("Wait for dT update").stop();
 
                 // In the case where this weak-up call is at the destructor (dT has been executing without notifying the
@@ -141,45 +210,57 @@ void DEMKinematicThread::workerThread() {
                 }
             }
 
+            // Owners may be added while kT waits for an order, but not while it works on one
+            std::lock_guard<std::mutex> workLock(pSchedSupport->kinematicWork_AccessCoordination);
+
             timers.GetTimer("Unpack updates from dT").start();
             // Getting here means that new `work order' data has been provided
             {
                 // Acquire lock and get the work order
                 std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
                 unpackMyBuffer();
+                // Make it clear that the data for most recent work order has been used, in case there is interest in
+                // updating it
+                pSchedSupport->kinematicOwned_Cons2ProdBuffer.consume();
                 // pSchedSupport->schedulingStats.nKinematicReceives++;
             }
             timers.GetTimer("Unpack updates from dT").stop();
 
-            // Make it clear that the data for most recent work order has been used, in case there is interest in
-            // updating it
-            pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = false;
-
             // figure out the amount of shared mem
             // cudaDeviceGetAttribute.cudaDevAttrMaxSharedMemoryPerBlock
 
             // kT's main task, contact detection
-            contactDetection(bin_occupation_kernels, contact_detection_kernels, history_kernels, granData, simParams,
-                             solverFlags, verbosity, idGeometryA, idGeometryB, contactType, previous_idGeometryA,
-                             previous_idGeometryB, previous_contactType, contactMapping, streamInfo.stream,
-                             stateOfSolver_resources, timers);
+            if (solverFlags.useHostContactDetection) {
+                hostContactDetection(granData, simParams, solverFlags, verbosity, idGeometryA, idGeometryB, contactType,
+                                     previous_idGeometryA, previous_idGeometryB, previous_contactType, contactMapping,
+                                     stateOfSolver_resources, timers);
+            } else {
+                contactDetection(bin_occupation_kernels, contact_detection_kernels, history_kernels, granData,
+                                 simParams, solverFlags, verbosity, idGeometryA, idGeometryB, contactType,
+                                 previous_idGeometryA, previous_idGeometryB, previous_contactType, contactMapping,
+                                 streamInfo.stream, stateOfSolver_resources, timers);
+            }
+            if (stateOfSolver_resources.numOverfullBins > 0) {
+                nOverfullBins += stateOfSolver_resources.numOverfullBins;
+                nCDWithOverfullBins++;
+            }
 
             timers.GetTimer("Send to dT buffer").start();
             {
                 // Acquire lock and supply the dynamic with fresh produce
                 std::lock_guard<std::mutex> lock(pSchedSupport->dynamicOwnedBuffer_AccessCoordination);
                 sendToTheirBuffer();
+                pSchedSupport->dynamicOwned_Prod2ConsBuffer.publish();
             }
-            pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh = true;
             pSchedSupport->schedulingStats.nDynamicUpdates++;
             timers.GetTimer("Send to dT buffer").stop();
 
             // Signal the dynamic that it has fresh produce
-            pSchedSupport->cv_DynamicCanProceed.notify_all();
+            pSchedSupport->dynamicOwned_Prod2ConsBuffer.notifyConsumer();
         }
 
         // In case the dynamic is hanging in there...
-        pSchedSupport->cv_DynamicCanProceed.notify_all();
+        pSchedSupport->dynamicOwned_Prod2ConsBuffer.notifyConsumer();
 
         // When getting here, kT has finished one user call (although perhaps not at the end of the user script)
         pPagerToMain->userCallDone = true;
@@ -202,6 +283,29 @@ void DEMKinematicThread::changeFamily(unsigned int ID_from, unsigned int ID_to)
 }
 
 void DEMKinematicThread::changeOwnerSizes(const std::vector<bodyID_t>& IDs, const std::vector<float>& factors) {
+    // With host CD, the misc kernels are not built, and it is done by host threads
+    if (solverFlags.useHostContactDetection) {
+        std::vector<notStupidBool_t> idBool(simParams->nOwnerBodies, 0);
+        std::vector<float> ownerFactors(simParams->nOwnerBodies);
+        for (size_t i = 0; i < IDs.size(); i++) {
+            idBool[IDs[i]] = 1;
+            ownerFactors[IDs[i]] = factors[i];
+        }
+        hostParallelFor(simParams->nSpheresGM, solverFlags.nHostThreads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                bodyID_t myOwner = ownerClumpBody[i];
+                if (idBool[myOwner]) {
+                    float factor = ownerFactors[myOwner];
+                    relPosSphereX[i] *= factor;
+                    relPosSphereY[i] *= factor;
+                    relPosSphereZ[i] *= factor;
+                    radiiSphere[i] *= factor;
+                }
+            }
+        });
+        return;
+    }
+
     // Set the gpu for this thread
     // cudaSetDevice(streamInfo.device);
     // cudaStream_t new_stream;
@@ -242,6 +346,147 @@ void DEMKinematicThread::changeOwnerSizes(const std::vector<bodyID_t>& IDs, cons
     // cudaStreamDestroy(new_stream);
 }
 
+void DEMKinematicThread::applySpatialOrder(const std::vector<bodyID_t>& ownerNewToOld,
+                                           const std::vector<bodyID_t>& sphereNewToOld) {
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    std::vector<bodyID_t> ownerOldToNew(nOwners);
+    for (size_t i = 0; i < nOwners; i++)
+        ownerOldToNew[ownerNewToOld[i]] = i;
+
+    // Owner arrays (dT sends them over with each work order anyway)
+    hostApplyPermutation(familyID, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(voxelID, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(locX, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(locY, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(locZ, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQw, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQx, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQy, ownerNewToOld, nOwners, pool);
+    hostApplyPermutation(oriQz, ownerNewToOld, nOwners, pool);
+
+    // Sphere arrays, and the owners they belong to
+    hostApplyPermutation(ownerClumpBody, sphereNewToOld, nSpheres, pool);
+    pool.parallelFor(nSpheres, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            ownerClumpBody[i] = ownerOldToNew[ownerClumpBody[i]];
+    });
+    if (solverFlags.useClumpJitify) {
+        hostApplyPermutation(clumpComponentOffset, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(clumpComponentOffsetExt, sphereNewToOld, nSpheres, pool);
+    } else {
+        hostApplyPermutation(radiiSphere, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(relPosSphereX, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(relPosSphereY, sphereNewToOld, nSpheres, pool);
+        hostApplyPermutation(relPosSphereZ, sphereNewToOld, nSpheres, pool);
+    }
+    spherePublicID.assign(dT->sphereInternalToPublic.begin(), dT->sphereInternalToPublic.end());
+
+    // The previous contacts that the next contact list is matched against must be the ones dT holds (with their
+    // history), and dT has rearranged them
+    if (!solverFlags.isHistoryless) {
+        const size_t nContacts = *(dT->stateOfSolver_resources.pNumContacts);
+        if (nContacts > previous_idGeometryA.size()) {
+            previous_idGeometryA.resize(nContacts);
+            previous_idGeometryB.resize(nContacts);
+            previous_contactType.resize(nContacts);
+        }
+        std::copy(dT->idGeometryA.begin(), dT->idGeometryA.begin() + nContacts, previous_idGeometryA.begin());
+        std::copy(dT->idGeometryB.begin(), dT->idGeometryB.begin() + nContacts, previous_idGeometryB.begin());
+        std::copy(dT->contactType.begin(), dT->contactType.begin() + nContacts, previous_contactType.begin());
+        *(stateOfSolver_resources.pNumPrevContacts) = nContacts;
+        *(stateOfSolver_resources.pNumPrevSpheres) = nSpheres;
+    }
+    packDataPointers();
+}
+
+void DEMKinematicThread::applyPurge(const std::vector<bodyID_t>& ownerNewToOld,
+                                    const std::vector<bodyID_t>& sphereNewToOld) {
+    HostThreadPool& pool = HostThreadPool::Shared(solverFlags.nHostThreads);
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nSpheres = simParams->nSpheresGM;
+    const size_t nOwnersKept = ownerNewToOld.size();
+    const size_t nSpheresKept = sphereNewToOld.size();
+    std::vector<bodyID_t> ownerOldToNew(nOwners, NULL_BODYID);
+    for (size_t i = 0; i < nOwnersKept; i++)
+        ownerOldToNew[ownerNewToOld[i]] = i;
+
+    // Owner arrays, and the buffers dT fills them from (which get their memory anew, so they are advised again)
+    DEME_TRACKED_COMPACT(familyID, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(voxelID, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locX, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locY, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locZ, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQw, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQx, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQy, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQz, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(voxelID_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locX_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locY_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(locZ_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQ0_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQ1_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQ2_buffer, ownerNewToOld, nOwners, pool);
+    DEME_TRACKED_COMPACT(oriQ3_buffer, ownerNewToOld, nOwners, pool);
+    advise(voxelID_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(locX_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(locY_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(locZ_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ0_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ1_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ2_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ3_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    if (solverFlags.canFamilyChange) {
+        DEME_TRACKED_COMPACT(familyID_buffer, ownerNewToOld, nOwners, pool);
+        advise(familyID_buffer.data(), nOwnersKept, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    }
+
+    // Sphere arrays, and the owners they belong to
+    DEME_TRACKED_COMPACT(ownerClumpBody, sphereNewToOld, nSpheres, pool);
+    pool.parallelFor(nSpheresKept, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            ownerClumpBody[i] = ownerOldToNew[ownerClumpBody[i]];
+    });
+    if (solverFlags.useClumpJitify) {
+        DEME_TRACKED_COMPACT(clumpComponentOffset, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(clumpComponentOffsetExt, sphereNewToOld, nSpheres, pool);
+    } else {
+        DEME_TRACKED_COMPACT(radiiSphere, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(relPosSphereX, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(relPosSphereY, sphereNewToOld, nSpheres, pool);
+        DEME_TRACKED_COMPACT(relPosSphereZ, sphereNewToOld, nSpheres, pool);
+    }
+    for (auto& owner : ownerMesh)
+        owner = ownerOldToNew[owner];
+    for (auto& owner : ownerAnalBody)
+        owner = ownerOldToNew[owner];
+    if (!dT->sphereInternalToPublic.empty()) {
+        spherePublicID.assign(dT->sphereInternalToPublic.begin(), dT->sphereInternalToPublic.end());
+    }
+
+    simParams->nOwnerClumps -= nOwners - nOwnersKept;
+    simParams->nOwnerBodies = nOwnersKept;
+    simParams->nSpheresGM = nSpheresKept;
+
+    // Like after a spatial reordering, the next contact list is matched against dT's contacts, which dT has compacted
+    if (!solverFlags.isHistoryless) {
+        const size_t nContacts = *(dT->stateOfSolver_resources.pNumContacts);
+        if (nContacts > previous_idGeometryA.size()) {
+            previous_idGeometryA.resize(nContacts);
+            previous_idGeometryB.resize(nContacts);
+            previous_contactType.resize(nContacts);
+        }
+        std::copy(dT->idGeometryA.begin(), dT->idGeometryA.begin() + nContacts, previous_idGeometryA.begin());
+        std::copy(dT->idGeometryB.begin(), dT->idGeometryB.begin() + nContacts, previous_idGeometryB.begin());
+        std::copy(dT->contactType.begin(), dT->contactType.begin() + nContacts, previous_contactType.begin());
+        *(stateOfSolver_resources.pNumPrevContacts) = nContacts;
+        *(stateOfSolver_resources.pNumPrevSpheres) = nSpheresKept;
+    }
+    packDataPointers();
+}
+
 void DEMKinematicThread::startThread() {
     std::lock_guard<std::mutex> lock(pSchedSupport->kinematicStartLock);
     pSchedSupport->kinematicStarted = true;
@@ -249,20 +494,21 @@ void DEMKinematicThread::startThread() {
 }
 
 void DEMKinematicThread::breakWaitingStatus() {
-    // dynamicDone == true and cv_KinematicCanProceed should ensure kT breaks to the outer loop
+    // dynamicDone == true and a fresh (empty) work order should ensure kT breaks to the outer loop
     pSchedSupport->dynamicDone = true;
-    // We distrubed kinematicOwned_Cons2ProdBuffer_isFresh and kTShouldReset here, but it matters not, as when
+    // We distrubed kinematicOwned_Cons2ProdBuffer and kTShouldReset here, but it matters not, as when
     // breakWaitingStatus is called, they will always be reset to default soon
-    pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
     kTShouldReset = true;
-
-    std::lock_guard<std::mutex> lock(pSchedSupport->kinematicCanProceed);
-    pSchedSupport->cv_KinematicCanProceed.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
+        pSchedSupport->kinematicOwned_Cons2ProdBuffer.publish();
+    }
+    pSchedSupport->kinematicOwned_Cons2ProdBuffer.notifyConsumer();
 }
 
 void DEMKinematicThread::resetUserCallStat() {
     // Reset kT stats variables, making ready for next user call
-    pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = false;
+    pSchedSupport->kinematicOwned_Cons2ProdBuffer.consume();
     kTShouldReset = false;
 }
 
@@ -291,18 +537,19 @@ void DEMKinematicThread::packDataPointers() {
     granData->familyMasks = familyMaskMatrix.data();
 
     // for kT, those state vectors are fed by dT, so each has a buffer
-    // granData->voxelID_buffer = voxelID_buffer.data();
-    // granData->locX_buffer = locX_buffer.data();
-    // granData->locY_buffer = locY_buffer.data();
-    // granData->locZ_buffer = locZ_buffer.data();
-    // granData->oriQ0_buffer = oriQ0_buffer.data();
-    // granData->oriQ1_buffer = oriQ1_buffer.data();
-    // granData->oriQ2_buffer = oriQ2_buffer.data();
-    // granData->oriQ3_buffer = oriQ3_buffer.data();
-    // granData->familyID_buffer = familyID_buffer.data();
+    granData->voxelID_buffer = voxelID_buffer.data();
+    granData->locX_buffer = locX_buffer.data();
+    granData->locY_buffer = locY_buffer.data();
+    granData->locZ_buffer = locZ_buffer.data();
+    granData->oriQ0_buffer = oriQ0_buffer.data();
+    granData->oriQ1_buffer = oriQ1_buffer.data();
+    granData->oriQ2_buffer = oriQ2_buffer.data();
+    granData->oriQ3_buffer = oriQ3_buffer.data();
+    granData->familyID_buffer = familyID_buffer.data();
 
     // The offset info that indexes into the template arrays
     granData->ownerClumpBody = ownerClumpBody.data();
+    granData->spherePublicID = spherePublicID.empty() ? NULL : spherePublicID.data();
     granData->clumpComponentOffset = clumpComponentOffset.data();
     granData->clumpComponentOffsetExt = clumpComponentOffsetExt.data();
 
@@ -312,6 +559,20 @@ void DEMKinematicThread::packDataPointers() {
     granData->relPosNode2 = relPosNode2.data();
     granData->relPosNode3 = relPosNode3.data();
 
+    // Analytical entity-related
+    granData->ownerAnalBody = ownerAnalBody.data();
+    granData->typeAnalEntity = typeAnalEntity.data();
+    granData->normalAnalEntity = normalAnalEntity.data();
+    granData->relPosEntityX = relPosEntityX.data();
+    granData->relPosEntityY = relPosEntityY.data();
+    granData->relPosEntityZ = relPosEntityZ.data();
+    granData->oriEntityX = oriEntityX.data();
+    granData->oriEntityY = oriEntityY.data();
+    granData->oriEntityZ = oriEntityZ.data();
+    granData->sizeEntity1 = sizeEntity1.data();
+    granData->sizeEntity2 = sizeEntity2.data();
+    granData->sizeEntity3 = sizeEntity3.data();
+
     // Template array pointers
     granData->radiiSphere = radiiSphere.data();
     granData->relPosSphereX = relPosSphereX.data();
@@ -320,6 +581,7 @@ void DEMKinematicThread::packDataPointers() {
 }
 
 void DEMKinematicThread::packTransferPointers(DEMDynamicThread*& dT) {
+    swapTransferBuffers = (streamInfo.device == dT->streamInfo.device);
     // Set the pointers to dT owned buffers
     granData->pDTOwnedBuffer_nContactPairs = &(dT->granData->nContactPairs_buffer);
     granData->pDTOwnedBuffer_idGeometryA = dT->granData->idGeometryA_buffer;
@@ -383,12 +645,9 @@ void DEMKinematicThread::allocateManagedArrays(size_t nOwnerBodies,
                                                unsigned int nMatTuples) {
     GPU_CALL(cudaSetDevice(streamInfo.device));
 
-    // Sizes of these arrays
-    simParams->nSpheresGM = nSpheresGM;
+    // Sizes of these arrays (those of the owner and sphere arrays are set in resizeEntityArrays)
     simParams->nTriGM = nTriGM;
     simParams->nAnalGM = nAnalGM;
-    simParams->nOwnerBodies = nOwnerBodies;
-    simParams->nOwnerClumps = nOwnerClumps;
     simParams->nExtObj = nExtObj;
     simParams->nTriMeshes = nTriMeshes;
     simParams->nDistinctMassProperties = nMassProperties;
@@ -401,6 +660,64 @@ void DEMKinematicThread::allocateManagedArrays(size_t nOwnerBodies,
     DEME_TRACKED_RESIZE(familyMaskMatrix, (NUM_AVAL_FAMILIES - 1) * NUM_AVAL_FAMILIES / 2, "familyMaskMatrix",
                         DONT_PREVENT_CONTACT);
 
+    // Resize to the number of owners and spheres
+    resizeEntityArrays(nOwnerBodies, nOwnerClumps, nSpheresGM);
+    // Unless they trade places with the work arrays, the transfer buffers are preferably placed on dT, to save dT
+    // access time
+    advise(voxelID_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(locX_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(locY_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(locZ_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ0_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ1_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ2_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    advise(oriQ3_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    if (solverFlags.canFamilyChange) {
+        advise(familyID_buffer.data(), nOwnerBodies, ManagedAdvice::PREFERRED_LOC, dT->streamInfo.device);
+    }
+
+    // Resize to the number of triangle facets
+    DEME_TRACKED_RESIZE(ownerMesh, nTriGM, "ownerMesh", 0);
+    DEME_TRACKED_RESIZE(relPosNode1, nTriGM, "relPosNode1", make_float3(0));
+    DEME_TRACKED_RESIZE(relPosNode2, nTriGM, "relPosNode2", make_float3(0));
+    DEME_TRACKED_RESIZE(relPosNode3, nTriGM, "relPosNode3", make_float3(0));
+
+    // Resize to the number of analytical entities
+    DEME_TRACKED_RESIZE(ownerAnalBody, nAnalGM, "ownerAnalBody", 0);
+    DEME_TRACKED_RESIZE(typeAnalEntity, nAnalGM, "typeAnalEntity", 0);
+    DEME_TRACKED_RESIZE(normalAnalEntity, nAnalGM, "normalAnalEntity", 0);
+    DEME_TRACKED_RESIZE(relPosEntityX, nAnalGM, "relPosEntityX", 0);
+    DEME_TRACKED_RESIZE(relPosEntityY, nAnalGM, "relPosEntityY", 0);
+    DEME_TRACKED_RESIZE(relPosEntityZ, nAnalGM, "relPosEntityZ", 0);
+    DEME_TRACKED_RESIZE(oriEntityX, nAnalGM, "oriEntityX", 0);
+    DEME_TRACKED_RESIZE(oriEntityY, nAnalGM, "oriEntityY", 0);
+    DEME_TRACKED_RESIZE(oriEntityZ, nAnalGM, "oriEntityZ", 0);
+    DEME_TRACKED_RESIZE(sizeEntity1, nAnalGM, "sizeEntity1", 0);
+    DEME_TRACKED_RESIZE(sizeEntity2, nAnalGM, "sizeEntity2", 0);
+    DEME_TRACKED_RESIZE(sizeEntity3, nAnalGM, "sizeEntity3", 0);
+
+    // Arrays for kT produced contact info
+    // The following several arrays will have variable sizes, so here we only used an estimate. My estimate of total
+    // contact pairs is 2n, and I think the max is 6n (although I can't prove it). Note the estimate should be large
+    // enough to decrease the number of reallocations in the simulation, but not too large that eats too much memory.
+    DEME_TRACKED_GROW(idGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryA", 0);
+    DEME_TRACKED_GROW(idGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryB", 0);
+    DEME_TRACKED_GROW(contactType, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactType", NOT_A_CONTACT);
+    if (!solverFlags.isHistoryless) {
+        DEME_TRACKED_GROW(previous_idGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "previous_idGeometryA", 0);
+        DEME_TRACKED_GROW(previous_idGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "previous_idGeometryB", 0);
+        DEME_TRACKED_GROW(previous_contactType, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "previous_contactType",
+                          NOT_A_CONTACT);
+        DEME_TRACKED_GROW(contactMapping, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactMapping",
+                          NULL_MAPPING_PARTNER);
+    }
+}
+
+void DEMKinematicThread::resizeEntityArrays(size_t nOwnerBodies, size_t nOwnerClumps, size_t nSpheresGM) {
+    simParams->nOwnerBodies = nOwnerBodies;
+    simParams->nOwnerClumps = nOwnerClumps;
+    simParams->nSpheresGM = nSpheresGM;
+
     // Resize to the number of clumps
     DEME_TRACKED_RESIZE(familyID, nOwnerBodies, "familyID", 0);
     DEME_TRACKED_RESIZE(voxelID, nOwnerBodies, "voxelID", 0);
@@ -413,53 +730,26 @@ void DEMKinematicThread::allocateManagedArrays(size_t nOwnerBodies,
     DEME_TRACKED_RESIZE(oriQz, nOwnerBodies, "oriQz", 0);
 
     // Transfer buffer arrays
-    // It is cudaMalloc-ed memory, not managed, because we want explicit locality control of buffers
-    {
-        // These buffers should be on dT, to save dT access time
-        GPU_CALL(cudaSetDevice(dT->streamInfo.device));
-        DEME_DEVICE_PTR_ALLOC(granData->voxelID_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->locX_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->locY_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->locZ_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->oriQ0_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->oriQ1_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->oriQ2_buffer, nOwnerBodies);
-        DEME_DEVICE_PTR_ALLOC(granData->oriQ3_buffer, nOwnerBodies);
-
-        // DEME_TRACKED_RESIZE(voxelID_buffer, nOwnerBodies, "voxelID_buffer", 0);
-        // DEME_TRACKED_RESIZE(locX_buffer, nOwnerBodies, "locX_buffer", 0);
-        // DEME_TRACKED_RESIZE(locY_buffer, nOwnerBodies, "locY_buffer", 0);
-        // DEME_TRACKED_RESIZE(locZ_buffer, nOwnerBodies, "locZ_buffer", 0);
-        // DEME_TRACKED_RESIZE(oriQ0_buffer, nOwnerBodies, "oriQ0_buffer", 0);
-        // DEME_TRACKED_RESIZE(oriQ1_buffer, nOwnerBodies, "oriQ1_buffer", 0);
-        // DEME_TRACKED_RESIZE(oriQ2_buffer, nOwnerBodies, "oriQ2_buffer", 0);
-        // DEME_TRACKED_RESIZE(oriQ3_buffer, nOwnerBodies, "oriQ3_buffer", 0);
-        // DEME_ADVISE_DEVICE(voxelID_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(locX_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(locY_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(locZ_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(oriQ0_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(oriQ1_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(oriQ2_buffer, dT->streamInfo.device);
-        // DEME_ADVISE_DEVICE(oriQ3_buffer, dT->streamInfo.device);
-        if (solverFlags.canFamilyChange) {
-            // DEME_TRACKED_RESIZE(familyID_buffer, nOwnerBodies, "familyID_buffer", 0);
-            // DEME_ADVISE_DEVICE(familyID_buffer, dT->streamInfo.device);
-            DEME_DEVICE_PTR_ALLOC(granData->familyID_buffer, nOwnerBodies);
-        }
-        // Unset the device change we just did
-        GPU_CALL(cudaSetDevice(streamInfo.device));
+    // They are managed arrays like the work arrays, so that when kT and dT share a device, a buffer and a work array
+    // can trade places instead of being copied.
+    DEME_TRACKED_RESIZE(voxelID_buffer, nOwnerBodies, "voxelID_buffer", 0);
+    DEME_TRACKED_RESIZE(locX_buffer, nOwnerBodies, "locX_buffer", 0);
+    DEME_TRACKED_RESIZE(locY_buffer, nOwnerBodies, "locY_buffer", 0);
+    DEME_TRACKED_RESIZE(locZ_buffer, nOwnerBodies, "locZ_buffer", 0);
+    DEME_TRACKED_RESIZE(oriQ0_buffer, nOwnerBodies, "oriQ0_buffer", 1);
+    DEME_TRACKED_RESIZE(oriQ1_buffer, nOwnerBodies, "oriQ1_buffer", 0);
+    DEME_TRACKED_RESIZE(oriQ2_buffer, nOwnerBodies, "oriQ2_buffer", 0);
+    DEME_TRACKED_RESIZE(oriQ3_buffer, nOwnerBodies, "oriQ3_buffer", 0);
+    if (solverFlags.canFamilyChange) {
+        DEME_TRACKED_RESIZE(familyID_buffer, nOwnerBodies, "familyID_buffer", 0);
     }
 
     // Resize to the number of spheres (or plus num of triangle facets)
     DEME_TRACKED_RESIZE(ownerClumpBody, nSpheresGM, "ownerClumpBody", 0);
-
-    // Resize to the number of triangle facets
-    DEME_TRACKED_RESIZE(ownerMesh, nTriGM, "ownerMesh", 0);
-    DEME_TRACKED_RESIZE(relPosNode1, nTriGM, "relPosNode1", make_float3(0));
-    DEME_TRACKED_RESIZE(relPosNode2, nTriGM, "relPosNode2", make_float3(0));
-    DEME_TRACKED_RESIZE(relPosNode3, nTriGM, "relPosNode3", make_float3(0));
-
+    // If spheres were rearranged before, the ones added now get public IDs that are where they are
+    for (size_t i = spherePublicID.size(); !spherePublicID.empty() && i < nSpheresGM; i++) {
+        spherePublicID.push_back(i);
+    }
     if (solverFlags.useClumpJitify) {
         DEME_TRACKED_RESIZE(clumpComponentOffset, nSpheresGM, "clumpComponentOffset", 0);
         // This extended component offset array can hold offset numbers even for big clumps (whereas
@@ -467,32 +757,22 @@ void DEMKinematicThread::allocateManagedArrays(size_t nOwnerBodies,
         // range then it is not jitified, and the kernel needs to look for it in the global memory.
         DEME_TRACKED_RESIZE(clumpComponentOffsetExt, nSpheresGM, "clumpComponentOffsetExt", 0);
         // Resize to the length of the clump templates
-        DEME_TRACKED_RESIZE(radiiSphere, nClumpComponents, "radiiSphere", 0);
-        DEME_TRACKED_RESIZE(relPosSphereX, nClumpComponents, "relPosSphereX", 0);
-        DEME_TRACKED_RESIZE(relPosSphereY, nClumpComponents, "relPosSphereY", 0);
-        DEME_TRACKED_RESIZE(relPosSphereZ, nClumpComponents, "relPosSphereZ", 0);
+        DEME_TRACKED_RESIZE(radiiSphere, simParams->nDistinctClumpComponents, "radiiSphere", 0);
+        DEME_TRACKED_RESIZE(relPosSphereX, simParams->nDistinctClumpComponents, "relPosSphereX", 0);
+        DEME_TRACKED_RESIZE(relPosSphereY, simParams->nDistinctClumpComponents, "relPosSphereY", 0);
+        DEME_TRACKED_RESIZE(relPosSphereZ, simParams->nDistinctClumpComponents, "relPosSphereZ", 0);
     } else {
         DEME_TRACKED_RESIZE(radiiSphere, nSpheresGM, "radiiSphere", 0);
         DEME_TRACKED_RESIZE(relPosSphereX, nSpheresGM, "relPosSphereX", 0);
         DEME_TRACKED_RESIZE(relPosSphereY, nSpheresGM, "relPosSphereY", 0);
         DEME_TRACKED_RESIZE(relPosSphereZ, nSpheresGM, "relPosSphereZ", 0);
     }
+}
 
-    // Arrays for kT produced contact info
-    // The following several arrays will have variable sizes, so here we only used an estimate. My estimate of total
-    // contact pairs is 2n, and I think the max is 6n (although I can't prove it). Note the estimate should be large
-    // enough to decrease the number of reallocations in the simulation, but not too large that eats too much memory.
-    DEME_TRACKED_RESIZE(idGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryA", 0);
-    DEME_TRACKED_RESIZE(idGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "idGeometryB", 0);
-    DEME_TRACKED_RESIZE(contactType, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactType", NOT_A_CONTACT);
-    if (!solverFlags.isHistoryless) {
-        DEME_TRACKED_RESIZE(previous_idGeometryA, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "previous_idGeometryA", 0);
-        DEME_TRACKED_RESIZE(previous_idGeometryB, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "previous_idGeometryB", 0);
-        DEME_TRACKED_RESIZE(previous_contactType, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "previous_contactType",
-                            NOT_A_CONTACT);
-        DEME_TRACKED_RESIZE(contactMapping, nOwnerBodies * DEME_INIT_CNT_MULTIPLIER, "contactMapping",
-                            NULL_MAPPING_PARTNER);
-    }
+bool DEMKinematicThread::entityArraysHaveRoom(size_t nOwnerBodies, size_t nSpheresGM) const {
+    // The owner arrays (and their transfer buffers) are allocated, grown and compacted together, and so are the sphere
+    // arrays, so one of each tells
+    return familyID.capacity() >= nOwnerBodies && ownerClumpBody.capacity() >= nSpheresGM;
 }
 
 void DEMKinematicThread::registerPolicies(const std::vector<notStupidBool_t>& family_mask_matrix) {
@@ -625,6 +905,32 @@ void DEMKinematicThread::populateEntityArrays(const std::vector<std::shared_ptr<
     }
 }
 
+void DEMKinematicThread::populateAnalGeoArrays(const std::vector<unsigned int>& input_anal_owner,
+                                               const std::vector<objType_t>& input_anal_types,
+                                               const std::vector<objNormal_t>& input_anal_normals,
+                                               const std::vector<float3>& input_anal_comp_pos,
+                                               const std::vector<float3>& input_anal_comp_rot,
+                                               const std::vector<float>& input_anal_size_1,
+                                               const std::vector<float>& input_anal_size_2,
+                                               const std::vector<float>& input_anal_size_3,
+                                               size_t nOwnerClumps) {
+    for (size_t i = 0; i < input_anal_owner.size(); i++) {
+        // Analytical entities' owners are numbered after the clumps, same as in the jitified version
+        ownerAnalBody.at(i) = nOwnerClumps + input_anal_owner.at(i);
+        typeAnalEntity.at(i) = input_anal_types.at(i);
+        normalAnalEntity.at(i) = input_anal_normals.at(i);
+        relPosEntityX.at(i) = input_anal_comp_pos.at(i).x;
+        relPosEntityY.at(i) = input_anal_comp_pos.at(i).y;
+        relPosEntityZ.at(i) = input_anal_comp_pos.at(i).z;
+        oriEntityX.at(i) = input_anal_comp_rot.at(i).x;
+        oriEntityY.at(i) = input_anal_comp_rot.at(i).y;
+        oriEntityZ.at(i) = input_anal_comp_rot.at(i).z;
+        sizeEntity1.at(i) = input_anal_size_1.at(i);
+        sizeEntity2.at(i) = input_anal_size_2.at(i);
+        sizeEntity3.at(i) = input_anal_size_3.at(i);
+    }
+}
+
 void DEMKinematicThread::initManagedArrays(const std::vector<std::shared_ptr<DEMClumpBatch>>& input_clump_batches,
                                            const std::vector<unsigned int>& input_ext_obj_family,
                                            const std::vector<unsigned int>& input_mesh_obj_family,
@@ -655,36 +961,58 @@ void DEMKinematicThread::updateClumpMeshArrays(const std::vector<std::shared_ptr
                                                size_t nExistingFacets) {
     populateEntityArrays(input_clump_batches, input_ext_obj_family, input_mesh_obj_family, input_mesh_facet_owner,
                          input_mesh_facets, clump_templates, nExistingOwners, nExistingSpheres, nExistingFacets);
+    // A work order that dT handed over before these owners were added (see DEMSolver::InsertStagedClumps) does not
+    // have them, so they are put in the transfer buffers too
+    std::copy(voxelID.begin() + nExistingOwners, voxelID.end(), voxelID_buffer.begin() + nExistingOwners);
+    std::copy(locX.begin() + nExistingOwners, locX.end(), locX_buffer.begin() + nExistingOwners);
+    std::copy(locY.begin() + nExistingOwners, locY.end(), locY_buffer.begin() + nExistingOwners);
+    std::copy(locZ.begin() + nExistingOwners, locZ.end(), locZ_buffer.begin() + nExistingOwners);
+    std::copy(oriQw.begin() + nExistingOwners, oriQw.end(), oriQ0_buffer.begin() + nExistingOwners);
+    std::copy(oriQx.begin() + nExistingOwners, oriQx.end(), oriQ1_buffer.begin() + nExistingOwners);
+    std::copy(oriQy.begin() + nExistingOwners, oriQy.end(), oriQ2_buffer.begin() + nExistingOwners);
+    std::copy(oriQz.begin() + nExistingOwners, oriQz.end(), oriQ3_buffer.begin() + nExistingOwners);
+    if (solverFlags.canFamilyChange) {
+        std::copy(familyID.begin() + nExistingOwners, familyID.end(), familyID_buffer.begin() + nExistingOwners);
+    }
 }
 
-void DEMKinematicThread::jitifyKernels(const std::unordered_map<std::string, std::string>& Subs) {
+void DEMKinematicThread::jitifyKernels(const std::unordered_map<std::string, std::string>& Subs,
+                                        const std::shared_ptr<JitDiskCache>& disk_cache) {
+    // If CD is done on the host, then no kernel is needed: the misc kernels' work is done by host threads too
+    if (solverFlags.useHostContactDetection) {
+        return;
+    }
+    jitifyCDKernels(Subs, disk_cache);
+    {
+        misc_kernels = std::make_shared<JitProgram>(
+            std::move(JitHelper::buildProgram("DEMMiscKernels", JitHelper::KERNEL_DIR / "DEMMiscKernels.cu", Subs,
+                                              {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
+    }
+}
+
+void DEMKinematicThread::jitifyCDKernels(const std::unordered_map<std::string, std::string>& Subs,
+                                          const std::shared_ptr<JitDiskCache>& disk_cache) {
     // First one is bin_occupation_kernels kernels, which figure out the bin--sphere touch pairs
     {
-        bin_occupation_kernels = std::make_shared<jitify::Program>(
+        bin_occupation_kernels = std::make_shared<JitProgram>(
             std::move(JitHelper::buildProgram("DEMBinSphereKernels", JitHelper::KERNEL_DIR / "DEMBinSphereKernels.cu",
-                                              Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+                                              Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
     }
     // Then CD kernels
     if (solverFlags.useOneBinPerThread) {
-        contact_detection_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        contact_detection_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMContactKernels", JitHelper::KERNEL_DIR / "DEMContactKernels.cu", Subs,
-            {"-I" + (JitHelper::KERNEL_DIR / "..").string(), "-I" + std::string(CUDA_TOOLKIT_HEADERS)})));
+            {"-I" + (JitHelper::KERNEL_DIR / "..").string(), "-I" + std::string(CUDA_TOOLKIT_HEADERS)}, disk_cache)));
     } else {
-        contact_detection_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        contact_detection_kernels = std::make_shared<JitProgram>(std::move(JitHelper::buildProgram(
             "DEMContactKernels_Blockwise", JitHelper::KERNEL_DIR / "DEMContactKernels_Blockwise.cu", Subs,
-            {"-I" + (JitHelper::KERNEL_DIR / "..").string(), "-I" + std::string(CUDA_TOOLKIT_HEADERS)})));
+            {"-I" + (JitHelper::KERNEL_DIR / "..").string(), "-I" + std::string(CUDA_TOOLKIT_HEADERS)}, disk_cache)));
     }
     // Then contact history mapping kernels
     {
-        history_kernels = std::make_shared<jitify::Program>(std::move(
+        history_kernels = std::make_shared<JitProgram>(std::move(
             JitHelper::buildProgram("DEMHistoryMappingKernels", JitHelper::KERNEL_DIR / "DEMHistoryMappingKernels.cu",
-                                    Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
-    }
-    // Then misc kernels
-    {
-        misc_kernels = std::make_shared<jitify::Program>(
-            std::move(JitHelper::buildProgram("DEMMiscKernels", JitHelper::KERNEL_DIR / "DEMMiscKernels.cu", Subs,
-                                              {"-I" + (JitHelper::KERNEL_DIR / "..").string()})));
+                                    Subs, {"-I" + (JitHelper::KERNEL_DIR / "..").string()}, disk_cache)));
     }
 }
 
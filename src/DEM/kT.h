@@ -25,10 +25,9 @@
 
 // #include <core/utils/JitHelper.h>
 
-// Forward declare jitify::Program to avoid downstream dependency
-namespace jitify {
-class Program;
-}
+// Forward declare JitProgram to avoid downstream dependency (on jitify)
+class JitProgram;
+class JitDiskCache;
 
 namespace deme {
 
@@ -59,10 +58,15 @@ class DEMKinematicThread {
     GpuManager::StreamInfo streamInfo;
 
     // A class that contains scratch pad and system status data (constructed with the number of temp arrays we need)
-    DEMSolverStateData stateOfSolver_resources = DEMSolverStateData(6);
+    DEMSolverStateData stateOfSolver_resources = DEMSolverStateData(7);
 
     size_t m_approx_bytes_used = 0;
 
+    // Number of bins that took the overfull-bin path in CD, and the number of CD runs that had such bins, since the
+    // stats were last cleared
+    std::atomic<size_t> nOverfullBins{0};
+    std::atomic<size_t> nCDWithOverfullBins{0};
+
     // kT should break out of its inner loop and return to a state where it awaits a `start' call at the outer loop
     bool kTShouldReset = false;
 
@@ -75,19 +79,22 @@ class DEMKinematicThread {
     // Buffer arrays for storing info from the dT side.
     // dT modifies these arrays; kT uses them only.
 
-    // // kT gets clump locations and rotations from dT
-    // // The voxel ID
-    // std::vector<voxelID_t, ManagedAllocator<voxelID_t>> voxelID_buffer;
-    // // The XYZ local location inside a voxel
-    // std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locX_buffer;
-    // std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locY_buffer;
-    // std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locZ_buffer;
-    // // The clump quaternion
-    // std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ0_buffer;
-    // std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ1_buffer;
-    // std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ2_buffer;
-    // std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ3_buffer;
-    // std::vector<family_t, ManagedAllocator<family_t>> familyID_buffer;
+    // kT gets clump locations and rotations from dT
+    // The voxel ID
+    std::vector<voxelID_t, ManagedAllocator<voxelID_t>> voxelID_buffer;
+    // The XYZ local location inside a voxel
+    std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locX_buffer;
+    std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locY_buffer;
+    std::vector<subVoxelPos_t, ManagedAllocator<subVoxelPos_t>> locZ_buffer;
+    // The clump quaternion
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ0_buffer;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ1_buffer;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ2_buffer;
+    std::vector<oriQ_t, ManagedAllocator<oriQ_t>> oriQ3_buffer;
+    std::vector<family_t, ManagedAllocator<family_t>> familyID_buffer;
+
+    // If kT and dT share a device, the buffers are exchanged with the work arrays by swapping them, not copying them
+    bool swapTransferBuffers = false;
 
     // kT's copy of family map
     // std::unordered_map<unsigned int, family_t> familyUserImplMap;
@@ -128,6 +135,11 @@ class DEMKinematicThread {
     std::vector<float, ManagedAllocator<float>> sizeEntity1;
     std::vector<float, ManagedAllocator<float>> sizeEntity2;
     std::vector<float, ManagedAllocator<float>> sizeEntity3;
+    // Owner, type and normal direction of analytical entities. Note the normal is stored as notStupidBool_t, since
+    // objNormal_t is bool and a vector of bool is not an array.
+    std::vector<bodyID_t, ManagedAllocator<bodyID_t>> ownerAnalBody;
+    std::vector<objType_t, ManagedAllocator<objType_t>> typeAnalEntity;
+    std::vector<notStupidBool_t, ManagedAllocator<notStupidBool_t>> normalAnalEntity;
 
     // The voxel ID (split into 3 parts, representing XYZ location)
     std::vector<voxelID_t, ManagedAllocator<voxelID_t>> voxelID;
@@ -166,6 +178,9 @@ class DEMKinematicThread {
     // Owner body ID of this component
     std::vector<bodyID_t, ManagedAllocator<bodyID_t>> ownerClumpBody;
     std::vector<bodyID_t, ManagedAllocator<bodyID_t>> ownerMesh;
+    // Public ID of each sphere, which does not change when spheres are rearranged in memory (see dT). Sphere--sphere
+    // contact pairs are oriented by it. Empty if spheres were never rearranged.
+    std::vector<bodyID_t, ManagedAllocator<bodyID_t>> spherePublicID;
 
     // The ID that maps this sphere component's geometry-defining parameters, when this component is jitified
     std::vector<clumpComponentOffset_t, ManagedAllocator<clumpComponentOffset_t>> clumpComponentOffset;
@@ -224,7 +239,7 @@ class DEMKinematicThread {
     void setDestinationBufferPointers();
 
     // Break inner loop hanging status and wait in the outer loop. Note we must ensure resetUserCallStat is called
-    // shortly after breakWaitingStatus is called, since kinematicOwned_Cons2ProdBuffer_isFresh and kTShouldReset can be
+    // shortly after breakWaitingStatus is called, since kinematicOwned_Cons2ProdBuffer and kTShouldReset can be
     // vulnerable if kT exited through dynamicsDone rather than control variable-based release.
     void breakWaitingStatus();
 
@@ -253,6 +268,10 @@ class DEMKinematicThread {
                                unsigned int nClumpComponents,
                                unsigned int nJitifiableClumpComponents,
                                unsigned int nMatTuples);
+    /// Resize the arrays that have an element per owner or per sphere, and set the numbers of those
+    void resizeEntityArrays(size_t nOwnerBodies, size_t nOwnerClumps, size_t nSpheresGM);
+    /// Whether the arrays that have an element per owner or per sphere can grow to these lengths without reallocating
+    bool entityArraysHaveRoom(size_t nOwnerBodies, size_t nSpheresGM) const;
 
     // initManagedArrays's components
     void registerPolicies(const std::vector<notStupidBool_t>& family_mask_matrix);
@@ -266,6 +285,18 @@ class DEMKinematicThread {
                               size_t nExistSpheres,
                               size_t nExistingFacets);
 
+    /// Store analytical entity definitions in managed arrays (needed by host-side contact detection; the GPU kernels use
+    /// the jitified version)
+    void populateAnalGeoArrays(const std::vector<unsigned int>& input_anal_owner,
+                               const std::vector<objType_t>& input_anal_types,
+                               const std::vector<objNormal_t>& input_anal_normals,
+                               const std::vector<float3>& input_anal_comp_pos,
+                               const std::vector<float3>& input_anal_comp_rot,
+                               const std::vector<float>& input_anal_size_1,
+                               const std::vector<float>& input_anal_size_2,
+                               const std::vector<float>& input_anal_size_3,
+                               size_t nOwnerClumps);
+
     /// Initialize managed arrays
     void initManagedArrays(const std::vector<std::shared_ptr<DEMClumpBatch>>& input_clump_batches,
                            const std::vector<unsigned int>& input_ext_obj_family,
@@ -329,25 +360,40 @@ class DEMKinematicThread {
     /// Change radii and relPos info of these owners (if these owners are clumps)
     void changeOwnerSizes(const std::vector<bodyID_t>& IDs, const std::vector<float>& factors);
 
+    /// Rearrange the owner and sphere arrays in this order (given as new-to-old maps), after dT did the same, and take
+    /// dT's rearranged contacts as the previous contacts. kT and dT must both be idle.
+    void applySpatialOrder(const std::vector<bodyID_t>& ownerNewToOld, const std::vector<bodyID_t>& sphereNewToOld);
+    /// Keep only these owners and spheres (given as new-to-old maps), after dT did the same, and take dT's compacted
+    /// contacts as the previous contacts. kT and dT must both be idle.
+    void applyPurge(const std::vector<bodyID_t>& ownerNewToOld, const std::vector<bodyID_t>& sphereNewToOld);
+
     // Jitify kT kernels (at initialization) based on existing knowledge of this run
-    void jitifyKernels(const std::unordered_map<std::string, std::string>& Subs);
+    void jitifyKernels(const std::unordered_map<std::string, std::string>& Subs,
+                       const std::shared_ptr<JitDiskCache>& disk_cache);
 
   private:
     const std::string Name = "kT";
 
     // Bring kT buffer array data to its working arrays
     void unpackMyBuffer();
+    // Jitify the kernels used by the GPU version of contact detection
+    void jitifyCDKernels(const std::unordered_map<std::string, std::string>& Subs,
+                         const std::shared_ptr<JitDiskCache>& disk_cache);
     // Send produced data to dT-owned biffers
     void sendToTheirBuffer();
     // Resize dT's buffer arrays based on the number of contact pairs
     inline void transferArraysResize(size_t nContactPairs);
+    // Swap the owner state buffers dT filled with the work arrays, and point both threads to where they now are
+    inline void swapOwnerBuffers();
+    // Swap the contact arrays with dT's contact buffers, and point both threads to where they now are
+    inline void swapContactBuffers();
 
     // Just-in-time compiled kernels
-    // jitify::Program bin_occupation_kernels = JitHelper::buildProgram("bin_occupation_kernels", " ");
-    std::shared_ptr<jitify::Program> bin_occupation_kernels;
-    std::shared_ptr<jitify::Program> contact_detection_kernels;
-    std::shared_ptr<jitify::Program> history_kernels;
-    std::shared_ptr<jitify::Program> misc_kernels;
+    // JitProgram bin_occupation_kernels = JitHelper::buildProgram("bin_occupation_kernels", " ");
+    std::shared_ptr<JitProgram> bin_occupation_kernels;
+    std::shared_ptr<JitProgram> contact_detection_kernels;
+    std::shared_ptr<JitProgram> history_kernels;
+    std::shared_ptr<JitProgram> misc_kernels;
 
 };  // kT ends
 
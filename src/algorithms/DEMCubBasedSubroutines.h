@@ -45,9 +45,9 @@ void floatSortByKey(notStupidBool_t* d_keys_in,
                     cudaStream_t& this_stream,
                     DEMSolverStateData& scratchPad);
 
-void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
-                      std::shared_ptr<jitify::Program>& contact_detection_kernels,
-                      std::shared_ptr<jitify::Program>& history_kernels,
+void contactDetection(std::shared_ptr<JitProgram>& bin_occupation_kernels,
+                      std::shared_ptr<JitProgram>& contact_detection_kernels,
+                      std::shared_ptr<JitProgram>& history_kernels,
                       DEMDataKT* granData,
                       DEMSimParams* simParams,
                       SolverFlags& solverFlags,
@@ -64,7 +64,7 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
                       DEMSolverStateData& scratchPad,
                       SolverTimers& timers);
 
-void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernels,
+void collectContactForces(std::shared_ptr<JitProgram>& collect_force_kernels,
                           DEMDataDT* granData,
                           const size_t nContactPairs,
                           const size_t nClumps,
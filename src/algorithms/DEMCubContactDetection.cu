@@ -13,6 +13,8 @@
 
 #include <algorithms/DEMCubWrappers.cu>
 
+#include <algorithm>
+
 #include <core/utils/GpuError.h>
 
 namespace deme {
@@ -36,9 +38,9 @@ inline void contactEventArraysResize(size_t nContactPairs,
     granData->contactType = contactType.data();
 }
 
-void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
-                      std::shared_ptr<jitify::Program>& contact_detection_kernels,
-                      std::shared_ptr<jitify::Program>& history_kernels,
+void contactDetection(std::shared_ptr<JitProgram>& bin_occupation_kernels,
+                      std::shared_ptr<JitProgram>& contact_detection_kernels,
+                      std::shared_ptr<JitProgram>& history_kernels,
                       DEMDataKT* granData,
                       DEMSimParams* simParams,
                       SolverFlags& solverFlags,
@@ -179,12 +181,20 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
         (solverFlags.useOneBinPerThread)
             ? (*pNumActiveBins + DEME_KT_CD_NTHREADS_PER_BLOCK - 1) / DEME_KT_CD_NTHREADS_PER_BLOCK
             : *pNumActiveBins;
+    scratchPad.numOverfullBins = 0;
     if (blocks_needed_for_bins > 0) {
+        // Bins that have more spheres than the bin-wise kernels can hold are listed by the counting kernel (with 0
+        // contacts) and processed by the overfull-bin kernels later. pNumBinSphereTouchPairs is no longer needed, so
+        // its variable counts them.
+        CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(binID_t);
+        binID_t* overfullBinList = (binID_t*)scratchPad.allocateTempVector(6, CD_temp_arr_bytes);
+        size_t* pNumOverfullBins = scratchPad.pTempSizeVar1;
+        *pNumOverfullBins = 0;
         contact_detection_kernels->kernel("getNumberOfContactsEachBin")
             .instantiate()
             .configure(dim3(blocks_needed_for_bins), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
             .launch(simParams, granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
-                    sphereIDsLookUpTable, numContactsInEachBin, *pNumActiveBins);
+                    sphereIDsLookUpTable, numContactsInEachBin, overfullBinList, pNumOverfullBins, *pNumActiveBins);
         GPU_CALL(cudaStreamSynchronize(this_stream));
 
         //// TODO: sphere should have jitified and non-jitified part. Use a component ID > max_comp_id to signal
@@ -230,6 +240,89 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
                     sphereIDsLookUpTable, contactReportOffsets, idSphA, idSphB, *pNumActiveBins);
         GPU_CALL(cudaStreamSynchronize(this_stream));
 
+        // Overfull bins are processed by one block each, which goes through the bin's spheres tile by tile. Their
+        // contacts go after the other sphere--sphere contacts. numContactsInEachBin and contactReportOffsets can retire
+        // now, so we re-use temp vectors 4 and 5.
+        const size_t nOverfullBins = *pNumOverfullBins;
+        scratchPad.numOverfullBins = nOverfullBins;
+        if (nOverfullBins > 0) {
+            // The list is in the order the counting kernel happened to find them; sort it so the output is repeatable
+            std::sort(overfullBinList, overfullBinList + nOverfullBins);
+            CD_temp_arr_bytes = nOverfullBins * sizeof(contactPairs_t);
+            contactPairs_t* numContactsEachOverfullBin =
+                (contactPairs_t*)scratchPad.allocateTempVector(4, CD_temp_arr_bytes);
+            bin_occupation_kernels->kernel("getNumberOfContactsEachOverfullBin")
+                .instantiate()
+                .configure(dim3(nOverfullBins), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                .launch(simParams, granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+                        sphereIDsLookUpTable, overfullBinList, numContactsEachOverfullBin);
+            GPU_CALL(cudaStreamSynchronize(this_stream));
+
+            contactPairs_t* overfullReportOffsets =
+                (contactPairs_t*)scratchPad.allocateTempVector(5, CD_temp_arr_bytes);
+            cubDEMPrefixScan<contactPairs_t, contactPairs_t, DEMSolverStateData>(
+                numContactsEachOverfullBin, overfullReportOffsets, nOverfullBins, this_stream, scratchPad);
+            size_t nOverfullBinContact = (size_t)numContactsEachOverfullBin[nOverfullBins - 1] +
+                                         (size_t)overfullReportOffsets[nOverfullBins - 1];
+            size_t nOtherContact = *scratchPad.pNumContacts;
+            *scratchPad.pNumContacts = nOtherContact + nOverfullBinContact;
+            if (*scratchPad.pNumContacts > idGeometryA.size()) {
+                contactEventArraysResize(*scratchPad.pNumContacts, idGeometryA, idGeometryB, contactType, granData);
+            }
+            if (nOverfullBinContact > 0) {
+                GPU_CALL(cudaMemset((void*)(granData->contactType + nOtherContact), SPHERE_SPHERE_CONTACT,
+                                    nOverfullBinContact * sizeof(contact_t)));
+                bin_occupation_kernels->kernel("populateContactPairsEachOverfullBin")
+                    .instantiate()
+                    .configure(dim3(nOverfullBins), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(simParams, granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+                            sphereIDsLookUpTable, overfullBinList, overfullReportOffsets,
+                            granData->idGeometryA + nOtherContact, granData->idGeometryB + nOtherContact);
+                GPU_CALL(cudaStreamSynchronize(this_stream));
+            }
+            DEME_STEP_STATS("%zu bins have too many spheres for the bin-wise CD kernels and took the overfull-bin path",
+                            nOverfullBins);
+        }
+
+        // With a multi-level bin hierarchy, the contacts between spheres of different levels are not found above. Each
+        // sphere queries the coarser-level bins it touches for them, and they go after the same-level sphere--sphere
+        // contacts. Temp vectors 4 and 5 are re-used again.
+        if (simParams->nBinLevels > 1) {
+            CD_temp_arr_bytes = simParams->nSpheresGM * sizeof(geoSphereTouches_t);
+            geoSphereTouches_t* numCrossLevelContacts =
+                (geoSphereTouches_t*)scratchPad.allocateTempVector(4, CD_temp_arr_bytes);
+            bin_occupation_kernels->kernel("getNumberOfCrossLevelContactsEachSphere")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_bodies), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+                .launch(simParams, granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+                        sphereIDsLookUpTable, numCrossLevelContacts, *pNumActiveBins);
+            GPU_CALL(cudaStreamSynchronize(this_stream));
+
+            CD_temp_arr_bytes = simParams->nSpheresGM * sizeof(contactPairs_t);
+            contactPairs_t* crossLevelReportOffsets =
+                (contactPairs_t*)scratchPad.allocateTempVector(5, CD_temp_arr_bytes);
+            cubDEMPrefixScan<geoSphereTouches_t, contactPairs_t, DEMSolverStateData>(
+                numCrossLevelContacts, crossLevelReportOffsets, simParams->nSpheresGM, this_stream, scratchPad);
+            size_t nCrossLevelContact = (size_t)numCrossLevelContacts[simParams->nSpheresGM - 1] +
+                                        (size_t)crossLevelReportOffsets[simParams->nSpheresGM - 1];
+            size_t nSameLevelContact = *scratchPad.pNumContacts;
+            *scratchPad.pNumContacts = nSameLevelContact + nCrossLevelContact;
+            if (*scratchPad.pNumContacts > idGeometryA.size()) {
+                contactEventArraysResize(*scratchPad.pNumContacts, idGeometryA, idGeometryB, contactType, granData);
+            }
+
+            if (nCrossLevelContact > 0) {
+                GPU_CALL(cudaMemset((void*)(granData->contactType + nSameLevelContact), SPHERE_SPHERE_CONTACT,
+                                    nCrossLevelContact * sizeof(contact_t)));
+                bin_occupation_kernels->kernel("populateCrossLevelContactPairs")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_bodies), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+                    .launch(simParams, granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+                            sphereIDsLookUpTable, crossLevelReportOffsets, granData->idGeometryA + nSameLevelContact,
+                            granData->idGeometryB + nSameLevelContact, *pNumActiveBins);
+                GPU_CALL(cudaStreamSynchronize(this_stream));
+            }
+        }
     }  // End of bin-wise contact detection subroutine
     timers.GetTimer("Find contact pairs").stop();
 
@@ -239,22 +332,30 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
         if ((!solverFlags.isHistoryless) || solverFlags.should_sort_pairs) {
             // All temp vectors are free now, and all of them are fairly long...
             size_t type_arr_bytes = (*scratchPad.pNumContacts) * sizeof(contact_t);
-            contact_t* contactType_sorted = (contact_t*)scratchPad.allocateTempVector(0, type_arr_bytes);
             size_t id_arr_bytes = (*scratchPad.pNumContacts) * sizeof(bodyID_t);
-            bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector(1, id_arr_bytes);
-            bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector(2, id_arr_bytes);
-
-            // TODO: But do I have to SortByKey twice?? Can I zip these value arrays together??
-            cubDEMSortByKeys<bodyID_t, bodyID_t, DEMSolverStateData>(granData->idGeometryA, idA_sorted,
-                                                                     granData->idGeometryB, idB_sorted,
-                                                                     *scratchPad.pNumContacts, this_stream, scratchPad);
-            cubDEMSortByKeys<bodyID_t, contact_t, DEMSolverStateData>(
-                granData->idGeometryA, idA_sorted, granData->contactType, contactType_sorted, *scratchPad.pNumContacts,
+            size_t key_arr_bytes = (*scratchPad.pNumContacts) * sizeof(uint64_t);
+            uint64_t* contactKeys = (uint64_t*)scratchPad.allocateTempVector(0, key_arr_bytes);
+            uint64_t* contactKeys_sorted = (uint64_t*)scratchPad.allocateTempVector(1, key_arr_bytes);
+            contact_t* contactType_sorted = (contact_t*)scratchPad.allocateTempVector(2, type_arr_bytes);
+
+            // idA and idB are packed into one 64-bit key, so one sort (carrying the contact type along) orders the
+            // contacts by idA, then idB. The sorted idA and idB are then unpacked from the keys.
+            size_t blocks_needed_for_keys =
+                (*scratchPad.pNumContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+            history_kernels->kernel("buildContactKeys")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_keys), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, this_stream)
+                .launch(contactKeys, granData->idGeometryA, granData->idGeometryB, *scratchPad.pNumContacts);
+            GPU_CALL(cudaStreamSynchronize(this_stream));
+            cubDEMSortByKeys<uint64_t, contact_t, DEMSolverStateData>(
+                contactKeys, contactKeys_sorted, granData->contactType, contactType_sorted, *scratchPad.pNumContacts,
                 this_stream, scratchPad);
-
-            // Copy back to idGeometry arrays
-            GPU_CALL(cudaMemcpy(granData->idGeometryA, idA_sorted, id_arr_bytes, cudaMemcpyDeviceToDevice));
-            GPU_CALL(cudaMemcpy(granData->idGeometryB, idB_sorted, id_arr_bytes, cudaMemcpyDeviceToDevice));
+            history_kernels->kernel("unpackContactKeys")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_keys), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, this_stream)
+                .launch(granData->idGeometryA, granData->idGeometryB, contactKeys_sorted,
+                        *scratchPad.pNumContacts);
+            GPU_CALL(cudaStreamSynchronize(this_stream));
             GPU_CALL(cudaMemcpy(granData->contactType, contactType_sorted, type_arr_bytes, cudaMemcpyDeviceToDevice));
             // DEME_DEBUG_PRINTF("New contact IDs (A):");
             // DEME_DEBUG_EXEC(displayArray<bodyID_t>(granData->idGeometryA, *scratchPad.pNumContacts));
@@ -265,90 +366,19 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_occupation_kernels,
 
             // For history-based models, construct the persistent contact map
             if (!solverFlags.isHistoryless) {
-                // This CD run and previous CD run could have different number of spheres in them. We pick the larger
-                // number to refer in building the persistent contact map to avoid potential problems.
-                size_t nSpheresSafe = (simParams->nSpheresGM > *scratchPad.pNumPrevSpheres)
-                                          ? simParams->nSpheresGM
-                                          : *scratchPad.pNumPrevSpheres;
-
-                // First, identify the new and old idA run-length
-                size_t run_length_bytes = nSpheresSafe * sizeof(geoSphereTouches_t);
-                geoSphereTouches_t* new_idA_runlength =
-                    (geoSphereTouches_t*)scratchPad.allocateTempVector(0, run_length_bytes);
-                size_t unique_id_bytes = nSpheresSafe * sizeof(bodyID_t);
-                bodyID_t* unique_new_idA = (bodyID_t*)scratchPad.allocateTempVector(1, unique_id_bytes);
-                size_t* pNumUniqueNewA = scratchPad.pTempSizeVar1;
-                cubDEMRunLengthEncode<bodyID_t, geoSphereTouches_t, DEMSolverStateData>(
-                    granData->idGeometryA, unique_new_idA, new_idA_runlength, pNumUniqueNewA, *scratchPad.pNumContacts,
-                    this_stream, scratchPad);
-
-                geoSphereTouches_t* old_idA_runlength =
-                    (geoSphereTouches_t*)scratchPad.allocateTempVector(2, run_length_bytes);
-                bodyID_t* unique_old_idA = (bodyID_t*)scratchPad.allocateTempVector(3, unique_id_bytes);
-                size_t* pNumUniqueOldA = scratchPad.pTempSizeVar2;
-                cubDEMRunLengthEncode<bodyID_t, geoSphereTouches_t, DEMSolverStateData>(
-                    granData->previous_idGeometryA, unique_old_idA, old_idA_runlength, pNumUniqueOldA,
-                    *(scratchPad.pNumPrevContacts), this_stream, scratchPad);
-
-                // Then, add zeros to run-length arrays such that even if a sphereID is not present in idA, it has a
-                // place in the run-length arrays that indicates 0 run-length
-                geoSphereTouches_t* new_idA_runlength_full =
-                    (geoSphereTouches_t*)scratchPad.allocateTempVector(4, run_length_bytes);
-                geoSphereTouches_t* old_idA_runlength_full =
-                    (geoSphereTouches_t*)scratchPad.allocateTempVector(5, run_length_bytes);
-                GPU_CALL(cudaMemset((void*)new_idA_runlength_full, 0, run_length_bytes));
-                GPU_CALL(cudaMemset((void*)old_idA_runlength_full, 0, run_length_bytes));
-                size_t blocks_needed_for_mapping =
-                    (*pNumUniqueNewA + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
-                if (blocks_needed_for_mapping > 0) {
-                    history_kernels->kernel("fillRunLengthArray")
-                        .instantiate()
-                        .configure(dim3(blocks_needed_for_mapping), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, this_stream)
-                        .launch(new_idA_runlength_full, unique_new_idA, new_idA_runlength, *pNumUniqueNewA);
-                    GPU_CALL(cudaStreamSynchronize(this_stream));
-                }
-
-                blocks_needed_for_mapping =
-                    (*pNumUniqueOldA + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
-                if (blocks_needed_for_mapping > 0) {
-                    history_kernels->kernel("fillRunLengthArray")
-                        .instantiate()
-                        .configure(dim3(blocks_needed_for_mapping), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, this_stream)
-                        .launch(old_idA_runlength_full, unique_old_idA, old_idA_runlength, *pNumUniqueOldA);
-                    GPU_CALL(cudaStreamSynchronize(this_stream));
-                }
-                // DEME_DEBUG_PRINTF("Unique contact IDs (A):");
-                // DEME_DEBUG_EXEC(displayArray<bodyID_t>(unique_new_idA, *pNumUniqueNewA));
-                // DEME_DEBUG_PRINTF("Unique contacts run-length:");
-                // DEME_DEBUG_EXEC(displayArray<geoSphereTouches_t>(new_idA_runlength, *pNumUniqueNewA));
-
-                // Then, prescan to find run-length offsets, in preparation for custom kernels
-                size_t scanned_runlength_bytes = nSpheresSafe * sizeof(contactPairs_t);
-                contactPairs_t* new_idA_scanned_runlength =
-                    (contactPairs_t*)scratchPad.allocateTempVector(0, scanned_runlength_bytes);
-                contactPairs_t* old_idA_scanned_runlength =
-                    (contactPairs_t*)scratchPad.allocateTempVector(1, scanned_runlength_bytes);
-                cubDEMPrefixScan<geoSphereTouches_t, contactPairs_t, DEMSolverStateData>(
-                    new_idA_runlength_full, new_idA_scanned_runlength, nSpheresSafe, this_stream, scratchPad);
-                cubDEMPrefixScan<geoSphereTouches_t, contactPairs_t, DEMSolverStateData>(
-                    old_idA_runlength_full, old_idA_scanned_runlength, nSpheresSafe, this_stream, scratchPad);
-
-                // Then, each thread will scan a sphere, if this sphere has non-zero run-length in both new and old idA,
-                // manually store the mapping. This mapping's elemental values are the indices of the corresponding
-                // contacts in the previous contact array.
+                // Each thread finds the partner of one new contact among the previous contacts, which were sorted
+                // the same way. The mapping's elemental values are the indices of the corresponding contacts in
+                // the previous contact array.
                 if (*scratchPad.pNumContacts > contactMapping.size()) {
                     contactMapping.resize(*scratchPad.pNumContacts);
                     granData->contactMapping = contactMapping.data();
                 }
-                blocks_needed_for_mapping = (nSpheresSafe + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
-                if (blocks_needed_for_mapping > 0) {
-                    history_kernels->kernel("buildPersistentMap")
-                        .instantiate()
-                        .configure(dim3(blocks_needed_for_mapping), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
-                        .launch(new_idA_runlength_full, old_idA_runlength_full, new_idA_scanned_runlength,
-                                old_idA_scanned_runlength, granData->contactMapping, granData, nSpheresSafe);
-                    GPU_CALL(cudaStreamSynchronize(this_stream));
-                }
+                history_kernels->kernel("buildPersistentMap")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_keys), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, this_stream)
+                    .launch(granData->contactMapping, granData, *scratchPad.pNumContacts,
+                            *(scratchPad.pNumPrevContacts));
+                GPU_CALL(cudaStreamSynchronize(this_stream));
                 // DEME_DEBUG_PRINTF("Contact mapping:");
                 // DEME_DEBUG_EXEC(displayArray<contactPairs_t>(granData->contactMapping,
                 // *scratchPad.pNumContacts));
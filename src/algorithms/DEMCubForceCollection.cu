@@ -17,7 +17,7 @@
 
 namespace deme {
 
-void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernels,
+void collectContactForces(std::shared_ptr<JitProgram>& collect_force_kernels,
                           DEMDataDT* granData,
                           const size_t nContactPairs,
                           const size_t nClumps,
@@ -29,19 +29,18 @@ void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernel
     // if contactPairArr_isFresh is false, then this allocation should not alter the size and content of the temp array
     // space, so the information in it can be used in the next iteration.
     size_t cachedArraySizeOwner = (size_t)2 * nContactPairs * sizeof(bodyID_t);
-    // Use temp vector 0 to store the flattened owner IDs. So the rest of the temp arrays start from number 1.
+    // Use temp vector 0 to store the flattened owner IDs, and temp vector 7 to store the owner-to-contact CSR (offsets
+    // then slots). Both only change when the contact pair array is refreshed by kT.
     bodyID_t* idAOwner = (bodyID_t*)scratchPad.allocateTempVector(0, cachedArraySizeOwner);
     bodyID_t* idBOwner = (bodyID_t*)(idAOwner + nContactPairs);
-    // size_t cachedArraySizeMass = (size_t)2 * nContactPairs * sizeof(float);
-    // size_t cachedArraySizeMOI = (size_t)2 * nContactPairs * sizeof(float3);
-    // float* massAOwner = (float*)scratchPad.allocateCachedMass(cachedArraySizeMass);
-    // float* massBOwner = (float*)(massAOwner + nContactPairs);
-    // float3* moiAOwner = (float3*)scratchPad.allocateCachedMOI(cachedArraySizeMOI);
-    // float3* moiBOwner = (float3*)(moiAOwner + nContactPairs);
+    size_t cachedArraySizeCSR = ((size_t)nClumps + 1 + (size_t)2 * nContactPairs) * sizeof(contactPairs_t);
+    contactPairs_t* ownerOffsets = (contactPairs_t*)scratchPad.allocateTempVector(7, cachedArraySizeCSR);
+    contactPairs_t* ownerSlots = (contactPairs_t*)(ownerOffsets + nClumps + 1);
 
-    // size_t blocks_needed_for_twice_contacts = (2 * nContactPairs + DEME_NUM_BODIES_PER_BLOCK - 1) /
-    // DEME_NUM_BODIES_PER_BLOCK;
     size_t blocks_needed_for_contacts = (nContactPairs + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
+    size_t blocks_needed_for_twice_contacts =
+        (2 * nContactPairs + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
+    size_t blocks_needed_for_owners = (nClumps + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
     if (contactPairArr_isFresh) {
         // First step, prepare the owner ID array (nContactPairs * bodyID_t) for usage in final reduction by key (do it
         // for both A and B)
@@ -60,24 +59,32 @@ void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernel
         GPU_CALL(cudaStreamSynchronize(this_stream));
         // displayArray<bodyID_t>(idAOwner, nContactPairs);
         // displayArray<bodyID_t>(idBOwner, nContactPairs);
+
+        // Then build the owner-to-contact CSR. Sorting the slots by their owners (this is done once per contact
+        // array, not every step) groups each owner's slots together, then the offsets are where the owners change.
+        bodyID_t* idOwner_sorted = (bodyID_t*)scratchPad.allocateTempVector(2, cachedArraySizeOwner);
+        size_t slotArraySize = (size_t)2 * nContactPairs * sizeof(contactPairs_t);
+        contactPairs_t* slots_unsorted = (contactPairs_t*)scratchPad.allocateTempVector(3, slotArraySize);
+        collect_force_kernels->kernel("fillOwnerSlots")
+            .instantiate()
+            .configure(dim3(blocks_needed_for_twice_contacts), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+            .launch(slots_unsorted, 2 * nContactPairs);
+        GPU_CALL(cudaStreamSynchronize(this_stream));
+        cubDEMSortByKeys<bodyID_t, contactPairs_t, DEMSolverStateData>(
+            idAOwner, idOwner_sorted, slots_unsorted, ownerSlots, nContactPairs * 2, this_stream, scratchPad);
+        collect_force_kernels->kernel("markOwnerSegments")
+            .instantiate()
+            .configure(dim3(blocks_needed_for_twice_contacts), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+            .launch(ownerOffsets, idOwner_sorted, 2 * nContactPairs, nClumps);
+        GPU_CALL(cudaStreamSynchronize(this_stream));
     }
 
     // ==============================================
     // 2nd, combine mass and force to get (contact pair-wise) acceleration, which will be reduced...
     // Note here allocated is temp vector, since unlike cached vectors, they cannot be reused in the next iteration
     size_t tempArraySizeAcc = (size_t)2 * nContactPairs * sizeof(float3);
-    size_t tempArraySizeAcc_sorted = (size_t)2 * nContactPairs * sizeof(float3);
-    size_t tempArraySizeOwnerAcc = (size_t)nClumps * sizeof(float3);
-    size_t tempArraySizeOwner = (size_t)nClumps * sizeof(bodyID_t);
     float3* acc_A = (float3*)scratchPad.allocateTempVector(1, tempArraySizeAcc);
     float3* acc_B = (float3*)(acc_A + nContactPairs);
-    float3* acc_A_sorted = (float3*)scratchPad.allocateTempVector(2, tempArraySizeAcc_sorted);
-    // float3* acc_B_sorted = (float3*)(acc_A_sorted  + nContactPairs);
-    bodyID_t* idAOwner_sorted = (bodyID_t*)scratchPad.allocateTempVector(3, cachedArraySizeOwner);
-    // bodyID_t* idBOwner_sorted = (bodyID_t*)(idAOwner_sorted + nContactPairs);
-    float3* accOwner = (float3*)scratchPad.allocateTempVector(
-        4, tempArraySizeOwnerAcc);  // can store both linear and angular acceleration
-    bodyID_t* uniqueOwner = (bodyID_t*)scratchPad.allocateTempVector(5, tempArraySizeOwner);
     // Collect accelerations for body A (modifier used to be h * h / l when we stored acc as h^2*acc)
     // NOTE!! If you pass floating point number to kernels, the number needs to be something like 1.f, not 1.0.
     // Somtimes 1.0 got converted to 0.f with the kernel call.
@@ -95,24 +102,11 @@ void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernel
     // displayFloat3(acc_A, 2 * nContactPairs);
     // displayFloat3(granData->contactForces, nContactPairs);
 
-    // Reducing the acceleration (2 * nContactPairs for both body A and B)
-    // Note: to do this, idAOwner needs to be sorted along with acc_A. So we sort first.
-    cubDEMSortByKeys<bodyID_t, float3, DEMSolverStateData>(idAOwner, idAOwner_sorted, acc_A, acc_A_sorted,
-                                                           nContactPairs * 2, this_stream, scratchPad);
-    // Then we reduce by key
-    // This variable stores the cub output of how many cub runs it executed for collecting forces
-    size_t* pForceCollectionRuns = scratchPad.pTempSizeVar1;
-    CubFloat3Add float3_add_op;
-    cubDEMReduceByKeys<bodyID_t, float3, CubFloat3Add, DEMSolverStateData>(
-        idAOwner_sorted, uniqueOwner, acc_A_sorted, accOwner, pForceCollectionRuns, float3_add_op, nContactPairs * 2,
-        this_stream, scratchPad);
-    // Then we stash acceleration
-    size_t blocks_needed_for_stashing =
-        (*pForceCollectionRuns + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
-    collect_force_kernels->kernel("stashElem")
+    // Reducing the acceleration (2 * nContactPairs for both body A and B): each owner gathers from its CSR segment
+    collect_force_kernels->kernel("gatherOwnerValues")
         .instantiate()
-        .configure(dim3(blocks_needed_for_stashing), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
-        .launch(granData->aX, granData->aY, granData->aZ, uniqueOwner, accOwner, *pForceCollectionRuns);
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+        .launch(granData->aX, granData->aY, granData->aZ, acc_A, ownerOffsets, ownerSlots, nClumps);
     GPU_CALL(cudaStreamSynchronize(this_stream));
     // displayArray<float>(granData->aX, nClumps);
     // displayArray<float>(granData->aY, nClumps);
@@ -122,8 +116,6 @@ void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernel
     // Then take care of angular accelerations
     float3* alpha_A = (float3*)(acc_A);  // Memory spaces for accelerations can be reused
     float3* alpha_B = (float3*)(acc_B);
-    float3* alpha_A_sorted = (float3*)(acc_A_sorted);
-    // float3* alpha_B_sorted = (float3*)(acc_B_sorted);
     // collect angular accelerations for body A (modifier used to be h * h when we stored acc as h^2*acc)
     collect_force_kernels->kernel("forceToAngAcc")
         .instantiate()
@@ -140,20 +132,11 @@ void collectContactForces(std::shared_ptr<jitify::Program>& collect_force_kernel
                 granData->oriQz, granData->contactForces, granData->contactTorque_convToForce, idBOwner, -1.f,
                 nContactPairs, granData);
     GPU_CALL(cudaStreamSynchronize(this_stream));
-    // Reducing the angular acceleration (2 * nContactPairs for both body A and B)
-    // Note: to do this, idAOwner needs to be sorted along with alpha_A. So we sort first.
-    cubDEMSortByKeys<bodyID_t, float3, DEMSolverStateData>(idAOwner, idAOwner_sorted, alpha_A, alpha_A_sorted,
-                                                           nContactPairs * 2, this_stream, scratchPad);
-    // Then we reduce
-    cubDEMReduceByKeys<bodyID_t, float3, CubFloat3Add, DEMSolverStateData>(
-        idAOwner_sorted, uniqueOwner, alpha_A_sorted, accOwner, pForceCollectionRuns, float3_add_op, nContactPairs * 2,
-        this_stream, scratchPad);
-    // Then we stash angular acceleration
-    blocks_needed_for_stashing = (*pForceCollectionRuns + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
-    collect_force_kernels->kernel("stashElem")
+    // Reducing the angular acceleration, using the same CSR
+    collect_force_kernels->kernel("gatherOwnerValues")
         .instantiate()
-        .configure(dim3(blocks_needed_for_stashing), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
-        .launch(granData->alphaX, granData->alphaY, granData->alphaZ, uniqueOwner, accOwner, *pForceCollectionRuns);
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+        .launch(granData->alphaX, granData->alphaY, granData->alphaZ, alpha_A, ownerOffsets, ownerSlots, nClumps);
     GPU_CALL(cudaStreamSynchronize(this_stream));
 }
 
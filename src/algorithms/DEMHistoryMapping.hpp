@@ -0,0 +1,137 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HISTORY_MAPPING_HPP
+#define DEME_HISTORY_MAPPING_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <nvmath/helper_math.cuh>
+#include <DEM/Defines.h>
+#include <core/utils/HostThreadPool.h>
+#include <algorithms/DEMHostWrappers.hpp>
+
+// Host (CPU) version of the persistent contact mapping stage, following DEMHistoryMappingKernels.cu step by step. It is
+// what the host CD uses, and it also serves as a GPU-free reference to validate and benchmark the mapping against.
+//
+// A contact is identified by (idA, idB, contactType). idA and idB are packed into a 64-bit key, and the contact arrays
+// are sorted by it in one go. Since the previous contact arrays were sorted the same way, the partner of a new contact
+// is found by searching for its key among the previous keys, then for its contact type among the (rarely more than one)
+// previous contacts with that key.
+
+namespace deme {
+
+inline uint64_t hostContactKey(const bodyID_t& idA, const bodyID_t& idB) {
+    return ((uint64_t)idA << (sizeof(bodyID_t) * DEME_BITS_PER_BYTE)) | (uint64_t)idB;
+}
+
+// Sort the contact arrays by (idA, idB) in one go. keys and keys_sorted hold n items each, type_sorted holds n items.
+template <typename T1>
+inline void hostSortContactsByKey(bodyID_t* idA,
+                                  bodyID_t* idB,
+                                  contact_t* type,
+                                  uint64_t* keys,
+                                  uint64_t* keys_sorted,
+                                  contact_t* type_sorted,
+                                  size_t n,
+                                  HostThreadPool& pool,
+                                  T1& scratchPad) {
+    pool.parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            keys[i] = hostContactKey(idA[i], idB[i]);
+    });
+    hostDEMSortByKeys(keys, keys_sorted, type, type_sorted, n, pool, scratchPad);
+    pool.parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            idA[i] = (bodyID_t)(keys_sorted[i] >> (sizeof(bodyID_t) * DEME_BITS_PER_BYTE));
+            idB[i] = (bodyID_t)keys_sorted[i];
+        }
+    });
+    std::memcpy(type, type_sorted, n * sizeof(contact_t));
+}
+
+// Build the contact mapping: for each new contact, the index of the same contact in the previous contact arrays, or
+// NULL_MAPPING_PARTNER if it is a new one. Fake contacts (NOT_A_CONTACT) have no partner. If a contact appears more
+// than once in the previous arrays, the first one is its partner. Both contact arrays must be sorted by their keys.
+inline void hostBuildPersistentMap(const bodyID_t* idA,
+                                   const bodyID_t* idB,
+                                   const contact_t* type,
+                                   size_t nNew,
+                                   const bodyID_t* old_idA,
+                                   const bodyID_t* old_idB,
+                                   const contact_t* old_type,
+                                   size_t nOld,
+                                   contactPairs_t* mapping,
+                                   HostThreadPool& pool) {
+    pool.parallelFor(nNew, [&](size_t begin, size_t end) {
+        if (begin >= end)
+            return;
+        // Binary search for where the first key of this chunk is among the previous keys (the kernel does this for
+        // every contact); the rest of the chunk then merges along, since the new keys are in order too
+        const uint64_t firstKey = hostContactKey(idA[begin], idB[begin]);
+        size_t lo = 0, hi = nOld;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (hostContactKey(old_idA[mid], old_idB[mid]) < firstKey)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        size_t j = lo;
+        for (size_t i = begin; i < end; i++) {
+            const uint64_t key = hostContactKey(idA[i], idB[i]);
+            while (j < nOld && hostContactKey(old_idA[j], old_idB[j]) < key)
+                j++;
+            contactPairs_t my_partner = NULL_MAPPING_PARTNER;
+            if (type[i] != NOT_A_CONTACT) {
+                for (size_t k = j; k < nOld && hostContactKey(old_idA[k], old_idB[k]) == key; k++) {
+                    if (old_type[k] == type[i]) {
+                        my_partner = k;
+                        break;
+                    }
+                }
+            }
+            mapping[i] = my_partner;
+        }
+    });
+}
+
+// The mapping as it used to be built: each new contact looks for its partner linearly among the previous contacts of
+// the same idA. It only needs the contact arrays grouped by idA, but is quadratic in the number of contacts an idA has.
+// It is kept as the reference that hostBuildPersistentMap is validated against.
+inline void hostBuildPersistentMapLinearScan(const bodyID_t* idA,
+                                             const bodyID_t* idB,
+                                             const contact_t* type,
+                                             size_t nNew,
+                                             const bodyID_t* old_idA,
+                                             const bodyID_t* old_idB,
+                                             const contact_t* old_type,
+                                             size_t nOld,
+                                             size_t nSpheresSafe,
+                                             contactPairs_t* mapping) {
+    std::vector<contactPairs_t> old_offsets(nSpheresSafe + 1, 0);
+    for (size_t i = 0; i < nOld; i++)
+        old_offsets[old_idA[i] + 1]++;
+    for (size_t i = 0; i < nSpheresSafe; i++)
+        old_offsets[i + 1] += old_offsets[i];
+    for (size_t i = 0; i < nNew; i++) {
+        contactPairs_t my_partner = NULL_MAPPING_PARTNER;
+        if (type[i] != NOT_A_CONTACT) {
+            for (contactPairs_t j = old_offsets[idA[i]]; j < old_offsets[idA[i] + 1]; j++) {
+                if (idB[i] == old_idB[j] && type[i] == old_type[j]) {
+                    my_partner = j;
+                    break;
+                }
+            }
+        }
+        mapping[i] = my_partner;
+    }
+}
+
+}  // namespace deme
+
+#endif
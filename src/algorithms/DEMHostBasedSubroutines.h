@@ -0,0 +1,47 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HOST_SUBROUTINES
+#define DEME_HOST_SUBROUTINES
+
+#include <core/utils/ManagedAllocator.hpp>
+#include <core/utils/HostJitHelper.h>
+#include <nvmath/helper_math.cuh>
+#include <DEM/Structs.h>
+#include <DEM/Defines.h>
+
+namespace deme {
+
+// Host (CPU) version of contactDetection. It uses the same DEMDataKT arrays as inputs and produces the same contact
+// pair arrays (and contact mapping) as the GPU version, but no kernel is launched.
+void hostContactDetection(DEMDataKT* granData,
+                          DEMSimParams* simParams,
+                          SolverFlags& solverFlags,
+                          VERBOSITY& verbosity,
+                          // The following arrays may need to change sizes, so we can't pass pointers
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& idGeometryA,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& idGeometryB,
+                          std::vector<contact_t, ManagedAllocator<contact_t>>& contactType,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& previous_idGeometryA,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& previous_idGeometryB,
+                          std::vector<contact_t, ManagedAllocator<contact_t>>& previous_contactType,
+                          std::vector<contactPairs_t, ManagedAllocator<contactPairs_t>>& contactMapping,
+                          DEMSolverStateData& scratchPad,
+                          SolverTimers& timers);
+
+// Host (CPU) version of collectContactForces. The kernels in collect_force_kernels are the DEMCollectForceKernels
+// compiled as host code.
+void hostCollectContactForces(HostJitProgram& collect_force_kernels,
+                              DEMDataDT* granData,
+                              const size_t nContactPairs,
+                              const size_t nClumps,
+                              bool contactPairArr_isFresh,
+                              unsigned int nThreads,
+                              DEMSolverStateData& scratchPad,
+                              SolverTimers& timers);
+
+}  // namespace deme
+
+#endif
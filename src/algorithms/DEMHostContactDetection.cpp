@@ -0,0 +1,788 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+#include <algorithms/DEMHostBasedSubroutines.h>
+#include <algorithms/DEMHistoryMapping.hpp>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+////////////////////////////////////////////////////////////////////////////////
+// Host counterparts of the device helpers used in CD kernels. They follow the
+// kernels' arithmetic (including the precision of each intermediate quantity),
+// so that the host and GPU CD produce the same contact pairs.
+////////////////////////////////////////////////////////////////////////////////
+
+// Exclusive prefix scan from in to out, and returns the total sum
+template <typename T1, typename T2>
+inline size_t hostExclusiveScan(T1* in, T2* out, size_t n, HostThreadPool& pool, DEMSolverStateData& scratchPad) {
+    if (n == 0)
+        return 0;
+    hostDEMPrefixScan(in, out, n, pool, scratchPad);
+    return (size_t)out[n - 1] + (size_t)in[n - 1];
+}
+
+// Get the location of a sphere component and its (expanded) CD radius. T2 is the precision of the radius, and it is
+// double in bin--sphere kernels and float in bin-wise contact kernels.
+template <typename T2>
+inline void hostGetSphereCDInfo(double& X,
+                                double& Y,
+                                double& Z,
+                                T2& radius,
+                                bodyID_t& ownerID,
+                                const bodyID_t& sphereID,
+                                const DEMDataKT* granData,
+                                const DEMSimParams* simParams,
+                                const bool& useClumpJitify) {
+    ownerID = granData->ownerClumpBody[sphereID];
+    // If clump templates are jitified, then kT has the full template arrays, and the component offset (ext version)
+    // tells where to find this sphere's info
+    size_t myCompOffset = (useClumpJitify) ? (size_t)granData->clumpComponentOffsetExt[sphereID] : (size_t)sphereID;
+    float myRelPosX = granData->relPosSphereX[myCompOffset];
+    float myRelPosY = granData->relPosSphereY[myCompOffset];
+    float myRelPosZ = granData->relPosSphereZ[myCompOffset];
+    radius = granData->radiiSphere[myCompOffset];
+    radius += simParams->beta;
+
+    double ownerX, ownerY, ownerZ;
+    hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+        ownerX, ownerY, ownerZ, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+        granData->locZ[ownerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+    hostApplyOriQToVector3<float, oriQ_t>(myRelPosX, myRelPosY, myRelPosZ, granData->oriQw[ownerID],
+                                          granData->oriQx[ownerID], granData->oriQy[ownerID],
+                                          granData->oriQz[ownerID]);
+    X = ownerX + (double)myRelPosX;
+    Y = ownerY + (double)myRelPosY;
+    Z = ownerZ + (double)myRelPosZ;
+}
+
+inline binID_t hostGetPointBinID(const double& X,
+                                 const double& Y,
+                                 const double& Z,
+                                 const double& binSize,
+                                 const binID_t& nbX,
+                                 const binID_t& nbY) {
+    binID_t binIDX = X / binSize;
+    binID_t binIDY = Y / binSize;
+    binID_t binIDZ = Z / binSize;
+    return binIDX + binIDY * nbX + binIDZ * nbX * nbY;
+}
+
+inline unsigned int hostGetSphereBinLevel(const double& radius, const double& binSize, const unsigned int& nBinLevels) {
+    unsigned int level = 0;
+    double levelBinSize = binSize;
+    while (level + 1 < nBinLevels && 2.0 * radius > levelBinSize) {
+        level++;
+        levelBinSize *= 2.0;
+    }
+    return level;
+}
+
+inline void hostGetBinLevelInfo(double& levelBinSize,
+                                binID_t& nbX,
+                                binID_t& nbY,
+                                binID_t& offset,
+                                const unsigned int& level,
+                                const DEMSimParams* simParams) {
+    levelBinSize = simParams->binSize;
+    nbX = simParams->nbX;
+    nbY = simParams->nbY;
+    binID_t nbZ = simParams->nbZ;
+    offset = 0;
+    for (unsigned int i = 0; i < level; i++) {
+        offset += nbX * nbY * nbZ;
+        nbX = (nbX + 1) / 2;
+        nbY = (nbY + 1) / 2;
+        nbZ = (nbZ + 1) / 2;
+        levelBinSize *= 2.0;
+    }
+}
+
+inline unsigned int hostGetBinLevel(const binID_t& binID, const DEMSimParams* simParams) {
+    binID_t nbX = simParams->nbX, nbY = simParams->nbY, nbZ = simParams->nbZ;
+    binID_t levelEnd = nbX * nbY * nbZ;
+    unsigned int level = 0;
+    while (level + 1 < simParams->nBinLevels && binID >= levelEnd) {
+        level++;
+        nbX = (nbX + 1) / 2;
+        nbY = (nbY + 1) / 2;
+        nbZ = (nbZ + 1) / 2;
+        levelEnd += nbX * nbY * nbZ;
+    }
+    return level;
+}
+
+inline contact_t hostCheckSpheresOverlap(const double& XA,
+                                         const double& YA,
+                                         const double& ZA,
+                                         const double& radA,
+                                         const double& XB,
+                                         const double& YB,
+                                         const double& ZB,
+                                         const double& radB,
+                                         double& CPX,
+                                         double& CPY,
+                                         double& CPZ) {
+    double centerDist2 = (XA - XB) * (XA - XB) + (YA - YB) * (YA - YB) + (ZA - ZB) * (ZA - ZB);
+    if (centerDist2 > (radA + radB) * (radA + radB)) {
+        return NOT_A_CONTACT;
+    }
+    // Same as the device version, the B-to-A direction is normalized in single precision
+    float B2AVecX = XA - XB;
+    float B2AVecY = YA - YB;
+    float B2AVecZ = ZA - ZB;
+    float magnitude = std::sqrt(B2AVecX * B2AVecX + B2AVecY * B2AVecY + B2AVecZ * B2AVecZ);
+    B2AVecX /= magnitude;
+    B2AVecY /= magnitude;
+    B2AVecZ /= magnitude;
+    double halfOverlapDepth = (radA + radB - std::sqrt(centerDist2)) / 2.0;
+    // From center of B, towards center of A, move a distance of radB, then backtrack a bit, for half the overlap depth
+    CPX = XB + (radB - halfOverlapDepth) * B2AVecX;
+    CPY = YB + (radB - halfOverlapDepth) * B2AVecY;
+    CPZ = ZB + (radB - halfOverlapDepth) * B2AVecZ;
+    return SPHERE_SPHERE_CONTACT;
+}
+
+inline void hostWrapIntoPeriod(double& X, const bool& periodic, const double& period) {
+    if (periodic) {
+        X -= period * std::floor(X / period);
+        // Rounding can land it right on the period
+        if (X >= period)
+            X -= period;
+    }
+}
+
+inline void hostWrapIntoPeriodicDomain(double& X, double& Y, double& Z, const DEMSimParams* simParams) {
+    hostWrapIntoPeriod(X, simParams->periodicX, simParams->periodX);
+    hostWrapIntoPeriod(Y, simParams->periodicY, simParams->periodY);
+    hostWrapIntoPeriod(Z, simParams->periodicZ, simParams->periodZ);
+}
+
+// Sphere B is tested at its periodic image nearest to A, and the contact point is brought back into the periodic
+// domain, where the bins are
+inline contact_t hostCheckSpheresOverlapPeriodic(const double& XA,
+                                                 const double& YA,
+                                                 const double& ZA,
+                                                 const double& radA,
+                                                 double XB,
+                                                 double YB,
+                                                 double ZB,
+                                                 const double& radB,
+                                                 double& CPX,
+                                                 double& CPY,
+                                                 double& CPZ,
+                                                 const DEMSimParams* simParams) {
+    if (simParams->periodicX)
+        XB -= simParams->periodX * std::round((XB - XA) / simParams->periodX);
+    if (simParams->periodicY)
+        YB -= simParams->periodY * std::round((YB - YA) / simParams->periodY);
+    if (simParams->periodicZ)
+        ZB -= simParams->periodZ * std::round((ZB - ZA) / simParams->periodZ);
+    contact_t contact_type = hostCheckSpheresOverlap(XA, YA, ZA, radA, XB, YB, ZB, radB, CPX, CPY, CPZ);
+    if (contact_type)
+        hostWrapIntoPeriodicDomain(CPX, CPY, CPZ, simParams);
+    return contact_type;
+}
+
+// Same as getSphereBinRange: num bins from lo on, wrapping around after nbPeriod along periodic directions
+inline void hostGetSphereBinRange(unsigned int& lo,
+                                  unsigned int& num,
+                                  unsigned int& nbPeriod,
+                                  const double& myBin,
+                                  const double& span,
+                                  const bool& periodic,
+                                  const double& period,
+                                  const double& levelBinSize) {
+    if (!periodic) {
+        lo = (unsigned int)(myBin - span);
+        num = (unsigned int)(myBin + span) - lo + 1;
+        nbPeriod = 0;
+        return;
+    }
+    const double periodBins = period / levelBinSize;
+    nbPeriod = (unsigned int)std::ceil(periodBins);
+    double lower = myBin - span, upper = myBin + span;
+    if (upper - lower >= periodBins) {
+        lo = 0;
+        num = nbPeriod;
+        return;
+    }
+    if (lower < 0.) {
+        lower += periodBins;
+        upper += periodBins;
+    }
+    lo = std::min((unsigned int)lower, nbPeriod - 1);
+    if (upper < periodBins) {
+        num = std::min((unsigned int)upper, nbPeriod - 1) - lo + 1;
+    } else {
+        num = std::min(nbPeriod - lo + std::min((unsigned int)(upper - periodBins), nbPeriod - 1) + 1, nbPeriod);
+    }
+}
+
+inline unsigned int hostGetBinIndexInRange(const unsigned int& lo,
+                                           const unsigned int& n,
+                                           const unsigned int& nbPeriod) {
+    unsigned int i = lo + n;
+    return (nbPeriod > 0 && i >= nbPeriod) ? i - nbPeriod : i;
+}
+
+// The bins a sphere touches on a level, as ranges along each direction
+struct HostSphereBinRange {
+    unsigned int loX, loY, loZ, numX, numY, numZ, nbPeriodX, nbPeriodY, nbPeriodZ;
+    HostSphereBinRange(double X,
+                       double Y,
+                       double Z,
+                       const double& radius,
+                       const double& levelBinSize,
+                       const DEMSimParams* simParams) {
+        // Along periodic directions, the bins cover the period, so the sphere is binned at its image in there
+        hostWrapIntoPeriodicDomain(X, Y, Z, simParams);
+        const double span = radius / levelBinSize;
+        hostGetSphereBinRange(loX, numX, nbPeriodX, X / levelBinSize, span, simParams->periodicX, simParams->periodX,
+                              levelBinSize);
+        hostGetSphereBinRange(loY, numY, nbPeriodY, Y / levelBinSize, span, simParams->periodicY, simParams->periodY,
+                              levelBinSize);
+        hostGetSphereBinRange(loZ, numZ, nbPeriodZ, Z / levelBinSize, span, simParams->periodicZ, simParams->periodZ,
+                              levelBinSize);
+    }
+    unsigned int count() const { return numX * numY * numZ; }
+    // Call func(i, j, k) for each bin in the ranges, in the same order as the kernels
+    template <typename Func>
+    void forEach(const Func& func) const {
+        for (unsigned int kk = 0; kk < numZ; kk++) {
+            unsigned int k = hostGetBinIndexInRange(loZ, kk, nbPeriodZ);
+            for (unsigned int jj = 0; jj < numY; jj++) {
+                unsigned int j = hostGetBinIndexInRange(loY, jj, nbPeriodY);
+                for (unsigned int ii = 0; ii < numX; ii++) {
+                    func(hostGetBinIndexInRange(loX, ii, nbPeriodX), j, k);
+                }
+            }
+        }
+    }
+};
+
+// Check the contact between a sphere and analytical entity objB, family mask included. Unlike sphere pairs, this uses
+// no periodic image: analytical objects are not imaged in a periodic domain (see InstructBoxDomainPeriodic), the same
+// as in the GPU kernels and in dT's force calculation. Imaging them would not be right anyway for a one-sided plane
+// whose normal is along a periodic direction, as its nearest image can be on the sphere's back side.
+inline contact_t hostCheckSphereAnalEntityOverlap(const double& sphX,
+                                                  const double& sphY,
+                                                  const double& sphZ,
+                                                  const double& sphRadius,
+                                                  const unsigned int& sphFamilyNum,
+                                                  const objID_t& objB,
+                                                  const DEMDataKT* granData,
+                                                  const DEMSimParams* simParams) {
+    bodyID_t objBOwner = granData->ownerAnalBody[objB];
+    unsigned int objFamilyNum = granData->familyID[objBOwner];
+    unsigned int maskMatID = locateMaskPair<unsigned int>(sphFamilyNum, objFamilyNum);
+    // If marked no contact, skip
+    if (granData->familyMasks[maskMatID] != DONT_PREVENT_CONTACT) {
+        return NOT_A_CONTACT;
+    }
+    double ownerX, ownerY, ownerZ;
+    hostVoxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+        ownerX, ownerY, ownerZ, granData->voxelID[objBOwner], granData->locX[objBOwner], granData->locY[objBOwner],
+        granData->locZ[objBOwner], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+    const float ownerOriQw = granData->oriQw[objBOwner];
+    const float ownerOriQx = granData->oriQx[objBOwner];
+    const float ownerOriQy = granData->oriQy[objBOwner];
+    const float ownerOriQz = granData->oriQz[objBOwner];
+    float objBRelPosX = granData->relPosEntityX[objB];
+    float objBRelPosY = granData->relPosEntityY[objB];
+    float objBRelPosZ = granData->relPosEntityZ[objB];
+    float objBRotX = granData->oriEntityX[objB];
+    float objBRotY = granData->oriEntityY[objB];
+    float objBRotZ = granData->oriEntityZ[objB];
+    hostApplyOriQToVector3<float, oriQ_t>(objBRelPosX, objBRelPosY, objBRelPosZ, ownerOriQw, ownerOriQx, ownerOriQy,
+                                          ownerOriQz);
+    hostApplyOriQToVector3<float, oriQ_t>(objBRotX, objBRotY, objBRotZ, ownerOriQw, ownerOriQx, ownerOriQy,
+                                          ownerOriQz);
+    double objBPosX = ownerX + (double)objBRelPosX;
+    double objBPosY = ownerY + (double)objBRelPosY;
+    double objBPosZ = ownerZ + (double)objBRelPosZ;
+
+    switch (granData->typeAnalEntity[objB]) {
+        case (ANAL_OBJ_TYPE_PLANE): {
+            // Plane is directional, and the direction is given by plane rotation
+            const double dist = (sphX - objBPosX) * (double)objBRotX + (sphY - objBPosY) * (double)objBRotY +
+                                (sphZ - objBPosZ) * (double)objBRotZ;
+            if (dist > sphRadius + simParams->beta) {
+                return NOT_A_CONTACT;
+            }
+            return SPHERE_PLANE_CONTACT;
+        }
+        case (ANAL_OBJ_TYPE_PLATE): {
+            return NOT_A_CONTACT;
+        }
+        default:
+            return NOT_A_CONTACT;
+    }
+}
+
+inline void hostContactEventArraysResize(size_t nContactPairs,
+                                         std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& idGeometryA,
+                                         std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& idGeometryB,
+                                         std::vector<contact_t, ManagedAllocator<contact_t>>& contactType,
+                                         DEMDataKT* granData) {
+    idGeometryA.resize(nContactPairs);
+    idGeometryB.resize(nContactPairs);
+    contactType.resize(nContactPairs);
+
+    // Re-pack pointers in case the arrays got reallocated
+    granData->idGeometryA = idGeometryA.data();
+    granData->idGeometryB = idGeometryB.data();
+    granData->contactType = contactType.data();
+}
+
+// Go through the sphere pairs in one bin and call func(sphereA, sphereB) for each pair that is a valid contact
+// registered in this bin. The scratch vectors are passed in so they can be re-used among bins.
+template <typename Func>
+inline void hostProcessBinContacts(const binID_t& binID,
+                                   const bodyID_t* sphereIDs,
+                                   const spheresBinTouches_t& nBodies,
+                                   const DEMDataKT* granData,
+                                   const DEMSimParams* simParams,
+                                   const bool& useClumpJitify,
+                                   std::vector<bodyID_t>& ownerIDs,
+                                   std::vector<family_t>& ownerFamily,
+                                   std::vector<float>& radii,
+                                   std::vector<double>& bodyX,
+                                   std::vector<double>& bodyY,
+                                   std::vector<double>& bodyZ,
+                                   const Func& func) {
+    // Unlike the kernels, there is no DEME_MAX_SPHERES_PER_BIN limit here
+    ownerIDs.resize(nBodies);
+    ownerFamily.resize(nBodies);
+    radii.resize(nBodies);
+    bodyX.resize(nBodies);
+    bodyY.resize(nBodies);
+    bodyZ.resize(nBodies);
+    for (spheresBinTouches_t i = 0; i < nBodies; i++) {
+        hostGetSphereCDInfo<float>(bodyX[i], bodyY[i], bodyZ[i], radii[i], ownerIDs[i], sphereIDs[i], granData,
+                                   simParams, useClumpJitify);
+        ownerFamily[i] = granData->familyID[ownerIDs[i]];
+    }
+
+    double levelBinSize;
+    binID_t levelNbX, levelNbY, levelOffset;
+    hostGetBinLevelInfo(levelBinSize, levelNbX, levelNbY, levelOffset, hostGetBinLevel(binID, simParams), simParams);
+
+    for (spheresBinTouches_t bodyA = 0; bodyA < nBodies; bodyA++) {
+        for (spheresBinTouches_t bodyB = bodyA + 1; bodyB < nBodies; bodyB++) {
+            // For 2 bodies to be considered in contact, the contact point must be in this bin (to avoid
+            // double-counting), and they do not belong to the same clump
+            if (ownerIDs[bodyA] == ownerIDs[bodyB])
+                continue;
+
+            unsigned int maskMatID = locateMaskPair<unsigned int>(ownerFamily[bodyA], ownerFamily[bodyB]);
+            // If marked no contact, skip ths iteration
+            if (granData->familyMasks[maskMatID] != DONT_PREVENT_CONTACT) {
+                continue;
+            }
+
+            double contactPntX, contactPntY, contactPntZ;
+            bool in_contact = hostCheckSpheresOverlapPeriodic(
+                bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA], bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB],
+                radii[bodyB], contactPntX, contactPntY, contactPntZ, simParams);
+            if (!in_contact)
+                continue;
+            binID_t contactPntBin = levelOffset + hostGetPointBinID(contactPntX, contactPntY, contactPntZ,
+                                                                    levelBinSize, levelNbX, levelNbY);
+            if (contactPntBin == binID) {
+                func(sphereIDs[bodyA], sphereIDs[bodyB]);
+            }
+        }
+    }
+}
+
+// Go through the coarser-level bins that a sphere touches and call func(otherSphere) for each sphere there that is in
+// contact with it, if the contact is registered in that bin
+template <typename Func>
+inline void hostProcessCrossLevelContacts(const bodyID_t& myID,
+                                          const bodyID_t* sphereIDsEachBinTouches_sorted,
+                                          const binID_t* activeBinIDs,
+                                          const spheresBinTouches_t* numSpheresBinTouches,
+                                          const binSphereTouchPairs_t* sphereIDsLookUpTable,
+                                          const size_t& nActiveBins,
+                                          const DEMDataKT* granData,
+                                          const DEMSimParams* simParams,
+                                          const bool& useClumpJitify,
+                                          const Func& func) {
+    // Like the kernel, bins are found with the double-precision radius, and the contact is tested with the float one
+    double myX, myY, myZ, myBinRadius;
+    float myRadius;
+    bodyID_t myOwnerID;
+    hostGetSphereCDInfo<double>(myX, myY, myZ, myBinRadius, myOwnerID, myID, granData, simParams, useClumpJitify);
+    hostGetSphereCDInfo<float>(myX, myY, myZ, myRadius, myOwnerID, myID, granData, simParams, useClumpJitify);
+    const unsigned int myFamily = granData->familyID[myOwnerID];
+    const unsigned int myLevel = hostGetSphereBinLevel(myBinRadius, simParams->binSize, simParams->nBinLevels);
+
+    for (unsigned int level = myLevel + 1; level < simParams->nBinLevels; level++) {
+        double levelBinSize;
+        binID_t levelNbX, levelNbY, levelOffset;
+        hostGetBinLevelInfo(levelBinSize, levelNbX, levelNbY, levelOffset, level, simParams);
+        HostSphereBinRange binRange(myX, myY, myZ, myBinRadius, levelBinSize, simParams);
+        binRange.forEach([&](unsigned int i, unsigned int j, unsigned int k) {
+            binID_t thisBinID = levelOffset + (binID_t)i + (binID_t)j * levelNbX + (binID_t)k * levelNbX * levelNbY;
+            const binID_t* found = std::lower_bound(activeBinIDs, activeBinIDs + nActiveBins, thisBinID);
+            if (found == activeBinIDs + nActiveBins || *found != thisBinID)
+                return;
+            size_t myActiveID = found - activeBinIDs;
+
+            const bodyID_t* sphereIDs = sphereIDsEachBinTouches_sorted + sphereIDsLookUpTable[myActiveID];
+            for (spheresBinTouches_t n = 0; n < numSpheresBinTouches[myActiveID]; n++) {
+                double otherX, otherY, otherZ;
+                float otherRadius;
+                bodyID_t otherOwnerID;
+                hostGetSphereCDInfo<float>(otherX, otherY, otherZ, otherRadius, otherOwnerID, sphereIDs[n], granData,
+                                           simParams, useClumpJitify);
+                if (otherOwnerID == myOwnerID)
+                    continue;
+                unsigned int maskMatID =
+                    locateMaskPair<unsigned int>(myFamily, (unsigned int)granData->familyID[otherOwnerID]);
+                if (granData->familyMasks[maskMatID] != DONT_PREVENT_CONTACT) {
+                    continue;
+                }
+
+                double contactPntX, contactPntY, contactPntZ;
+                bool in_contact = hostCheckSpheresOverlapPeriodic(myX, myY, myZ, myRadius, otherX, otherY, otherZ,
+                                                                  otherRadius, contactPntX, contactPntY, contactPntZ,
+                                                                  simParams);
+                if (!in_contact)
+                    continue;
+                binID_t contactPntBin = levelOffset + hostGetPointBinID(contactPntX, contactPntY, contactPntZ,
+                                                                        levelBinSize, levelNbX, levelNbY);
+                if (contactPntBin == thisBinID) {
+                    func(sphereIDs[n]);
+                }
+            }
+        });
+    }
+}
+
+void hostContactDetection(DEMDataKT* granData,
+                          DEMSimParams* simParams,
+                          SolverFlags& solverFlags,
+                          VERBOSITY& verbosity,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& idGeometryA,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& idGeometryB,
+                          std::vector<contact_t, ManagedAllocator<contact_t>>& contactType,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& previous_idGeometryA,
+                          std::vector<bodyID_t, ManagedAllocator<bodyID_t>>& previous_idGeometryB,
+                          std::vector<contact_t, ManagedAllocator<contact_t>>& previous_contactType,
+                          std::vector<contactPairs_t, ManagedAllocator<contactPairs_t>>& contactMapping,
+                          DEMSolverStateData& scratchPad,
+                          SolverTimers& timers) {
+    // total bytes needed for temp arrays in contact detection
+    size_t CD_temp_arr_bytes = 0;
+    const size_t nSpheres = simParams->nSpheresGM;
+    const unsigned int nThreads = solverFlags.nHostThreads;
+    HostThreadPool& pool = HostThreadPool::Shared(nThreads);
+    const bool useClumpJitify = solverFlags.useClumpJitify;
+    // Host CD has no limit on the number of spheres in a bin, so no bin is overfull
+    scratchPad.numOverfullBins = 0;
+
+    timers.GetTimer("Discretize domain").start();
+    // 1st step: register the number of sphere--bin touching pairs for each sphere, and how many analytical objects each
+    // sphere touches
+    CD_temp_arr_bytes = nSpheres * sizeof(binsSphereTouches_t);
+    binsSphereTouches_t* numBinsSphereTouches =
+        (binsSphereTouches_t*)scratchPad.allocateTempVector(0, CD_temp_arr_bytes);
+    CD_temp_arr_bytes = nSpheres * sizeof(objID_t);
+    objID_t* numAnalGeoSphereTouches = (objID_t*)scratchPad.allocateTempVector(2, CD_temp_arr_bytes);
+    hostParallelFor(nSpheres, nThreads, [&](size_t begin, size_t end) {
+        for (size_t sphereID = begin; sphereID < end; sphereID++) {
+            double myPosX, myPosY, myPosZ, myRadius;
+            bodyID_t myOwnerID;
+            hostGetSphereCDInfo<double>(myPosX, myPosY, myPosZ, myRadius, myOwnerID, sphereID, granData, simParams,
+                                        useClumpJitify);
+            double levelBinSize;
+            binID_t levelNbX, levelNbY, levelOffset;
+            hostGetBinLevelInfo(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                hostGetSphereBinLevel(myRadius, simParams->binSize, simParams->nBinLevels), simParams);
+            HostSphereBinRange binRange(myPosX, myPosY, myPosZ, myRadius, levelBinSize, simParams);
+            numBinsSphereTouches[sphereID] = (binsSphereTouches_t)binRange.count();
+
+            // Sphere--analytical geometry contacts
+            unsigned int sphFamilyNum = granData->familyID[myOwnerID];
+            objID_t contact_count = 0;
+            for (objID_t objB = 0; objB < simParams->nAnalGM; objB++) {
+                if (hostCheckSphereAnalEntityOverlap(myPosX, myPosY, myPosZ, myRadius, sphFamilyNum, objB, granData,
+                                                     simParams)) {
+                    contact_count++;
+                }
+            }
+            numAnalGeoSphereTouches[sphereID] = contact_count;
+        }
+    });
+
+    // 2nd step: prefix scan sphere--bin touching pairs and sphere--analytical geometry pairs
+    CD_temp_arr_bytes = nSpheres * sizeof(binSphereTouchPairs_t);
+    binSphereTouchPairs_t* numBinsSphereTouchesScan =
+        (binSphereTouchPairs_t*)scratchPad.allocateTempVector(1, CD_temp_arr_bytes);
+    size_t* pNumBinSphereTouchPairs = scratchPad.pTempSizeVar1;
+    *pNumBinSphereTouchPairs =
+        hostExclusiveScan(numBinsSphereTouches, numBinsSphereTouchesScan, nSpheres, pool, scratchPad);
+    binSphereTouchPairs_t* numAnalGeoSphereTouchesScan =
+        (binSphereTouchPairs_t*)scratchPad.allocateTempVector(3, CD_temp_arr_bytes);
+    *(scratchPad.pNumContacts) =
+        hostExclusiveScan(numAnalGeoSphereTouches, numAnalGeoSphereTouchesScan, nSpheres, pool, scratchPad);
+    if (*scratchPad.pNumContacts > idGeometryA.size()) {
+        hostContactEventArraysResize(*scratchPad.pNumContacts, idGeometryA, idGeometryB, contactType, granData);
+    }
+
+    // 3rd step: figure out all sphere--bin touching pairs, and sphere--analytical geometry pairs (which go to the front
+    // of the contact arrays)
+    CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
+    binID_t* binIDsEachSphereTouches = (binID_t*)scratchPad.allocateTempVector(0, CD_temp_arr_bytes);
+    CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(bodyID_t);
+    bodyID_t* sphereIDsEachBinTouches = (bodyID_t*)scratchPad.allocateTempVector(2, CD_temp_arr_bytes);
+    hostParallelFor(nSpheres, nThreads, [&](size_t begin, size_t end) {
+        for (size_t sphereID = begin; sphereID < end; sphereID++) {
+            double myPosX, myPosY, myPosZ, myRadius;
+            bodyID_t myOwnerID;
+            hostGetSphereCDInfo<double>(myPosX, myPosY, myPosZ, myRadius, myOwnerID, sphereID, granData, simParams,
+                                        useClumpJitify);
+            double levelBinSize;
+            binID_t levelNbX, levelNbY, levelOffset;
+            hostGetBinLevelInfo(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                hostGetSphereBinLevel(myRadius, simParams->binSize, simParams->nBinLevels), simParams);
+            HostSphereBinRange binRange(myPosX, myPosY, myPosZ, myRadius, levelBinSize, simParams);
+            binSphereTouchPairs_t myReportOffset = numBinsSphereTouchesScan[sphereID];
+            binRange.forEach([&](unsigned int i, unsigned int j, unsigned int k) {
+                binIDsEachSphereTouches[myReportOffset] =
+                    levelOffset + (binID_t)i + (binID_t)j * levelNbX + (binID_t)k * levelNbX * levelNbY;
+                sphereIDsEachBinTouches[myReportOffset] = sphereID;
+                myReportOffset++;
+            });
+
+            unsigned int sphFamilyNum = granData->familyID[myOwnerID];
+            binSphereTouchPairs_t mySphereGeoReportOffset = numAnalGeoSphereTouchesScan[sphereID];
+            for (objID_t objB = 0; objB < simParams->nAnalGM; objB++) {
+                contact_t contact_type = hostCheckSphereAnalEntityOverlap(myPosX, myPosY, myPosZ, myRadius,
+                                                                          sphFamilyNum, objB, granData, simParams);
+                if (contact_type) {
+                    granData->idGeometryA[mySphereGeoReportOffset] = sphereID;
+                    granData->idGeometryB[mySphereGeoReportOffset] = (bodyID_t)objB;
+                    granData->contactType[mySphereGeoReportOffset] = contact_type;
+                    mySphereGeoReportOffset++;
+                }
+            }
+        }
+    });
+
+    // 4th step: sort the sphere--bin pairs by bin ID. Within a bin, sphere IDs stay in ascending order, which is also
+    // what the (stable) CUB radix sort gives.
+    CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(bodyID_t);
+    bodyID_t* sphereIDsEachBinTouches_sorted = (bodyID_t*)scratchPad.allocateTempVector(1, CD_temp_arr_bytes);
+    CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
+    binID_t* binIDsEachSphereTouches_sorted = (binID_t*)scratchPad.allocateTempVector(3, CD_temp_arr_bytes);
+    hostDEMSortByKeys(binIDsEachSphereTouches, binIDsEachSphereTouches_sorted, sphereIDsEachBinTouches,
+                      sphereIDsEachBinTouches_sorted, *pNumBinSphereTouchPairs, pool, scratchPad);
+
+    // 5th step: run-length encode the sorted bin IDs to identify active bins, then scan to find the offsets that are
+    // used to index into sphereIDsEachBinTouches_sorted to obtain bin-wise spheres. The (unsorted)
+    // binIDsEachSphereTouches and sphereIDsEachBinTouches can retire now, so temp vectors 0 and 2 are reused; they are
+    // large enough for as many runs as there are pairs.
+    size_t* pNumActiveBins = scratchPad.pTempSizeVar2;
+    CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
+    binID_t* activeBinIDs = (binID_t*)scratchPad.allocateTempVector(0, CD_temp_arr_bytes);
+    CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(spheresBinTouches_t);
+    spheresBinTouches_t* numSpheresBinTouches =
+        (spheresBinTouches_t*)scratchPad.allocateTempVector(2, CD_temp_arr_bytes);
+    hostDEMRunLengthEncode(binIDsEachSphereTouches_sorted, activeBinIDs, numSpheresBinTouches, pNumActiveBins,
+                           *pNumBinSphereTouchPairs, pool, scratchPad);
+    CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(binSphereTouchPairs_t);
+    binSphereTouchPairs_t* sphereIDsLookUpTable =
+        (binSphereTouchPairs_t*)scratchPad.allocateTempVector(3, CD_temp_arr_bytes);
+    hostExclusiveScan(numSpheresBinTouches, sphereIDsLookUpTable, *pNumActiveBins, pool, scratchPad);
+    timers.GetTimer("Discretize domain").stop();
+
+    timers.GetTimer("Find contact pairs").start();
+    // 6th step: find the contact pairs. First find num of contacts in each bin, then prescan, then find the actual pair
+    // names.
+    CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(spheresBinTouches_t);
+    spheresBinTouches_t* numContactsInEachBin =
+        (spheresBinTouches_t*)scratchPad.allocateTempVector(4, CD_temp_arr_bytes);
+    if (*pNumActiveBins > 0) {
+        hostParallelFor(*pNumActiveBins, nThreads, [&](size_t begin, size_t end) {
+            std::vector<bodyID_t> ownerIDs;
+            std::vector<family_t> ownerFamily;
+            std::vector<float> radii;
+            std::vector<double> bodyX, bodyY, bodyZ;
+            for (size_t myActiveID = begin; myActiveID < end; myActiveID++) {
+                spheresBinTouches_t contact_count = 0;
+                hostProcessBinContacts(activeBinIDs[myActiveID],
+                                       sphereIDsEachBinTouches_sorted + sphereIDsLookUpTable[myActiveID],
+                                       numSpheresBinTouches[myActiveID], granData, simParams, useClumpJitify, ownerIDs,
+                                       ownerFamily, radii, bodyX, bodyY, bodyZ,
+                                       [&](const bodyID_t&, const bodyID_t&) { contact_count++; });
+                numContactsInEachBin[myActiveID] = contact_count;
+            }
+        });
+
+        CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(contactPairs_t);
+        contactPairs_t* contactReportOffsets = (contactPairs_t*)scratchPad.allocateTempVector(5, CD_temp_arr_bytes);
+        size_t nSphereSphereContact =
+            hostExclusiveScan(numContactsInEachBin, contactReportOffsets, *pNumActiveBins, pool, scratchPad);
+
+        // Add sphere--sphere contacts together with sphere--analytical geometry contacts
+        size_t nSphereGeoContact = *scratchPad.pNumContacts;
+        *scratchPad.pNumContacts = nSphereSphereContact + nSphereGeoContact;
+        if (*scratchPad.pNumContacts > idGeometryA.size()) {
+            hostContactEventArraysResize(*scratchPad.pNumContacts, idGeometryA, idGeometryB, contactType, granData);
+        }
+
+        // Sphere--sphere contact pairs go after sphere--anal-geo contacts
+        bodyID_t* idSphA = (granData->idGeometryA + nSphereGeoContact);
+        bodyID_t* idSphB = (granData->idGeometryB + nSphereGeoContact);
+        std::fill(granData->contactType + nSphereGeoContact, granData->contactType + *scratchPad.pNumContacts,
+                  SPHERE_SPHERE_CONTACT);
+        hostParallelFor(*pNumActiveBins, nThreads, [&](size_t begin, size_t end) {
+            std::vector<bodyID_t> ownerIDs;
+            std::vector<family_t> ownerFamily;
+            std::vector<float> radii;
+            std::vector<double> bodyX, bodyY, bodyZ;
+            for (size_t myActiveID = begin; myActiveID < end; myActiveID++) {
+                contactPairs_t myReportOffset = contactReportOffsets[myActiveID];
+                hostProcessBinContacts(activeBinIDs[myActiveID],
+                                       sphereIDsEachBinTouches_sorted + sphereIDsLookUpTable[myActiveID],
+                                       numSpheresBinTouches[myActiveID], granData, simParams, useClumpJitify, ownerIDs,
+                                       ownerFamily, radii, bodyX, bodyY, bodyZ,
+                                       [&](const bodyID_t& sphA, const bodyID_t& sphB) {
+                                           // If spheres were rearranged in memory, pairs are oriented by their public
+                                           // IDs, so contact history still matches
+                                           bool swap = granData->spherePublicID != NULL &&
+                                                       granData->spherePublicID[sphA] > granData->spherePublicID[sphB];
+                                           idSphA[myReportOffset] = swap ? sphB : sphA;
+                                           idSphB[myReportOffset] = swap ? sphA : sphB;
+                                           myReportOffset++;
+                                       });
+            }
+        });
+
+        // With a multi-level bin hierarchy, contacts between spheres of different levels are found by each sphere
+        // querying the coarser-level bins it touches. They go after the same-level sphere--sphere contacts, and temp
+        // vectors 4 and 5 are re-used for them.
+        if (simParams->nBinLevels > 1) {
+            CD_temp_arr_bytes = nSpheres * sizeof(geoSphereTouches_t);
+            geoSphereTouches_t* numCrossLevelContacts =
+                (geoSphereTouches_t*)scratchPad.allocateTempVector(4, CD_temp_arr_bytes);
+            hostParallelFor(nSpheres, nThreads, [&](size_t begin, size_t end) {
+                for (size_t sphereID = begin; sphereID < end; sphereID++) {
+                    geoSphereTouches_t contact_count = 0;
+                    hostProcessCrossLevelContacts(sphereID, sphereIDsEachBinTouches_sorted, activeBinIDs,
+                                                  numSpheresBinTouches, sphereIDsLookUpTable, *pNumActiveBins,
+                                                  granData, simParams, useClumpJitify,
+                                                  [&](const bodyID_t&) { contact_count++; });
+                    numCrossLevelContacts[sphereID] = contact_count;
+                }
+            });
+
+            CD_temp_arr_bytes = nSpheres * sizeof(contactPairs_t);
+            contactPairs_t* crossLevelReportOffsets =
+                (contactPairs_t*)scratchPad.allocateTempVector(5, CD_temp_arr_bytes);
+            size_t nCrossLevelContact =
+                hostExclusiveScan(numCrossLevelContacts, crossLevelReportOffsets, nSpheres, pool, scratchPad);
+            size_t nSameLevelContact = *scratchPad.pNumContacts;
+            *scratchPad.pNumContacts = nSameLevelContact + nCrossLevelContact;
+            if (*scratchPad.pNumContacts > idGeometryA.size()) {
+                hostContactEventArraysResize(*scratchPad.pNumContacts, idGeometryA, idGeometryB, contactType, granData);
+            }
+
+            bodyID_t* idCrossA = (granData->idGeometryA + nSameLevelContact);
+            bodyID_t* idCrossB = (granData->idGeometryB + nSameLevelContact);
+            std::fill(granData->contactType + nSameLevelContact, granData->contactType + *scratchPad.pNumContacts,
+                      SPHERE_SPHERE_CONTACT);
+            hostParallelFor(nSpheres, nThreads, [&](size_t begin, size_t end) {
+                for (size_t sphereID = begin; sphereID < end; sphereID++) {
+                    contactPairs_t myReportOffset = crossLevelReportOffsets[sphereID];
+                    const bodyID_t myID = sphereID;
+                    hostProcessCrossLevelContacts(
+                        myID, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches, sphereIDsLookUpTable,
+                        *pNumActiveBins, granData, simParams, useClumpJitify, [&](const bodyID_t& otherID) {
+                            // Oriented by (public) sphere IDs, like the same-level pairs
+                            bool swap = (granData->spherePublicID != NULL)
+                                            ? (granData->spherePublicID[myID] > granData->spherePublicID[otherID])
+                                            : (myID > otherID);
+                            idCrossA[myReportOffset] = swap ? otherID : myID;
+                            idCrossB[myReportOffset] = swap ? myID : otherID;
+                            myReportOffset++;
+                        });
+                }
+            });
+        }
+    }  // End of bin-wise contact detection subroutine
+    timers.GetTimer("Find contact pairs").stop();
+
+    timers.GetTimer("Build history map").start();
+    // Now, sort idGeometryAB by their owners. Needed for identifying persistent contacts in history-based models.
+    if (*scratchPad.pNumContacts > 0) {
+        if ((!solverFlags.isHistoryless) || solverFlags.should_sort_pairs) {
+            const size_t nContacts = *scratchPad.pNumContacts;
+            size_t type_arr_bytes = nContacts * sizeof(contact_t);
+            size_t id_arr_bytes = nContacts * sizeof(bodyID_t);
+            size_t key_arr_bytes = nContacts * sizeof(uint64_t);
+            uint64_t* contactKeys = (uint64_t*)scratchPad.allocateTempVector(0, key_arr_bytes);
+            uint64_t* contactKeys_sorted = (uint64_t*)scratchPad.allocateTempVector(1, key_arr_bytes);
+            contact_t* contactType_sorted = (contact_t*)scratchPad.allocateTempVector(2, type_arr_bytes);
+
+            // One sort by the (idA, idB) keys, same as the GPU version
+            hostSortContactsByKey(granData->idGeometryA, granData->idGeometryB, granData->contactType, contactKeys,
+                                  contactKeys_sorted, contactType_sorted, nContacts, pool, scratchPad);
+
+            // For history-based models, construct the persistent contact map
+            if (!solverFlags.isHistoryless) {
+                if (nContacts > contactMapping.size()) {
+                    contactMapping.resize(nContacts);
+                    granData->contactMapping = contactMapping.data();
+                }
+                hostBuildPersistentMap(granData->idGeometryA, granData->idGeometryB, granData->contactType, nContacts,
+                                       granData->previous_idGeometryA, granData->previous_idGeometryB,
+                                       granData->previous_contactType, *(scratchPad.pNumPrevContacts),
+                                       granData->contactMapping, pool);
+
+                // Finally, copy new contact array to old contact array for the record
+                if (nContacts > previous_idGeometryA.size()) {
+                    previous_idGeometryA.resize(nContacts);
+                    previous_idGeometryB.resize(nContacts);
+                    previous_contactType.resize(nContacts);
+
+                    granData->previous_idGeometryA = previous_idGeometryA.data();
+                    granData->previous_idGeometryB = previous_idGeometryB.data();
+                    granData->previous_contactType = previous_contactType.data();
+                }
+                std::memcpy(granData->previous_idGeometryA, granData->idGeometryA, id_arr_bytes);
+                std::memcpy(granData->previous_idGeometryB, granData->idGeometryB, id_arr_bytes);
+                std::memcpy(granData->previous_contactType, granData->contactType, type_arr_bytes);
+            }
+        }
+    }  // End of contact sorting--mapping subroutine
+    timers.GetTimer("Build history map").stop();
+
+    if (solverFlags.use_compact_force_kernel && solverFlags.should_sort_pairs) {
+        // Figure out how many contacts an item in idA array typically has
+        size_t num_unique_idA = 0;
+        for (size_t i = 0; i < *scratchPad.pNumContacts; i++) {
+            if (i == 0 || granData->idGeometryA[i] != granData->idGeometryA[i - 1])
+                num_unique_idA++;
+        }
+        double avg_cnts_per_geo =
+            (num_unique_idA > 0) ? (double)(*scratchPad.pNumContacts) / (double)(num_unique_idA) : 0.0;
+
+        DEME_DEBUG_PRINTF("Average number of contacts for each geometry: %.9g", avg_cnts_per_geo);
+    }
+
+    // Store the number of contacts for the next iteration
+    *scratchPad.pNumPrevContacts = *scratchPad.pNumContacts;
+    *scratchPad.pNumPrevSpheres = nSpheres;
+}
+
+}  // namespace deme
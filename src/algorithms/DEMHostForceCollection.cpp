@@ -0,0 +1,86 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+
+#include <algorithms/DEMHostBasedSubroutines.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+void hostCollectContactForces(HostJitProgram& collect_force_kernels,
+                              DEMDataDT* granData,
+                              const size_t nContactPairs,
+                              const size_t nClumps,
+                              bool contactPairArr_isFresh,
+                              unsigned int nThreads,
+                              DEMSolverStateData& scratchPad,
+                              SolverTimers& timers) {
+    // Same temp vector layout as the GPU version: vector 0 keeps the flattened owner IDs, and vector 7 keeps the
+    // owner-to-contact CSR. They are reused until the contact pair array is refreshed.
+    size_t cachedArraySizeOwner = (size_t)2 * nContactPairs * sizeof(bodyID_t);
+    bodyID_t* idAOwner = (bodyID_t*)scratchPad.allocateTempVector(0, cachedArraySizeOwner);
+    bodyID_t* idBOwner = (bodyID_t*)(idAOwner + nContactPairs);
+    size_t cachedArraySizeCSR = ((size_t)nClumps + 1 + (size_t)2 * nContactPairs) * sizeof(contactPairs_t);
+    contactPairs_t* ownerOffsets = (contactPairs_t*)scratchPad.allocateTempVector(7, cachedArraySizeCSR);
+    contactPairs_t* ownerSlots = (contactPairs_t*)(ownerOffsets + nClumps + 1);
+    if (contactPairArr_isFresh) {
+        hostParallelFor(nContactPairs, nThreads, [&](size_t begin, size_t end) {
+            collect_force_kernels.launch("cashInOwnerIndexA", begin, end, idAOwner, granData->idGeometryA,
+                                         granData->ownerClumpBody, granData->contactType, nContactPairs);
+            collect_force_kernels.launch("cashInOwnerIndexB", begin, end, idBOwner, granData->idGeometryB,
+                                         granData->ownerClumpBody, granData->contactType, nContactPairs);
+        });
+        // Build the owner-to-contact CSR, same as the GPU version
+        bodyID_t* idOwner_sorted = (bodyID_t*)scratchPad.allocateTempVector(2, cachedArraySizeOwner);
+        size_t slotArraySize = (size_t)2 * nContactPairs * sizeof(contactPairs_t);
+        contactPairs_t* slots_unsorted = (contactPairs_t*)scratchPad.allocateTempVector(3, slotArraySize);
+        hostParallelFor(2 * nContactPairs, nThreads, [&](size_t begin, size_t end) {
+            collect_force_kernels.launch("fillOwnerSlots", begin, end, slots_unsorted, 2 * nContactPairs);
+        });
+        hostDEMSortByKeys(idAOwner, idOwner_sorted, slots_unsorted, ownerSlots, 2 * nContactPairs,
+                          HostThreadPool::Shared(nThreads), scratchPad);
+        hostParallelFor(2 * nContactPairs, nThreads, [&](size_t begin, size_t end) {
+            collect_force_kernels.launch("markOwnerSegments", begin, end, ownerOffsets, idOwner_sorted,
+                                         2 * nContactPairs, nClumps);
+        });
+    }
+
+    size_t tempArraySizeAcc = (size_t)2 * nContactPairs * sizeof(float3);
+    float3* acc_A = (float3*)scratchPad.allocateTempVector(1, tempArraySizeAcc);
+    float3* acc_B = (float3*)(acc_A + nContactPairs);
+
+    // Linear accelerations
+    hostParallelFor(nContactPairs, nThreads, [&](size_t begin, size_t end) {
+        collect_force_kernels.launch("forceToAcc", begin, end, acc_A, granData->contactForces, idAOwner, 1.f,
+                                     nContactPairs, granData);
+        collect_force_kernels.launch("forceToAcc", begin, end, acc_B, granData->contactForces, idBOwner, -1.f,
+                                     nContactPairs, granData);
+    });
+    hostParallelFor(nClumps, nThreads, [&](size_t begin, size_t end) {
+        collect_force_kernels.launch("gatherOwnerValues", begin, end, granData->aX, granData->aY, granData->aZ, acc_A,
+                                     ownerOffsets, ownerSlots, nClumps);
+    });
+
+    // Angular accelerations
+    float3* alpha_A = acc_A;
+    float3* alpha_B = acc_B;
+    hostParallelFor(nContactPairs, nThreads, [&](size_t begin, size_t end) {
+        collect_force_kernels.launch("forceToAngAcc", begin, end, alpha_A, granData->contactPointGeometryA,
+                                     granData->oriQw, granData->oriQx, granData->oriQy, granData->oriQz,
+                                     granData->contactForces, granData->contactTorque_convToForce, idAOwner, 1.f,
+                                     nContactPairs, granData);
+        collect_force_kernels.launch("forceToAngAcc", begin, end, alpha_B, granData->contactPointGeometryB,
+                                     granData->oriQw, granData->oriQx, granData->oriQy, granData->oriQz,
+                                     granData->contactForces, granData->contactTorque_convToForce, idBOwner, -1.f,
+                                     nContactPairs, granData);
+    });
+    hostParallelFor(nClumps, nThreads, [&](size_t begin, size_t end) {
+        collect_force_kernels.launch("gatherOwnerValues", begin, end, granData->alphaX, granData->alphaY,
+                                     granData->alphaZ, alpha_A, ownerOffsets, ownerSlots, nClumps);
+    });
+}
+
+}  // namespace deme
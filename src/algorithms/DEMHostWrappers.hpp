@@ -0,0 +1,353 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HOST_WRAPPERS_HPP
+#define DEME_HOST_WRAPPERS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <core/utils/HostThreadPool.h>
+
+// Host (CPU) counterparts of the CUB wrappers in DEMCubWrappers.cu, with the same argument lists except that a thread
+// pool takes the place of the CUDA stream. scratchPad only needs to provide allocateScratchSpace(bytes), like
+// DEMSolverStateData does. Inputs and outputs may not overlap, unless stated otherwise.
+
+namespace deme {
+
+// Below this many elements per chunk, using more threads does not pay off
+constexpr size_t DEME_HOST_PRIMITIVE_MIN_CHUNK = 16384;
+
+// Bytes of a scratch array of n items of T, rounded up so that the next one stays aligned
+template <typename T>
+inline size_t hostScratchBytes(size_t n) {
+    return (n * sizeof(T) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+}
+// Carve a typed array out of the scratch space and advance the cursor. The scratch space is shared, so each wrapper
+// allocates all it needs at once, then carves it up.
+template <typename T>
+inline T* hostScratchArray(char*& cursor, size_t n) {
+    T* arr = reinterpret_cast<T*>(cursor);
+    cursor += hostScratchBytes<T>(n);
+    return arr;
+}
+
+// For callers that do not have a DEMSolverStateData at hand
+class HostScratchPad {
+  public:
+    char* allocateScratchSpace(size_t sizeNeeded) {
+        if (space.size() < sizeNeeded)
+            space.resize(sizeNeeded);
+        return space.data();
+    }
+
+  private:
+    std::vector<char> space;
+};
+
+// Exclusive prefix sum of d_in into d_out, accumulated (and stored) as T2, like cubDEMPrefixScan. d_in and d_out may be
+// the same array.
+template <typename T1, typename T2, typename T3>
+inline void hostDEMPrefixScan(T1* d_in, T2* d_out, size_t n, HostThreadPool& pool, T3& scratchPad) {
+    const size_t nChunks = pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK);
+    if (nChunks <= 1) {
+        T2 sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            T2 item = (T2)d_in[i];
+            d_out[i] = sum;
+            sum += item;
+        }
+        return;
+    }
+    char* cursor = (char*)scratchPad.allocateScratchSpace(hostScratchBytes<T2>(nChunks));
+    T2* chunkSums = hostScratchArray<T2>(cursor, nChunks);
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        T2 sum = 0;
+        for (size_t i = begin; i < end; i++)
+            sum += (T2)d_in[i];
+        chunkSums[c] = sum;
+    });
+    T2 offset = 0;
+    for (size_t c = 0; c < nChunks; c++) {
+        T2 sum = chunkSums[c];
+        chunkSums[c] = offset;
+        offset += sum;
+    }
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        T2 sum = chunkSums[c];
+        for (size_t i = begin; i < end; i++) {
+            T2 item = (T2)d_in[i];
+            d_out[i] = sum;
+            sum += item;
+        }
+    });
+}
+
+// Inclusive prefix sum of d_in into d_out, accumulated as T2. d_in and d_out may be the same array.
+template <typename T1, typename T2, typename T3>
+inline void hostDEMInclusiveScan(T1* d_in, T2* d_out, size_t n, HostThreadPool& pool, T3& scratchPad) {
+    const size_t nChunks = pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK);
+    if (nChunks <= 1) {
+        T2 sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += (T2)d_in[i];
+            d_out[i] = sum;
+        }
+        return;
+    }
+    char* cursor = (char*)scratchPad.allocateScratchSpace(hostScratchBytes<T2>(nChunks));
+    T2* chunkSums = hostScratchArray<T2>(cursor, nChunks);
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        T2 sum = 0;
+        for (size_t i = begin; i < end; i++)
+            sum += (T2)d_in[i];
+        chunkSums[c] = sum;
+    });
+    T2 offset = 0;
+    for (size_t c = 0; c < nChunks; c++) {
+        T2 sum = chunkSums[c];
+        chunkSums[c] = offset;
+        offset += sum;
+    }
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        T2 sum = chunkSums[c];
+        for (size_t i = begin; i < end; i++) {
+            sum += (T2)d_in[i];
+            d_out[i] = sum;
+        }
+    });
+}
+
+// Stable LSD radix sort of (unsigned integer) keys, carrying the values along, like cubDEMSortByKeys. Passes over
+// digits that are the same for all keys are skipped, so small keys in wide types are cheap.
+template <typename T1, typename T2, typename T3>
+inline void hostDEMSortByKeys(T1* d_keys_in,
+                              T1* d_keys_out,
+                              T2* d_vals_in,
+                              T2* d_vals_out,
+                              size_t n,
+                              HostThreadPool& pool,
+                              T3& scratchPad) {
+    static_assert(std::is_integral<T1>::value && std::is_unsigned<T1>::value,
+                  "hostDEMSortByKeys only sorts unsigned integer keys.");
+    constexpr unsigned int RADIX_BITS = 8;
+    constexpr size_t RADIX = (size_t)1 << RADIX_BITS;
+    constexpr unsigned int nPasses = (sizeof(T1) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+    if (n == 0)
+        return;
+
+    const size_t nChunks = std::max<size_t>(1, pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+    char* cursor = (char*)scratchPad.allocateScratchSpace(hostScratchBytes<T1>(n) + hostScratchBytes<T2>(n) +
+                                                          hostScratchBytes<size_t>(nChunks * RADIX * nPasses));
+    T1* keys_alt = hostScratchArray<T1>(cursor, n);
+    T2* vals_alt = hostScratchArray<T2>(cursor, n);
+    size_t* hist = hostScratchArray<size_t>(cursor, nChunks * RADIX * nPasses);
+
+    // First find out which digits are the same for all keys, by counting the digits of all passes in one go
+    std::memset(hist, 0, nChunks * RADIX * nPasses * sizeof(size_t));
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        size_t* myHist = hist + c * RADIX * nPasses;
+        for (size_t i = begin; i < end; i++) {
+            const T1 key = d_keys_in[i];
+            for (unsigned int p = 0; p < nPasses; p++)
+                myHist[p * RADIX + ((key >> (p * RADIX_BITS)) & (RADIX - 1))]++;
+        }
+    });
+    bool trivialPass[nPasses];
+    for (unsigned int p = 0; p < nPasses; p++) {
+        // If all keys have the same digit, this pass does not move anything
+        trivialPass[p] = false;
+        for (size_t d = 0; d < RADIX; d++) {
+            size_t total = 0;
+            for (size_t c = 0; c < nChunks; c++)
+                total += hist[(c * nPasses + p) * RADIX + d];
+            if (total > 0) {
+                trivialPass[p] = (total == n);
+                break;
+            }
+        }
+    }
+
+    // Ping-pong between the output and the alternative buffers; the first pass reads from the input
+    const T1* keys_src = d_keys_in;
+    const T2* vals_src = d_vals_in;
+    for (unsigned int p = 0; p < nPasses; p++) {
+        if (trivialPass[p])
+            continue;
+        const unsigned int shift = p * RADIX_BITS;
+        // Each chunk's digit counts, then turned into its starting offset for each digit: digit-major, then chunk
+        // order, for stability
+        size_t* passHist = hist;
+        pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+            size_t* myHist = passHist + c * RADIX;
+            std::fill(myHist, myHist + RADIX, (size_t)0);
+            for (size_t i = begin; i < end; i++)
+                myHist[(keys_src[i] >> shift) & (RADIX - 1)]++;
+        });
+        size_t offset = 0;
+        for (size_t d = 0; d < RADIX; d++) {
+            for (size_t c = 0; c < nChunks; c++) {
+                size_t count = passHist[c * RADIX + d];
+                passHist[c * RADIX + d] = offset;
+                offset += count;
+            }
+        }
+        // Write to whichever buffer is not the source
+        T1* keys_dst = (keys_src == d_keys_out) ? keys_alt : d_keys_out;
+        T2* vals_dst = (vals_src == d_vals_out) ? vals_alt : d_vals_out;
+        pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+            size_t* myOffsets = passHist + c * RADIX;
+            for (size_t i = begin; i < end; i++) {
+                const T1 key = keys_src[i];
+                const size_t pos = myOffsets[(key >> shift) & (RADIX - 1)]++;
+                keys_dst[pos] = key;
+                vals_dst[pos] = vals_src[i];
+            }
+        });
+        keys_src = keys_dst;
+        vals_src = vals_dst;
+    }
+    if (keys_src != d_keys_out)
+        std::memcpy((void*)d_keys_out, keys_src, n * sizeof(T1));
+    if (vals_src != d_vals_out)
+        std::memcpy((void*)d_vals_out, vals_src, n * sizeof(T2));
+}
+
+// Call func(run, begin, end) for each run of identical consecutive items in d_in, where run is the index of the run,
+// and returns the number of runs. The first pass only counts the runs that start in each chunk; in the second, each
+// chunk handles the runs that start in it, following them into the next chunk if needed.
+template <typename T1, typename T3, typename Func>
+inline size_t hostDEMForEachRun(const T1* d_in, size_t n, HostThreadPool& pool, T3& scratchPad, const Func& func) {
+    const size_t nChunks = pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK);
+    if (nChunks <= 1) {
+        size_t nRuns = 0;
+        for (size_t i = 0; i < n;) {
+            size_t j = i + 1;
+            while (j < n && d_in[j] == d_in[i])
+                j++;
+            func(nRuns++, i, j);
+            i = j;
+        }
+        return nRuns;
+    }
+    char* cursor = (char*)scratchPad.allocateScratchSpace(hostScratchBytes<size_t>(nChunks));
+    size_t* chunkRuns = hostScratchArray<size_t>(cursor, nChunks);
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (i == 0 || !(d_in[i] == d_in[i - 1]))
+                count++;
+        }
+        chunkRuns[c] = count;
+    });
+    size_t nRuns = 0;
+    for (size_t c = 0; c < nChunks; c++) {
+        size_t count = chunkRuns[c];
+        chunkRuns[c] = nRuns;
+        nRuns += count;
+    }
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        size_t run = chunkRuns[c];
+        size_t i = begin;
+        // Skip the tail of a run that started in the previous chunk
+        while (i < end && i > 0 && d_in[i] == d_in[i - 1])
+            i++;
+        while (i < end) {
+            size_t j = i + 1;
+            while (j < n && d_in[j] == d_in[i])
+                j++;
+            func(run++, i, j);
+            i = j;
+        }
+    });
+    return nRuns;
+}
+
+// Keep the first item of each run of identical consecutive items, like cubDEMUnique
+template <typename T1, typename T2>
+inline void hostDEMUnique(T1* d_in, T1* d_out, size_t* d_num_out, size_t n, HostThreadPool& pool, T2& scratchPad) {
+    *d_num_out = hostDEMForEachRun(d_in, n, pool, scratchPad,
+                                   [&](size_t run, size_t begin, size_t) { d_out[run] = d_in[begin]; });
+}
+
+// Run-length encode d_in, like cubDEMRunLengthEncode
+template <typename T1, typename T2, typename T3>
+inline void hostDEMRunLengthEncode(T1* d_in,
+                                   T1* d_unique_out,
+                                   T2* d_counts_out,
+                                   size_t* d_num_out,
+                                   size_t n,
+                                   HostThreadPool& pool,
+                                   T3& scratchPad) {
+    *d_num_out = hostDEMForEachRun(d_in, n, pool, scratchPad, [&](size_t run, size_t begin, size_t end) {
+        d_unique_out[run] = d_in[begin];
+        d_counts_out[run] = (T2)(end - begin);
+    });
+}
+
+// Reduce the values of each run of identical consecutive keys with reduce_op, like cubDEMReduceByKeys
+template <typename T1, typename T2, typename T3, typename T4>
+inline void hostDEMReduceByKeys(T1* d_keys_in,
+                                T1* d_unique_out,
+                                T2* d_vals_in,
+                                T2* d_aggregates_out,
+                                size_t* d_num_out,
+                                T3& reduce_op,
+                                size_t n,
+                                HostThreadPool& pool,
+                                T4& scratchPad) {
+    *d_num_out = hostDEMForEachRun(d_keys_in, n, pool, scratchPad, [&](size_t run, size_t begin, size_t end) {
+        T2 aggregate = d_vals_in[begin];
+        for (size_t i = begin + 1; i < end; i++)
+            aggregate = reduce_op(aggregate, d_vals_in[i]);
+        d_unique_out[run] = d_keys_in[begin];
+        d_aggregates_out[run] = aggregate;
+    });
+}
+
+// Sum of d_in, accumulated as T2, like cubDEMSum
+template <typename T1, typename T2, typename T3>
+inline void hostDEMSum(T1* d_in, T2* d_out, size_t n, HostThreadPool& pool, T3& scratchPad) {
+    const size_t nChunks = std::max<size_t>(1, pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+    char* cursor = (char*)scratchPad.allocateScratchSpace(hostScratchBytes<T2>(nChunks));
+    T2* chunkSums = hostScratchArray<T2>(cursor, nChunks);
+    std::fill(chunkSums, chunkSums + nChunks, (T2)0);
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        T2 sum = 0;
+        for (size_t i = begin; i < end; i++)
+            sum += (T2)d_in[i];
+        chunkSums[c] = sum;
+    });
+    T2 sum = 0;
+    for (size_t c = 0; c < nChunks; c++)
+        sum += chunkSums[c];
+    *d_out = sum;
+}
+
+// Max of d_in (n > 0), like cubDEMMax
+template <typename T1, typename T2>
+inline void hostDEMMax(T1* d_in, T1* d_out, size_t n, HostThreadPool& pool, T2& scratchPad) {
+    const size_t nChunks = std::max<size_t>(1, pool.numChunks(n, DEME_HOST_PRIMITIVE_MIN_CHUNK));
+    char* cursor = (char*)scratchPad.allocateScratchSpace(hostScratchBytes<T1>(nChunks));
+    T1* chunkMax = hostScratchArray<T1>(cursor, nChunks);
+    std::fill(chunkMax, chunkMax + nChunks, d_in[0]);
+    pool.parallelForChunks(n, nChunks, [&](size_t c, size_t begin, size_t end) {
+        T1 myMax = d_in[begin];
+        for (size_t i = begin + 1; i < end; i++)
+            myMax = (myMax < d_in[i]) ? d_in[i] : myMax;
+        chunkMax[c] = myMax;
+    });
+    T1 result = chunkMax[0];
+    for (size_t c = 1; c < nChunks; c++)
+        result = (result < chunkMax[c]) ? chunkMax[c] : result;
+    *d_out = result;
+}
+
+}  // namespace deme
+
+#endif
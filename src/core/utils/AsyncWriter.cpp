@@ -0,0 +1,85 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <core/utils/AsyncWriter.h>
+
+AsyncWriter::AsyncWriter(unsigned int nThreads, size_t maxPending) {
+    if (nThreads == 0)
+        nThreads = 1;
+    this->maxPending = (maxPending == 0) ? 1 : maxPending;
+    workers.reserve(nThreads);
+    for (unsigned int i = 0; i < nThreads; i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+AsyncWriter::~AsyncWriter() {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobsCV.notify_all();
+    // Workers drain the queue before they quit; an error of a job that no one waited for is lost with the writer
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void AsyncWriter::rethrowJobError() {
+    if (jobError) {
+        std::exception_ptr err = jobError;
+        jobError = nullptr;
+        std::rethrow_exception(err);
+    }
+}
+
+void AsyncWriter::submit(std::function<void()> job) {
+    {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        rethrowJobError();
+        spaceCV.wait(lock, [this]() { return jobs.size() < maxPending; });
+        jobs.push_back(std::move(job));
+    }
+    jobsCV.notify_one();
+}
+
+void AsyncWriter::flush() {
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    idleCV.wait(lock, [this]() { return jobs.empty() && nRunning == 0; });
+    rethrowJobError();
+}
+
+size_t AsyncWriter::numPending() {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    return jobs.size() + nRunning;
+}
+
+void AsyncWriter::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobsCV.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            nRunning++;
+        }
+        spaceCV.notify_one();
+        std::exception_ptr err;
+        try {
+            job();
+        } catch (...) {
+            err = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            if (err && !jobError)
+                jobError = err;
+            nRunning--;
+        }
+        idleCV.notify_all();
+    }
+}
@@ -0,0 +1,55 @@
+//	Copyright (c) 2021, SBEL GPU Development Team
+//	Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_ASYNC_WRITER_H
+#define DEME_ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background threads that run jobs (formatting and writing output files) in the order they are submitted, so the
+// caller does not wait on the disk. At most maxPending jobs wait in the queue: submit blocks while it is full, which
+// bounds the memory that staged data can take when jobs come faster than the disk takes them.
+class AsyncWriter {
+  public:
+    explicit AsyncWriter(unsigned int nThreads = 1, size_t maxPending = 4);
+    // Finishes all submitted jobs first
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    // Queue a job, blocking while the queue is full. If an earlier job threw, that exception is rethrown here.
+    void submit(std::function<void()> job);
+
+    // Wait until all submitted jobs are done. If a job threw, the first such exception is rethrown here.
+    void flush();
+
+    // The number of jobs that are queued or running
+    size_t numPending();
+
+  private:
+    void workerLoop();
+    // Rethrow (once) the exception a job threw, if any; lock must be held
+    void rethrowJobError();
+
+    size_t maxPending;
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    size_t nRunning = 0;
+    std::exception_ptr jobError;
+    std::mutex jobsMutex;
+    std::condition_variable jobsCV;
+    std::condition_variable spaceCV;
+    std::condition_variable idleCV;
+    bool stopping = false;
+};
+
+#endif
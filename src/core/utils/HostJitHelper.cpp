@@ -0,0 +1,186 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <core/ApiVersion.h>
+#include <core/utils/JitHelper.h>
+#include <core/utils/HostJitHelper.h>
+#include <core/utils/JitSubstitution.h>
+#include <core/utils/JitDiskCache.h>
+
+const std::string HostJitProgram::KERNEL_TYPE_PREFIX = "demeHostKernelType_";
+
+const std::filesystem::path HostJitHelper::BUILD_DIR = std::filesystem::temp_directory_path() / "deme_host_jit";
+
+HostJitProgram::HostJitProgram(const std::filesystem::path& library, const std::string& name) : m_name(name) {
+    void* handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        throw std::runtime_error("Failed to load host program " + name + ": " + std::string(dlerror()));
+    }
+    m_handle = std::shared_ptr<void>(handle, [](void* h) { dlclose(h); });
+    m_getBlockIdxX = reinterpret_cast<unsigned int* (*)()>(dlsym(handle, "demeHostBlockIdxX"));
+    if (!m_getBlockIdxX) {
+        throw std::runtime_error("Host program " + name + " was not built with the host kernel prelude.");
+    }
+}
+
+// Readable name of a mangled type name (as given by std::type_info::name)
+static std::string demangle(const char* mangled) {
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> name(abi::__cxa_demangle(mangled, nullptr, nullptr, &status), std::free);
+    return (status == 0 && name) ? std::string(name.get()) : std::string(mangled);
+}
+
+void* HostJitProgram::getKernel(const std::string& kernel_name, const std::type_info& signature) const {
+    void* kernel = dlsym(m_handle.get(), kernel_name.c_str());
+    if (!kernel) {
+        throw std::runtime_error("Kernel " + kernel_name + " is not found in host program " + m_name + ".");
+    }
+    // The kernel's own type, recorded when the program was built (see HostJitHelper::buildProgram)
+    const std::string type_symbol = KERNEL_TYPE_PREFIX + kernel_name;
+    auto kernel_type = reinterpret_cast<const char* (*)()>(dlsym(m_handle.get(), type_symbol.c_str()));
+    if (!kernel_type) {
+        throw std::runtime_error("The type of kernel " + kernel_name + " is not recorded in host program " + m_name +
+                                 ".");
+    }
+    if (std::strcmp(kernel_type(), signature.name()) != 0) {
+        throw std::runtime_error("Kernel " + kernel_name + " in host program " + m_name + " is " +
+                                 demangle(kernel_type()) + ", but it is launched as " + demangle(signature.name()) +
+                                 ".");
+    }
+    return kernel;
+}
+
+// The toolkit header location may come as a CMake list
+static std::vector<std::string> splitPathList(const std::string& list) {
+    std::vector<std::string> paths;
+    std::stringstream ss(list);
+    std::string path;
+    while (std::getline(ss, path, ';')) {
+        if (!path.empty())
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+// Quote an argument for the shell that std::system runs, so paths with spaces or shell characters stay one argument
+static std::string shellQuote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+}
+
+static std::string readBinaryFile(const std::filesystem::path& path) {
+    std::ifstream input(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    return buffer.str();
+}
+
+HostJitProgram HostJitHelper::buildProgram(const std::string& name,
+                                           const std::filesystem::path& source,
+                                           std::unordered_map<std::string, std::string> substitutions,
+                                           std::vector<std::string> flags,
+                                           std::shared_ptr<JitDiskCache> disk_cache) {
+    std::string code = "// " + name + "\n#include <kernel/DEMHostKernelPrelude.cu>\n";
+    {
+        std::ifstream input(source);
+        if (!input) {
+            throw std::runtime_error("Failed to open kernel source " + source.string() + ".");
+        }
+        std::stringstream buffer;
+        buffer << input.rdbuf();
+        code.append(buffer.str());
+    }
+    // Apply the substitutions, the same way JitHelper does
+    code = JitSubstitution::apply(code, substitutions);
+    // Record the type of each kernel in the library, so a launch can check its argument types against it
+    const std::regex kernel_decl(R"((^|\n)[ \t]*__global__\s+void\s+(\w+)\s*\()");
+    std::string type_records = "\n";
+    for (std::sregex_iterator it(code.begin(), code.end(), kernel_decl), last; it != last; ++it) {
+        const std::string kernel_name = (*it)[2];
+        type_records += "extern \"C\" const char* " + HostJitProgram::KERNEL_TYPE_PREFIX + kernel_name +
+                        "() { return typeid(" + kernel_name + ").name(); }\n";
+    }
+    code += type_records;
+
+    std::vector<std::string> include_flags = {"-I" + (JitHelper::KERNEL_DIR / "..").string()};
+    for (const auto& path : splitPathList(CUDA_TOOLKIT_HEADERS)) {
+        include_flags.push_back("-I" + path);
+    }
+    std::string command = shellQuote(HOST_CXX_COMPILER) + " -std=c++17 -O3 -fPIC -shared -w";
+    for (const auto& flag : include_flags) {
+        command += " -I" + shellQuote(flag.substr(2));
+    }
+    for (const auto& flag : flags) {
+        command += " " + flag;
+    }
+
+    // Everything that goes into the library: the code, the headers it includes (such as the data struct layouts in
+    // Defines.h), the compile command, and our version. The key is a hash that is the same across builds and runs.
+    std::vector<std::string> key_flags(include_flags);
+    key_flags.insert(key_flags.end(), flags.begin(), flags.end());
+    const std::string key = JitDiskCache::makeKey(
+        {"host", code, command, JitHelper::includedSources(code, key_flags), std::to_string(API_VERSION)});
+
+    // Libraries are written out under a private name only to be loaded. Once loaded, the file can go: the loaded
+    // library stays mapped. The libraries are kept in the JIT caches (see JitHelper::fetchCached) as entries.
+    std::stringstream tmp_stem;
+    tmp_stem << name << "_" << key << "_" << getpid() << "_"
+             << std::hash<std::thread::id>{}(std::this_thread::get_id());
+    std::filesystem::create_directories(BUILD_DIR);
+    const std::filesystem::path tmp_library = BUILD_DIR / (tmp_stem.str() + ".so");
+    std::string blob;
+    if (!JitHelper::fetchCached(key, blob, disk_cache)) {
+        const std::filesystem::path src_file = BUILD_DIR / (tmp_stem.str() + ".cpp");
+        const std::filesystem::path log_file = BUILD_DIR / (tmp_stem.str() + ".log");
+        {
+            std::ofstream output(src_file);
+            output << code;
+        }
+        command += " " + shellQuote(src_file.string()) + " -o " + shellQuote(tmp_library.string()) + " > " +
+                   shellQuote(log_file.string()) + " 2>&1";
+        if (std::system(command.c_str()) != 0) {
+            std::ifstream log(log_file);
+            std::stringstream log_content;
+            log_content << log.rdbuf();
+            throw std::runtime_error("Failed to compile host program " + name + " (source kept at " +
+                                     src_file.string() + "):\n" + log_content.str());
+        }
+        std::filesystem::remove(src_file);
+        std::filesystem::remove(log_file);
+        JitHelper::storeCached(key, readBinaryFile(tmp_library), disk_cache);
+    } else {
+        std::ofstream output(tmp_library, std::ios::binary | std::ios::trunc);
+        output.write(blob.data(), blob.size());
+        if (!output) {
+            throw std::runtime_error("Failed to write host program " + name + " to " + tmp_library.string() + ".");
+        }
+    }
+
+    HostJitProgram program(tmp_library, name);
+    std::error_code ec;
+    std::filesystem::remove(tmp_library, ec);
+    return program;
+}
@@ -0,0 +1,70 @@
+//	Copyright (c) 2021, SBEL GPU Development Team
+//	Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HOST_JIT_HELPER_H
+#define DEME_HOST_JIT_HELPER_H
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include <unordered_map>
+
+class JitDiskCache;
+
+// A kernel source file compiled as host C++ and loaded as a shared library. The __global__ functions in it become
+// extern "C" functions that process one `thread' (element) per call, so launching them is just looping over a range.
+class HostJitProgram {
+  public:
+    HostJitProgram(const std::filesystem::path& library, const std::string& name);
+
+    // Run kernel_name for elements [begin, end). The argument types must exactly match the kernel's parameter types;
+    // they are checked against the kernel's type recorded at build time, and a mismatch throws. Different host threads
+    // can call this concurrently, on disjoint ranges.
+    template <typename... Args>
+    void launch(const std::string& kernel_name, size_t begin, size_t end, Args... args) const {
+        auto kernel = reinterpret_cast<void (*)(Args...)>(getKernel(kernel_name, typeid(void(Args...))));
+        // blockIdx is thread-local in the compiled program, so this pointer is only valid in this calling thread
+        unsigned int* blockIdxX = m_getBlockIdxX();
+        for (size_t i = begin; i < end; i++) {
+            *blockIdxX = (unsigned int)i;
+            kernel(args...);
+        }
+    }
+
+    const std::string& getName() const { return m_name; }
+
+    // For each kernel, the library has an extern "C" function of this name plus the kernel name, returning the
+    // kernel's std::type_info::name()
+    static const std::string KERNEL_TYPE_PREFIX;
+
+  private:
+    // Throws if the kernel is not there, or if its type is not signature
+    void* getKernel(const std::string& kernel_name, const std::type_info& signature) const;
+
+    std::string m_name;
+    std::shared_ptr<void> m_handle;
+    unsigned int* (*m_getBlockIdxX)() = nullptr;
+};
+
+class HostJitHelper {
+  public:
+    // Host counterpart of JitHelper::buildProgram: same source and same substitutions, but compiled by the host C++
+    // compiler. The flags are passed to the compiler as they are.
+    static HostJitProgram buildProgram(
+        const std::string& name,
+        const std::filesystem::path& source,
+        std::unordered_map<std::string, std::string> substitutions = std::unordered_map<std::string, std::string>(),
+        std::vector<std::string> flags = std::vector<std::string>(),
+        std::shared_ptr<JitDiskCache> disk_cache = nullptr);
+
+    // The libraries are built (and loaded from) in this directory, and the sources of failed compilations are kept
+    // there. The compiled libraries are also kept in memory and, if disk_cache is not null, in the on-disk JIT cache,
+    // keyed by a hash of the code, the headers it includes and the compile command.
+    static const std::filesystem::path BUILD_DIR;
+};
+
+#endif
@@ -0,0 +1,127 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <map>
+
+#include <core/utils/HostThreadPool.h>
+
+HostThreadPool::HostThreadPool(unsigned int nThreads) {
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+    this->nThreads = nThreads;
+    // The calling thread is one of the workers of a parallelFor
+    workers.reserve(nThreads - 1);
+    for (unsigned int i = 0; i + 1 < nThreads; i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+HostThreadPool::~HostThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobsCV.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+size_t HostThreadPool::numChunks(size_t n, size_t minChunkSize) const {
+    if (minChunkSize == 0)
+        minChunkSize = 1;
+    size_t nChunks = (n + minChunkSize - 1) / minChunkSize;
+    return (nChunks < nThreads) ? nChunks : nThreads;
+}
+
+void HostThreadPool::work(Job& job) {
+    for (size_t c = job.nextChunk++; c < job.nChunks; c = job.nextChunk++) {
+        size_t chunkSize = (job.n + job.nChunks - 1) / job.nChunks;
+        size_t begin = c * chunkSize;
+        size_t end = (begin + chunkSize < job.n) ? begin + chunkSize : job.n;
+        if (begin < end)
+            (*job.func)(c, begin, end);
+        job.nDone++;
+    }
+}
+
+void HostThreadPool::workerLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobsCV.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty())
+                return;
+            job = jobs.front();
+            // Leave it in the queue while there are chunks to grab, so other workers can join in
+            if (job->nextChunk.load() + 1 >= job->nChunks)
+                jobs.pop_front();
+        }
+        work(*job);
+        if (job->nDone.load() == job->nChunks) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            doneCV.notify_all();
+        }
+    }
+}
+
+void HostThreadPool::parallelForChunks(size_t n,
+                                       size_t nChunks,
+                                       const std::function<void(size_t, size_t, size_t)>& func) {
+    if (n == 0 || nChunks == 0)
+        return;
+    if (nChunks > n)
+        nChunks = n;
+    if (nChunks == 1 || workers.empty()) {
+        size_t chunkSize = (n + nChunks - 1) / nChunks;
+        for (size_t c = 0; c < nChunks; c++) {
+            size_t begin = c * chunkSize;
+            size_t end = (begin + chunkSize < n) ? begin + chunkSize : n;
+            if (begin < end)
+                func(c, begin, end);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->func = &func;
+    job->n = n;
+    job->nChunks = nChunks;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.push_back(job);
+    }
+    jobsCV.notify_all();
+
+    // Work on it too. Once there are no chunks left to grab, the job no longer needs to be in the queue.
+    work(*job);
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        for (auto it = jobs.begin(); it != jobs.end(); it++) {
+            if (*it == job) {
+                jobs.erase(it);
+                break;
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCV.wait(lock, [&job]() { return job->nDone.load() == job->nChunks; });
+}
+
+HostThreadPool& HostThreadPool::Shared(unsigned int nThreads) {
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+    static std::mutex poolsMutex;
+    static std::map<unsigned int, std::unique_ptr<HostThreadPool>> pools;
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    auto& pool = pools[nThreads];
+    if (!pool)
+        pool = std::make_unique<HostThreadPool>(nThreads);
+    return *pool;
+}
@@ -0,0 +1,72 @@
+//	Copyright (c) 2021, SBEL GPU Development Team
+//	Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HOST_THREAD_POOL_H
+#define DEME_HOST_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed-size pool of worker threads for host-side data-parallel work. parallelFor splits [0, n) into contiguous
+// chunks; the pool's workers and the calling thread all grab chunks until there are none left, so it is safe to call
+// from several threads at once, and from inside another parallelFor.
+class HostThreadPool {
+  public:
+    // nThreads is the total number of threads working on a parallelFor, including the caller. 0 means the hardware
+    // concurrency.
+    explicit HostThreadPool(unsigned int nThreads = 0);
+    ~HostThreadPool();
+
+    HostThreadPool(const HostThreadPool&) = delete;
+    HostThreadPool& operator=(const HostThreadPool&) = delete;
+
+    unsigned int size() const { return nThreads; }
+
+    // Call func(chunk_id, begin, end) for nChunks contiguous chunks of [0, n), and return when all are done
+    void parallelForChunks(size_t n, size_t nChunks, const std::function<void(size_t, size_t, size_t)>& func);
+
+    // Call func(begin, end) on chunks of [0, n) (one chunk per thread), and return when all are done
+    template <typename Func>
+    void parallelFor(size_t n, const Func& func) {
+        parallelForChunks(n, nThreads, [&func](size_t, size_t begin, size_t end) { func(begin, end); });
+    }
+
+    // The number of chunks that parallelFor splits [0, n) into: at most one per thread, and not too small to be worth
+    // a thread
+    size_t numChunks(size_t n, size_t minChunkSize = 1) const;
+
+    // A process-wide pool with nThreads threads, created on first use
+    static HostThreadPool& Shared(unsigned int nThreads = 0);
+
+  private:
+    struct Job {
+        const std::function<void(size_t, size_t, size_t)>* func;
+        size_t n;
+        size_t nChunks;
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> nDone{0};
+    };
+
+    // Run chunks of job until there are none left to grab
+    static void work(Job& job);
+    void workerLoop();
+
+    unsigned int nThreads;
+    std::vector<std::thread> workers;
+    std::deque<std::shared_ptr<Job>> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobsCV;
+    std::mutex doneMutex;
+    std::condition_variable doneCV;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,301 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <core/utils/JitDiskCache.h>
+
+namespace fs = std::filesystem;
+
+// Every entry starts with this line, followed by the key, the payload size and the digest of the payload, so truncated,
+// corrupted or foreign files (and entries under a key they were not stored under) are rejected
+static const std::string ENTRY_MAGIC = "DEME_JIT_CACHE_ENTRY_V2";
+static const std::string ENTRY_EXT = ".jit";
+// Temp files older than this are leftovers of crashed writers
+static const auto STALE_TEMP_AGE = std::chrono::hours(1);
+
+JitDiskCache::JitDiskCache(const fs::path& dir, size_t max_bytes) : m_dir(dir), m_max_bytes(max_bytes) {
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+    if (ec) {
+        m_stats.errors++;
+    }
+}
+
+fs::path JitDiskCache::entryPath(const std::string& key) const {
+    return m_dir / (key + ENTRY_EXT);
+}
+
+bool JitDiskCache::fetch(const std::string& key, std::string& blob) {
+    const fs::path path = entryPath(key);
+    bool good = false;
+    {
+        std::ifstream input(path, std::ios::binary);
+        if (input) {
+            std::string magic, stored_key, digest;
+            size_t size = 0;
+            input >> magic >> stored_key >> size >> digest;
+            input.get();  // The newline after the header
+            if (input && magic == ENTRY_MAGIC && stored_key == key) {
+                blob.resize(size);
+                input.read(&blob[0], size);
+                good = (input.gcount() == (std::streamsize)size) && makeKey({blob}) == digest;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!good) {
+        m_stats.misses++;
+        // A corrupted entry is removed so that it can be replaced
+        std::error_code ec;
+        if (fs::exists(path, ec)) {
+            fs::remove(path, ec);
+        }
+        return false;
+    }
+    m_stats.hits++;
+    // Mark it as recently used, for eviction
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void JitDiskCache::store(const std::string& key, const std::string& blob) {
+    // Write to a private temp file first, then publish it with an atomic rename, so readers never see a partial entry
+    std::stringstream tmp_name;
+    tmp_name << key << "." << getpid() << "." << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+    const fs::path tmp_path = m_dir / tmp_name.str();
+    bool good;
+    {
+        std::ofstream output(tmp_path, std::ios::binary | std::ios::trunc);
+        output << ENTRY_MAGIC << " " << key << " " << blob.size() << " " << makeKey({blob}) << "\n";
+        output.write(blob.data(), blob.size());
+        output.flush();
+        good = output.good();
+    }
+    std::error_code ec;
+    if (good) {
+        fs::rename(tmp_path, entryPath(key), ec);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!good || ec) {
+            m_stats.errors++;
+            fs::remove(tmp_path, ec);
+            return;
+        }
+        m_stats.stores++;
+    }
+    evict();
+}
+
+void JitDiskCache::evict() {
+    // One evictor at a time (across processes), otherwise they may both remove entries for the same excess
+    const std::string lock_path = (m_dir / ".lock").string();
+    int lock_fd = open(lock_path.c_str(), O_CREAT | O_RDWR, 0666);
+    if (lock_fd < 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.errors++;
+        return;
+    }
+    flock(lock_fd, LOCK_EX);
+
+    struct Entry {
+        fs::path path;
+        fs::file_time_type time;
+        size_t size;
+    };
+    std::vector<Entry> entries;
+    size_t total = 0;
+    const auto now = fs::file_time_type::clock::now();
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(m_dir, ec)) {
+        std::error_code item_ec;
+        if (!item.is_regular_file(item_ec))
+            continue;
+        const fs::path& path = item.path();
+        const auto time = item.last_write_time(item_ec);
+        if (item_ec)
+            continue;
+        if (path.extension() == ".tmp") {
+            if (now - time > STALE_TEMP_AGE)
+                fs::remove(path, item_ec);
+            continue;
+        }
+        if (path.extension() != ENTRY_EXT)
+            continue;
+        const size_t size = item.file_size(item_ec);
+        if (item_ec)
+            continue;
+        entries.push_back({path, time, size});
+        total += size;
+    }
+
+    size_t n_evicted = 0;
+    if (total > m_max_bytes) {
+        // Least recently used first
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+        for (const auto& entry : entries) {
+            if (total <= m_max_bytes)
+                break;
+            std::error_code rm_ec;
+            if (fs::remove(entry.path, rm_ec)) {
+                n_evicted++;
+            }
+            total -= entry.size;
+        }
+    }
+
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.evictions += n_evicted;
+}
+
+void JitDiskCache::clear() {
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(m_dir, ec)) {
+        if (item.path().extension() == ENTRY_EXT) {
+            std::error_code rm_ec;
+            fs::remove(item.path(), rm_ec);
+        }
+    }
+}
+
+size_t JitDiskCache::diskUsage() const {
+    size_t total = 0;
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(m_dir, ec)) {
+        std::error_code item_ec;
+        if (item.path().extension() == ENTRY_EXT) {
+            const size_t size = item.file_size(item_ec);
+            if (!item_ec)
+                total += size;
+        }
+    }
+    return total;
+}
+
+JitDiskCache::Stats JitDiskCache::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+// SHA-256 (FIPS 180-4). A strong digest, so that two different sets of sources never end up under one key in practice;
+// std::hash is not used since it does not have to be the same across builds.
+namespace {
+
+class Sha256 {
+  public:
+    void update(const char* data, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            m_block[m_block_len++] = (unsigned char)data[i];
+            if (m_block_len == 64) {
+                compress();
+                m_block_len = 0;
+            }
+        }
+        m_total_len += n;
+    }
+
+    std::string hexDigest() {
+        const uint64_t total_bits = m_total_len * 8;
+        const char pad_start = (char)0x80, zero = 0;
+        update(&pad_start, 1);
+        while (m_block_len != 56) {
+            update(&zero, 1);
+        }
+        for (int i = 7; i >= 0; i--) {
+            m_block[m_block_len++] = (unsigned char)(total_bits >> (8 * i));
+        }
+        compress();
+        char hex[65];
+        for (int i = 0; i < 8; i++) {
+            std::snprintf(hex + 8 * i, 9, "%08x", m_state[i]);
+        }
+        return std::string(hex);
+    }
+
+  private:
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress() {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)m_block[4 * i] << 24) | ((uint32_t)m_block[4 * i + 1] << 16) |
+                   ((uint32_t)m_block[4 * i + 2] << 8) | (uint32_t)m_block[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+        uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+        for (int i = 0; i < 64; i++) {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        m_state[0] += a;
+        m_state[1] += b;
+        m_state[2] += c;
+        m_state[3] += d;
+        m_state[4] += e;
+        m_state[5] += f;
+        m_state[6] += g;
+        m_state[7] += h;
+    }
+
+    uint32_t m_state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                           0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    unsigned char m_block[64];
+    size_t m_block_len = 0;
+    uint64_t m_total_len = 0;
+};
+
+}  // namespace
+
+std::string JitDiskCache::makeKey(const std::vector<std::string>& parts) {
+    Sha256 sha;
+    for (const auto& part : parts) {
+        // Length-prefixed (little-endian, regardless of the machine), so that different splits of the same bytes do
+        // not collide
+        char len[8];
+        for (int i = 0; i < 8; i++) {
+            len[i] = (char)((uint64_t)part.size() >> (8 * i));
+        }
+        sha.update(len, sizeof(len));
+        sha.update(part.data(), part.size());
+    }
+    return sha.hexDigest();
+}
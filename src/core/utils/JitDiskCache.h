@@ -0,0 +1,57 @@
+//	Copyright (c) 2021, SBEL GPU Development Team
+//	Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_JIT_DISK_CACHE_H
+#define DEME_JIT_DISK_CACHE_H
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A content-addressed directory of compiled JIT artifacts. Entries are keyed by a hash of everything that affects the
+// compilation result, so an entry never needs invalidating; it just gets evicted (least recently used first) when the
+// directory grows beyond the size limit. Several processes can share one cache directory: entries are published by
+// atomic renames, and eviction is serialized by a lock file.
+class JitDiskCache {
+  public:
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t stores = 0;
+        size_t evictions = 0;
+        // Failed reads/writes (such as an unwritable directory). The cache is best-effort, so these are not fatal.
+        size_t errors = 0;
+    };
+
+    JitDiskCache(const std::filesystem::path& dir, size_t max_bytes);
+
+    // Get the entry under key into blob. Returns false on a miss (or if the entry is unreadable or corrupted).
+    bool fetch(const std::string& key, std::string& blob);
+    // Put blob under key, then evict old entries if the size limit is exceeded
+    void store(const std::string& key, const std::string& blob);
+    // Remove all entries
+    void clear();
+
+    // Total bytes of the entries in the cache directory
+    size_t diskUsage() const;
+    Stats getStats() const;
+    const std::filesystem::path& getDir() const { return m_dir; }
+    size_t getMaxBytes() const { return m_max_bytes; }
+
+    // A stable (across processes and runs) SHA-256 digest of the parts, in hex
+    static std::string makeKey(const std::vector<std::string>& parts);
+
+  private:
+    std::filesystem::path entryPath(const std::string& key) const;
+    void evict();
+
+    std::filesystem::path m_dir;
+    size_t m_max_bytes;
+    mutable std::mutex m_mutex;
+    Stats m_stats;
+};
+
+#endif
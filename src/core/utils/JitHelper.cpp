@@ -6,14 +6,18 @@
 #include <fstream>
 #include <filesystem>
 #include <string>
-#include <regex>
+#include <set>
+#include <sstream>
 
 #include <jitify/jitify.hpp>
+#include <nvrtc.h>
 
 #include <core/ApiVersion.h>
 #include <core/utils/JitHelper.h>
+#include <core/utils/JitSubstitution.h>
 
-jitify::JitCache JitHelper::kcache;
+std::unordered_map<std::string, std::string> JitHelper::memoryCache;
+std::mutex JitHelper::memoryCacheMutex;
 
 const std::filesystem::path JitHelper::KERNEL_DIR = std::filesystem::path(PROJECT_SOURCE_DIRECTORY) / "src" / "kernel";
 
@@ -33,19 +37,166 @@ void JitHelper::Header::substitute(const std::string& symbol, const std::string&
     }
 }
 
-jitify::Program JitHelper::buildProgram(
+JitProgram::JitProgram(const std::string& code,
+                       const std::vector<std::string>& headers,
+                       const std::vector<std::string>& flags,
+                       const std::string& fingerprint,
+                       std::shared_ptr<JitDiskCache> disk_cache)
+    : m_code(code),
+      m_headers(headers),
+      m_flags(flags),
+      m_fingerprint(fingerprint),
+      m_disk_cache(disk_cache),
+      m_mutex(new std::mutex) {}
+
+const jitify::experimental::Program& JitProgram::getProgram() {
+    if (m_program) {
+        return *m_program;
+    }
+    // Preprocessing (locating all the headers) is a part of the cost too, so the preprocessed program is also cached
+    const std::string key = JitDiskCache::makeKey({"program", m_fingerprint});
+    std::string blob;
+    if (JitHelper::fetchCached(key, blob, m_disk_cache)) {
+        try {
+            m_program = std::make_unique<jitify::experimental::Program>(
+                jitify::experimental::Program::deserialize(blob));
+            return *m_program;
+        } catch (const std::exception&) {
+            // Unusable entry (say written by a different jitify version); just rebuild it
+        }
+    }
+    m_program = std::make_unique<jitify::experimental::Program>(m_code, m_headers, m_flags);
+    JitHelper::storeCached(key, m_program->serialize(), m_disk_cache);
+    return *m_program;
+}
+
+const jitify::experimental::KernelInstantiation& JitProgram::getInstantiation(
+    const std::string& name,
+    const std::vector<std::string>& template_args) {
+    std::lock_guard<std::mutex> lock(*m_mutex);
+    std::string inst_name = name;
+    for (const auto& arg : template_args) {
+        inst_name += "," + arg;
+    }
+    auto it = m_instantiations.find(inst_name);
+    if (it != m_instantiations.end()) {
+        return *(it->second);
+    }
+
+    // Compiled code depends on the device it is compiled for, and that is the current device of the calling thread
+    int device = 0, cc_major = 0, cc_minor = 0;
+    cudaGetDevice(&device);
+    cudaDeviceGetAttribute(&cc_major, cudaDevAttrComputeCapabilityMajor, device);
+    cudaDeviceGetAttribute(&cc_minor, cudaDevAttrComputeCapabilityMinor, device);
+    const std::string key =
+        JitDiskCache::makeKey({"kernel", m_fingerprint, inst_name, std::to_string(cc_major * 10 + cc_minor)});
+    std::string blob;
+    if (JitHelper::fetchCached(key, blob, m_disk_cache)) {
+        try {
+            auto inst = std::make_unique<jitify::experimental::KernelInstantiation>(
+                jitify::experimental::KernelInstantiation::deserialize(blob));
+            return *(m_instantiations[inst_name] = std::move(inst));
+        } catch (const std::exception&) {
+            // Unusable entry; compile it again below
+        }
+    }
+
+    auto inst = std::make_unique<jitify::experimental::KernelInstantiation>(
+        getProgram().kernel(name).instantiate(template_args));
+    JitHelper::storeCached(key, inst->serialize(), m_disk_cache);
+    return *(m_instantiations[inst_name] = std::move(inst));
+}
+
+bool JitHelper::fetchCached(const std::string& key,
+                            std::string& blob,
+                            const std::shared_ptr<JitDiskCache>& disk_cache) {
+    {
+        std::lock_guard<std::mutex> lock(memoryCacheMutex);
+        auto it = memoryCache.find(key);
+        if (it != memoryCache.end()) {
+            blob = it->second;
+            return true;
+        }
+    }
+    if (!disk_cache || !disk_cache->fetch(key, blob)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(memoryCacheMutex);
+    memoryCache[key] = blob;
+    return true;
+}
+
+void JitHelper::storeCached(const std::string& key,
+                            const std::string& blob,
+                            const std::shared_ptr<JitDiskCache>& disk_cache) {
+    {
+        std::lock_guard<std::mutex> lock(memoryCacheMutex);
+        memoryCache[key] = blob;
+    }
+    if (disk_cache) {
+        disk_cache->store(key, blob);
+    }
+}
+
+std::string JitHelper::includedSources(const std::string& code, const std::vector<std::string>& flags) {
+    std::vector<std::filesystem::path> include_dirs;
+    for (const auto& flag : flags) {
+        if (flag.rfind("-I", 0) == 0) {
+            include_dirs.push_back(flag.substr(2));
+        }
+    }
+    std::string sources;
+    std::set<std::filesystem::path> visited;
+    std::vector<std::string> to_scan = {code};
+    while (!to_scan.empty()) {
+        const std::string text = std::move(to_scan.back());
+        to_scan.pop_back();
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line)) {
+            // Only look at lines like `#include <file>' or `#include "file"' (commented-out ones do not count)
+            size_t p = line.find_first_not_of(" \t");
+            if (p == std::string::npos || line[p] != '#')
+                continue;
+            p = line.find_first_not_of(" \t", p + 1);
+            if (p == std::string::npos || line.compare(p, 7, "include") != 0)
+                continue;
+            p = line.find_first_of("<\"", p + 7);
+            if (p == std::string::npos)
+                continue;
+            const size_t q = line.find_first_of(">\"", p + 1);
+            if (q == std::string::npos)
+                continue;
+            const std::string included = line.substr(p + 1, q - p - 1);
+            for (const auto& dir : include_dirs) {
+                std::error_code ec;
+                const std::filesystem::path path = std::filesystem::weakly_canonical(dir / included, ec);
+                if (ec || !std::filesystem::is_regular_file(path, ec))
+                    continue;
+                if (visited.insert(path).second) {
+                    std::string content = loadSourceFile(path);
+                    sources += path.string() + "\n" + content;
+                    to_scan.push_back(std::move(content));
+                }
+                break;
+            }
+        }
+    }
+    return sources;
+}
+
+JitProgram JitHelper::buildProgram(
     const std::string& name,
     const std::filesystem::path& source,
     std::unordered_map<std::string, std::string> substitutions,
     // std::vector<JitHelper::Header> headers, // THIS PARAMETER PROBABLY WON'T EVER BE USED
-    std::vector<std::string> flags) {
+    std::vector<std::string> flags,
+    std::shared_ptr<JitDiskCache> disk_cache) {
     std::string code = name + "\n";
 
     code.append(JitHelper::loadSourceFile(source));
     // Apply the substitutions
-    for (auto& subst : substitutions) {
-        code = std::regex_replace(code, std::regex(subst.first), subst.second);
-    }
+    code = JitSubstitution::apply(code, substitutions);
 
     std::vector<std::string> header_code;
     // THIS BLOCK IS ONLY NEEDED IF THE headers PARAMETER IS USED
@@ -55,5 +206,17 @@ jitify::Program JitHelper::buildProgram(
     }
     */
 
-    return kcache.program(code, header_code, flags);
+    // Everything that goes into the compilation: source, headers, flags, and the versions of the compiler and us
+    int nvrtc_major = 0, nvrtc_minor = 0, runtime_version = 0;
+    nvrtcVersion(&nvrtc_major, &nvrtc_minor);
+    cudaRuntimeGetVersion(&runtime_version);
+    std::vector<std::string> parts = {code};
+    parts.insert(parts.end(), header_code.begin(), header_code.end());
+    parts.insert(parts.end(), flags.begin(), flags.end());
+    parts.push_back(includedSources(code, flags));
+    parts.push_back(std::to_string(nvrtc_major) + "." + std::to_string(nvrtc_minor) + "/" +
+                    std::to_string(runtime_version) + "/" + std::to_string(API_VERSION));
+    const std::string fingerprint = JitDiskCache::makeKey(parts);
+
+    return JitProgram(code, header_code, flags, fingerprint, disk_cache);
 }
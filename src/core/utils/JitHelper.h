@@ -7,12 +7,63 @@
 #define DEME_JIT_HELPER_H
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <unordered_map>
 
 #include <jitify/jitify.hpp>
 
+#include <core/utils/JitDiskCache.h>
+
+// A jitified program. Used as prog->kernel("name").instantiate().configure(...).launch(...), like a jitify::Program.
+// Kernel instantiations are compiled the first time they are asked for, and then kept. Before compiling, an
+// instantiation is looked up in the process-wide in-memory cache and then in the on-disk cache (if in use), and it is
+// stored in them after compiling.
+class JitProgram {
+  public:
+    class Kernel {
+      public:
+        Kernel(JitProgram* program, const std::string& name) : m_program(program), m_name(name) {}
+        const jitify::experimental::KernelInstantiation& instantiate(
+            const std::vector<std::string>& template_args = std::vector<std::string>()) const {
+            return m_program->getInstantiation(m_name, template_args);
+        }
+
+      private:
+        JitProgram* m_program;
+        std::string m_name;
+    };
+
+    JitProgram(const std::string& code,
+               const std::vector<std::string>& headers,
+               const std::vector<std::string>& flags,
+               const std::string& fingerprint,
+               std::shared_ptr<JitDiskCache> disk_cache);
+
+    Kernel kernel(const std::string& name) { return Kernel(this, name); }
+
+  private:
+    const jitify::experimental::KernelInstantiation& getInstantiation(const std::string& name,
+                                                                       const std::vector<std::string>& template_args);
+    // Preprocessed program, built (or loaded from disk cache) only if an instantiation has to be compiled
+    const jitify::experimental::Program& getProgram();
+
+    std::string m_code;
+    std::vector<std::string> m_headers;
+    std::vector<std::string> m_flags;
+    // Everything that affects the compiled result, other than the kernel name and the device
+    std::string m_fingerprint;
+    // Null if the on-disk cache is not in use
+    std::shared_ptr<JitDiskCache> m_disk_cache;
+
+    std::unique_ptr<jitify::experimental::Program> m_program;
+    std::unordered_map<std::string, std::unique_ptr<jitify::experimental::KernelInstantiation>> m_instantiations;
+    // Held in a pointer so the program stays movable
+    std::unique_ptr<std::mutex> m_mutex;
+};
+
 class JitHelper {
   public:
     class Header {
@@ -25,11 +76,13 @@ class JitHelper {
         std::string _source;
     };
 
-    static jitify::Program buildProgram(
+    // The program caches what it compiles in disk_cache too, unless it is null
+    static JitProgram buildProgram(
         const std::string& name,
         const std::filesystem::path& source,
         std::unordered_map<std::string, std::string> substitutions = std::unordered_map<std::string, std::string>(),
-        std::vector<std::string> flags = std::vector<std::string>());
+        std::vector<std::string> flags = std::vector<std::string>(),
+        std::shared_ptr<JitDiskCache> disk_cache = nullptr);
 
     //// I'm pretty sure C++17 auto-converts this
     // static jitify::Program buildProgram(
@@ -38,10 +91,25 @@ class JitHelper {
     // 	std::vector<std::string> flags = 0
     // );
 
+    // Compiled artifacts are also kept in memory for the life of the process, keyed like the on-disk cache, so that
+    // solvers in the same process do not compile the same thing twice. Look up key there, then in disk_cache (if not
+    // null); an on-disk hit is kept in memory too.
+    static bool fetchCached(const std::string& key, std::string& blob, const std::shared_ptr<JitDiskCache>& disk_cache);
+    // Keep blob under key in memory, and in disk_cache if not null
+    static void storeCached(const std::string& key,
+                            const std::string& blob,
+                            const std::shared_ptr<JitDiskCache>& disk_cache);
+
     static const std::filesystem::path KERNEL_DIR;
 
+    // The content of the files that code includes (recursively), if they can be found in the -I directories in flags.
+    // They are a part of the fingerprint, since jitify would pick up any change to them.
+    static std::string includedSources(const std::string& code, const std::vector<std::string>& flags);
+
   private:
-    static jitify::JitCache kcache;
+    // Serialized, not loaded, since a loaded kernel belongs to the device it was loaded on
+    static std::unordered_map<std::string, std::string> memoryCache;
+    static std::mutex memoryCacheMutex;
 
     inline static std::string loadSourceFile(const std::filesystem::path& sourcefile) {
         std::string code;
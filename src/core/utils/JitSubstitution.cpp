@@ -0,0 +1,151 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#include <cstring>
+#include <regex>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <core/utils/JitSubstitution.h>
+
+namespace {
+
+using SubTable = std::unordered_map<std::string_view, const std::string*>;
+
+inline bool isPlaceholderChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+inline bool isWordChar(char c) {
+    return c == '_' || isPlaceholderChar(c);
+}
+
+// A placeholder looks like _[A-Za-z0-9]+_. The single-pass scan relies on that: it only needs to look at underscores.
+bool isPlainPlaceholder(const std::string& key) {
+    if (key.size() < 3 || key.front() != '_' || key.back() != '_')
+        return false;
+    for (size_t i = 1; i + 1 < key.size(); i++) {
+        if (!isPlaceholderChar(key[i]))
+            return false;
+    }
+    return true;
+}
+
+// If a placeholder in table starts at text[p] (which is an underscore), return its end (one past the closing
+// underscore) and set value; otherwise return 0
+inline size_t matchAt(const char* text, size_t n, size_t p, const SubTable& table, const std::string*& value) {
+    size_t q = p + 1;
+    while (q < n && isPlaceholderChar(text[q]))
+        q++;
+    if (q == p + 1 || q == n || text[q] != '_')
+        return 0;
+    auto it = table.find(std::string_view(text + p, q + 1 - p));
+    if (it == table.end())
+        return 0;
+    value = it->second;
+    return q + 1;
+}
+
+// If any placeholder in table starts at an underscore in text[begin, end) (it may run past end), return true
+bool anyMatchStartsIn(const char* text, size_t n, size_t begin, size_t end, const SubTable& table) {
+    const std::string* value;
+    for (size_t p = begin; p < end; p++) {
+        const char* next = (const char*)std::memchr(text + p, '_', end - p);
+        if (!next)
+            return false;
+        p = next - text;
+        if (matchAt(text, n, p, table, value))
+            return true;
+    }
+    return false;
+}
+
+struct Match {
+    size_t begin;
+    size_t end;
+    const std::string* value;
+};
+
+}  // namespace
+
+std::string JitSubstitution::applyRegex(std::string code, const std::unordered_map<std::string, std::string>& subs) {
+    for (auto& subst : subs) {
+        code = std::regex_replace(code, std::regex(subst.first), subst.second);
+    }
+    return code;
+}
+
+std::string JitSubstitution::apply(const std::string& code, const std::unordered_map<std::string, std::string>& subs) {
+    // Keys that are not plain placeholders are regexes, and values with $ are regex format strings; the reference
+    // behavior handles them
+    SubTable table;
+    table.reserve(subs.size());
+    for (const auto& subst : subs) {
+        if (!isPlainPlaceholder(subst.first) || subst.second.find('$') != std::string::npos)
+            return applyRegex(code, subs);
+        table.emplace(subst.first, &subst.second);
+    }
+    if (table.empty())
+        return code;
+
+    // The one scan over code. Only underscores can start a placeholder, so hop from one to the next.
+    const char* text = code.data();
+    const size_t n = code.size();
+    std::vector<Match> matches;
+    size_t out_size = n;
+    for (size_t p = 0; p < n;) {
+        const char* next = (const char*)std::memchr(text + p, '_', n - p);
+        if (!next)
+            break;
+        p = next - text;
+        const std::string* value;
+        const size_t end = matchAt(text, n, p, table, value);
+        if (!end) {
+            p++;
+            continue;
+        }
+        // Two placeholders sharing an underscore (_a_b_): which one gets replaced depends on the order
+        const std::string* other;
+        if (matchAt(text, n, end - 1, table, other))
+            return applyRegex(code, subs);
+        // A value and its surroundings could combine into a placeholder, which is then substituted by the later
+        // substitutions only. Placeholders are made of word characters, so that needs word characters on both sides of
+        // a boundary of the value. (A non-word character next to a placeholder stays there, whatever the order.)
+        const bool word_before = (p > 0) && isWordChar(text[p - 1]);
+        const bool word_after = (end < n) && isWordChar(text[end]);
+        if (value->empty() ? (word_before && word_after)
+                           : ((word_before && isWordChar(value->front())) || (word_after && isWordChar(value->back()))))
+            return applyRegex(code, subs);
+        matches.push_back({p, end, value});
+        out_size = out_size - (end - p) + value->size();
+        p = end;
+    }
+    if (matches.empty())
+        return code;
+
+    // A value that has placeholders in it would be substituted again, or not, depending on the order
+    std::unordered_set<const std::string*> checked_values;
+    for (const auto& match : matches) {
+        if (checked_values.insert(match.value).second &&
+            anyMatchStartsIn(match.value->data(), match.value->size(), 0, match.value->size(), table))
+            return applyRegex(code, subs);
+    }
+
+    std::string out;
+    out.resize(out_size);
+    char* dst = &out[0];
+    size_t src = 0;
+    for (const auto& match : matches) {
+        std::memcpy(dst, text + src, match.begin - src);
+        dst += match.begin - src;
+        std::memcpy(dst, match.value->data(), match.value->size());
+        dst += match.value->size();
+        src = match.end;
+    }
+    std::memcpy(dst, text + src, n - src);
+
+    return out;
+}
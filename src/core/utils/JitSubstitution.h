@@ -0,0 +1,25 @@
+//	Copyright (c) 2021, SBEL GPU Development Team
+//	Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_JIT_SUBSTITUTION_H
+#define DEME_JIT_SUBSTITUTION_H
+
+#include <string>
+#include <unordered_map>
+
+// Fills the placeholders (like _Radii_) in a kernel source with their values before it is jitified.
+class JitSubstitution {
+  public:
+    // Replace every placeholder in code with its value in one scan of code. Placeholders are looked up in a hash table,
+    // and the result is written into a buffer allocated once. The output is byte-identical to that of applyRegex; in the
+    // rare case that it cannot be guaranteed (the result depends on the order the substitutions are applied, for
+    // example when a value contains another placeholder), this falls back to applyRegex.
+    static std::string apply(const std::string& code, const std::unordered_map<std::string, std::string>& subs);
+
+    // The reference behavior: one std::regex_replace over the whole code per substitution, in the map's order
+    static std::string applyRegex(std::string code, const std::unordered_map<std::string, std::string>& subs);
+};
+
+#endif
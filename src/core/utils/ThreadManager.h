@@ -8,7 +8,13 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #include <immintrin.h>
+#endif
 
 // class holds on to statistics related to the scheduling process
 class ManagerStatistics {
@@ -32,6 +38,85 @@ class ManagerStatistics {
     ~ManagerStatistics() {}
 };
 
+// How a worker waits for the other to hand something over: first check on it nSpins times in a busy loop, then nYields
+// times giving up the CPU in between, and then sleep until woken up. Spinning gets the fastest handoff when the other
+// worker is about to deliver; sleeping frees the core when it is not. With only one core, spinning just keeps the other
+// worker from running, so it is skipped.
+struct HandoffBackoff {
+    unsigned int nSpins = 512;
+    unsigned int nYields = 16;
+};
+
+inline void handoffCpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#endif
+}
+
+// One direction of the dT--kT handoff, with one producer and one consumer. The producer publishes new buffer content by
+// advancing a sequence number, and the content is fresh for the consumer as long as the published number is ahead of
+// the last one it consumed. Both publish and consume must be called while holding the lock of the buffer in question,
+// so the consumer never takes in content newer than what it marks as consumed. Checking and waiting for fresh content
+// take no lock; only a consumer that ran out of patience sleeps on a condition variable, and only then does the
+// producer touch it.
+class HandoffChannel {
+  public:
+    HandoffChannel() noexcept {
+        published = 0;
+        consumed = 0;
+        parked = false;
+    }
+
+    // Producer: make the content written into the buffer available
+    void publish() { published.fetch_add(1); }
+    // Producer: wake the consumer up, if it is sleeping
+    void notifyConsumer() {
+        if (parked.load()) {
+            std::lock_guard<std::mutex> lock(parkLock);
+            cv_Park.notify_all();
+        }
+    }
+
+    // If there is content the consumer has not taken in yet
+    bool isFresh() const { return published.load() != consumed.load(); }
+    // Consumer: mark all content published so far as taken in
+    void consume() { consumed.store(published.load()); }
+
+    // Consumer: wait until there is fresh content
+    void waitForFresh(const HandoffBackoff& backoff) {
+        static const bool canSpin = (std::thread::hardware_concurrency() != 1);
+        for (unsigned int i = 0; canSpin && i < backoff.nSpins; i++) {
+            if (isFresh())
+                return;
+            handoffCpuRelax();
+        }
+        for (unsigned int i = 0; i < backoff.nYields; i++) {
+            if (isFresh())
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(parkLock);
+        // Saying that we sleep before the last check, and the producer publishing before checking if we sleep, make
+        // sure that at least one of us sees the other (all these atomics are sequentially consistent)
+        parked.store(true);
+        while (!isFresh()) {
+            cv_Park.wait(lock);
+        }
+        parked.store(false);
+        nParks++;
+    }
+
+    // Number of times the consumer had to sleep
+    std::atomic<uint64_t> nParks{0};
+
+  private:
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> consumed;
+    std::atomic<bool> parked;
+    std::mutex parkLock;
+    std::condition_variable cv_Park;
+};
+
 // class that will be used via an atomic object to coordinate the
 // production-consumption interplay
 class ThreadManager {
@@ -41,15 +126,17 @@ class ThreadManager {
     std::atomic<int64_t> dynamicRequestedUpdateFrequency;
     std::atomic<bool> dynamicDone;
 
-    std::atomic<bool> dynamicOwned_Prod2ConsBuffer_isFresh;
-    std::atomic<bool> kinematicOwned_Cons2ProdBuffer_isFresh;
+    // kT's produce (contact pairs) for dT, and dT's work orders (owner states) for kT
+    HandoffChannel dynamicOwned_Prod2ConsBuffer;
+    HandoffChannel kinematicOwned_Cons2ProdBuffer;
+    // How dT and kT wait on those
+    HandoffBackoff handoffBackoff;
 
     std::mutex dynamicOwnedBuffer_AccessCoordination;
     std::mutex kinematicOwnedBuffer_AccessCoordination;
-    std::mutex kinematicCanProceed;
-    std::mutex dynamicCanProceed;
-    std::condition_variable cv_KinematicCanProceed;
-    std::condition_variable cv_DynamicCanProceed;
+    // Held by kT while it works on an order (from unpacking it to handing over the produce), so that kT's arrays can be
+    // grown while kT waits for the next one, without syncing kT and dT
+    std::mutex kinematicWork_AccessCoordination;
     ManagerStatistics schedulingStats;
 
     // The following variables are used to ensure that when an instance of d or k thread is created, a while loop that
@@ -70,8 +157,6 @@ class ThreadManager {
         stampLastUpdateOfDynamic = -1;
         currentStampOfDynamic = 0;
         dynamicDone = false;
-        dynamicOwned_Prod2ConsBuffer_isFresh = false;
-        kinematicOwned_Cons2ProdBuffer_isFresh = false;
     }
 
     ~ThreadManager() {}
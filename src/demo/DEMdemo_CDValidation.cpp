@@ -0,0 +1,200 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A validation of the contact detection variants. The same polydisperse packing is set up in a few solvers that differ
+// only in how kT does its job or in how the arrays are ordered, and the contact pairs they hand to dT (which include
+// the false positives in the expanded margin) are written as BINARY contact files, read back and compared by owner IDs.
+// Compared here:
+// - Contact detection on host threads against the GPU kernels, and with a bin hierarchy against single-level bins
+//   (on both), after one step. The pair sets have to be identical.
+// - Runs with and without spatial reordering of the arrays, after one step, and after a short settling run that
+//   reorders every few hundred steps. The pair sets have to be identical, and so do the contact forces (which carry
+//   the contact history of the frictional model), up to the rounding of forces being summed in another order.
+
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/SnapshotIO.h>
+#include <DEM/utils/Samplers.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace deme;
+using namespace std::filesystem;
+
+// One contact, with the owner pair in a canonical order so that it does not depend on the internal body order
+using ContactKey = std::tuple<bodyID_t, bodyID_t, contact_t>;
+
+// The contacts of a run, sorted by key, and the force of each
+struct ContactList {
+    std::vector<ContactKey> keys;
+    std::vector<float3> forces;
+};
+
+struct CDCase {
+    std::string name;
+    bool host_cd = false;
+    bool bin_hierarchy = false;
+    // Rearrange the arrays along a Morton curve right after initialization, and then every this many steps (0 for no
+    // rearranging)
+    unsigned int reorder_freq = 0;
+};
+
+// Set up the packing with the case's contact detection settings, run n_steps (in n_calls DoDynamics calls), then return
+// the contacts
+ContactList runCase(const CDCase& c, unsigned int n_steps, unsigned int n_calls, const path& out_dir) {
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(ERROR);
+    DEMSim.UseFrictionalHertzianModel();
+    DEMSim.SetContactOutputFormat(OUTPUT_FORMAT::BINARY);
+    DEMSim.SetContactOutputContent(OWNERS | FORCE);
+    if (c.host_cd)
+        DEMSim.SetHostContactDetection();
+    if (c.reorder_freq > 0)
+        DEMSim.SetSpatialReorderFreq(c.reorder_freq);
+    DEMSim.UseBinHierarchy(c.bin_hierarchy);
+
+    auto mat = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.5}, {"mu", 0.5}});
+
+    // Small spheres of a few random sizes at the bottom, so that many pairs are in the expanded margin, and a layer
+    // of big ones on top of them
+    srand(42);
+    std::vector<std::shared_ptr<DEMClumpTemplate>> small_types;
+    for (int i = 0; i < 5; i++) {
+        float r = 0.012 + 0.003 * i;
+        small_types.push_back(DEMSim.LoadSphereType(r * r * r * 4000., r, mat));
+    }
+    std::vector<std::shared_ptr<DEMClumpTemplate>> types;
+    std::vector<float3> xyz;
+    HCPSampler small_sampler(0.05);
+    auto small_xyz = small_sampler.SampleBox(make_float3(0, 0, -0.3), make_float3(0.4, 0.4, 0.15));
+    for (const auto& pos : small_xyz) {
+        types.push_back(small_types.at(rand() % small_types.size()));
+        xyz.push_back(pos);
+    }
+    HCPSampler big_sampler(0.2005);
+    auto big_xyz = big_sampler.SampleBox(make_float3(0, 0, 0.2), make_float3(0.35, 0.35, 0.05));
+    auto big_type = DEMSim.LoadSphereType(0.1 * 0.1 * 0.1 * 4000., 0.1, mat);
+    for (const auto& pos : big_xyz) {
+        types.push_back(big_type);
+        xyz.push_back(pos);
+    }
+    DEMSim.AddClumps(types, xyz);
+
+    DEMSim.InstructBoxDomainDimension(1.2, 1.2, 1.2);
+    DEMSim.AddBCPlane(make_float3(0, 0, -0.47), make_float3(0, 0, 1), mat);
+    DEMSim.SetCoordSysOrigin("center");
+    DEMSim.SetInitTimeStep(1e-5);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.8));
+    // Contact detection in lockstep with dT, so that which contact list dT ends up with does not depend on timing
+    DEMSim.SetCDUpdateFreq(0);
+    DEMSim.SetExpandFactor(0.004);
+    DEMSim.Initialize();
+    if (c.reorder_freq > 0)
+        DEMSim.ReorderSpatially();
+
+    for (unsigned int i = 0; i < n_calls; i++)
+        DEMSim.DoDynamicsThenSync(n_steps / n_calls * 1e-5);
+    std::string filename = (out_dir / (c.name + "_" + std::to_string(n_steps) + ".bin")).string();
+    DEMSim.WriteContactFile(filename);
+
+    DEMSnapshot snap = DEMSnapshot::ReadFile(filename);
+    std::vector<bodyID_t> A = snap.GetColumn<bodyID_t>(OUTPUT_FILE_OWNER_1_NAME);
+    std::vector<bodyID_t> B = snap.GetColumn<bodyID_t>(OUTPUT_FILE_OWNER_2_NAME);
+    std::vector<contact_t> type = snap.GetColumn<contact_t>(OUTPUT_FILE_CNT_TYPE_NAME);
+    std::vector<float> f[3] = {snap.GetColumn<float>(OUTPUT_FILE_FORCE_X_NAME),
+                               snap.GetColumn<float>(OUTPUT_FILE_FORCE_Y_NAME),
+                               snap.GetColumn<float>(OUTPUT_FILE_FORCE_Z_NAME)};
+    std::vector<std::pair<ContactKey, float3>> contacts(snap.GetNumRows());
+    for (size_t i = 0; i < contacts.size(); i++) {
+        // For sphere--sphere contacts, which sphere is A is decided by the internal order, and the force is the one A
+        // feels
+        float sign = 1.f;
+        if (type[i] == SPHERE_SPHERE_CONTACT && A[i] > B[i]) {
+            std::swap(A[i], B[i]);
+            sign = -1.f;
+        }
+        contacts[i] = {ContactKey(A[i], B[i], type[i]), make_float3(f[0][i], f[1][i], f[2][i]) * sign};
+    }
+    std::sort(contacts.begin(), contacts.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    ContactList res;
+    for (const auto& contact : contacts) {
+        res.keys.push_back(contact.first);
+        res.forces.push_back(contact.second);
+    }
+    return res;
+}
+
+// Report how two sorted contact key lists compare; returns true if they are identical
+bool comparePairs(const std::string& what, const std::vector<ContactKey>& ref, const std::vector<ContactKey>& other) {
+    std::vector<ContactKey> only_ref, only_other;
+    std::set_difference(ref.begin(), ref.end(), other.begin(), other.end(), std::back_inserter(only_ref));
+    std::set_difference(other.begin(), other.end(), ref.begin(), ref.end(), std::back_inserter(only_other));
+    bool same = only_ref.empty() && only_other.empty() && ref.size() == other.size();
+    printf("%s: %zu vs %zu pairs, %zu missing, %zu extra... %s\n", what.c_str(), ref.size(), other.size(),
+           only_ref.size(), only_other.size(), same ? "identical" : "DIFFERENT");
+    return same;
+}
+
+// Report how the forces of two runs with the same contacts compare; returns true if they differ by no more than tol
+// times the largest force
+bool compareForces(const std::string& what, const ContactList& ref, const ContactList& other, float tol) {
+    float max_force = 0.f, max_diff = 0.f;
+    for (size_t i = 0; i < ref.forces.size(); i++) {
+        max_force = std::max(max_force, length(ref.forces[i]));
+        max_diff = std::max(max_diff, length(ref.forces[i] - other.forces[i]));
+    }
+    bool same = max_diff <= tol * max_force;
+    printf("%s: largest force %g, largest difference %g... %s\n", what.c_str(), max_force, max_diff,
+           same ? "identical" : "DIFFERENT");
+    return same;
+}
+
+int main() {
+    path out_dir = current_path();
+    out_dir += "/DEMdemo_CDValidation";
+    create_directory(out_dir);
+
+    bool all_good = true;
+
+    // Right after the first contact detection, so that all cases see exactly the same positions
+    CDCase gpu_case{"gpu_cd"};
+    CDCase host_case{"host_cd"};
+    host_case.host_cd = true;
+    CDCase reorder_case{"reordered"};
+    reorder_case.reorder_freq = 500;
+    auto gpu_contacts = runCase(gpu_case, 1, 1, out_dir);
+    auto host_contacts = runCase(host_case, 1, 1, out_dir);
+    all_good &= comparePairs("Host CD vs GPU CD", gpu_contacts.keys, host_contacts.keys);
+    for (bool host_cd : {false, true}) {
+        CDCase hierarchy_case{host_cd ? "host_cd_bin_hierarchy" : "gpu_cd_bin_hierarchy"};
+        hierarchy_case.host_cd = host_cd;
+        hierarchy_case.bin_hierarchy = true;
+        auto hierarchy_contacts = runCase(hierarchy_case, 1, 1, out_dir);
+        all_good &= comparePairs(std::string(host_cd ? "Host" : "GPU") + " CD, bin hierarchy vs single-level bins",
+                                 (host_cd ? host_contacts : gpu_contacts).keys, hierarchy_contacts.keys);
+    }
+    auto reorder_contacts = runCase(reorder_case, 1, 1, out_dir);
+    all_good &= comparePairs("Reordered vs not reordered", gpu_contacts.keys, reorder_contacts.keys);
+
+    // After settling for a while, with reorderings in between; the contact forces carry the history
+    const unsigned int n_steps = 2000, n_calls = 4;
+    gpu_contacts = runCase(gpu_case, n_steps, n_calls, out_dir);
+    reorder_contacts = runCase(reorder_case, n_steps, n_calls, out_dir);
+    bool same_pairs = comparePairs("Reordered vs not reordered, settled", gpu_contacts.keys, reorder_contacts.keys);
+    all_good &= same_pairs;
+    if (same_pairs)
+        all_good &= compareForces("Reordered vs not reordered, settled", gpu_contacts, reorder_contacts, 1e-3);
+
+    std::cout << "DEMdemo_CDValidation exiting..." << std::endl;
+    return all_good ? 0 : 1;
+}
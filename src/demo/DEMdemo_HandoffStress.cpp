@@ -0,0 +1,226 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A stress test of the dT--kT handoff protocol in ThreadManager.h. Two threads run the same loops as dT and kT do, with
+// busy-waiting dummy work in place of force calculation and contact detection, and the work orders and produce carry
+// IDs and time stamps. It checks that kT gets every work order exactly once and in order, that every produce dT takes
+// in answers its latest order, and that dT never runs further ahead than the update frequency allows; it also measures
+// how long it takes a waiting worker to notice a handoff, with a few backoff settings. No GPU is needed.
+
+#include <core/utils/ThreadManager.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+inline int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+inline void dummyWork(unsigned int us) {
+    int64_t until = nowNs() + (int64_t)us * 1000;
+    while (nowNs() < until) {
+    }
+}
+
+// What goes through the buffers
+struct Handoff {
+    int64_t id = -1;
+    int64_t stampNs = 0;
+};
+
+struct RunResult {
+    bool correct = true;
+    int64_t maxLag = 0;
+    uint64_t nOrders = 0;
+    uint64_t nParks = 0;
+    double seconds = 0.;
+    // How long after the publish the waiting side noticed it, in ns
+    std::vector<int64_t> dTWakeups;
+    std::vector<int64_t> kTWakeups;
+};
+
+RunResult runOnce(int updateFreq,
+                  unsigned int nSteps,
+                  unsigned int dTWorkUs,
+                  unsigned int kTWorkUs,
+                  const HandoffBackoff& backoff) {
+    ThreadManager tm;
+    tm.dynamicRequestedUpdateFrequency = updateFreq;
+    tm.handoffBackoff = backoff;
+    Handoff orderBuffer, produceBuffer;
+    bool kTShouldReset = false;
+    RunResult res;
+    // kT's own findings, merged in when it is done
+    bool kTCorrect = true;
+    std::vector<int64_t> kTWakeups;
+
+    std::thread kT([&]() {
+        int64_t lastOrder = -1;
+        while (!tm.dynamicDone) {
+            bool waited = false;
+            if (!tm.kinematicOwned_Cons2ProdBuffer.isFresh()) {
+                tm.kinematicOwned_Cons2ProdBuffer.waitForFresh(tm.handoffBackoff);
+                waited = true;
+                if (kTShouldReset)
+                    break;
+            }
+            Handoff order;
+            {
+                std::lock_guard<std::mutex> lock(tm.kinematicOwnedBuffer_AccessCoordination);
+                order = orderBuffer;
+                tm.kinematicOwned_Cons2ProdBuffer.consume();
+            }
+            if (waited)
+                kTWakeups.push_back(nowNs() - order.stampNs);
+            // dT only orders again after it took in the produce of the last order
+            if (order.id != lastOrder + 1) {
+                std::printf("kT got order %lld after order %lld\n", (long long)order.id, (long long)lastOrder);
+                kTCorrect = false;
+            }
+            lastOrder = order.id;
+
+            dummyWork(kTWorkUs);
+
+            {
+                std::lock_guard<std::mutex> lock(tm.dynamicOwnedBuffer_AccessCoordination);
+                produceBuffer.id = order.id;
+                produceBuffer.stampNs = nowNs();
+                tm.dynamicOwned_Prod2ConsBuffer.publish();
+            }
+            tm.dynamicOwned_Prod2ConsBuffer.notifyConsumer();
+        }
+    });
+
+    auto start = Clock::now();
+    int64_t lastOrderSent = -1;
+    auto sendNewOrder = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(tm.kinematicOwnedBuffer_AccessCoordination);
+            orderBuffer.id = ++lastOrderSent;
+            orderBuffer.stampNs = nowNs();
+            tm.kinematicOwned_Cons2ProdBuffer.publish();
+        }
+        tm.kinematicOwned_Cons2ProdBuffer.notifyConsumer();
+    };
+    auto waitForProduce = [&]() {
+        tm.dynamicOwned_Prod2ConsBuffer.waitForFresh(tm.handoffBackoff);
+        std::lock_guard<std::mutex> lock(tm.dynamicOwnedBuffer_AccessCoordination);
+        res.dTWakeups.push_back(nowNs() - produceBuffer.stampNs);
+    };
+
+    // The `new-boot' case: dT needs one contact list to start with
+    sendNewOrder();
+    waitForProduce();
+    for (unsigned int step = 0; step < nSteps; step++) {
+        if (tm.dynamicOwned_Prod2ConsBuffer.isFresh()) {
+            Handoff produce;
+            {
+                std::lock_guard<std::mutex> lock(tm.dynamicOwnedBuffer_AccessCoordination);
+                produce = produceBuffer;
+                tm.dynamicOwned_Prod2ConsBuffer.consume();
+            }
+            if (produce.id != lastOrderSent) {
+                std::printf("dT got produce for order %lld while waiting for order %lld\n", (long long)produce.id,
+                            (long long)lastOrderSent);
+                res.correct = false;
+            }
+            tm.stampLastUpdateOfDynamic = tm.currentStampOfDynamic.load();
+            sendNewOrder();
+        }
+        if (tm.dynamicShouldWait()) {
+            waitForProduce();
+        }
+        // Like in dT, the step after a wait still runs on the old contact list, and the new one is taken in after it
+        res.maxLag = std::max(res.maxLag, tm.currentStampOfDynamic - tm.stampLastUpdateOfDynamic);
+        dummyWork(dTWorkUs);
+        tm.currentStampOfDynamic++;
+    }
+    res.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // What breakWaitingStatus does
+    tm.dynamicDone = true;
+    kTShouldReset = true;
+    {
+        std::lock_guard<std::mutex> lock(tm.kinematicOwnedBuffer_AccessCoordination);
+        tm.kinematicOwned_Cons2ProdBuffer.publish();
+    }
+    tm.kinematicOwned_Cons2ProdBuffer.notifyConsumer();
+    kT.join();
+    res.correct = res.correct && kTCorrect;
+    res.kTWakeups = std::move(kTWakeups);
+
+    if (updateFreq >= 0 && res.maxLag > updateFreq + 1) {
+        std::printf("dT ran %lld steps ahead of the last update, with update frequency %d\n", (long long)res.maxLag,
+                    updateFreq);
+        res.correct = false;
+    }
+    res.nOrders = lastOrderSent + 1;
+    res.nParks = tm.dynamicOwned_Prod2ConsBuffer.nParks + tm.kinematicOwned_Cons2ProdBuffer.nParks;
+    return res;
+}
+
+double percentileUs(std::vector<int64_t> v, double p) {
+    if (v.empty())
+        return 0.;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))] / 1e3;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int nSteps = (argc > 1) ? std::atoi(argv[1]) : 20000;
+    unsigned int dTWorkUs = (argc > 2) ? std::atoi(argv[2]) : 5;
+    unsigned int kTWorkUs = (argc > 3) ? std::atoi(argv[3]) : 10;
+
+    struct Setting {
+        const char* name;
+        HandoffBackoff backoff;
+    };
+    std::vector<Setting> settings = {{"sleep at once", {0, 0}}, {"default", HandoffBackoff()}, {"spin", {1u << 30, 0}}};
+    std::vector<int> freqs = {0, 1, 5, -1};
+    // A lost wake-up would leave a worker asleep for good, so bail out if the runs take far longer than they should
+    std::atomic<bool> finished(false);
+    std::thread watchdog([&]() {
+        for (int i = 0; i < 600 && !finished; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!finished) {
+            std::printf("The handoff got stuck!\n");
+            std::exit(1);
+        }
+    });
+    watchdog.detach();
+
+    std::printf("%u dT steps, %u us per dT step, %u us per CD\n", nSteps, dTWorkUs, kTWorkUs);
+    std::printf("%-14s %5s %9s %8s %8s %12s %12s %12s %12s\n", "backoff", "freq", "time (s)", "orders", "sleeps",
+                "dT wake p50", "dT wake p99", "kT wake p50", "kT wake p99");
+    bool allCorrect = true;
+    for (const auto& setting : settings) {
+        for (int freq : freqs) {
+            RunResult res = runOnce(freq, nSteps, dTWorkUs, kTWorkUs, setting.backoff);
+            allCorrect = allCorrect && res.correct;
+            std::printf("%-14s %5d %9.3f %8llu %8llu %9.2f us %9.2f us %9.2f us %9.2f us\n", setting.name, freq,
+                        res.seconds, (unsigned long long)res.nOrders, (unsigned long long)res.nParks,
+                        percentileUs(res.dTWakeups, 0.5), percentileUs(res.dTWakeups, 0.99),
+                        percentileUs(res.kTWakeups, 0.5), percentileUs(res.kTWakeups, 0.99));
+        }
+    }
+    finished = true;
+
+    if (!allCorrect) {
+        std::printf("The handoff protocol misbehaved!\n");
+        return 1;
+    }
+    std::printf("DEMdemo_HandoffStress exiting...\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A benchmark of the persistent contact mapping in DEMHistoryMapping.hpp, which is keyed on (idA, idB, contactType),
+// against the per-idA linear scan it replaced. Two contact lists that share most of their contacts are made up, like
+// two consecutive CD runs; both mappings are built, and the new one is checked against the old one. No GPU is needed.
+
+#include <algorithms/DEMHistoryMapping.hpp>
+#include <core/utils/HostThreadPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace deme;
+
+// Best of a few runs, in ms
+template <typename Func>
+double timeIt(Func&& func) {
+    double best = 1e30;
+    for (int i = 0; i < 3; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+struct ContactList {
+    std::vector<bodyID_t> idA, idB;
+    std::vector<contact_t> type;
+    size_t size() const { return idA.size(); }
+    void add(bodyID_t a, bodyID_t b, contact_t t) {
+        idA.push_back(a);
+        idB.push_back(b);
+        type.push_back(t);
+    }
+};
+
+// Each sphere touches a few neighbors with larger IDs and, now and then, a plane or two. A fraction of the contacts is
+// replaced by others (or turned into fake ones) in the second list.
+void makeContactLists(ContactList& prev, ContactList& next, size_t nSpheres, double churn, std::mt19937& rng) {
+    std::uniform_int_distribution<unsigned int> nNeighborDist(0, 6), offsetDist(1, 200), planeDist(0, 5);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    for (size_t i = 0; i < nSpheres; i++) {
+        unsigned int nNeighbors = nNeighborDist(rng);
+        for (unsigned int n = 0; n < nNeighbors; n++) {
+            bodyID_t other = (bodyID_t)std::min(i + offsetDist(rng), nSpheres - 1);
+            if (other == i)
+                continue;
+            prev.add(i, other, SPHERE_SPHERE_CONTACT);
+            if (uniform(rng) >= churn)
+                next.add(i, other, SPHERE_SPHERE_CONTACT);
+            else if (uniform(rng) < 0.1)
+                next.add(i, other, NOT_A_CONTACT);
+            else
+                next.add(i, (bodyID_t)std::min(i + offsetDist(rng), nSpheres - 1), SPHERE_SPHERE_CONTACT);
+        }
+        // A sphere--plane contact with the same idB as a sphere--sphere contact is a different contact
+        if (uniform(rng) < 0.05) {
+            bodyID_t plane = planeDist(rng);
+            prev.add(i, plane, SPHERE_PLANE_CONTACT);
+            if (uniform(rng) >= churn)
+                next.add(i, plane, SPHERE_PLANE_CONTACT);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t nSpheres = (argc > 1) ? std::strtoull(argv[1], NULL, 10) : 2000000;
+    double churn = (argc > 2) ? std::atof(argv[2]) : 0.1;
+    unsigned int nThreads = (argc > 3) ? std::atoi(argv[3]) : 0;
+    HostThreadPool& pool = HostThreadPool::Shared(nThreads);
+    HostScratchPad scratchPad;
+
+    std::mt19937 rng(42);
+    ContactList prev, next;
+    makeContactLists(prev, next, nSpheres, churn, rng);
+    // Both lists come out of contact detection sorted by key
+    std::vector<uint64_t> keys(std::max(prev.size(), next.size())), keys_sorted(keys.size());
+    std::vector<contact_t> type_sorted(keys.size());
+    hostSortContactsByKey(prev.idA.data(), prev.idB.data(), prev.type.data(), keys.data(), keys_sorted.data(),
+                          type_sorted.data(), prev.size(), pool, scratchPad);
+    ContactList shuffled = next;
+    double t_sort = timeIt([&]() {
+        next = shuffled;
+        hostSortContactsByKey(next.idA.data(), next.idB.data(), next.type.data(), keys.data(), keys_sorted.data(),
+                              type_sorted.data(), next.size(), pool, scratchPad);
+    });
+    std::printf("%zu spheres, %zu previous contacts, %zu new contacts, %u threads\n", nSpheres, prev.size(),
+                next.size(), pool.size());
+
+    std::vector<contactPairs_t> mapping(next.size()), mapping_ref(next.size());
+    double t_map = timeIt([&]() {
+        hostBuildPersistentMap(next.idA.data(), next.idB.data(), next.type.data(), next.size(), prev.idA.data(),
+                               prev.idB.data(), prev.type.data(), prev.size(), mapping.data(), pool);
+    });
+    double t_scan = timeIt([&]() {
+        hostBuildPersistentMapLinearScan(next.idA.data(), next.idB.data(), next.type.data(), next.size(),
+                                         prev.idA.data(), prev.idB.data(), prev.type.data(), prev.size(), nSpheres,
+                                         mapping_ref.data());
+    });
+
+    size_t nPersistent = 0;
+    for (size_t i = 0; i < next.size(); i++)
+        nPersistent += (mapping_ref[i] != NULL_MAPPING_PARTNER);
+    bool correct = (mapping == mapping_ref);
+    std::printf("Key sort         %9.3f ms\n", t_sort);
+    std::printf("Keyed mapping    %9.3f ms\n", t_map);
+    std::printf("Linear scan      %9.3f ms (serial)\n", t_scan);
+    std::printf("%zu persistent contacts, mapping is %s\n", nPersistent, correct ? "correct" : "WRONG");
+
+    if (!correct) {
+        std::printf("The keyed mapping differs from the linear scan!\n");
+        return 1;
+    }
+    std::printf("DEMdemo_HistoryMapping exiting...\n");
+    return 0;
+}
@@ -0,0 +1,142 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A micro-benchmark of the host (CPU) primitives in DEMHostWrappers.hpp, against their serial std counterparts. Each
+// result is also checked against the serial one.
+
+#include <algorithms/DEMHostWrappers.hpp>
+#include <core/utils/HostThreadPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace deme;
+
+// Best of a few runs, in ms
+template <typename Func>
+double timeIt(Func&& func) {
+    double best = 1e30;
+    for (int i = 0; i < 3; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+bool report(const char* name, double t_parallel, double t_serial, bool correct) {
+    std::printf("%-16s parallel %9.3f ms, serial %9.3f ms, speedup %6.2fx, %s\n", name, t_parallel, t_serial,
+                t_serial / t_parallel, correct ? "correct" : "WRONG");
+    return correct;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = (argc > 1) ? std::strtoull(argv[1], NULL, 10) : 20000000;
+    unsigned int nThreads = (argc > 2) ? std::atoi(argv[2]) : 0;
+    HostThreadPool& pool = HostThreadPool::Shared(nThreads);
+    HostScratchPad scratchPad;
+    std::printf("%zu items, %u threads\n", n, pool.size());
+
+    // Keys like bin IDs: many repeats, not in order
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<unsigned int> keyDist(0, (unsigned int)(n / 8));
+    std::vector<unsigned int> keys(n), vals(n);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = keyDist(rng);
+        vals[i] = (unsigned int)i;
+    }
+    bool all_correct = true;
+
+    // Sort by key
+    std::vector<unsigned int> keys_out(n), vals_out(n);
+    double t_par = timeIt([&]() {
+        hostDEMSortByKeys(keys.data(), keys_out.data(), vals.data(), vals_out.data(), n, pool, scratchPad);
+    });
+    std::vector<unsigned int> perm(n);
+    double t_ser = timeIt([&]() {
+        std::iota(perm.begin(), perm.end(), 0u);
+        std::stable_sort(perm.begin(), perm.end(), [&](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+    });
+    bool correct = true;
+    for (size_t i = 0; i < n && correct; i++)
+        correct = (keys_out[i] == keys[perm[i]]) && (vals_out[i] == vals[perm[i]]);
+    all_correct = report("SortByKeys", t_par, t_ser, correct) && all_correct;
+
+    // Exclusive and inclusive scans
+    std::vector<unsigned short> counts(n);
+    for (size_t i = 0; i < n; i++)
+        counts[i] = (unsigned short)(rng() % 27);
+    std::vector<size_t> scanned(n), scanned_ref(n);
+    t_par = timeIt([&]() { hostDEMPrefixScan(counts.data(), scanned.data(), n, pool, scratchPad); });
+    t_ser = timeIt([&]() { std::exclusive_scan(counts.begin(), counts.end(), scanned_ref.begin(), (size_t)0); });
+    all_correct = report("PrefixScan", t_par, t_ser, scanned == scanned_ref) && all_correct;
+    t_par = timeIt([&]() { hostDEMInclusiveScan(counts.data(), scanned.data(), n, pool, scratchPad); });
+    t_ser = timeIt([&]() { std::inclusive_scan(counts.begin(), counts.end(), scanned_ref.begin(), std::plus<size_t>(),
+                                               (size_t)0); });
+    all_correct = report("InclusiveScan", t_par, t_ser, scanned == scanned_ref) && all_correct;
+
+    // Run-length encode and unique, on the sorted keys
+    std::vector<unsigned int> unique_out(n), unique_ref(n);
+    std::vector<unsigned short> run_counts(n);
+    size_t nRuns = 0, nRuns_ref = 0;
+    t_par = timeIt([&]() {
+        hostDEMRunLengthEncode(keys_out.data(), unique_out.data(), run_counts.data(), &nRuns, n, pool, scratchPad);
+    });
+    t_ser = timeIt([&]() {
+        nRuns_ref = std::unique_copy(keys_out.begin(), keys_out.end(), unique_ref.begin()) - unique_ref.begin();
+    });
+    correct = (nRuns == nRuns_ref) && std::equal(unique_out.begin(), unique_out.begin() + nRuns, unique_ref.begin());
+    size_t counted = 0;
+    for (size_t r = 0; r < nRuns && correct; r++) {
+        correct = (keys_out[counted] == unique_out[r]);
+        counted += run_counts[r];
+    }
+    correct = correct && (counted == n);
+    all_correct = report("RunLengthEncode", t_par, t_ser, correct) && all_correct;
+    t_par = timeIt([&]() { hostDEMUnique(keys_out.data(), unique_out.data(), &nRuns, n, pool, scratchPad); });
+    correct = (nRuns == nRuns_ref) && std::equal(unique_out.begin(), unique_out.begin() + nRuns, unique_ref.begin());
+    all_correct = report("Unique", t_par, t_ser, correct) && all_correct;
+
+    // Reduce by key
+    std::vector<double> values(n), aggregates(n), aggregates_ref(n);
+    for (size_t i = 0; i < n; i++)
+        values[i] = (double)(rng() % 1000);
+    auto add = [](const double& a, const double& b) { return a + b; };
+    t_par = timeIt([&]() {
+        hostDEMReduceByKeys(keys_out.data(), unique_out.data(), values.data(), aggregates.data(), &nRuns, add, n, pool,
+                            scratchPad);
+    });
+    t_ser = timeIt([&]() {
+        size_t r = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (i == 0 || keys_out[i] != keys_out[i - 1])
+                aggregates_ref[r++] = values[i];
+            else
+                aggregates_ref[r - 1] += values[i];
+        }
+    });
+    correct =
+        (nRuns == nRuns_ref) && std::equal(aggregates.begin(), aggregates.begin() + nRuns, aggregates_ref.begin());
+    all_correct = report("ReduceByKeys", t_par, t_ser, correct) && all_correct;
+
+    // Sum
+    double sum = 0., sum_ref = 0.;
+    t_par = timeIt([&]() { hostDEMSum(values.data(), &sum, n, pool, scratchPad); });
+    t_ser = timeIt([&]() { sum_ref = std::accumulate(values.begin(), values.end(), 0.); });
+    all_correct = report("Sum", t_par, t_ser, sum == sum_ref) && all_correct;
+
+    if (!all_correct) {
+        std::printf("Some results are wrong!\n");
+        return 1;
+    }
+    std::printf("DEMdemo_HostPrimitives exiting...\n");
+    return 0;
+}
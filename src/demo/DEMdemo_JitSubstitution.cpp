@@ -0,0 +1,136 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// Times the substitution step of the kernel jitification on its own: the single-pass engine against the per-key
+// std::regex_replace it replaces, on the actual kernel sources and a large set of jitified clump templates. It also
+// checks that both produce the same bytes.
+
+#include <core/ApiVersion.h>
+#include <core/utils/JitHelper.h>
+#include <core/utils/JitSubstitution.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::filesystem;
+
+std::string loadFile(const path& file) {
+    std::ifstream input(file);
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    return buffer.str();
+}
+
+// Time one substitution engine; returns the best of a few runs in ms
+template <typename Func>
+double timeIt(Func&& func, std::string& result) {
+    double best = 1e30;
+    for (int i = 0; i < 3; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        result = func();
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    // Number of jitified clump components; each gets ~5 numbers in the template arrays
+    unsigned int n_components = (argc > 1) ? std::atoi(argv[1]) : 50000;
+    const path policy_dir = JitHelper::KERNEL_DIR / "DEMCustomizablePolicies";
+    bool all_identical = true;
+
+    // The inner step: filling the clump template arrays
+    std::unordered_map<std::string, std::string> array_content;
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        std::string Radii, CDRadii, CDRelPosX, CDRelPosY, CDRelPosZ;
+        char buf[32];
+        for (unsigned int i = 0; i < n_components; i++) {
+            std::snprintf(buf, sizeof(buf), "%.9g,", dist(rng));
+            Radii += buf;
+            CDRadii += buf;
+            std::snprintf(buf, sizeof(buf), "%.9g,", dist(rng));
+            CDRelPosX += buf;
+            std::snprintf(buf, sizeof(buf), "%.9g,", dist(rng));
+            CDRelPosY += buf;
+            std::snprintf(buf, sizeof(buf), "%.9g,", dist(rng));
+            CDRelPosZ += buf;
+        }
+        array_content["_Radii_"] = Radii;
+        array_content["_CDRadii_"] = CDRadii;
+        array_content["_CDRelPosX_"] = CDRelPosX;
+        array_content["_CDRelPosY_"] = CDRelPosY;
+        array_content["_CDRelPosZ_"] = CDRelPosZ;
+    }
+    const std::string template_defs_src = loadFile(policy_dir / "ClumpCompDefJitify.cu");
+    std::string template_defs, template_defs_ref;
+    double t_new = timeIt([&]() { return JitSubstitution::apply(template_defs_src, array_content); }, template_defs);
+    double t_ref =
+        timeIt([&]() { return JitSubstitution::applyRegex(template_defs_src, array_content); }, template_defs_ref);
+    all_identical = all_identical && (template_defs == template_defs_ref);
+    std::printf("Clump template arrays (%u components, %zu bytes): single-pass %.3f ms, regex %.3f ms, identical: %s\n",
+                n_components, template_defs.size(), t_new, t_ref, (template_defs == template_defs_ref) ? "yes" : "no");
+
+    // The outer step: the kernels, with all the substitutions the solver makes
+    std::unordered_map<std::string, std::string> subs;
+    for (const char* key : {"_nbX_", "_nbY_", "_nbZ_", "_nvXp2_", "_nvYp2_", "_nvZp2_", "_nSpheresGM_", "_nAnalGM_",
+                            "_nOwnerBodies_", "_nDistinctMassProperties_", "_nJitifiableClumpComponents_",
+                            "_nMatTuples_", "_nActiveLoadingThreads_", "_nFamilyMaskEntries_", "_nRulesOfChange_"}) {
+        subs[key] = "128";
+    }
+    for (const char* key : {"_l_", "_voxelSize_", "_binSize_", "_beta_", "_Gx_", "_Gy_", "_Gz_", "_LBFX_", "_LBFY_",
+                            "_LBFZ_"}) {
+        subs[key] = "0.001";
+    }
+    subs["_clumpTemplateDefs_"] = template_defs;
+    subs["_componentAcqStrat_"] = loadFile(policy_dir / "ClumpCompAcqStratAllJitify.cu");
+    subs["_massDefs_"] = loadFile(policy_dir / "MassDefJitify.cu");
+    subs["_moiDefs_"] = loadFile(policy_dir / "MOIDefJitify.cu");
+    subs["_massAcqStrat_"] = loadFile(policy_dir / "MassAcqStratJitify.cu");
+    subs["_moiAcqStrat_"] = loadFile(policy_dir / "MOIAcqStratJitify.cu");
+    subs["_analyticalEntityDefs_"] = loadFile(policy_dir / "AnalyticalCompDefJitify.cu");
+    subs["_DEMForceModel_"] = loadFile(policy_dir / "FullHertzianForceModel.cu");
+    subs["_integrationVelocityPassOnStrategy_"] = loadFile(policy_dir / "IntegrationVelPassOnExtendedTaylor.cu");
+    for (const char* key : {"_forceModelIngredientDefinition_", "_forceModelIngredientAcqForA_",
+                            "_forceModelIngredientAcqForB_", "_forceModelContactWildcardAcq_",
+                            "_forceModelContactWildcardWrite_", "_forceModelContactWildcardDestroy_",
+                            "_familyMasks_", "_familyChangeRules_", "_materialDefs_", "_posPrescriptionStrategy_",
+                            "_velPrescriptionStrategy_", "_inRegionPolicy_", "_quantityQueryProcess_"}) {
+        subs[key] = " ";
+    }
+
+    double total_new = 0., total_ref = 0.;
+    for (const char* kernel : {"DEMBinSphereKernels.cu", "DEMContactKernels.cu", "DEMPrepForceKernels.cu",
+                               "DEMCalcForceKernels.cu", "DEMCollectForceKernels.cu", "DEMIntegrationKernels.cu",
+                               "DEMMiscKernels.cu", "DEMHistoryMappingKernels.cu"}) {
+        const std::string code = loadFile(JitHelper::KERNEL_DIR / kernel);
+        std::string result, result_ref;
+        t_new = timeIt([&]() { return JitSubstitution::apply(code, subs); }, result);
+        t_ref = timeIt([&]() { return JitSubstitution::applyRegex(code, subs); }, result_ref);
+        total_new += t_new;
+        total_ref += t_ref;
+        all_identical = all_identical && (result == result_ref);
+        std::printf("%s (%zu bytes after substitution): single-pass %.3f ms, regex %.3f ms, identical: %s\n", kernel,
+                    result.size(), t_new, t_ref, (result == result_ref) ? "yes" : "no");
+    }
+    std::printf("Kernels total: single-pass %.3f ms, regex %.3f ms\n", total_new, total_ref);
+
+    if (!all_identical) {
+        std::printf("The substitution results differ!\n");
+        return 1;
+    }
+    std::printf("DEMdemo_JitSubstitution exiting...\n");
+    return 0;
+}
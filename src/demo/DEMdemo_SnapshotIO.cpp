@@ -0,0 +1,247 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// A round trip test of the output files. A few clumps settle for a while, then their states are written to files,
+// which are read back and checked against what the solver reports: BINARY files through DEMSnapshot::ReadFile (and a
+// second Write/Read round trip in memory), CSV files with a column selection and with a few precision settings, and
+// NATIVE files with each quaternion bit width through DecodeNativeSnapshot.
+
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/SnapshotIO.h>
+#include <DEM/utils/Samplers.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace deme;
+using namespace std::filesystem;
+
+// Report whether a check passed; returns the result
+bool report(const std::string& what, bool good) {
+    printf("%s... %s\n", what.c_str(), good ? "correct" : "WRONG");
+    return good;
+}
+
+// The largest difference between two columns of the same length (infinity if the lengths differ)
+template <typename T1, typename T2>
+double maxDiff(const std::vector<T1>& a, const std::vector<T2>& b) {
+    if (a.size() != b.size())
+        return INFINITY;
+    double diff = 0.;
+    for (size_t i = 0; i < a.size(); i++)
+        diff = std::max(diff, std::abs((double)a[i] - (double)b[i]));
+    return diff;
+}
+
+// Read a CSV file into its header line and its rows of fields
+void readCsv(const std::string& filename, std::string& header, std::vector<std::vector<std::string>>& rows) {
+    std::ifstream in(filename);
+    std::getline(in, header);
+    rows.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ','))
+            fields.push_back(field);
+        rows.push_back(fields);
+    }
+}
+
+// The number of significant digits a formatted number has
+unsigned int numSignificantDigits(const std::string& str) {
+    std::string mantissa = str.substr(0, str.find_first_of("eE"));
+    size_t first = mantissa.find_first_of("123456789");
+    if (first == std::string::npos)
+        return 1;
+    unsigned int n = 0;
+    for (size_t i = first; i < mantissa.size(); i++)
+        n += (mantissa[i] >= '0' && mantissa[i] <= '9');
+    // Trailing zeros of an integer part are not counted
+    if (mantissa.find('.') == std::string::npos) {
+        for (size_t i = mantissa.size(); i > first && mantissa[i - 1] == '0'; i--)
+            n--;
+    }
+    return n;
+}
+
+int main() {
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(ERROR);
+    DEMSim.SetOutputContent(OUTPUT_CONTENT::QUAT | OUTPUT_CONTENT::VEL | OUTPUT_CONTENT::FAMILY);
+
+    auto mat = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.5}, {"mu", 0.5}});
+    // Clumps of two spheres, so that they tumble and their quaternions are not trivial
+    auto clump_type = DEMSim.LoadClumpType(0.01, make_float3(2e-6, 2e-6, 1e-6), std::vector<float>{0.02, 0.015},
+                                           std::vector<float3>{make_float3(0, 0, 0.01), make_float3(0, 0, -0.012)},
+                                           mat);
+    clump_type->AssignName("Peanut");
+    HCPSampler sampler(0.05);
+    auto xyz = sampler.SampleBox(make_float3(0, 0, 0), make_float3(0.2, 0.2, 0.2));
+    DEMSim.AddClumps(clump_type, xyz);
+    const size_t nClumps = xyz.size();
+
+    DEMSim.InstructBoxDomainDimension(1, 1, 1);
+    DEMSim.AddBCPlane(make_float3(0, 0, -0.45), make_float3(0, 0, 1), mat);
+    DEMSim.SetCoordSysOrigin("center");
+    DEMSim.SetInitTimeStep(1e-5);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.8));
+    DEMSim.SetMaxVelocity(5.);
+    DEMSim.Initialize();
+    DEMSim.DoDynamicsThenSync(0.1);
+
+    path out_dir = current_path();
+    out_dir += "/DEMdemo_SnapshotIO";
+    create_directory(out_dir);
+
+    // What the solver reports. Clumps are added first, so their public IDs are also their row numbers.
+    std::vector<double> X(nClumps), Y(nClumps), Z(nClumps);
+    std::vector<float> Qw(nClumps), Qx(nClumps), Qy(nClumps), Qz(nClumps), v_x(nClumps);
+    for (size_t i = 0; i < nClumps; i++) {
+        float3 pos = DEMSim.GetOwnerPosition(i);
+        float4 Q = DEMSim.GetOwnerOriQ(i);
+        X[i] = pos.x;
+        Y[i] = pos.y;
+        Z[i] = pos.z;
+        Qw[i] = Q.w;
+        Qx[i] = Q.x;
+        Qy[i] = Q.y;
+        Qz[i] = Q.z;
+        v_x[i] = DEMSim.GetOwnerVelocity(i).x;
+    }
+
+    bool all_good = true;
+
+    // BINARY: positions are doubles in the file, and the getters give floats
+    DEMSim.SetOutputFormat(OUTPUT_FORMAT::BINARY);
+    std::string bin_file = (out_dir / "clumps.bin").string();
+    DEMSim.WriteClumpFile(bin_file);
+    DEMSnapshot bin = DEMSnapshot::ReadFile(bin_file);
+    all_good &= report("BINARY row count", bin.GetNumRows() == nClumps && bin.entity == "clump");
+    all_good &= report("BINARY positions",
+                       maxDiff(bin.GetColumn<double>(OUTPUT_FILE_X_COL_NAME), X) < 1e-6 &&
+                           maxDiff(bin.GetColumn<double>(OUTPUT_FILE_Y_COL_NAME), Y) < 1e-6 &&
+                           maxDiff(bin.GetColumn<double>(OUTPUT_FILE_Z_COL_NAME), Z) < 1e-6);
+    all_good &= report("BINARY quaternions and velocities",
+                       maxDiff(bin.GetColumn<float>("Qw"), Qw) == 0. && maxDiff(bin.GetColumn<float>("Qx"), Qx) == 0. &&
+                           maxDiff(bin.GetColumn<float>("Qy"), Qy) == 0. &&
+                           maxDiff(bin.GetColumn<float>("Qz"), Qz) == 0. &&
+                           maxDiff(bin.GetColumn<float>("v_x"), v_x) == 0.);
+    {
+        std::vector<uint64_t> types = bin.GetColumn<uint64_t>(OUTPUT_FILE_CLUMP_TYPE_NAME);
+        bool names_good = bin.stringTableColumn == OUTPUT_FILE_CLUMP_TYPE_NAME;
+        for (auto t : types)
+            names_good &= t < bin.stringTable.size() && bin.stringTable[t] == "Peanut";
+        all_good &= report("BINARY clump type names", names_good);
+    }
+    {
+        // Written and read again in memory, every column comes back byte for byte
+        std::stringstream buf;
+        bin.Write(buf);
+        DEMSnapshot again = DEMSnapshot::Read(buf);
+        bool same = again.GetNumRows() == bin.GetNumRows() && again.time == bin.time &&
+                    again.attributes == bin.attributes && again.stringTable == bin.stringTable &&
+                    again.GetColumns().size() == bin.GetColumns().size();
+        for (size_t j = 0; same && j < bin.GetColumns().size(); j++) {
+            const auto& a = again.GetColumns()[j];
+            const auto& b = bin.GetColumns()[j];
+            same = a.name == b.name && a.unit == b.unit && a.type == b.type && a.data == b.data;
+        }
+        all_good &= report("BINARY Write/Read round trip", same);
+    }
+
+    // CSV with a column selection (in the selected order, and with a column that clump files do not have), and with
+    // the precision that makes every number read back exactly
+    const std::vector<double> binXYZ[3] = {bin.GetColumn<double>(OUTPUT_FILE_X_COL_NAME),
+                                           bin.GetColumn<double>(OUTPUT_FILE_Y_COL_NAME),
+                                           bin.GetColumn<double>(OUTPUT_FILE_Z_COL_NAME)};
+    DEMSim.SetOutputFormat(OUTPUT_FORMAT::CSV);
+    DEMSim.SetCsvPrecision(0);
+    DEMSim.SetCsvColumns(
+        {OUTPUT_FILE_Z_COL_NAME, OUTPUT_FILE_CLUMP_TYPE_NAME, "no_such_column", OUTPUT_FILE_X_COL_NAME});
+    std::string csv_file = (out_dir / "clumps_selected.csv").string();
+    DEMSim.WriteClumpFile(csv_file);
+    {
+        std::string header;
+        std::vector<std::vector<std::string>> rows;
+        readCsv(csv_file, header, rows);
+        bool good = header == "Z,clump_type,X" && rows.size() == nClumps;
+        for (size_t i = 0; good && i < rows.size(); i++) {
+            good = rows[i].size() == 3 && std::strtod(rows[i][0].c_str(), nullptr) == binXYZ[2][i] &&
+                   rows[i][1] == "Peanut" && std::strtod(rows[i][2].c_str(), nullptr) == binXYZ[0][i];
+        }
+        all_good &= report("CSV column selection, read back exactly", good);
+    }
+
+    // CSV of all columns, with a few significant digits
+    DEMSim.SetCsvPrecision(4);
+    DEMSim.SetCsvColumns({});
+    csv_file = (out_dir / "clumps_4_digits.csv").string();
+    DEMSim.WriteClumpFile(csv_file);
+    {
+        std::string header;
+        std::vector<std::vector<std::string>> rows;
+        readCsv(csv_file, header, rows);
+        std::string expected_header;
+        for (const auto& col : bin.GetColumns())
+            expected_header += (expected_header.empty() ? "" : ",") + col.name;
+        bool good = header == expected_header && rows.size() == nClumps;
+        for (size_t i = 0; good && i < rows.size(); i++) {
+            good = rows[i].size() == bin.GetNumColumns();
+            // X, Y and Z are the first columns
+            for (size_t j = 0; good && j < 3; j++) {
+                double val = std::strtod(rows[i][j].c_str(), nullptr);
+                double ref = binXYZ[j][i];
+                good = numSignificantDigits(rows[i][j]) <= 4 && std::abs(val - ref) <= 5e-4 * std::abs(ref);
+            }
+        }
+        all_good &= report("CSV all columns, 4 significant digits", good);
+    }
+
+    // NATIVE: the decoded positions are computed the same way as those in BINARY files, so they have to be the same
+    // to the last bit. Quaternions are normalized when decoded, and quantized to 8 or 16 bits if asked for.
+    DEMSim.SetOutputFormat(OUTPUT_FORMAT::NATIVE);
+    const std::vector<float> binQ[4] = {bin.GetColumn<float>("Qw"), bin.GetColumn<float>("Qx"),
+                                        bin.GetColumn<float>("Qy"), bin.GetColumn<float>("Qz")};
+    const std::vector<uint64_t> binFamily = bin.GetColumn<uint64_t>("family");
+    for (unsigned int bits : {32u, 16u, 8u}) {
+        DEMSim.SetNativeOutputQuatBits(bits);
+        std::string native_file = (out_dir / ("clumps_native_" + std::to_string(bits) + ".bin")).string();
+        DEMSim.WriteClumpFile(native_file);
+        DEMSnapshot native = DEMSnapshot::ReadFile(native_file);
+        DEMSnapshot decoded = DecodeNativeSnapshot(native);
+        std::string what = "NATIVE with " + std::to_string(bits) + "-bit quaternions";
+
+        all_good &= report(what + ", smaller than BINARY", file_size(native_file) < file_size(bin_file));
+        all_good &= report(what + ", positions",
+                           maxDiff(decoded.GetColumn<double>(OUTPUT_FILE_X_COL_NAME), binXYZ[0]) == 0. &&
+                               maxDiff(decoded.GetColumn<double>(OUTPUT_FILE_Y_COL_NAME), binXYZ[1]) == 0. &&
+                               maxDiff(decoded.GetColumn<double>(OUTPUT_FILE_Z_COL_NAME), binXYZ[2]) == 0.);
+        // One quantization step, plus what normalizing adds
+        double tol = (bits == 32) ? 1e-6 : 4. / ((1u << (bits - 1)) - 1);
+        bool quat_good = true;
+        const std::string QNames[4] = {"Qw", "Qx", "Qy", "Qz"};
+        for (int j = 0; j < 4; j++)
+            quat_good &= maxDiff(decoded.GetColumn<float>(QNames[j]), binQ[j]) <= tol;
+        all_good &= report(what + ", quaternions", quat_good);
+        all_good &= report(what + ", other columns",
+                           maxDiff(decoded.GetColumn<float>("v_x"), v_x) == 0. &&
+                               maxDiff(decoded.GetColumn<uint64_t>("family"), binFamily) == 0. &&
+                               decoded.stringTable == bin.stringTable);
+    }
+
+    std::cout << "DEMdemo_SnapshotIO exiting..." << std::endl;
+    return all_good ? 0 : 1;
+}
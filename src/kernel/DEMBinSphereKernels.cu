@@ -49,27 +49,38 @@ __global__ void getNumberOfBinsEachSphereTouches(deme::DEMSimParams* simParams,
             myPosX = ownerX + (double)myRelPosX;
             myPosY = ownerY + (double)myRelPosY;
             myPosZ = ownerZ + (double)myRelPosZ;
-            double myBinX = myPosX / simParams->binSize;
-            double myBinY = myPosY / simParams->binSize;
-            double myBinZ = myPosZ / simParams->binSize;
+            // I only register in the bins of the level that matches my size
+            double levelBinSize;
+            deme::binID_t levelNbX, levelNbY, levelOffset;
+            getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                           getSphereBinLevel(myRadius, simParams->binSize, simParams->nBinLevels),
+                                           simParams);
+            // Along periodic directions, the bins cover the period, so I am binned at my image in there
+            double binPosX = myPosX, binPosY = myPosY, binPosZ = myPosZ;
+            wrapIntoPeriodicDomain<double>(binPosX, binPosY, binPosZ, simParams);
+            double myBinX = binPosX / levelBinSize;
+            double myBinY = binPosY / levelBinSize;
+            double myBinZ = binPosZ / levelBinSize;
             // How many bins my radius spans (with fractions)?
-            double myRadiusSpan = myRadius / simParams->binSize;
+            double myRadiusSpan = myRadius / levelBinSize;
             // printf("myRadius: %f\n", myRadiusSpan);
             // Now, figure out how many bins I touch in each direction
-            deme::binsSphereTouches_t numX =
-                (unsigned int)(myBinX + myRadiusSpan) - (unsigned int)(myBinX - myRadiusSpan) + 1;
-            deme::binsSphereTouches_t numY =
-                (unsigned int)(myBinY + myRadiusSpan) - (unsigned int)(myBinY - myRadiusSpan) + 1;
-            deme::binsSphereTouches_t numZ =
-                (unsigned int)(myBinZ + myRadiusSpan) - (unsigned int)(myBinZ - myRadiusSpan) + 1;
+            unsigned int loX, loY, loZ, numX, numY, numZ, nbPeriodX, nbPeriodY, nbPeriodZ;
+            getSphereBinRange(loX, numX, nbPeriodX, myBinX, myRadiusSpan, simParams->periodicX, simParams->periodX,
+                              levelBinSize);
+            getSphereBinRange(loY, numY, nbPeriodY, myBinY, myRadiusSpan, simParams->periodicY, simParams->periodY,
+                              levelBinSize);
+            getSphereBinRange(loZ, numZ, nbPeriodZ, myBinZ, myRadiusSpan, simParams->periodicZ, simParams->periodZ,
+                              levelBinSize);
             // TODO: Add an error message if numX * numY * numZ > MAX(binsSphereTouches_t)
 
             // Write the number of bins this sphere touches back to the global array
-            numBinsSphereTouches[sphereID] = numX * numY * numZ;
+            numBinsSphereTouches[sphereID] = (deme::binsSphereTouches_t)(numX * numY * numZ);
             // printf("This sp takes num of bins: %u\n", numX * numY * numZ);
         }
 
-        // Each sphere entity should also check if it overlaps with an analytical boundary-type geometry
+        // Each sphere entity should also check if it overlaps with an analytical boundary-type geometry (at its actual
+        // location, not a periodic image: analytical objects are not imaged)
         for (deme::objID_t objB = 0; objB < simParams->nAnalGM; objB++) {
             deme::contact_t contact_type;
             deme::bodyID_t objBOwner = objOwner[objB];
@@ -160,21 +171,37 @@ __global__ void populateBinSphereTouchingPairs(deme::DEMSimParams* simParams,
             myPosX = ownerX + (double)myRelPosX;
             myPosY = ownerY + (double)myRelPosY;
             myPosZ = ownerZ + (double)myRelPosZ;
-            double myBinX = myPosX / simParams->binSize;
-            double myBinY = myPosY / simParams->binSize;
-            double myBinZ = myPosZ / simParams->binSize;
+            // I only register in the bins of the level that matches my size
+            double levelBinSize;
+            deme::binID_t levelNbX, levelNbY, levelOffset;
+            getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                           getSphereBinLevel(myRadius, simParams->binSize, simParams->nBinLevels),
+                                           simParams);
+            // Along periodic directions, the bins cover the period, so I am binned at my image in there
+            double binPosX = myPosX, binPosY = myPosY, binPosZ = myPosZ;
+            wrapIntoPeriodicDomain<double>(binPosX, binPosY, binPosZ, simParams);
+            double myBinX = binPosX / levelBinSize;
+            double myBinY = binPosY / levelBinSize;
+            double myBinZ = binPosZ / levelBinSize;
             // How many bins my radius spans (with fractions)?
-            double myRadiusSpan = myRadius / simParams->binSize;
+            double myRadiusSpan = myRadius / levelBinSize;
+            unsigned int loX, loY, loZ, numX, numY, numZ, nbPeriodX, nbPeriodY, nbPeriodZ;
+            getSphereBinRange(loX, numX, nbPeriodX, myBinX, myRadiusSpan, simParams->periodicX, simParams->periodX,
+                              levelBinSize);
+            getSphereBinRange(loY, numY, nbPeriodY, myBinY, myRadiusSpan, simParams->periodicY, simParams->periodY,
+                              levelBinSize);
+            getSphereBinRange(loZ, numZ, nbPeriodZ, myBinZ, myRadiusSpan, simParams->periodicZ, simParams->periodZ,
+                              levelBinSize);
             // Now, write the IDs of those bins that I touch, back to the global memory
             deme::binID_t thisBinID;
-            for (unsigned int k = (unsigned int)(myBinZ - myRadiusSpan); k <= (unsigned int)(myBinZ + myRadiusSpan);
-                 k++) {
-                for (unsigned int j = (unsigned int)(myBinY - myRadiusSpan); j <= (unsigned int)(myBinY + myRadiusSpan);
-                     j++) {
-                    for (unsigned int i = (unsigned int)(myBinX - myRadiusSpan);
-                         i <= (unsigned int)(myBinX + myRadiusSpan); i++) {
-                        thisBinID = (deme::binID_t)i + (deme::binID_t)j * simParams->nbX +
-                                    (deme::binID_t)k * simParams->nbX * simParams->nbY;
+            for (unsigned int kk = 0; kk < numZ; kk++) {
+                unsigned int k = getBinIndexInRange(loZ, kk, nbPeriodZ);
+                for (unsigned int jj = 0; jj < numY; jj++) {
+                    unsigned int j = getBinIndexInRange(loY, jj, nbPeriodY);
+                    for (unsigned int ii = 0; ii < numX; ii++) {
+                        unsigned int i = getBinIndexInRange(loX, ii, nbPeriodX);
+                        thisBinID = levelOffset + (deme::binID_t)i + (deme::binID_t)j * levelNbX +
+                                    (deme::binID_t)k * levelNbX * levelNbY;
                         binIDsEachSphereTouches[myReportOffset] = thisBinID;
                         sphereIDsEachBinTouches[myReportOffset] = sphereID;
                         myReportOffset++;
@@ -183,7 +210,8 @@ __global__ void populateBinSphereTouchingPairs(deme::DEMSimParams* simParams,
             }
         }
 
-        // Each sphere entity should also check if it overlaps with an analytical boundary-type geometry
+        // Each sphere entity should also check if it overlaps with an analytical boundary-type geometry (at its actual
+        // location, not a periodic image: analytical objects are not imaged)
         for (deme::objID_t objB = 0; objB < simParams->nAnalGM; objB++) {
             deme::contact_t contact_type;
             deme::bodyID_t objBOwner = objOwner[objB];
@@ -228,3 +256,307 @@ __global__ void populateBinSphereTouchingPairs(deme::DEMSimParams* simParams,
         }
     }
 }
+
+// Location of a sphere component, its (expanded) CD radius in float as the bin-wise contact kernels use, and the
+// expanded radius in double as the bin--sphere kernels use to find its bins
+inline __device__ void getSphereCDPosAndRadius(double& X,
+                                               double& Y,
+                                               double& Z,
+                                               float& radius,
+                                               double& binRadius,
+                                               deme::bodyID_t& ownerID,
+                                               const deme::bodyID_t& sphereID,
+                                               deme::DEMSimParams* simParams,
+                                               deme::DEMDataKT* granData) {
+    ownerID = granData->ownerClumpBody[sphereID];
+    float myRelPosX, myRelPosY, myRelPosZ, myRadius;
+    double ownerX, ownerY, ownerZ;
+    // Get my component offset info from either jitified arrays or global memory
+    // Outputs myRelPosXYZ, myRadius (in CD kernels, radius needs to be expanded)
+    // Use an input named exactly `sphereID' which is the id of this sphere component
+    {
+        _componentAcqStrat_;
+        binRadius = (double)myRadius + (double)simParams->beta;
+        myRadius += simParams->beta;
+    }
+    voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+        ownerX, ownerY, ownerZ, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+        granData->locZ[ownerID], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+    applyOriQToVector3<float, deme::oriQ_t>(myRelPosX, myRelPosY, myRelPosZ, granData->oriQw[ownerID],
+                                            granData->oriQx[ownerID], granData->oriQy[ownerID],
+                                            granData->oriQz[ownerID]);
+    X = ownerX + (double)myRelPosX;
+    Y = ownerY + (double)myRelPosY;
+    Z = ownerZ + (double)myRelPosZ;
+    radius = myRadius;
+}
+
+// Find the contacts between a sphere and the spheres registered in coarser bin levels. The sphere goes through the
+// coarser-level bins it would touch and tests against the spheres in them; a contact is only taken by the bin that its
+// contact point is in, so each pair is found once. If idSphA is NULL, the contacts are only counted.
+inline __device__ deme::geoSphereTouches_t findCrossLevelContacts(deme::DEMSimParams* simParams,
+                                                                  deme::DEMDataKT* granData,
+                                                                  const deme::bodyID_t& myID,
+                                                                  deme::bodyID_t* sphereIDsEachBinTouches_sorted,
+                                                                  deme::binID_t* activeBinIDs,
+                                                                  deme::spheresBinTouches_t* numSpheresBinTouches,
+                                                                  deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
+                                                                  size_t nActiveBins,
+                                                                  deme::bodyID_t* idSphA,
+                                                                  deme::bodyID_t* idSphB,
+                                                                  deme::contactPairs_t myReportOffset) {
+    double myX, myY, myZ, myBinRadius;
+    float myRadius;
+    deme::bodyID_t myOwnerID;
+    getSphereCDPosAndRadius(myX, myY, myZ, myRadius, myBinRadius, myOwnerID, myID, simParams, granData);
+    const unsigned int myFamily = granData->familyID[myOwnerID];
+    const unsigned int myLevel = getSphereBinLevel(myBinRadius, simParams->binSize, simParams->nBinLevels);
+    // Along periodic directions, the bins cover the period, so the bins to look in are those around my image in there
+    double myBinPosX = myX, myBinPosY = myY, myBinPosZ = myZ;
+    wrapIntoPeriodicDomain<double>(myBinPosX, myBinPosY, myBinPosZ, simParams);
+
+    deme::geoSphereTouches_t contact_count = 0;
+    for (unsigned int level = myLevel + 1; level < simParams->nBinLevels; level++) {
+        double levelBinSize;
+        deme::binID_t levelNbX, levelNbY, levelOffset;
+        getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset, level, simParams);
+        double myBinX = myBinPosX / levelBinSize;
+        double myBinY = myBinPosY / levelBinSize;
+        double myBinZ = myBinPosZ / levelBinSize;
+        double myRadiusSpan = myBinRadius / levelBinSize;
+        unsigned int loX, loY, loZ, numX, numY, numZ, nbPeriodX, nbPeriodY, nbPeriodZ;
+        getSphereBinRange(loX, numX, nbPeriodX, myBinX, myRadiusSpan, simParams->periodicX, simParams->periodX,
+                          levelBinSize);
+        getSphereBinRange(loY, numY, nbPeriodY, myBinY, myRadiusSpan, simParams->periodicY, simParams->periodY,
+                          levelBinSize);
+        getSphereBinRange(loZ, numZ, nbPeriodZ, myBinZ, myRadiusSpan, simParams->periodicZ, simParams->periodZ,
+                          levelBinSize);
+        for (unsigned int kk = 0; kk < numZ; kk++) {
+            unsigned int k = getBinIndexInRange(loZ, kk, nbPeriodZ);
+            for (unsigned int jj = 0; jj < numY; jj++) {
+                unsigned int j = getBinIndexInRange(loY, jj, nbPeriodY);
+                for (unsigned int ii = 0; ii < numX; ii++) {
+                    unsigned int i = getBinIndexInRange(loX, ii, nbPeriodX);
+                    deme::binID_t thisBinID = levelOffset + (deme::binID_t)i + (deme::binID_t)j * levelNbX +
+                                              (deme::binID_t)k * levelNbX * levelNbY;
+                    // Active bin IDs are sorted, so binary-search for this bin
+                    size_t lo = 0, hi = nActiveBins;
+                    while (lo < hi) {
+                        size_t mid = (lo + hi) / 2;
+                        if (activeBinIDs[mid] < thisBinID)
+                            lo = mid + 1;
+                        else
+                            hi = mid;
+                    }
+                    if (lo == nActiveBins || activeBinIDs[lo] != thisBinID)
+                        continue;
+
+                    const deme::binSphereTouchPairs_t thisBodiesTableEntry = sphereIDsLookUpTable[lo];
+                    const deme::spheresBinTouches_t nBodiesInBin = numSpheresBinTouches[lo];
+                    for (deme::spheresBinTouches_t n = 0; n < nBodiesInBin; n++) {
+                        deme::bodyID_t otherID = sphereIDsEachBinTouches_sorted[thisBodiesTableEntry + n];
+                        double otherX, otherY, otherZ, otherBinRadius;
+                        float otherRadius;
+                        deme::bodyID_t otherOwnerID;
+                        getSphereCDPosAndRadius(otherX, otherY, otherZ, otherRadius, otherBinRadius, otherOwnerID,
+                                                otherID, simParams, granData);
+                        if (otherOwnerID == myOwnerID)
+                            continue;
+                        unsigned int maskMatID =
+                            locateMaskPair<unsigned int>(myFamily, (unsigned int)granData->familyID[otherOwnerID]);
+                        // If marked no contact, skip ths iteration
+                        if (granData->familyMasks[maskMatID] != deme::DONT_PREVENT_CONTACT) {
+                            continue;
+                        }
+
+                        double contactPntX, contactPntY, contactPntZ;
+                        bool in_contact = checkSpheresOverlapPeriodic<double>(
+                            myX, myY, myZ, myRadius, otherX, otherY, otherZ, otherRadius, contactPntX, contactPntY,
+                            contactPntZ, simParams);
+                        if (!in_contact)
+                            continue;
+                        deme::binID_t contactPntBin = levelOffset + getPointBinID<deme::binID_t>(
+                                                                        contactPntX, contactPntY, contactPntZ,
+                                                                        levelBinSize, levelNbX, levelNbY);
+                        if (contactPntBin != thisBinID)
+                            continue;
+
+                        if (idSphA != NULL) {
+                            // Like in bin-wise contact kernels, pairs are oriented by (public) sphere IDs
+                            bool swap = (granData->spherePublicID != NULL)
+                                            ? (granData->spherePublicID[myID] > granData->spherePublicID[otherID])
+                                            : (myID > otherID);
+                            idSphA[myReportOffset + contact_count] = swap ? otherID : myID;
+                            idSphB[myReportOffset + contact_count] = swap ? myID : otherID;
+                        }
+                        contact_count++;
+                    }
+                }
+            }
+        }
+    }
+    return contact_count;
+}
+
+__global__ void getNumberOfCrossLevelContactsEachSphere(deme::DEMSimParams* simParams,
+                                                        deme::DEMDataKT* granData,
+                                                        deme::bodyID_t* sphereIDsEachBinTouches_sorted,
+                                                        deme::binID_t* activeBinIDs,
+                                                        deme::spheresBinTouches_t* numSpheresBinTouches,
+                                                        deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
+                                                        deme::geoSphereTouches_t* numCrossLevelContacts,
+                                                        size_t nActiveBins) {
+    deme::bodyID_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (sphereID < simParams->nSpheresGM) {
+        numCrossLevelContacts[sphereID] = findCrossLevelContacts(
+            simParams, granData, sphereID, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+            sphereIDsLookUpTable, nActiveBins, NULL, NULL, 0);
+    }
+}
+
+__global__ void populateCrossLevelContactPairs(deme::DEMSimParams* simParams,
+                                               deme::DEMDataKT* granData,
+                                               deme::bodyID_t* sphereIDsEachBinTouches_sorted,
+                                               deme::binID_t* activeBinIDs,
+                                               deme::spheresBinTouches_t* numSpheresBinTouches,
+                                               deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
+                                               deme::contactPairs_t* crossLevelReportOffsets,
+                                               deme::bodyID_t* idSphA,
+                                               deme::bodyID_t* idSphB,
+                                               size_t nActiveBins) {
+    deme::bodyID_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (sphereID < simParams->nSpheresGM) {
+        findCrossLevelContacts(simParams, granData, sphereID, sphereIDsEachBinTouches_sorted, activeBinIDs,
+                               numSpheresBinTouches, sphereIDsLookUpTable, nActiveBins, idSphA, idSphB,
+                               crossLevelReportOffsets[sphereID]);
+    }
+}
+
+// Find the contacts registered in a bin that has too many spheres for the bin-wise contact kernels. The block brings
+// the bin's spheres into shared memory one tile at a time, and each thread tests its own sphere against the tile, so
+// the bin can have any number of spheres. Every thread in the block must call this. The number of contacts found goes
+// to blockPairCnt (which the caller zeros), and if idSphA is not NULL, the pairs are written after myReportOffset.
+inline __device__ void processOverfullBin(deme::DEMSimParams* simParams,
+                                          deme::DEMDataKT* granData,
+                                          const deme::bodyID_t* sphereIDs,
+                                          const deme::spheresBinTouches_t& nBodiesInBin,
+                                          const deme::binID_t& binID,
+                                          deme::bodyID_t* idSphA,
+                                          deme::bodyID_t* idSphB,
+                                          const deme::contactPairs_t& myReportOffset,
+                                          unsigned int& blockPairCnt) {
+    __shared__ deme::bodyID_t tileOwnerIDs[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ deme::bodyID_t tileBodyIDs[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ float tileRadii[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ double tileX[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ double tileY[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ double tileZ[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ deme::family_t tileFamilies[DEME_KT_CD_NTHREADS_PER_BLOCK];
+
+    // Contact points are located using the bins of the level this bin belongs to
+    double levelBinSize;
+    deme::binID_t levelNbX, levelNbY, levelOffset;
+    getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                   getBinLevel<deme::binID_t>(binID, simParams), simParams);
+
+    for (unsigned int baseA = 0; baseA < nBodiesInBin; baseA += blockDim.x) {
+        const unsigned int bodyA = baseA + threadIdx.x;
+        double myX, myY, myZ, myBinRadius;
+        float myRadius;
+        deme::bodyID_t myID, myOwnerID;
+        unsigned int myFamily;
+        if (bodyA < nBodiesInBin) {
+            myID = sphereIDs[bodyA];
+            getSphereCDPosAndRadius(myX, myY, myZ, myRadius, myBinRadius, myOwnerID, myID, simParams, granData);
+            myFamily = granData->familyID[myOwnerID];
+        }
+        // Only the spheres after bodyA in this bin need testing
+        for (unsigned int baseB = baseA; baseB < nBodiesInBin; baseB += blockDim.x) {
+            __syncthreads();
+            const unsigned int loadB = baseB + threadIdx.x;
+            if (loadB < nBodiesInBin) {
+                double binRadius;
+                tileBodyIDs[threadIdx.x] = sphereIDs[loadB];
+                getSphereCDPosAndRadius(tileX[threadIdx.x], tileY[threadIdx.x], tileZ[threadIdx.x],
+                                        tileRadii[threadIdx.x], binRadius, tileOwnerIDs[threadIdx.x],
+                                        tileBodyIDs[threadIdx.x], simParams, granData);
+                tileFamilies[threadIdx.x] = granData->familyID[tileOwnerIDs[threadIdx.x]];
+            }
+            __syncthreads();
+            if (bodyA >= nBodiesInBin)
+                continue;
+            const unsigned int tileSize = min(blockDim.x, (unsigned int)nBodiesInBin - baseB);
+            for (unsigned int n = 0; n < tileSize; n++) {
+                if (baseB + n <= bodyA || tileOwnerIDs[n] == myOwnerID)
+                    continue;
+                unsigned int maskMatID = locateMaskPair<unsigned int>(myFamily, (unsigned int)tileFamilies[n]);
+                // If marked no contact, skip ths iteration
+                if (granData->familyMasks[maskMatID] != deme::DONT_PREVENT_CONTACT) {
+                    continue;
+                }
+
+                double contactPntX, contactPntY, contactPntZ;
+                bool in_contact = checkSpheresOverlapPeriodic<double>(myX, myY, myZ, myRadius, tileX[n], tileY[n],
+                                                                      tileZ[n], tileRadii[n], contactPntX,
+                                                                      contactPntY, contactPntZ, simParams);
+                deme::binID_t contactPntBin = levelOffset + getPointBinID<deme::binID_t>(
+                                                                contactPntX, contactPntY, contactPntZ, levelBinSize,
+                                                                levelNbX, levelNbY);
+                if (in_contact && (contactPntBin == binID)) {
+                    unsigned int inBlockOffset = atomicAdd_block(&blockPairCnt, 1);
+                    if (idSphA != NULL) {
+                        // Like in bin-wise contact kernels, pairs are oriented by (public) sphere IDs
+                        deme::bodyID_t sphA = myID, sphB = tileBodyIDs[n];
+                        if (granData->spherePublicID != NULL &&
+                            granData->spherePublicID[sphA] > granData->spherePublicID[sphB]) {
+                            deme::bodyID_t tmp = sphA;
+                            sphA = sphB;
+                            sphB = tmp;
+                        }
+                        idSphA[myReportOffset + inBlockOffset] = sphA;
+                        idSphB[myReportOffset + inBlockOffset] = sphB;
+                    }
+                }
+            }
+        }
+    }
+}
+
+__global__ void getNumberOfContactsEachOverfullBin(deme::DEMSimParams* simParams,
+                                                   deme::DEMDataKT* granData,
+                                                   deme::bodyID_t* sphereIDsEachBinTouches_sorted,
+                                                   deme::binID_t* activeBinIDs,
+                                                   deme::spheresBinTouches_t* numSpheresBinTouches,
+                                                   deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
+                                                   deme::binID_t* overfullBinList,
+                                                   deme::contactPairs_t* numContactsEachOverfullBin) {
+    __shared__ unsigned int blockPairCnt;
+    if (threadIdx.x == 0)
+        blockPairCnt = 0;
+    // The index of this bin in the active bin arrays
+    const deme::binID_t myActiveID = overfullBinList[blockIdx.x];
+    processOverfullBin(simParams, granData, sphereIDsEachBinTouches_sorted + sphereIDsLookUpTable[myActiveID],
+                       numSpheresBinTouches[myActiveID], activeBinIDs[myActiveID], NULL, NULL, 0, blockPairCnt);
+    __syncthreads();
+    if (threadIdx.x == 0)
+        numContactsEachOverfullBin[blockIdx.x] = blockPairCnt;
+}
+
+__global__ void populateContactPairsEachOverfullBin(deme::DEMSimParams* simParams,
+                                                    deme::DEMDataKT* granData,
+                                                    deme::bodyID_t* sphereIDsEachBinTouches_sorted,
+                                                    deme::binID_t* activeBinIDs,
+                                                    deme::spheresBinTouches_t* numSpheresBinTouches,
+                                                    deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
+                                                    deme::binID_t* overfullBinList,
+                                                    deme::contactPairs_t* overfullReportOffsets,
+                                                    deme::bodyID_t* idSphA,
+                                                    deme::bodyID_t* idSphB) {
+    __shared__ unsigned int blockPairCnt;
+    if (threadIdx.x == 0)
+        blockPairCnt = 0;
+    const deme::binID_t myActiveID = overfullBinList[blockIdx.x];
+    processOverfullBin(simParams, granData, sphereIDsEachBinTouches_sorted + sphereIDsLookUpTable[myActiveID],
+                       numSpheresBinTouches[myActiveID], activeBinIDs[myActiveID], idSphA, idSphB,
+                       overfullReportOffsets[blockIdx.x], blockPairCnt);
+}
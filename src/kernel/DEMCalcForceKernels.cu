@@ -16,6 +16,25 @@ __global__ void calculateContactForces(deme::DEMSimParams* simParams, deme::DEMD
     if (myContactID < nContactPairs) {
         // Identify contact type first
         deme::contact_t myContactType = granData->contactType[myContactID];
+        // A contact between two sleeping owners is frozen: it exerts no force, and its wildcards stay as they are. A
+        // sleeping owner that a restless one touches is asked to wake up.
+        if (simParams->sleepQuietSteps > 0 && myContactType != deme::NOT_A_CONTACT) {
+            deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myContactID]];
+            deme::bodyID_t ownerB = (myContactType == deme::SPHERE_SPHERE_CONTACT)
+                                        ? granData->ownerClumpBody[granData->idGeometryB[myContactID]]
+                                        : objOwner[granData->idGeometryB[myContactID]];
+            deme::sleepState_t stateA = granData->ownerSleepState[ownerA];
+            deme::sleepState_t stateB = granData->ownerSleepState[ownerB];
+            if ((stateA & deme::SLEEP_ASLEEP) && (stateB & deme::SLEEP_ASLEEP)) {
+                return;
+            }
+            if ((stateA & deme::SLEEP_ASLEEP) && (stateB & deme::SLEEP_RESTLESS)) {
+                granData->ownerSleepState[ownerA] = stateA | deme::SLEEP_WAKE_REQUEST;
+            }
+            if ((stateB & deme::SLEEP_ASLEEP) && (stateA & deme::SLEEP_RESTLESS)) {
+                granData->ownerSleepState[ownerB] = stateB | deme::SLEEP_WAKE_REQUEST;
+            }
+        }
         // The following quantities are always calculated, regardless of force model
         double3 contactPnt;
         float3 B2A;  // Unit vector pointing from body B to body A (contact normal)
@@ -100,6 +119,17 @@ __global__ void calculateContactForces(deme::DEMSimParams* simParams, deme::DEMD
             bodyBPos.x = BOwnerPos.x + (double)myRelPosX;
             bodyBPos.y = BOwnerPos.y + (double)myRelPosY;
             bodyBPos.z = BOwnerPos.z + (double)myRelPosZ;
+            // Across a periodic side, B is taken at its image nearest to A, and its owner is moved along with it, so
+            // the contact point, the lever arms and the contact history do not jump when either one wraps around
+            {
+                double3 bodyBImage = bodyBPos;
+                shiftToNearestPeriodicImage<double>(bodyAPos.x, bodyAPos.y, bodyAPos.z, bodyBImage.x, bodyBImage.y,
+                                                    bodyBImage.z, simParams);
+                BOwnerPos.x += bodyBImage.x - bodyBPos.x;
+                BOwnerPos.y += bodyBImage.y - bodyBPos.y;
+                BOwnerPos.z += bodyBImage.z - bodyBPos.z;
+                bodyBPos = bodyBImage;
+            }
 
             BRadius = myRadius;
             bodyBMatType = granData->sphereMaterialOffset[sphereID];
@@ -167,6 +197,10 @@ __global__ void calculateContactForces(deme::DEMSimParams* simParams, deme::DEMD
             // Write contact location values back to global memory
             granData->contactPointGeometryA[myContactID] = locCPA;
             granData->contactPointGeometryB[myContactID] = locCPB;
+            // The variable step size may go by the overlap relative to the smaller body
+            if (simParams->recordContactOverlap) {
+                granData->contactOverlap[myContactID] = overlapDepth / fminf(ARadius, BRadius);
+            }
         } else {
             // The contact is no longer active, so we need to destroy its contact history recording
             _forceModelContactWildcardDestroy_;
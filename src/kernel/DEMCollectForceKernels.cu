@@ -119,15 +119,58 @@ __global__ void forceToAngAcc(float3* angAcc,
     }
 }
 
-// Place information to an array based on an index array and a value array
-__global__ void stashElem(float* out1, float* out2, float* out3, deme::bodyID_t* index, float3* value, size_t n) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+// The owner-to-contact CSR lists, for each owner, the slots of the flattened (2 * nContactPairs) owner ID array that
+// belong to it. Slot i is body A of contact i if i < nContactPairs, or body B of contact (i - nContactPairs) otherwise,
+// so the slot also tells the sign of the contact force on this owner. Initially, the slots are just in order.
+__global__ void fillOwnerSlots(deme::contactPairs_t* slots, size_t n) {
+    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < n) {
+        slots[myID] = myID;
+    }
+}
+
+// Given the owner IDs sorted, find the CSR offsets of all owners (nOwners + 1 of them): each sorted item writes the
+// offsets of the owners between the previous item's owner and its own, and the last item also closes the rest
+__global__ void markOwnerSegments(deme::contactPairs_t* ownerOffsets,
+                                  deme::bodyID_t* sortedOwner,
+                                  size_t n,
+                                  size_t nOwners) {
+    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
-        // my_index is unique, no race condition
-        deme::bodyID_t my_index = index[myID];
-        float3 my_value = value[myID];
-        out1[my_index] += my_value.x;
-        out2[my_index] += my_value.y;
-        out3[my_index] += my_value.z;
+        size_t myOwner = sortedOwner[myID];
+        size_t firstOwner = (myID == 0) ? 0 : (size_t)sortedOwner[myID - 1] + 1;
+        for (size_t owner = firstOwner; owner <= myOwner; owner++) {
+            ownerOffsets[owner] = myID;
+        }
+        if (myID == n - 1) {
+            for (size_t owner = myOwner + 1; owner <= nOwners; owner++) {
+                ownerOffsets[owner] = n;
+            }
+        }
+    }
+}
+
+// Each owner sums up the contact-wise values in its slots and adds it to the output arrays. Only one thread touches an
+// owner, so there is no race condition, and the slots are in a fixed order, so the sum is deterministic.
+__global__ void gatherOwnerValues(float* out1,
+                                  float* out2,
+                                  float* out3,
+                                  float3* value,
+                                  deme::contactPairs_t* ownerOffsets,
+                                  deme::contactPairs_t* ownerSlots,
+                                  size_t nOwners) {
+    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nOwners) {
+        deme::contactPairs_t myStart = ownerOffsets[myID];
+        deme::contactPairs_t myEnd = ownerOffsets[myID + 1];
+        if (myStart == myEnd)
+            return;
+        float3 my_value = make_float3(0, 0, 0);
+        for (deme::contactPairs_t i = myStart; i < myEnd; i++) {
+            my_value += value[ownerSlots[i]];
+        }
+        out1[myID] += my_value.x;
+        out2[myID] += my_value.y;
+        out3[myID] += my_value.z;
     }
 }
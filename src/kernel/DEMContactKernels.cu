@@ -16,28 +16,38 @@ __global__ void getNumberOfContactsEachBin(deme::DEMSimParams* simParams,
                                            deme::spheresBinTouches_t* numSpheresBinTouches,
                                            deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
                                            deme::spheresBinTouches_t* numContactsInEachBin,
+                                           deme::binID_t* overfullBinList,
+                                           size_t* pNumOverfullBins,
                                            size_t nActiveBins) {
     // Only active bins got execute this...
     deme::binID_t myActiveID = blockIdx.x * blockDim.x + threadIdx.x;
     // I need to store all the sphereIDs that I am supposed to look into
     // A100 has about 164K shMem... these arrays really need to be small, or we can only fit a small number of bins in
     // one block
-    deme::bodyID_t ownerIDs[DEME_MAX_SPHERES_PER_BIN];
-    float radii[DEME_MAX_SPHERES_PER_BIN];
-    double bodyX[DEME_MAX_SPHERES_PER_BIN];
-    double bodyY[DEME_MAX_SPHERES_PER_BIN];
-    double bodyZ[DEME_MAX_SPHERES_PER_BIN];
-    deme::family_t ownerFamily[DEME_MAX_SPHERES_PER_BIN];
+    deme::bodyID_t ownerIDs[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    float radii[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    double bodyX[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    double bodyY[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    double bodyZ[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    deme::family_t ownerFamily[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
     if (myActiveID < nActiveBins) {
         // I got a true bin ID
         deme::binID_t binID = activeBinIDs[myActiveID];
+        // Contact points are located using the bins of the level this bin belongs to
+        double levelBinSize;
+        deme::binID_t levelNbX, levelNbY, levelOffset;
+        getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                       getBinLevel<deme::binID_t>(binID, simParams), simParams);
 
         deme::spheresBinTouches_t contact_count = 0;
         // Grab the bodies that I care, put into local memory
         deme::spheresBinTouches_t nBodiesMeHandle = numSpheresBinTouches[myActiveID];
-        if (nBodiesMeHandle > DEME_MAX_SPHERES_PER_BIN) {
-            DEME_ABORT_KERNEL("Bin %u contains %u sphere components, exceeding maximum allowance (%u)\n", myActiveID,
-                              nBodiesMeHandle, DEME_MAX_SPHERES_PER_BIN);
+        if (nBodiesMeHandle > DEME_MAX_SPHERES_PER_BIN_ONE_THREAD) {
+            // Too many spheres for my local arrays; this bin is left to the overfull-bin kernels
+            unsigned long long int overfullInd = atomicAdd((unsigned long long int*)pNumOverfullBins, 1ULL);
+            overfullBinList[overfullInd] = myActiveID;
+            numContactsInEachBin[myActiveID] = 0;
+            return;
         }
 
         deme::binSphereTouchPairs_t myBodiesTableEntry = sphereIDsLookUpTable[myActiveID];
@@ -92,11 +102,11 @@ __global__ void getNumberOfContactsEachBin(deme::DEMSimParams* simParams,
                 double contactPntY;
                 double contactPntZ;
                 bool in_contact;
-                in_contact = checkSpheresOverlap<double>(bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA],
-                                                         bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB], radii[bodyB],
-                                                         contactPntX, contactPntY, contactPntZ);
-                deme::binID_t contactPntBin = getPointBinID<deme::binID_t>(
-                    contactPntX, contactPntY, contactPntZ, simParams->binSize, simParams->nbX, simParams->nbY);
+                in_contact = checkSpheresOverlapPeriodic<double>(
+                    bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA], bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB],
+                    radii[bodyB], contactPntX, contactPntY, contactPntZ, simParams);
+                deme::binID_t contactPntBin = levelOffset + getPointBinID<deme::binID_t>(
+                    contactPntX, contactPntY, contactPntZ, levelBinSize, levelNbX, levelNbY);
 
                 /*
                 printf("contactPntBin: %u, %u, %u\n", (unsigned int)(contactPntX/_binSize_),
@@ -136,19 +146,27 @@ __global__ void populateContactPairsEachBin(deme::DEMSimParams* simParams,
     // I need to store all the sphereIDs that I am supposed to look into
     // A100 has about 164K shMem... these arrays really need to be small, or we can only fit a small number of bins in
     // one block
-    deme::bodyID_t ownerIDs[DEME_MAX_SPHERES_PER_BIN];
-    deme::bodyID_t bodyIDs[DEME_MAX_SPHERES_PER_BIN];
-    float radii[DEME_MAX_SPHERES_PER_BIN];
-    double bodyX[DEME_MAX_SPHERES_PER_BIN];
-    double bodyY[DEME_MAX_SPHERES_PER_BIN];
-    double bodyZ[DEME_MAX_SPHERES_PER_BIN];
-    deme::family_t ownerFamily[DEME_MAX_SPHERES_PER_BIN];
+    deme::bodyID_t ownerIDs[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    deme::bodyID_t bodyIDs[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    float radii[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    double bodyX[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    double bodyY[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    double bodyZ[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
+    deme::family_t ownerFamily[DEME_MAX_SPHERES_PER_BIN_ONE_THREAD];
     if (myActiveID < nActiveBins) {
         // But I got a true bin ID
         deme::binID_t binID = activeBinIDs[myActiveID];
+        // Contact points are located using the bins of the level this bin belongs to
+        double levelBinSize;
+        deme::binID_t levelNbX, levelNbY, levelOffset;
+        getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                       getBinLevel<deme::binID_t>(binID, simParams), simParams);
 
         // Grab the bodies that I care, put into local memory
         deme::spheresBinTouches_t nBodiesMeHandle = numSpheresBinTouches[myActiveID];
+        // Overfull bins are handled by the overfull-bin kernels
+        if (nBodiesMeHandle > DEME_MAX_SPHERES_PER_BIN_ONE_THREAD)
+            return;
         deme::binSphereTouchPairs_t myBodiesTableEntry = sphereIDsLookUpTable[myActiveID];
         for (deme::spheresBinTouches_t i = 0; i < nBodiesMeHandle; i++) {
             deme::bodyID_t sphereID = sphereIDsEachBinTouches_sorted[myBodiesTableEntry + i];
@@ -204,15 +222,24 @@ __global__ void populateContactPairsEachBin(deme::DEMSimParams* simParams,
                 double contactPntY;
                 double contactPntZ;
                 bool in_contact;
-                in_contact = checkSpheresOverlap<double>(bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA],
-                                                         bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB], radii[bodyB],
-                                                         contactPntX, contactPntY, contactPntZ);
-                deme::binID_t contactPntBin = getPointBinID<deme::binID_t>(
-                    contactPntX, contactPntY, contactPntZ, simParams->binSize, simParams->nbX, simParams->nbY);
+                in_contact = checkSpheresOverlapPeriodic<double>(
+                    bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA], bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB],
+                    radii[bodyB], contactPntX, contactPntY, contactPntZ, simParams);
+                deme::binID_t contactPntBin = levelOffset + getPointBinID<deme::binID_t>(
+                    contactPntX, contactPntY, contactPntZ, levelBinSize, levelNbX, levelNbY);
 
                 if (in_contact && (contactPntBin == binID)) {
-                    idSphA[myReportOffset] = bodyIDs[bodyA];
-                    idSphB[myReportOffset] = bodyIDs[bodyB];
+                    deme::bodyID_t sphA = bodyIDs[bodyA], sphB = bodyIDs[bodyB];
+                    // If spheres were rearranged in memory, pairs are oriented by their public IDs, like they were
+                    // before, so contact history still matches
+                    if (granData->spherePublicID != NULL &&
+                        granData->spherePublicID[sphA] > granData->spherePublicID[sphB]) {
+                        deme::bodyID_t tmp = sphA;
+                        sphA = sphB;
+                        sphB = tmp;
+                    }
+                    idSphA[myReportOffset] = sphA;
+                    idSphB[myReportOffset] = sphB;
                     myReportOffset++;
                 }
             }
@@ -19,6 +19,8 @@ __global__ void getNumberOfContactsEachBin(deme::DEMSimParams* simParams,
                                            deme::spheresBinTouches_t* numSpheresBinTouches,
                                            deme::binSphereTouchPairs_t* sphereIDsLookUpTable,
                                            deme::spheresBinTouches_t* numContactsInEachBin,
+                                           deme::binID_t* overfullBinList,
+                                           size_t* pNumOverfullBins,
                                            size_t nActiveBins) {
     // shared storage for bodies involved in this bin. Pre-allocated so that each threads can easily use.
     __shared__ deme::bodyID_t ownerIDs[DEME_MAX_SPHERES_PER_BIN];
@@ -28,22 +30,28 @@ __global__ void getNumberOfContactsEachBin(deme::DEMSimParams* simParams,
     __shared__ double bodyZ[DEME_MAX_SPHERES_PER_BIN];
     __shared__ deme::family_t ownerFamilies[DEME_MAX_SPHERES_PER_BIN];
 
-    typedef cub::BlockReduce<deme::spheresBinTouches_t, DEME_MAX_SPHERES_PER_BIN> BlockReduceT;
+    typedef cub::BlockReduce<deme::spheresBinTouches_t, DEME_KT_CD_NTHREADS_PER_BLOCK> BlockReduceT;
     __shared__ typename BlockReduceT::TempStorage temp_storage;
 
     const deme::spheresBinTouches_t nBodiesInBin = numSpheresBinTouches[blockIdx.x];
-    if (nBodiesInBin <= 1) {
+    if (nBodiesInBin <= 1 || nBodiesInBin > DEME_MAX_SPHERES_PER_BIN) {
         // Important: mark 0 contacts before exiting
         if (threadIdx.x == 0) {
             numContactsInEachBin[blockIdx.x] = 0;
+            // Too many spheres for the shared memory; this bin is left to the overfull-bin kernels
+            if (nBodiesInBin > 1) {
+                unsigned long long int overfullInd = atomicAdd((unsigned long long int*)pNumOverfullBins, 1ULL);
+                overfullBinList[overfullInd] = blockIdx.x;
+            }
         }
         return;
     }
-    if (threadIdx.x == 0 && nBodiesInBin > DEME_MAX_SPHERES_PER_BIN) {
-        DEME_ABORT_KERNEL("Bin %u contains %u sphere components, exceeding maximum allowance (%u)\n", blockIdx.x,
-                          nBodiesInBin, DEME_MAX_SPHERES_PER_BIN);
-    }
     const deme::binID_t binID = activeBinIDs[blockIdx.x];
+    // Contact points are located using the bins of the level this bin belongs to
+    double levelBinSize;
+    deme::binID_t levelNbX, levelNbY, levelOffset;
+    getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                   getBinLevel<deme::binID_t>(binID, simParams), simParams);
     deme::spheresBinTouches_t myThreadID = threadIdx.x;
     const deme::binSphereTouchPairs_t thisBodiesTableEntry = sphereIDsLookUpTable[blockIdx.x];
     // If I need to work on shared memory allocation
@@ -110,11 +118,11 @@ __global__ void getNumberOfContactsEachBin(deme::DEMSimParams* simParams,
             double contactPntY;
             double contactPntZ;
             bool in_contact;
-            in_contact = checkSpheresOverlap<double>(bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA],
-                                                     bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB], radii[bodyB],
-                                                     contactPntX, contactPntY, contactPntZ);
-            deme::binID_t contactPntBin = getPointBinID<deme::binID_t>(
-                contactPntX, contactPntY, contactPntZ, simParams->binSize, simParams->nbX, simParams->nbY);
+            in_contact = checkSpheresOverlapPeriodic<double>(
+                bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA], bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB],
+                radii[bodyB], contactPntX, contactPntY, contactPntZ, simParams);
+            deme::binID_t contactPntBin = levelOffset + getPointBinID<deme::binID_t>(
+                contactPntX, contactPntY, contactPntZ, levelBinSize, levelNbX, levelNbY);
 
             /*
             printf("contactPntBin: %u, %u, %u\n", (unsigned int)(contactPntX/_binSize_),
@@ -166,12 +174,17 @@ __global__ void populateContactPairsEachBin(deme::DEMSimParams* simParams,
     // __shared__ typename BlockScanT::TempStorage temp_storage;
 
     const deme::spheresBinTouches_t nBodiesInBin = numSpheresBinTouches[blockIdx.x];
-    if (nBodiesInBin <= 1) {
+    // Overfull bins are handled by the overfull-bin kernels
+    if (nBodiesInBin <= 1 || nBodiesInBin > DEME_MAX_SPHERES_PER_BIN) {
         return;
     }
-    // No need to check max spheres one more time
 
     const deme::binID_t binID = activeBinIDs[blockIdx.x];
+    // Contact points are located using the bins of the level this bin belongs to
+    double levelBinSize;
+    deme::binID_t levelNbX, levelNbY, levelOffset;
+    getBinLevelInfo<deme::binID_t>(levelBinSize, levelNbX, levelNbY, levelOffset,
+                                   getBinLevel<deme::binID_t>(binID, simParams), simParams);
     deme::spheresBinTouches_t myThreadID = threadIdx.x;
     const deme::binSphereTouchPairs_t thisBodiesTableEntry = sphereIDsLookUpTable[blockIdx.x];
     // If I need to work on shared memory allocation
@@ -247,17 +260,25 @@ __global__ void populateContactPairsEachBin(deme::DEMSimParams* simParams,
             double contactPntY;
             double contactPntZ;
             bool in_contact;
-            in_contact = checkSpheresOverlap<double>(bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA],
-                                                     bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB], radii[bodyB],
-                                                     contactPntX, contactPntY, contactPntZ);
-            deme::binID_t contactPntBin = getPointBinID<deme::binID_t>(
-                contactPntX, contactPntY, contactPntZ, simParams->binSize, simParams->nbX, simParams->nbY);
+            in_contact = checkSpheresOverlapPeriodic<double>(
+                bodyX[bodyA], bodyY[bodyA], bodyZ[bodyA], radii[bodyA], bodyX[bodyB], bodyY[bodyB], bodyZ[bodyB],
+                radii[bodyB], contactPntX, contactPntY, contactPntZ, simParams);
+            deme::binID_t contactPntBin = levelOffset + getPointBinID<deme::binID_t>(
+                contactPntX, contactPntY, contactPntZ, levelBinSize, levelNbX, levelNbY);
 
             if (in_contact && (contactPntBin == binID)) {
                 // blockwise_offset++;
                 unsigned int inBlockOffset = atomicAdd_block(&blockPairCnt, 1);
-                idSphA[myReportOffset + inBlockOffset] = bodyIDs[bodyA];
-                idSphB[myReportOffset + inBlockOffset] = bodyIDs[bodyB];
+                deme::bodyID_t sphA = bodyIDs[bodyA], sphB = bodyIDs[bodyB];
+                // If spheres were rearranged in memory, pairs are oriented by their public IDs
+                if (granData->spherePublicID != NULL &&
+                    granData->spherePublicID[sphA] > granData->spherePublicID[sphB]) {
+                    deme::bodyID_t tmp = sphA;
+                    sphA = sphB;
+                    sphB = tmp;
+                }
+                idSphA[myReportOffset + inBlockOffset] = sphA;
+                idSphB[myReportOffset + inBlockOffset] = sphB;
             }
         }
         // __syncthreads();
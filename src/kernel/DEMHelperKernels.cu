@@ -263,6 +263,69 @@ inline __device__ deme::contact_t checkSpheresOverlap(const T1& XA,
     return deme::SPHERE_SPHERE_CONTACT;
 }
 
+// Periodic boundaries. Along a periodic direction, owner positions are kept in [0, period) (relative to the LBF corner
+// of the domain), and 2 bodies interact through the image of one that is nearest to the other.
+template <typename T1>
+inline __device__ void wrapIntoPeriod(T1& X, const bool& periodic, const double& period) {
+    if (periodic) {
+        X -= (T1)period * floor(X / (T1)period);
+        // Rounding can land it right on the period
+        if (X >= (T1)period)
+            X -= (T1)period;
+    }
+}
+
+template <typename T1>
+inline __device__ void shiftToNearestImage(const T1& A, T1& B, const bool& periodic, const double& period) {
+    if (periodic) {
+        B -= (T1)period * round((B - A) / (T1)period);
+    }
+}
+
+template <typename T1>
+inline __device__ void wrapIntoPeriodicDomain(T1& X, T1& Y, T1& Z, const deme::DEMSimParams* simParams) {
+    wrapIntoPeriod<T1>(X, simParams->periodicX, simParams->periodX);
+    wrapIntoPeriod<T1>(Y, simParams->periodicY, simParams->periodY);
+    wrapIntoPeriod<T1>(Z, simParams->periodicZ, simParams->periodZ);
+}
+
+// Move (XB, YB, ZB) to its periodic image that is nearest to (XA, YA, ZA)
+template <typename T1>
+inline __device__ void shiftToNearestPeriodicImage(const T1& XA,
+                                                   const T1& YA,
+                                                   const T1& ZA,
+                                                   T1& XB,
+                                                   T1& YB,
+                                                   T1& ZB,
+                                                   const deme::DEMSimParams* simParams) {
+    shiftToNearestImage<T1>(XA, XB, simParams->periodicX, simParams->periodX);
+    shiftToNearestImage<T1>(YA, YB, simParams->periodicY, simParams->periodY);
+    shiftToNearestImage<T1>(ZA, ZB, simParams->periodicZ, simParams->periodZ);
+}
+
+// The contact detection version of checkSpheresOverlap: sphere B is tested at its image nearest to A, and the contact
+// point is brought back into the periodic domain, where the bins are
+template <typename T1>
+inline __device__ deme::contact_t checkSpheresOverlapPeriodic(const T1& XA,
+                                                              const T1& YA,
+                                                              const T1& ZA,
+                                                              const T1& radA,
+                                                              const T1& XB,
+                                                              const T1& YB,
+                                                              const T1& ZB,
+                                                              const T1& radB,
+                                                              T1& CPX,
+                                                              T1& CPY,
+                                                              T1& CPZ,
+                                                              const deme::DEMSimParams* simParams) {
+    T1 imageXB = XB, imageYB = YB, imageZB = ZB;
+    shiftToNearestPeriodicImage<T1>(XA, YA, ZA, imageXB, imageYB, imageZB, simParams);
+    deme::contact_t contact_type =
+        checkSpheresOverlap<T1>(XA, YA, ZA, radA, imageXB, imageYB, imageZB, radB, CPX, CPY, CPZ);
+    wrapIntoPeriodicDomain<T1>(CPX, CPY, CPZ, simParams);
+    return contact_type;
+}
+
 template <typename T1>
 inline __device__ T1
 getPointBinID(const double& X, const double& Y, const double& Z, const double& binSize, const T1& nbX, const T1& nbY) {
@@ -272,6 +335,104 @@ getPointBinID(const double& X, const double& Y, const double& Z, const double& b
     return binIDX + binIDY * nbX + binIDZ * nbX * nbY;
 }
 
+// The bin level that a sphere of this (expanded) radius registers at: the finest level whose bins are not smaller than
+// the sphere's diameter, capped by the coarsest level
+inline __device__ unsigned int getSphereBinLevel(const double& radius,
+                                                 const double& binSize,
+                                                 const unsigned int& nBinLevels) {
+    unsigned int level = 0;
+    double levelBinSize = binSize;
+    while (level + 1 < nBinLevels && 2.0 * radius > levelBinSize) {
+        level++;
+        levelBinSize *= 2.0;
+    }
+    return level;
+}
+
+// Bin size, number of bins in X and Y, and the bin ID offset of a bin level. The bins of a level are numbered after all
+// the bins of the finer levels, so a bin in level k has ID offset + i + j * nbX + kk * nbX * nbY.
+template <typename T1>
+inline __device__ void getBinLevelInfo(double& levelBinSize,
+                                       T1& nbX,
+                                       T1& nbY,
+                                       T1& offset,
+                                       const unsigned int& level,
+                                       const deme::DEMSimParams* simParams) {
+    levelBinSize = simParams->binSize;
+    nbX = simParams->nbX;
+    nbY = simParams->nbY;
+    T1 nbZ = simParams->nbZ;
+    offset = 0;
+    for (unsigned int i = 0; i < level; i++) {
+        offset += nbX * nbY * nbZ;
+        nbX = (nbX + 1) / 2;
+        nbY = (nbY + 1) / 2;
+        nbZ = (nbZ + 1) / 2;
+        levelBinSize *= 2.0;
+    }
+}
+
+// Which level a bin belongs to
+template <typename T1>
+inline __device__ unsigned int getBinLevel(const T1& binID, const deme::DEMSimParams* simParams) {
+    T1 nbX = simParams->nbX, nbY = simParams->nbY, nbZ = simParams->nbZ;
+    T1 levelEnd = nbX * nbY * nbZ;
+    unsigned int level = 0;
+    while (level + 1 < simParams->nBinLevels && binID >= levelEnd) {
+        level++;
+        nbX = (nbX + 1) / 2;
+        nbY = (nbY + 1) / 2;
+        nbZ = (nbZ + 1) / 2;
+        levelEnd += nbX * nbY * nbZ;
+    }
+    return level;
+}
+
+// The bins along one direction that a sphere covering [myBin - span, myBin + span] (in units of bins) touches: num bins
+// from lo on. Along a periodic direction, the bins wrap around after nbPeriod, the number of bins that cover the period
+// (the last one may be cut short), and no bin is taken twice; nbPeriod is 0 along the other directions.
+inline __device__ void getSphereBinRange(unsigned int& lo,
+                                         unsigned int& num,
+                                         unsigned int& nbPeriod,
+                                         const double& myBin,
+                                         const double& span,
+                                         const bool& periodic,
+                                         const double& period,
+                                         const double& levelBinSize) {
+    if (!periodic) {
+        lo = (unsigned int)(myBin - span);
+        num = (unsigned int)(myBin + span) - lo + 1;
+        nbPeriod = 0;
+        return;
+    }
+    const double periodBins = period / levelBinSize;
+    nbPeriod = (unsigned int)ceil(periodBins);
+    double lower = myBin - span, upper = myBin + span;
+    if (upper - lower >= periodBins) {
+        lo = 0;
+        num = nbPeriod;
+        return;
+    }
+    if (lower < 0.) {
+        lower += periodBins;
+        upper += periodBins;
+    }
+    lo = min((unsigned int)lower, nbPeriod - 1);
+    if (upper < periodBins) {
+        num = min((unsigned int)upper, nbPeriod - 1) - lo + 1;
+    } else {
+        num = min(nbPeriod - lo + min((unsigned int)(upper - periodBins), nbPeriod - 1) + 1, nbPeriod);
+    }
+}
+
+// The n-th bin index of a range from getSphereBinRange
+inline __device__ unsigned int getBinIndexInRange(const unsigned int& lo,
+                                                  const unsigned int& n,
+                                                  const unsigned int& nbPeriod) {
+    unsigned int i = lo + n;
+    return (nbPeriod > 0 && i >= nbPeriod) ? i - nbPeriod : i;
+}
+
 /**
  * Template arguments:
  *   - T1: the floating point accuracy level for the point coordinates
@@ -2,59 +2,67 @@
 #include <DEM/Defines.h>
 #include <kernel/DEMHelperKernels.cu>
 
-__global__ void fillRunLengthArray(deme::geoSphereTouches_t* runlength_full,
-                                   deme::bodyID_t* unique_ids,
-                                   deme::geoSphereTouches_t* runlength,
-                                   size_t numUnique) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
-    if (myID < numUnique) {
-        deme::bodyID_t i = unique_ids[myID];
-        runlength_full[i] = runlength[myID];
+// A contact is identified by (idA, idB, contactType). idA and idB make up a 64-bit key, whose order groups contacts by
+// idA; contacts with the same key are told apart by their contact type.
+inline __device__ uint64_t contactKey(const deme::bodyID_t& idA, const deme::bodyID_t& idB) {
+    return ((uint64_t)idA << (sizeof(deme::bodyID_t) * DEME_BITS_PER_BYTE)) | (uint64_t)idB;
+}
+
+__global__ void buildContactKeys(uint64_t* keys,
+                                 deme::bodyID_t* idGeometryA,
+                                 deme::bodyID_t* idGeometryB,
+                                 size_t nContacts) {
+    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContacts) {
+        keys[myID] = contactKey(idGeometryA[myID], idGeometryB[myID]);
     }
 }
 
-__global__ void buildPersistentMap(deme::geoSphereTouches_t* new_idA_runlength_full,
-                                   deme::geoSphereTouches_t* old_idA_runlength_full,
-                                   deme::contactPairs_t* new_idA_scanned_runlength,
-                                   deme::contactPairs_t* old_idA_scanned_runlength,
-                                   deme::contactPairs_t* mapping,
+__global__ void unpackContactKeys(deme::bodyID_t* idGeometryA,
+                                  deme::bodyID_t* idGeometryB,
+                                  uint64_t* keys,
+                                  size_t nContacts) {
+    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContacts) {
+        uint64_t key = keys[myID];
+        idGeometryA[myID] = (deme::bodyID_t)(key >> (sizeof(deme::bodyID_t) * DEME_BITS_PER_BYTE));
+        idGeometryB[myID] = (deme::bodyID_t)key;
+    }
+}
+
+// Each thread finds the partner of one new contact among the previous contacts. Both contact arrays are sorted by their
+// keys, so it is a binary search for the key, then a search for the contact type among the (rarely more than one)
+// previous contacts with that key. The mapping's elemental values are the indices of the corresponding contacts in the
+// previous contact array, or NULL_MAPPING_PARTNER for new contacts.
+__global__ void buildPersistentMap(deme::contactPairs_t* mapping,
                                    deme::DEMDataKT* granData,
-                                   size_t nSpheresSafe) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
-    if (myID < nSpheresSafe) {
-        deme::geoSphereTouches_t new_cnt_count = new_idA_runlength_full[myID];
-        deme::geoSphereTouches_t old_cnt_count = old_idA_runlength_full[myID];
-        // If this idA has non-zero runlength in new: a potential persistent sphere
-        if (new_cnt_count > 0) {
-            // Where should I start looking? Grab the offset.
-            deme::contactPairs_t new_cnt_offset = new_idA_scanned_runlength[myID];
-            deme::contactPairs_t old_cnt_offset = old_idA_scanned_runlength[myID];
-            for (deme::geoSphereTouches_t i = 0; i < new_cnt_count; i++) {
-                // Current contact number we are inspecting
-                deme::contactPairs_t this_contact = new_cnt_offset + i;
-                deme::bodyID_t new_idB = granData->idGeometryB[this_contact];
-                deme::contact_t new_cntType = granData->contactType[this_contact];
-                // Mark it as no matching pair found, being a new contact; modify it later
-                deme::contactPairs_t my_partner = deme::NULL_MAPPING_PARTNER;
-                // If this is a fake contact, we can move on
-                if (new_cntType == deme::NOT_A_CONTACT) {
-                    mapping[this_contact] = my_partner;
-                    continue;
-                }
-                // Loop through the old idB to see if there is a match
-                for (deme::geoSphereTouches_t j = 0; j < old_cnt_count; j++) {
-                    deme::bodyID_t old_idB = granData->previous_idGeometryB[old_cnt_offset + j];
-                    deme::contact_t old_cntType = granData->previous_contactType[old_cnt_offset + j];
-                    // If both idB and contact type match, then it is a persistent contact, write it to the mapping
-                    // array
-                    if (new_idB == old_idB && new_cntType == old_cntType) {
-                        my_partner = old_cnt_offset + j;
-                        break;
-                    }
+                                   size_t nContacts,
+                                   size_t nPrevContacts) {
+    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContacts) {
+        deme::contactPairs_t my_partner = deme::NULL_MAPPING_PARTNER;
+        deme::contact_t myType = granData->contactType[myID];
+        // If this is a fake contact, it has no partner
+        if (myType != deme::NOT_A_CONTACT) {
+            uint64_t myKey = contactKey(granData->idGeometryA[myID], granData->idGeometryB[myID]);
+            // Neighboring threads have neighboring keys, so their searches go through about the same elements
+            size_t lo = 0, hi = nPrevContacts;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (contactKey(granData->previous_idGeometryA[mid], granData->previous_idGeometryB[mid]) < myKey)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for (size_t j = lo; j < nPrevContacts; j++) {
+                if (contactKey(granData->previous_idGeometryA[j], granData->previous_idGeometryB[j]) != myKey)
+                    break;
+                if (granData->previous_contactType[j] == myType) {
+                    my_partner = j;
+                    break;
                 }
-                // If old_cnt_count == 0, it is automatically NULL_MAPPING_PARTNER
-                mapping[this_contact] = my_partner;
             }
         }
+        mapping[myID] = my_partner;
     }
 }
@@ -0,0 +1,62 @@
+// Host (CPU) stand-ins for the CUDA built-ins used by the jitified kernels. HostJitHelper puts this on top of a kernel
+// source, so the same kernel code (and the same substitutions) can be compiled by the host C++ compiler.
+#ifndef DEME_HOST_KERNEL_PRELUDE
+#define DEME_HOST_KERNEL_PRELUDE
+
+#include <vector_types.h>
+#include <vector_functions.h>
+#include <cmath>
+#include <math.h>
+#include <cstdio>
+#include <cstdlib>
+#include <typeinfo>
+
+// Kernels become unmangled functions so they can be looked up by name. Everything else is just host code.
+#undef __global__
+#undef __device__
+#undef __host__
+#undef __constant__
+#undef __forceinline__
+#define __global__ extern "C"
+#define __device__
+#define __host__
+#define __constant__ static
+#define __forceinline__ inline
+
+// A kernel call processes one element: blockIdx.x is that element's index and there is one thread per block
+static thread_local uint3 blockIdx = {0, 0, 0};
+static const uint3 threadIdx = {0, 0, 0};
+static const uint3 blockDim = {1, 1, 1};
+
+extern "C" unsigned int* demeHostBlockIdxX() {
+    return &(blockIdx.x);
+}
+
+inline float rsqrtf(float x) {
+    return 1.f / sqrtf(x);
+}
+
+// CUDA provides these for mixed argument types too
+template <typename T1, typename T2>
+inline auto min(const T1& a, const T2& b) -> decltype(a + b) {
+    return (b < a) ? b : a;
+}
+template <typename T1, typename T2>
+inline auto max(const T1& a, const T2& b) -> decltype(a + b) {
+    return (a < b) ? b : a;
+}
+
+inline void __threadfence() {}
+
+// Kernel calls on different host threads may count into the same variable
+inline unsigned long long int atomicAdd(unsigned long long int* address, unsigned long long int val) {
+    return __atomic_fetch_add(address, val, __ATOMIC_RELAXED);
+}
+
+namespace cub {
+inline void ThreadTrap() {
+    std::abort();
+}
+}  // namespace cub
+
+#endif
@@ -106,6 +106,7 @@ inline __device__ void integrateVel(deme::bodyID_t thisClump,
 // }
 
 inline __device__ void integratePos(deme::bodyID_t thisClump,
+                                    deme::DEMSimParams* simParams,
                                     deme::DEMDataDT* granData,
                                     float3 v,
                                     float3 omgBar,
@@ -138,6 +139,21 @@ inline __device__ void integratePos(deme::bodyID_t thisClump,
         Y += (double)v.y * h;
         Z += (double)v.z * h;
     }
+    // An owner that leaves through a periodic side comes back in through the other side
+    wrapIntoPeriodicDomain<double>(X, Y, Z, simParams);
+    // A clump that leaves the keep region is marked for removal by moving it into the culled family (fixed, and with no
+    // contacts), and it waits at the edge of the region, so its voxel ID stays valid until it is removed
+    if (simParams->cullOutOfDomain && family_code != simParams->cullFamily &&
+        granData->ownerTypes[thisClump] == deme::OWNER_T_CLUMP) {
+        if (X < simParams->keepLBFX || X > simParams->keepRTFX || Y < simParams->keepLBFY ||
+            Y > simParams->keepRTFY || Z < simParams->keepLBFZ || Z > simParams->keepRTFZ) {
+            X = fmin(fmax(X, simParams->keepLBFX), simParams->keepRTFX);
+            Y = fmin(fmax(Y, simParams->keepLBFY), simParams->keepRTFY);
+            Z = fmin(fmax(Z, simParams->keepLBFZ), simParams->keepRTFZ);
+            granData->familyID[thisClump] = simParams->cullFamily;
+            atomicAdd((unsigned long long int*)granData->pNumCulledClumps, 1ULL);
+        }
+    }
     positionToVoxelID<deme::voxelID_t, deme::subVoxelPos_t, double>(
         granData->voxelID[thisClump], granData->locX[thisClump], granData->locY[thisClump], granData->locZ[thisClump],
         X, Y, Z, _nvXp2_, _nvYp2_, _voxelSize_, _l_);
@@ -170,10 +186,76 @@ inline __device__ void integratePos(deme::bodyID_t thisClump,
 __global__ void integrateOwners(deme::DEMSimParams* simParams, deme::DEMDataDT* granData, float t) {
     deme::bodyID_t thisClump = blockIdx.x * blockDim.x + threadIdx.x;
     if (thisClump < simParams->nOwnerBodies) {
+        // Sleeping clumps stay where they are
+        if (simParams->sleepQuietSteps > 0 && (granData->ownerSleepState[thisClump] & deme::SLEEP_ASLEEP)) {
+            return;
+        }
         // These 2 quantities mean the velocity and ang vel used for updating position/quaternion for this step.
         // Depending on the integration scheme in use, they can be different.
         float3 v, omgBar;
         integrateVel(thisClump, simParams, granData, v, omgBar, simParams->h, t);
-        integratePos(thisClump, granData, v, omgBar, simParams->h, t);
+        integratePos(thisClump, simParams, granData, v, omgBar, simParams->h, t);
+    }
+}
+
+// Runs after integration. A clump falls asleep after staying quiet for sleepQuietSteps steps in a row, and a sleeping
+// one wakes up if a restless owner touched it in this step's force calculation, or its velocity or family was changed
+// from the outside. Other owners never sleep, but they too can be restless and wake up the clumps they touch.
+__global__ void updateSleepStates(deme::DEMSimParams* simParams, deme::DEMDataDT* granData, float t) {
+    deme::bodyID_t myOwner = blockIdx.x * blockDim.x + threadIdx.x;
+    if (myOwner < simParams->nOwnerBodies) {
+        deme::sleepState_t myState = granData->ownerSleepState[myOwner];
+        float3 v = make_float3(granData->vX[myOwner], granData->vY[myOwner], granData->vZ[myOwner]);
+        float3 omgBar = make_float3(granData->omgBarX[myOwner], granData->omgBarY[myOwner], granData->omgBarZ[myOwner]);
+        // The thresholds that are not set follow the step size in use now (see DEMSimParams)
+        const float maxVel =
+            (simParams->sleepMaxVel > 0.f) ? simParams->sleepMaxVel : simParams->sleepMaxDispPerStep / simParams->h;
+        const float maxAngVel =
+            (simParams->sleepMaxAngVel > 0.f) ? simParams->sleepMaxAngVel : maxVel / simParams->sleepRefRadius;
+        bool slow = length(v) < maxVel && length(omgBar) < maxAngVel;
+        // Owners with prescribed motion never sleep (the prescription is applied to copies, only to find that out)
+        bool LinPrescribed = false, RotPrescribed = false;
+        {
+            float3 v_copy = v, omgBar_copy = omgBar;
+            applyPrescribedVel<float, float>(LinPrescribed, RotPrescribed, v_copy.x, v_copy.y, v_copy.z, omgBar_copy.x,
+                                             omgBar_copy.y, omgBar_copy.z, granData->familyID[myOwner], t);
+        }
+        bool canSleep = granData->ownerTypes[myOwner] == deme::OWNER_T_CLUMP && !LinPrescribed && !RotPrescribed;
+
+        if (myState & deme::SLEEP_ASLEEP) {
+            if (!(myState & deme::SLEEP_WAKE_REQUEST) && slow && canSleep) {
+                return;
+            }
+            // The forces on it this step missed the frozen contacts, so they are not compared with the next step's
+            granData->ownerSleepState[myOwner] = deme::SLEEP_NO_ACC_REF;
+            granData->ownerQuietSteps[myOwner] = 0;
+            return;
+        }
+
+        // The acceleration here is the contacts' share only; gravity is not in it
+        float3 acc = make_float3(granData->aX[myOwner], granData->aY[myOwner], granData->aZ[myOwner]);
+        bool quiet = slow;
+        // The forces on a fixed or prescribed owner may change all they want without it moving
+        if (canSleep && !(myState & deme::SLEEP_NO_ACC_REF)) {
+            const float maxAccChange = (simParams->sleepMaxAccChange > 0.f)
+                                           ? simParams->sleepMaxAccChange
+                                           : DEME_SLEEP_ACC_CHANGE_FRACTION * maxVel / simParams->h;
+            quiet = quiet && length(acc - granData->ownerPrevAcc[myOwner]) < maxAccChange;
+        }
+        granData->ownerPrevAcc[myOwner] = acc;
+        unsigned int nQuietSteps = quiet ? granData->ownerQuietSteps[myOwner] + 1 : 0;
+        granData->ownerQuietSteps[myOwner] = nQuietSteps;
+
+        if (canSleep && nQuietSteps >= simParams->sleepQuietSteps) {
+            granData->vX[myOwner] = 0;
+            granData->vY[myOwner] = 0;
+            granData->vZ[myOwner] = 0;
+            granData->omgBarX[myOwner] = 0;
+            granData->omgBarY[myOwner] = 0;
+            granData->omgBarZ[myOwner] = 0;
+            granData->ownerSleepState[myOwner] = deme::SLEEP_ASLEEP;
+        } else {
+            granData->ownerSleepState[myOwner] = quiet ? 0 : deme::SLEEP_RESTLESS;
+        }
     }
 }
@@ -1,4 +1,5 @@
 // DEM misc. kernels
+#include <kernel/DEMHelperKernels.cu>
 #include <DEM/Defines.h>
 
 __global__ void markOwnerToChange(deme::notStupidBool_t* idBool,
@@ -49,3 +50,118 @@ __global__ void kTModifyComponents(deme::DEMDataKT* granData, deme::notStupidBoo
         }
     }
 }
+
+// An upper bound of how far any point of each owner moved since the reference (the state that the contact list in use
+// was detected with). It is the CoM displacement plus the most a rotation can move a point reach away from the CoM.
+__global__ void computeOwnerDisplacements(deme::DEMDataDT* granData,
+                                          deme::DEMSimParams* simParams,
+                                          float* ownerDisp,
+                                          size_t n) {
+    size_t ownerID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (ownerID < n) {
+        double X, Y, Z, refX, refY, refZ;
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            X, Y, Z, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+            granData->locZ[ownerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            refX, refY, refZ, granData->voxelID_cdRef[ownerID], granData->locX_cdRef[ownerID],
+            granData->locY_cdRef[ownerID], granData->locZ_cdRef[ownerID], simParams->nvXp2, simParams->nvYp2,
+            simParams->voxelSize, simParams->l);
+        // An owner that wrapped around a periodic side since CD only moved as far as its nearest image says
+        shiftToNearestPeriodicImage<double>(X, Y, Z, refX, refY, refZ, simParams);
+        double dX = X - refX, dY = Y - refY, dZ = Z - refZ;
+        // For unit quaternions q and p, a rotation by q moves a vector at most 2|v|min(|q-p|,|q+p|) away from the same
+        // vector rotated by p
+        float qDot = granData->oriQw[ownerID] * granData->oriQw_cdRef[ownerID] +
+                     granData->oriQx[ownerID] * granData->oriQx_cdRef[ownerID] +
+                     granData->oriQy[ownerID] * granData->oriQy_cdRef[ownerID] +
+                     granData->oriQz[ownerID] * granData->oriQz_cdRef[ownerID];
+        float qDist = sqrtf(fmaxf(2.f - 2.f * fabsf(qDot), 0.f));
+        ownerDisp[ownerID] = (float)sqrt(dX * dX + dY * dY + dZ * dZ) + 2.f * granData->ownerCDReach[ownerID] * qDist;
+    }
+}
+
+// The max velocity of any point of each owner, for the variable step size. It is the CoM velocity plus what the angular
+// velocity adds at reach away from the CoM.
+__global__ void computeOwnerMaxPointVel(deme::DEMDataDT* granData, float* ownerVel, size_t n) {
+    size_t ownerID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (ownerID < n) {
+        float3 v = make_float3(granData->vX[ownerID], granData->vY[ownerID], granData->vZ[ownerID]);
+        float3 omgBar = make_float3(granData->omgBarX[ownerID], granData->omgBarY[ownerID], granData->omgBarZ[ownerID]);
+        ownerVel[ownerID] = length(v) + length(omgBar) * granData->ownerCDReach[ownerID];
+    }
+}
+
+// Marks the staged clumps that have a sphere too close to a sphere at (X, Y, Z) of this radius
+inline __device__ void markInflowOverlapsOfSphere(const deme::DEMInflowGrid& grid,
+                                                  const double& X,
+                                                  const double& Y,
+                                                  const double& Z,
+                                                  const float& radius) {
+    double reach = (double)radius + grid.maxRadius + grid.clearance;
+    // The range of cells that this reach touches, if it touches the grid at all
+    double loX = (X - reach - grid.LBFX) / grid.cellSize, hiX = (X + reach - grid.LBFX) / grid.cellSize;
+    double loY = (Y - reach - grid.LBFY) / grid.cellSize, hiY = (Y + reach - grid.LBFY) / grid.cellSize;
+    double loZ = (Z - reach - grid.LBFZ) / grid.cellSize, hiZ = (Z + reach - grid.LBFZ) / grid.cellSize;
+    if (hiX < 0. || hiY < 0. || hiZ < 0. || loX >= grid.nCellX || loY >= grid.nCellY || loZ >= grid.nCellZ)
+        return;
+    int cellX0 = max(0, (int)floor(loX)), cellX1 = min((int)grid.nCellX - 1, (int)floor(hiX));
+    int cellY0 = max(0, (int)floor(loY)), cellY1 = min((int)grid.nCellY - 1, (int)floor(hiY));
+    int cellZ0 = max(0, (int)floor(loZ)), cellZ1 = min((int)grid.nCellZ - 1, (int)floor(hiZ));
+    for (int k = cellZ0; k <= cellZ1; k++) {
+        for (int j = cellY0; j <= cellY1; j++) {
+            for (int i = cellX0; i <= cellX1; i++) {
+                size_t cell = (size_t)i + (size_t)j * grid.nCellX + (size_t)k * grid.nCellX * grid.nCellY;
+                for (size_t s = grid.cellStart[cell]; s < grid.cellStart[cell + 1]; s++) {
+                    double dX = grid.sphX[s] - X, dY = grid.sphY[s] - Y, dZ = grid.sphZ[s] - Z;
+                    double minDist = (double)radius + grid.sphRadius[s] + grid.clearance;
+                    if (dX * dX + dY * dY + dZ * dZ < minDist * minDist) {
+                        grid.clumpRejected[grid.sphClump[s]] = 1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Each thread takes one existing sphere and marks the staged clumps (see DEMInflowGrid) that it overlaps. In periodic
+// directions, the images of the sphere one period away on either side are tested as well.
+__global__ void markInflowOverlaps(deme::DEMDataDT* granData,
+                                   deme::DEMSimParams* simParams,
+                                   deme::DEMInflowGrid grid,
+                                   bool useClumpJitify,
+                                   size_t n) {
+    size_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+    if (sphereID < n) {
+        deme::bodyID_t myOwner = granData->ownerClumpBody[sphereID];
+        size_t compOffset = (useClumpJitify) ? granData->clumpComponentOffsetExt[sphereID] : sphereID;
+        float myRadius = granData->radiiSphere[compOffset];
+        float myRelPosX = granData->relPosSphereX[compOffset];
+        float myRelPosY = granData->relPosSphereY[compOffset];
+        float myRelPosZ = granData->relPosSphereZ[compOffset];
+        applyOriQToVector3<float, deme::oriQ_t>(myRelPosX, myRelPosY, myRelPosZ, granData->oriQw[myOwner],
+                                                granData->oriQx[myOwner], granData->oriQy[myOwner],
+                                                granData->oriQz[myOwner]);
+        double X, Y, Z;
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            X, Y, Z, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+            granData->locZ[myOwner], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+        X += myRelPosX;
+        Y += myRelPosY;
+        Z += myRelPosZ;
+        for (int k = -1; k <= 1; k++) {
+            if (k != 0 && !simParams->periodicZ)
+                continue;
+            for (int j = -1; j <= 1; j++) {
+                if (j != 0 && !simParams->periodicY)
+                    continue;
+                for (int i = -1; i <= 1; i++) {
+                    if (i != 0 && !simParams->periodicX)
+                        continue;
+                    markInflowOverlapsOfSphere(grid, X + i * simParams->periodX, Y + j * simParams->periodY,
+                                               Z + k * simParams->periodZ, myRadius);
+                }
+            }
+        }
+    }
+}
@@ -8,6 +8,10 @@ inline __device__ void cleanUpContactForces(size_t thisContact,
     const float3 zeros = make_float3(0, 0, 0);
     granData->contactForces[thisContact] = zeros;
     granData->contactTorque_convToForce[thisContact] = zeros;
+    // Contacts that turn out not to be in contact (or are skipped) have no overlap
+    if (simParams->recordContactOverlap) {
+        granData->contactOverlap[thisContact] = 0;
+    }
 }
 
 inline __device__ void cleanUpAcc(size_t thisClump, deme::DEMSimParams* simParams, deme::DEMDataDT* granData) {